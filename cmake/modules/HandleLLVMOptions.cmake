@@ -39,6 +39,10 @@ else()
   endif()
 endif()
 
+if( LLVM_ENABLE_COMPACT_IR )
+  add_definitions( -DLLVM_COMPACT_IR )
+endif()
+
 if(WIN32)
   if(CYGWIN)
     set(LLVM_ON_WIN32 0)
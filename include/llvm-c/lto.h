@@ -20,7 +20,7 @@
 #include <stddef.h>
 #include <unistd.h>
 
-#define LTO_API_VERSION 4
+#define LTO_API_VERSION 5
 
 typedef enum {
     LTO_SYMBOL_ALIGNMENT_MASK              = 0x0000001F, /* log2 of alignment */
@@ -265,6 +265,50 @@ extern const void*
 lto_codegen_compile(lto_code_gen_t cg, size_t* length);
 
 
+/**
+ * Splits the optimized code into the given number of partitions, grouping
+ * functions that call each other, and generates code for them on up to
+ * threads threads (0 means one per hardware thread).  Each partition becomes
+ * a separate object file; see lto_codegen_get_num_objects().  The default is
+ * a single partition.
+ * Returns true on error (check lto_get_error_message() for details).
+ */
+extern bool
+lto_codegen_set_partitions(lto_code_gen_t cg, unsigned partitions,
+                           unsigned threads);
+
+/**
+ * Sets a directory in which object files are cached.  A link whose modules,
+ * preserved symbols and settings match an earlier one reuses its object files
+ * without optimizing or generating code.  Otherwise, each partition whose
+ * optimized code matches an earlier one reuses its object file.
+ */
+extern void
+lto_codegen_set_cache_dir(lto_code_gen_t cg, const char* path);
+
+/**
+ * Limits the cache directory to the given number of megabytes by evicting the
+ * least recently used entries.  Zero, the default, means no limit.
+ */
+extern void
+lto_codegen_set_cache_max_size(lto_code_gen_t cg, unsigned megabytes);
+
+/**
+ * Returns the number of object files produced by the last call to
+ * lto_codegen_compile(); the first one is the buffer it returned.
+ */
+extern unsigned
+lto_codegen_get_num_objects(lto_code_gen_t cg);
+
+/**
+ * Returns the object file at the given index, and sets length to its size.
+ * The buffer has the same lifetime as the one returned by
+ * lto_codegen_compile().  Returns NULL if index is out of range.
+ */
+extern const void*
+lto_codegen_get_object(lto_code_gen_t cg, unsigned index, size_t* length);
+
+
 /**
  * Sets options to help debug codegen bugs.
  */
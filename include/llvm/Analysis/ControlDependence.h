@@ -0,0 +1,120 @@
+//===- llvm/Analysis/ControlDependence.h - Control Dependences --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the ControlDependenceGraph class, which records for each
+// basic block of a function the blocks whose terminators decide whether it
+// runs.  Block Y is control dependent on block X if X is in the
+// post-dominance frontier of Y: some successor of X reaches Y's
+// post-dominators, but Y does not post-dominate X itself.
+//
+// The graph is computed from the PostDominatorTree in one bottom-up walk over
+// the tree, and stored as two arrays of block numbers sorted within each
+// block, one per direction.  Blocks that cannot reach an exit, such as those
+// in infinite loops, are not in the post-dominator tree and have no control
+// dependences.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_CONTROLDEPENDENCE_H
+#define LLVM_ANALYSIS_CONTROLDEPENDENCE_H
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+#include <iterator>
+#include <vector>
+
+namespace llvm {
+
+class BasicBlock;
+
+class ControlDependenceGraph : public FunctionPass {
+  /// Blocks - The blocks of the function, in order.  A block's position is
+  /// its number.
+  std::vector<BasicBlock*> Blocks;
+  DenseMap<const BasicBlock*, unsigned> BlockNumbers;
+
+  /// Dependents, DependentBegin - The blocks control dependent on block N are
+  /// Dependents[DependentBegin[N]] up to Dependents[DependentBegin[N + 1]].
+  std::vector<unsigned> Dependents, DependentBegin;
+
+  /// Controllers, ControllerBegin - Likewise, for the blocks that block N is
+  /// control dependent on.
+  std::vector<unsigned> Controllers, ControllerBegin;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+
+  ControlDependenceGraph() : FunctionPass(ID) {
+    initializeControlDependenceGraphPass(*PassRegistry::getPassRegistry());
+  }
+
+  /// block_iterator - Iterates over a list of block numbers, yielding the
+  /// blocks.
+  class block_iterator
+    : public std::iterator<std::forward_iterator_tag, BasicBlock*> {
+    const unsigned *I;
+    BasicBlock *const *Blocks;
+  public:
+    block_iterator(const unsigned *I, BasicBlock *const *Blocks)
+      : I(I), Blocks(Blocks) {}
+    BasicBlock *operator*() const { return Blocks[*I]; }
+    block_iterator &operator++() { ++I; return *this; }
+    block_iterator operator++(int) {
+      block_iterator Tmp = *this; ++I; return Tmp;
+    }
+    bool operator==(const block_iterator &RHS) const { return I == RHS.I; }
+    bool operator!=(const block_iterator &RHS) const { return I != RHS.I; }
+  };
+
+  /// dependent_begin/dependent_end - Iterate over the blocks that are control
+  /// dependent on BB, in function order.
+  block_iterator dependent_begin(const BasicBlock *BB) const {
+    return getRange(BB, Dependents, DependentBegin, false);
+  }
+  block_iterator dependent_end(const BasicBlock *BB) const {
+    return getRange(BB, Dependents, DependentBegin, true);
+  }
+
+  /// controller_begin/controller_end - Iterate over the blocks that BB is
+  /// control dependent on, in function order.
+  block_iterator controller_begin(const BasicBlock *BB) const {
+    return getRange(BB, Controllers, ControllerBegin, false);
+  }
+  block_iterator controller_end(const BasicBlock *BB) const {
+    return getRange(BB, Controllers, ControllerBegin, true);
+  }
+
+  /// isControlDependent - Return true if Dependent is control dependent on
+  /// Controller.
+  bool isControlDependent(const BasicBlock *Dependent,
+                          const BasicBlock *Controller) const;
+
+  virtual bool runOnFunction(Function &F);
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+  virtual void releaseMemory();
+  virtual void print(raw_ostream &OS, const Module *) const;
+
+private:
+  block_iterator getRange(const BasicBlock *BB,
+                          const std::vector<unsigned> &List,
+                          const std::vector<unsigned> &Begin,
+                          bool End) const {
+    DenseMap<const BasicBlock*, unsigned>::const_iterator I =
+      BlockNumbers.find(BB);
+    assert(I != BlockNumbers.end() && "Block not in this function!");
+    const unsigned *Base = List.empty() ? 0 : &List[0];
+    return block_iterator(Base + Begin[I->second + End], &Blocks[0]);
+  }
+};
+
+FunctionPass *createControlDependenceGraphPass();
+
+} // End llvm namespace
+
+#endif
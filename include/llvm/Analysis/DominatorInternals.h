@@ -12,6 +12,7 @@
 
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include <queue>
 
 //===----------------------------------------------------------------------===//
 //
@@ -276,6 +277,12 @@ void Calculate(DominatorTreeBase<typename GraphTraits<NodeT>::NodeType>& DT,
     DT.DomTreeNodes[W] = IDomNode->addChild(C);
   }
 
+  // A single exit gets a virtual root above it when some blocks cannot reach
+  // it, but it was numbered as the root of the search; give it its node here
+  // in case no other block needed it.
+  if (MultipleRoots && DT.Roots.size() == 1)
+    DT.getNodeForBlock(DT.Roots[0]);
+
   // Free temporary memory used to construct idom's
   DT.IDoms.clear();
   DT.Info.clear();
@@ -284,6 +291,478 @@ void Calculate(DominatorTreeBase<typename GraphTraits<NodeT>::NodeType>& DT,
   DT.updateDFSNumbers();
 }
 
+//===----------------------------------------------------------------------===//
+// Incremental updates
+//
+// insertEdge, deleteEdge and applyUpdates keep the tree in sync with CFG edits
+// without recomputing it.  Insertions use the depth-based search of Georgiadis
+// et al. ("An Experimental Study of Dynamic Dominators"): after inserting
+// From->To, a node is affected iff its level is greater than that of
+// NCD = NCA(From, To) plus one and it is reachable from To through nodes no
+// shallower than itself; every affected node becomes a child of NCD.
+// Deletions rebuild the subtree of the nearest common dominator of the edge
+// ends, which is the only part of the tree whose shape can change.
+//
+// Within these routines From and To name the edge in the graph the tree is
+// built over, i.e. they are swapped for postdominator trees.
+//===----------------------------------------------------------------------===//
+
+template<class NodeT>
+DomTreeNodeBase<NodeT> *
+DominatorTreeBase<NodeT>::findNCA(DomTreeNodeBase<NodeT> *A,
+                                  DomTreeNodeBase<NodeT> *B) {
+  while (A != B) {
+    if (A->getLevel() < B->getLevel())
+      std::swap(A, B);
+    A = A->getIDom();
+  }
+  return A;
+}
+
+/// getChildren - Put the successors of BB in the graph the tree is built over
+/// (or its predecessors, if Reverse is set) into Result, as the tree currently
+/// sees them while a batch of updates is pending.
+template<class NodeT>
+void DominatorTreeBase<NodeT>::getChildren(NodeT *BB, bool Reverse,
+                                           SmallVectorImpl<NodeT*> &Result) {
+  Result.clear();
+  bool CFGPreds = Reverse != this->IsPostDominators;
+  if (CFGPreds) {
+    typedef GraphTraits<Inverse<NodeT*> > GraphT;
+    Result.append(GraphT::child_begin(BB), GraphT::child_end(BB));
+  } else {
+    typedef GraphTraits<NodeT*> GraphT;
+    Result.append(GraphT::child_begin(BB), GraphT::child_end(BB));
+  }
+
+  PendingEdgeMapType &Pending = CFGPreds ? PendingPreds : PendingSuccs;
+  if (Pending.empty())
+    return;
+  typename PendingEdgeMapType::iterator I = Pending.find(BB);
+  if (I == Pending.end())
+    return;
+  // Each pending update stands for one instance of its edge.
+  for (unsigned i = 0, e = I->second.size(); i != e; ++i) {
+    NodeT *Other = I->second[i].first;
+    if (!I->second[i].second) {
+      Result.push_back(Other);
+      continue;
+    }
+    typename SmallVectorImpl<NodeT*>::iterator Pos =
+      std::find(Result.begin(), Result.end(), Other);
+    if (Pos != Result.end())
+      Result.erase(Pos);
+  }
+}
+
+template<class NodeT>
+bool DominatorTreeBase<NodeT>::hasEdge(NodeT *From, NodeT *To) {
+  SmallVector<NodeT*, 8> Succs;
+  getChildren(From, false, Succs);
+  return std::find(Succs.begin(), Succs.end(), To) != Succs.end();
+}
+
+template<class NodeT>
+void DominatorTreeBase<NodeT>::recalculateFrom(NodeT *BB) {
+  PendingSuccs.clear();
+  PendingPreds.clear();
+  recalculate(*BB->getParent());
+}
+
+/// computeRegionIDoms - Compute the immediate dominators of the blocks
+/// reachable from Root without leaving the region: the blocks in Subtree if
+/// it is given, and the blocks that are not in the tree otherwise.  The
+/// reached blocks are put into Order in postorder, so that Root comes last,
+/// and IDom[i] is the index in Order of the immediate dominator of Order[i]
+/// within the region.  If Exits is given, the edges that leave the region for
+/// a block in the tree are added to it.  This uses the iterative algorithm of
+/// Cooper, Harvey and Kennedy, which is fast on the small regions an update
+/// touches.
+template<class NodeT>
+void DominatorTreeBase<NodeT>::
+computeRegionIDoms(NodeT *Root, const SmallPtrSet<NodeT*, 32> *Subtree,
+                   std::vector<NodeT*> &Order, std::vector<unsigned> &IDom,
+                   SmallVectorImpl<std::pair<NodeT*, NodeT*> > *Exits) {
+  DenseMap<NodeT*, unsigned> Number;
+  SmallPtrSet<NodeT*, 32> Visited;
+  SmallVector<std::pair<NodeT*, bool>, 32> WorkStack;
+  SmallVector<NodeT*, 8> Children;
+  WorkStack.push_back(std::make_pair(Root, false));
+  while (!WorkStack.empty()) {
+    std::pair<NodeT*, bool> Top = WorkStack.pop_back_val();
+    NodeT *BB = Top.first;
+    if (Top.second) {
+      Number[BB] = Order.size();
+      Order.push_back(BB);
+      continue;
+    }
+    if (!Visited.insert(BB))
+      continue;
+    WorkStack.push_back(std::make_pair(BB, true));
+
+    getChildren(BB, false, Children);
+    for (unsigned i = Children.size(); i != 0; --i) {
+      NodeT *Succ = Children[i-1];
+      bool InRegion = Subtree ? Subtree->count(Succ) != 0 : !getNode(Succ);
+      if (InRegion) {
+        if (!Visited.count(Succ))
+          WorkStack.push_back(std::make_pair(Succ, false));
+      } else if (Exits && getNode(Succ)) {
+        Exits->push_back(std::make_pair(BB, Succ));
+      }
+    }
+  }
+
+  unsigned NumBlocks = Order.size();
+  std::vector<SmallVector<unsigned, 4> > Preds(NumBlocks);
+  for (unsigned i = 0; i + 1 < NumBlocks; ++i) {
+    getChildren(Order[i], true, Children);
+    for (unsigned j = 0, e = Children.size(); j != e; ++j) {
+      typename DenseMap<NodeT*, unsigned>::iterator I = Number.find(Children[j]);
+      if (I != Number.end())
+        Preds[i].push_back(I->second);
+    }
+  }
+
+  const unsigned Undef = ~0U;
+  IDom.assign(NumBlocks, Undef);
+  IDom[NumBlocks-1] = NumBlocks-1;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    // Visit the blocks in reverse postorder, skipping the root.
+    for (unsigned i = NumBlocks-1; i-- != 0; ) {
+      unsigned NewIDom = Undef;
+      for (unsigned j = 0, e = Preds[i].size(); j != e; ++j) {
+        unsigned P = Preds[i][j];
+        if (IDom[P] == Undef)
+          continue;
+        if (NewIDom == Undef) {
+          NewIDom = P;
+          continue;
+        }
+        // Walk both up to their nearest common dominator.  Dominators come
+        // later in postorder.
+        while (P != NewIDom) {
+          while (P < NewIDom)
+            P = IDom[P];
+          while (NewIDom < P)
+            NewIDom = IDom[NewIDom];
+        }
+      }
+      if (IDom[i] != NewIDom) {
+        IDom[i] = NewIDom;
+        Changed = true;
+      }
+    }
+  }
+}
+
+template<class NodeT>
+void DominatorTreeBase<NodeT>::
+insertReachable(DomTreeNodeBase<NodeT> *FromNode,
+                DomTreeNodeBase<NodeT> *ToNode) {
+  DomTreeNodeBase<NodeT> *NCD = findNCA(FromNode, ToNode);
+  const unsigned NCDLevel = NCD->getLevel();
+  // To is already a child of NCD (or NCD itself): nothing changes.
+  if (NCDLevel + 1 >= ToNode->getLevel())
+    return;
+  DFSInfoValid = false;
+
+  // Visit the candidates deepest first; the sequence number keeps the order
+  // deterministic among nodes on the same level.
+  std::vector<DomTreeNodeBase<NodeT>*> Queued(1, ToNode);
+  std::priority_queue<std::pair<unsigned, unsigned> > Bucket;
+  Bucket.push(std::make_pair(ToNode->getLevel(), 0U));
+  SmallPtrSet<DomTreeNodeBase<NodeT>*, 16> Visited;
+  Visited.insert(ToNode);
+  SmallVector<DomTreeNodeBase<NodeT>*, 16> Affected, UnaffectedOnCurrentLevel;
+  SmallVector<NodeT*, 8> Succs;
+
+  while (!Bucket.empty()) {
+    DomTreeNodeBase<NodeT> *Node = Queued[Bucket.top().second];
+    Bucket.pop();
+    Affected.push_back(Node);
+    const unsigned CurrentLevel = Node->getLevel();
+
+    while (true) {
+      getChildren(Node->getBlock(), false, Succs);
+      for (unsigned i = 0, e = Succs.size(); i != e; ++i) {
+        DomTreeNodeBase<NodeT> *SuccNode = getNode(Succs[i]);
+        if (!SuccNode || !Visited.insert(SuccNode))
+          continue;
+        const unsigned SuccLevel = SuccNode->getLevel();
+        if (SuccLevel > CurrentLevel) {
+          // Deeper than the node being processed: not affected itself, but
+          // the path through it may lead to affected nodes on this level.
+          UnaffectedOnCurrentLevel.push_back(SuccNode);
+        } else if (SuccLevel > NCDLevel + 1) {
+          Bucket.push(std::make_pair(SuccLevel, unsigned(Queued.size())));
+          Queued.push_back(SuccNode);
+        }
+      }
+      if (UnaffectedOnCurrentLevel.empty())
+        break;
+      Node = UnaffectedOnCurrentLevel.pop_back_val();
+    }
+  }
+
+  for (unsigned i = 0, e = Affected.size(); i != e; ++i)
+    Affected[i]->setIDom(NCD);
+}
+
+template<class NodeT>
+void DominatorTreeBase<NodeT>::
+insertUnreachable(DomTreeNodeBase<NodeT> *FromNode, NodeT *To) {
+  DFSInfoValid = false;
+  // Add the blocks that just became reachable through To, then process the
+  // edges from them into the rest of the tree as insertions.
+  std::vector<NodeT*> Order;
+  std::vector<unsigned> IDom;
+  SmallVector<std::pair<NodeT*, NodeT*>, 8> Exits;
+  computeRegionIDoms(To, 0, Order, IDom, &Exits);
+
+  DomTreeNodes[To] = FromNode->addChild(
+                       new DomTreeNodeBase<NodeT>(To, FromNode));
+  for (unsigned i = Order.size()-1; i-- != 0; ) {
+    DomTreeNodeBase<NodeT> *IDomNode = getNode(Order[IDom[i]]);
+    DomTreeNodes[Order[i]] = IDomNode->addChild(
+                               new DomTreeNodeBase<NodeT>(Order[i], IDomNode));
+  }
+
+  for (unsigned i = 0, e = Exits.size(); i != e; ++i)
+    insertReachable(getNode(Exits[i].first), getNode(Exits[i].second));
+}
+
+template<class NodeT>
+bool DominatorTreeBase<NodeT>::insertEdgeImpl(NodeT *From, NodeT *To) {
+  DomTreeNodeBase<NodeT> *FromNode = getNode(From);
+  // An edge out of an unreachable block changes nothing.
+  if (!FromNode)
+    return true;
+  if (DomTreeNodeBase<NodeT> *ToNode = getNode(To))
+    insertReachable(FromNode, ToNode);
+  else
+    insertUnreachable(FromNode, To);
+  return true;
+}
+
+/// hasProperSupport - Return true if Node is still reached through some
+/// predecessor that it does not dominate.
+template<class NodeT>
+bool DominatorTreeBase<NodeT>::hasProperSupport(DomTreeNodeBase<NodeT> *Node) {
+  SmallVector<NodeT*, 8> Preds;
+  getChildren(Node->getBlock(), true, Preds);
+  for (unsigned i = 0, e = Preds.size(); i != e; ++i)
+    if (DomTreeNodeBase<NodeT> *PredNode = getNode(Preds[i]))
+      if (findNCA(Node, PredNode) != Node)
+        return true;
+  return false;
+}
+
+template<class NodeT>
+void DominatorTreeBase<NodeT>::eraseSubtree(DomTreeNodeBase<NodeT> *Top) {
+  DFSInfoValid = false;
+  std::vector<DomTreeNodeBase<NodeT>*> &Siblings = Top->getIDom()->Children;
+  Siblings.erase(std::find(Siblings.begin(), Siblings.end(), Top));
+
+  SmallVector<DomTreeNodeBase<NodeT>*, 32> WorkStack(1, Top);
+  while (!WorkStack.empty()) {
+    DomTreeNodeBase<NodeT> *Node = WorkStack.pop_back_val();
+    WorkStack.append(Node->begin(), Node->end());
+    DomTreeNodes.erase(Node->getBlock());
+    delete Node;
+  }
+}
+
+/// rebuildSubtree - Recompute the part of the tree below Top, whose own
+/// immediate dominator is known to be unchanged, and drop the nodes that are
+/// no longer reachable.  Returns false if the whole tree was recalculated
+/// instead.
+template<class NodeT>
+bool DominatorTreeBase<NodeT>::rebuildSubtree(DomTreeNodeBase<NodeT> *Top) {
+  if (!Top->getIDom()) {
+    recalculateFrom(Top->getBlock() ? Top->getBlock() : this->Roots[0]);
+    return false;
+  }
+  DFSInfoValid = false;
+
+  SmallVector<DomTreeNodeBase<NodeT>*, 32> Nodes(1, Top);
+  SmallPtrSet<NodeT*, 32> Subtree;
+  for (unsigned i = 0; i != Nodes.size(); ++i) {
+    Subtree.insert(Nodes[i]->getBlock());
+    Nodes.append(Nodes[i]->begin(), Nodes[i]->end());
+  }
+
+  std::vector<NodeT*> Order;
+  std::vector<unsigned> IDom;
+  computeRegionIDoms(Top->getBlock(), &Subtree, Order, IDom, 0);
+  // A postdominator tree with a single exit as its root gets a virtual root
+  // once some block cannot reach the exit any more.
+  if (this->IsPostDominators && Order.size() != Nodes.size() &&
+      RootNode->getBlock()) {
+    recalculateFrom(Top->getBlock());
+    return false;
+  }
+
+  for (unsigned i = 0, e = Nodes.size(); i != e; ++i)
+    Nodes[i]->Children.clear();
+  // Reattach the reached nodes in reverse postorder, so that each node's
+  // immediate dominator has its final level before the node does.
+  for (unsigned i = Order.size()-1; i-- != 0; ) {
+    DomTreeNodeBase<NodeT> *Node = getNode(Order[i]);
+    DomTreeNodeBase<NodeT> *IDomNode = getNode(Order[IDom[i]]);
+    Node->IDom = IDomNode;
+    Node->Level = IDomNode->Level + 1;
+    IDomNode->Children.push_back(Node);
+  }
+  if (Order.size() == Nodes.size())
+    return true;
+
+  SmallPtrSet<NodeT*, 32> Reached;
+  Reached.insert(Order.begin(), Order.end());
+  for (unsigned i = 1, e = Nodes.size(); i != e; ++i)
+    if (!Reached.count(Nodes[i]->getBlock())) {
+      DomTreeNodes.erase(Nodes[i]->getBlock());
+      delete Nodes[i];
+    }
+  return true;
+}
+
+template<class NodeT>
+bool DominatorTreeBase<NodeT>::deleteEdgeImpl(NodeT *From, NodeT *To) {
+  DomTreeNodeBase<NodeT> *FromNode = getNode(From);
+  DomTreeNodeBase<NodeT> *ToNode = getNode(To);
+  // Nothing changes if the edge ended outside the tree, or if it was one of
+  // several edges between the same blocks.
+  if (!FromNode || !ToNode || hasEdge(From, To))
+    return true;
+  DomTreeNodeBase<NodeT> *NCD = findNCA(FromNode, ToNode);
+  // Nothing changes after deleting a back edge either.
+  if (NCD == ToNode)
+    return true;
+
+  if (ToNode->getIDom() != FromNode || hasProperSupport(ToNode))
+    return rebuildSubtree(NCD);
+
+  // Every path to To went through the deleted edge, so To and everything it
+  // dominates became unreachable.  The blocks they branched to lose those
+  // paths too; the ones whose immediate dominator can change are below the
+  // nearest common dominator of From and those blocks.
+  SmallVector<DomTreeNodeBase<NodeT>*, 32> Nodes(1, ToNode);
+  SmallPtrSet<NodeT*, 32> Subtree;
+  for (unsigned i = 0; i != Nodes.size(); ++i) {
+    Subtree.insert(Nodes[i]->getBlock());
+    Nodes.append(Nodes[i]->begin(), Nodes[i]->end());
+  }
+  SmallVector<NodeT*, 8> Succs;
+  bool HasExits = false;
+  for (unsigned i = 0, e = Nodes.size(); i != e; ++i) {
+    getChildren(Nodes[i]->getBlock(), false, Succs);
+    for (unsigned j = 0, je = Succs.size(); j != je; ++j) {
+      if (Subtree.count(Succs[j]))
+        continue;
+      if (DomTreeNodeBase<NodeT> *SuccNode = getNode(Succs[j])) {
+        NCD = findNCA(NCD, SuccNode);
+        HasExits = true;
+      }
+    }
+  }
+
+  if (this->IsPostDominators && RootNode->getBlock()) {
+    recalculateFrom(To);
+    return false;
+  }
+  if (!HasExits) {
+    eraseSubtree(ToNode);
+    return true;
+  }
+  return rebuildSubtree(NCD);
+}
+
+template<class NodeT>
+bool DominatorTreeBase<NodeT>::applyUpdate(const UpdateType &Update) {
+  NodeT *From = Update.From, *To = Update.To;
+  if (!this->IsPostDominators) {
+    if (Update.Kind == DomTreeUpdate::Insert)
+      return insertEdgeImpl(From, To);
+    return deleteEdgeImpl(From, To);
+  }
+
+  // The roots of a postdominator tree are the exit blocks, and whether they
+  // hang off a virtual root depends on the shape of the whole function.
+  // Recalculate when an update can change either.
+  SmallVector<NodeT*, 8> Succs;
+  if (Update.Kind == DomTreeUpdate::Insert) {
+    // From stops being an exit.
+    bool Recalculate = std::find(this->Roots.begin(), this->Roots.end(),
+                                 From) != this->Roots.end();
+    if (!getNode(To)) {
+      // To is a new exit, or a block that cannot reach an exit, which only a
+      // tree with a virtual root leaves out.
+      getChildren(To, true, Succs);
+      Recalculate |= Succs.empty() || (RootNode && RootNode->getBlock());
+    } else if (!getNode(From)) {
+      // From can reach an exit now, and may have been the last block that
+      // kept the virtual root in place.
+      Recalculate |= this->Roots.size() == 1 && !RootNode->getBlock();
+    }
+    if (Recalculate) {
+      recalculateFrom(From);
+      return false;
+    }
+    return insertEdgeImpl(To, From);
+  }
+
+  getChildren(From, true, Succs);
+  if (Succs.empty()) {
+    recalculateFrom(From);
+    return false;
+  }
+  return deleteEdgeImpl(To, From);
+}
+
+template<class NodeT>
+void DominatorTreeBase<NodeT>::applyUpdates(ArrayRef<UpdateType> Updates) {
+  if (Updates.empty())
+    return;
+  if (Updates.size() == 1) {
+    applyUpdate(Updates[0]);
+    return;
+  }
+  // Recalculating is cheaper than many updates to a small tree.
+  if (Updates.size() > 64 && Updates.size() > DomTreeNodes.size() / 16) {
+    recalculateFrom(Updates[0].From);
+    return;
+  }
+
+  for (unsigned i = 0, e = Updates.size(); i != e; ++i) {
+    bool Inserted = Updates[i].Kind == DomTreeUpdate::Insert;
+    PendingSuccs[Updates[i].From].push_back(
+      std::make_pair(Updates[i].To, Inserted));
+    PendingPreds[Updates[i].To].push_back(
+      std::make_pair(Updates[i].From, Inserted));
+  }
+
+  for (unsigned i = 0, e = Updates.size(); i != e; ++i) {
+    const UpdateType &Update = Updates[i];
+    std::pair<NodeT*, bool> Succ(Update.To,
+                                 Update.Kind == DomTreeUpdate::Insert);
+    std::pair<NodeT*, bool> Pred(Update.From, Succ.second);
+    SmallVectorImpl<std::pair<NodeT*, bool> > &Succs =
+      PendingSuccs[Update.From];
+    Succs.erase(std::find(Succs.begin(), Succs.end(), Succ));
+    SmallVectorImpl<std::pair<NodeT*, bool> > &Preds = PendingPreds[Update.To];
+    Preds.erase(std::find(Preds.begin(), Preds.end(), Pred));
+
+    // A recalculation already saw the CFG with every update applied.
+    if (!applyUpdate(Update))
+      break;
+  }
+  PendingSuccs.clear();
+  PendingPreds.clear();
+}
+
 }
 
 #endif
@@ -17,6 +17,7 @@
 
 #include "llvm/Pass.h"
 #include "llvm/Function.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
@@ -65,6 +66,7 @@ class DomTreeNodeBase {
   NodeT *TheBB;
   DomTreeNodeBase<NodeT> *IDom;
   std::vector<DomTreeNodeBase<NodeT> *> Children;
+  unsigned Level;
   int DFSNumIn, DFSNumOut;
 
   template<class N> friend class DominatorTreeBase;
@@ -85,8 +87,13 @@ public:
     return Children;
   }
 
+  /// getLevel - Return the depth of this node in the tree.  The root is at
+  /// level 0.
+  unsigned getLevel() const { return Level; }
+
   DomTreeNodeBase(NodeT *BB, DomTreeNodeBase<NodeT> *iDom)
-    : TheBB(BB), IDom(iDom), DFSNumIn(-1), DFSNumOut(-1) { }
+    : TheBB(BB), IDom(iDom), Level(iDom ? iDom->Level + 1 : 0),
+      DFSNumIn(-1), DFSNumOut(-1) { }
 
   DomTreeNodeBase<NodeT> *addChild(DomTreeNodeBase<NodeT> *C) {
     Children.push_back(C);
@@ -132,6 +139,7 @@ public:
       // Switch to new dominator
       IDom = NewIDom;
       IDom->Children.push_back(this);
+      updateLevel();
     }
   }
 
@@ -146,6 +154,21 @@ private:
     return this->DFSNumIn >= other->DFSNumIn &&
       this->DFSNumOut <= other->DFSNumOut;
   }
+
+  /// updateLevel - Recompute the level of this node and of the nodes it
+  /// dominates after it was moved under a new immediate dominator.
+  void updateLevel() {
+    if (Level == IDom->Level + 1)
+      return;
+    SmallVector<DomTreeNodeBase<NodeT>*, 32> WorkStack(1, this);
+    while (!WorkStack.empty()) {
+      DomTreeNodeBase<NodeT> *Node = WorkStack.pop_back_val();
+      Node->Level = Node->IDom->Level + 1;
+      for (iterator I = Node->begin(), E = Node->end(); I != E; ++I)
+        if ((*I)->Level != Node->Level + 1)
+          WorkStack.push_back(*I);
+    }
+  }
 };
 
 EXTERN_TEMPLATE_INSTANTIATION(class DomTreeNodeBase<BasicBlock>);
@@ -175,6 +198,11 @@ static void PrintDomTree(const DomTreeNodeBase<NodeT> *N, raw_ostream &o,
 
 typedef DomTreeNodeBase<BasicBlock> DomTreeNode;
 
+namespace DomTreeUpdate {
+  /// Kind - Whether a CFG edge described by an update was inserted or deleted.
+  enum Kind { Insert, Delete };
+}
+
 //===----------------------------------------------------------------------===//
 /// DominatorTree - Calculate the immediate dominator tree for a function.
 ///
@@ -210,6 +238,16 @@ protected:
   // Info - Collection of information used during the computation of idoms.
   DenseMap<NodeT*, InfoRec> Info;
 
+  // PendingSuccs/PendingPreds - While applyUpdates works through a batch, the
+  // CFG edges of the batch that are not processed yet, keyed by their source
+  // and destination block.  Edges still to be inserted are hidden from the
+  // update algorithms and edges still to be deleted stay visible, so that the
+  // algorithms see the CFG the tree currently describes.  The flag is true for
+  // insertions.
+  typedef DenseMap<NodeT*, SmallVector<std::pair<NodeT*, bool>, 2> >
+    PendingEdgeMapType;
+  PendingEdgeMapType PendingSuccs, PendingPreds;
+
   void reset() {
     for (typename DomTreeNodeMapType::iterator I = this->DomTreeNodes.begin(),
            E = DomTreeNodes.end(); I != E; ++I)
@@ -545,6 +583,38 @@ public:
       this->Split<NodeT*, GraphTraits<NodeT*> >(*this, NewBB);
   }
 
+  /// UpdateType - A CFG edge that was inserted or deleted, as passed to
+  /// applyUpdates.
+  struct UpdateType {
+    DomTreeUpdate::Kind Kind;
+    NodeT *From, *To;
+    UpdateType(DomTreeUpdate::Kind K, NodeT *F, NodeT *T)
+      : Kind(K), From(F), To(T) {}
+  };
+
+  /// insertEdge - Update the tree after the edge From->To was added to the
+  /// CFG.  To may be a block that is not in the tree yet; it is added along
+  /// with the blocks that only became reachable through it.  Only the nodes
+  /// whose immediate dominator changes are touched.
+  void insertEdge(NodeT *From, NodeT *To) {
+    applyUpdate(UpdateType(DomTreeUpdate::Insert, From, To));
+  }
+
+  /// deleteEdge - Update the tree after the edge From->To was removed from
+  /// the CFG.  Blocks that became unreachable are removed from the tree.  If
+  /// From still branches to To, nothing changes.  Only the subtree below the
+  /// nearest common dominator of From and To is rebuilt; if that is the root,
+  /// the tree is recalculated.
+  void deleteEdge(NodeT *From, NodeT *To) {
+    applyUpdate(UpdateType(DomTreeUpdate::Delete, From, To));
+  }
+
+  /// applyUpdates - Update the tree after all of the given CFG edges were
+  /// inserted or deleted.  Unlike a sequence of insertEdge and deleteEdge
+  /// calls, this may be called once the CFG reflects every update.  The blocks
+  /// named by the updates must still be in the function.
+  void applyUpdates(ArrayRef<UpdateType> Updates);
+
   /// print - Convert to human readable form
   ///
   void print(raw_ostream &o) const {
@@ -649,6 +719,26 @@ protected:
     this->Roots.push_back(BB);
   }
 
+  // Incremental update helpers; see DominatorInternals.h.
+  bool applyUpdate(const UpdateType &Update);
+  bool insertEdgeImpl(NodeT *From, NodeT *To);
+  bool deleteEdgeImpl(NodeT *From, NodeT *To);
+  void insertReachable(DomTreeNodeBase<NodeT> *FromNode,
+                       DomTreeNodeBase<NodeT> *ToNode);
+  void insertUnreachable(DomTreeNodeBase<NodeT> *FromNode, NodeT *To);
+  bool rebuildSubtree(DomTreeNodeBase<NodeT> *Top);
+  void eraseSubtree(DomTreeNodeBase<NodeT> *Top);
+  bool hasProperSupport(DomTreeNodeBase<NodeT> *Node);
+  void computeRegionIDoms(NodeT *Root, const SmallPtrSet<NodeT*, 32> *Subtree,
+                          std::vector<NodeT*> &Order,
+                          std::vector<unsigned> &IDom,
+                          SmallVectorImpl<std::pair<NodeT*, NodeT*> > *Exits);
+  void getChildren(NodeT *BB, bool Reverse, SmallVectorImpl<NodeT*> &Result);
+  bool hasEdge(NodeT *From, NodeT *To);
+  void recalculateFrom(NodeT *BB);
+  static DomTreeNodeBase<NodeT> *findNCA(DomTreeNodeBase<NodeT> *A,
+                                         DomTreeNodeBase<NodeT> *B);
+
 public:
   /// recalculate - compute a dominator tree for the given function
   template<class FT>
@@ -702,6 +792,8 @@ public:
 
   DominatorTreeBase<BasicBlock>& getBase() { return *DT; }
 
+  typedef DominatorTreeBase<BasicBlock>::UpdateType UpdateType;
+
   /// getRoots - Return the root blocks of the current CFG.  This may include
   /// multiple blocks if we are computing post dominators.  For forward
   /// dominators, this will always be a single block (the entry node).
@@ -814,6 +906,24 @@ public:
     DT->splitBlock(NewBB);
   }
 
+  /// insertEdge - Update the tree after the edge From->To was added to the
+  /// CFG.
+  inline void insertEdge(BasicBlock *From, BasicBlock *To) {
+    DT->insertEdge(From, To);
+  }
+
+  /// deleteEdge - Update the tree after the edge From->To was removed from
+  /// the CFG.
+  inline void deleteEdge(BasicBlock *From, BasicBlock *To) {
+    DT->deleteEdge(From, To);
+  }
+
+  /// applyUpdates - Update the tree after a batch of CFG edits, once the CFG
+  /// reflects all of them.
+  inline void applyUpdates(ArrayRef<UpdateType> Updates) {
+    DT->applyUpdates(Updates);
+  }
+
   bool isReachableFromEntry(const BasicBlock* A) {
     return DT->isReachableFromEntry(A);
   }
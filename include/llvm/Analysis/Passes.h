@@ -187,6 +187,9 @@ namespace llvm {
   // Print module-level debug info metadata in human-readable form.
   ModulePass *createModuleDebugInfoPrinterPass();
 
+  // Print how much memory the IR of a module takes, by class of object.
+  ModulePass *createIRMemoryUsagePass();
+
   //===--------------------------------------------------------------------===//
   //
   // createMemDepPrinter - This pass exhaustively collects all memdep
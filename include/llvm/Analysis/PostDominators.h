@@ -32,6 +32,8 @@ struct PostDominatorTree : public FunctionPass {
 
   ~PostDominatorTree();
 
+  typedef DominatorTreeBase<BasicBlock>::UpdateType UpdateType;
+
   virtual bool runOnFunction(Function &F);
 
   virtual void getAnalysisUsage(AnalysisUsage &AU) const {
@@ -74,6 +76,20 @@ struct PostDominatorTree : public FunctionPass {
     return DT->findNearestCommonDominator(A, B);
   }
 
+  /// insertEdge, deleteEdge, applyUpdates - Update the tree after CFG edits;
+  /// see DominatorTreeBase.
+  inline void insertEdge(BasicBlock *From, BasicBlock *To) {
+    DT->insertEdge(From, To);
+  }
+
+  inline void deleteEdge(BasicBlock *From, BasicBlock *To) {
+    DT->deleteEdge(From, To);
+  }
+
+  inline void applyUpdates(ArrayRef<UpdateType> Updates) {
+    DT->applyUpdates(Updates);
+  }
+
   virtual void releaseMemory() {
     DT->releaseMemory();
   }
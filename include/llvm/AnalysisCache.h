@@ -0,0 +1,141 @@
+//===- llvm/AnalysisCache.h - Function analyses kept across runs -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the AnalysisCache class.  A pass manager frees or reruns
+// a function analysis whenever a pass does not preserve it, and discards it at
+// the end of every run, so the same DominatorTree or LoopInfo is often built
+// many times for a function that did not change.  An AnalysisCache attached to
+// pass managers keeps one instance of each analysis it is told about per
+// function, and computes it again only after a pass that does not preserve it
+// reports that it changed that function:
+//
+//   AnalysisCache Cache;
+//   Cache.addAnalysis(&DominatorTree::ID);
+//   Cache.addAnalysis(&LoopInfo::ID);
+//   FunctionPassManager FPM(M);
+//   FPM.setAnalysisCache(&Cache);
+//
+// The results stay in the cache across runs of the pass managers, and across
+// pass managers, until the function is deleted or the cache is destroyed.  A
+// client that changes a function outside of these pass managers must call
+// invalidate() on it.  A module pass that asks for an analysis of a function
+// through getAnalysis<>(F) gets the kept results only on its first request for
+// that function; later requests compute them again, since the pass may have
+// changed the function in between.  A module pass that changes a function
+// before its first request for it must still call invalidate() on it.
+//
+// An analysis is only kept if everything it requires is kept as well or is an
+// immutable pass; otherwise it runs as usual.  The cache is not thread safe.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSISCACHE_H
+#define LLVM_ANALYSISCACHE_H
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace llvm {
+
+class Function;
+class PMDataManager;
+
+class AnalysisCache {
+  class FunctionResults;
+  struct AnalysisInfo;
+
+  /// Infos - The analyses to keep, as registered with addAnalysis, and what
+  /// is known about each of them.
+  DenseMap<AnalysisID, AnalysisInfo*> Infos;
+
+  /// Results - The instances kept for each function.
+  DenseMap<const Function*, FunctionResults*> Results;
+
+  /// CurrentFunction - The function the pass managers are working on, or
+  /// null when they run a module level pass.
+  Function *CurrentFunction;
+
+  /// Manager - The pass manager of the analysis instances the cache owns.
+  PMDataManager *Manager;
+
+  unsigned NumHits, NumMisses;
+
+  AnalysisCache(const AnalysisCache &);   // DO NOT IMPLEMENT
+  void operator=(const AnalysisCache &);  // DO NOT IMPLEMENT
+
+  AnalysisInfo *getInfo(AnalysisID ID);
+  bool isCached(AnalysisID ID, PMDataManager &PM);
+  Pass *getResult(AnalysisID ID, Function &F, PMDataManager &PM);
+  void forget(const Function *F);
+
+public:
+  AnalysisCache();
+  ~AnalysisCache();
+
+  /// addAnalysis - Keep the results of the function analysis with the given
+  /// ID.  Analysis groups cannot be kept, only the passes implementing them.
+  void addAnalysis(AnalysisID ID);
+
+  /// invalidate - Forget every result for F.
+  void invalidate(Function &F);
+
+  /// clear - Forget every result.
+  void clear();
+
+  /// getNumHits - Return how many times an analysis did not run because its
+  /// results were kept.
+  unsigned getNumHits() const { return NumHits; }
+
+  /// getNumMisses - Return how many times the cache had to compute results.
+  unsigned getNumMisses() const { return NumMisses; }
+
+  //===--------------------------------------------------------------------===//
+  // The interface below is used by the pass managers.
+
+  /// isCached - Return true if the results of analysis pass P, scheduled in
+  /// PM, are kept in the cache.
+  bool isCached(Pass *P, PMDataManager &PM) {
+    return Infos.count(P->getPassID()) && isCached(P->getPassID(), PM);
+  }
+
+  /// getCachedPass - Return the instance that holds the results of the
+  /// analysis implemented by P for F, computing them if they are out of date.
+  /// Return P itself if its results are not kept.
+  Pass *getCachedPass(Pass *P, Function &F, PMDataManager &PM);
+
+  /// getCachedPass - Likewise, for the function being processed.  Return P if
+  /// no function is being processed.
+  Pass *getCachedPass(Pass *P, PMDataManager &PM) {
+    return CurrentFunction ? getCachedPass(P, *CurrentFunction, PM) : P;
+  }
+
+  /// runCachedPass - Run analysis pass P, whose results are kept, on F: only
+  /// compute them if those kept for F are out of date.
+  void runCachedPass(Pass *P, Function &F, PMDataManager &PM);
+
+  /// setCurrentFunction - Set the function being processed, or null, and
+  /// return the previous one.
+  Function *setCurrentFunction(Function *F) {
+    Function *Old = CurrentFunction;
+    CurrentFunction = F;
+    return Old;
+  }
+
+  /// invalidate - Forget the results for F that a pass with usage AU does not
+  /// preserve.  The pass managers call this after a pass changed F.
+  void invalidate(Function &F, const AnalysisUsage &AU);
+
+  /// invalidate - Likewise, for every function.  This is used for passes that
+  /// do not say which functions they changed.
+  void invalidate(const AnalysisUsage &AU);
+};
+
+} // End llvm namespace
+
+#endif
@@ -54,7 +54,8 @@ class ArchiveMember : public ilist_node<ArchiveMember> {
       BitcodeFlag = 16,            ///< Member is bitcode
       HasPathFlag = 64,            ///< Member has a full or partial path
       HasLongFilenameFlag = 128,   ///< Member uses the long filename syntax
-      StringTableFlag = 256        ///< Member is an ar(1) format string table
+      StringTableFlag = 256,       ///< Member is an ar(1) format string table
+      LLVMSymbolIndexFlag = 512    ///< Member is the LLVM symbol table index
     };
 
   /// @}
@@ -126,6 +127,11 @@ class ArchiveMember : public ilist_node<ArchiveMember> {
     /// @brief Determine if this member is the LLVM symbol table.
     bool isLLVMSymbolTable() const { return flags&LLVMSymbolTableFlag; }
 
+    /// @returns true iff the archive member is the hash index of the LLVM
+    /// symbol table
+    /// @brief Determine if this member is the LLVM symbol table index.
+    bool isLLVMSymbolIndex() const { return flags&LLVMSymbolIndexFlag; }
+
     /// @returns true iff the archive member is the ar(1) string table
     /// @brief Determine if this member is the ar(1) string table.
     bool isStringTable() const { return flags&StringTableFlag; }
@@ -345,10 +351,12 @@ class Archive {
     /// offset in the symbol table to obtain the real file offset. Note that
     /// there is purposefully no interface provided by Archive to look up
     /// members by their offset. Use the findModulesDefiningSymbols and
-    /// findModuleDefiningSymbol methods instead.
+    /// findModuleDefiningSymbol methods instead. If the archive was opened
+    /// with OpenAndLoadSymbols and has a symbol table index, the symbol table
+    /// is only parsed the first time this method is called.
     /// @returns the Archive's symbol table.
     /// @brief Get the archive's symbol table
-    const SymTabType& getSymbolTable() { return symTab; }
+    const SymTabType& getSymbolTable();
 
     /// This method returns the offset in the archive file to the first "real"
     /// file member. Archive files, on disk, have a signature and might have a
@@ -458,6 +466,26 @@ class Archive {
     /// @brief Parse the symbol table at \p data.
     bool parseSymbolTable(const void* data,unsigned len,std::string* error);
 
+    /// @param data The symbol table index data to be checked
+    /// @param len  The length of the symbol table index data
+    /// @returns false if the index is malformed and must be ignored
+    /// @brief Use the hash index at \p data for symbol lookups.
+    bool setSymbolIndex(const char* data, unsigned len);
+
+    /// Find \p symbol in the symbol table, probing the on-disk hash index if
+    /// there is one, and set \p offset to the offset of the defining member
+    /// relative to the first file.
+    /// @returns false if the symbol is not defined by the archive.
+    /// @brief Look up a symbol's member offset.
+    bool lookupSymbol(const std::string& symbol, unsigned& offset);
+
+    /// Build the symbol table of an archive without one by reading the symbols
+    /// of every bitcode member. The members are read in parallel when LLVM is
+    /// multithreaded.
+    /// @returns false on error
+    /// @brief Build the symbol table from the archive members.
+    bool scanMemberSymbols(std::string* error);
+
     /// @returns A fully populated ArchiveMember or 0 if an error occurred.
     /// @brief Parse the header of a member starting at \p At
     ArchiveMember* parseMemberHeader(
@@ -484,6 +512,9 @@ class Archive {
     /// @brief Write the symbol table to an ofstream.
     void writeSymbolTable(std::ofstream& ARFile);
 
+    /// @brief Write the hash index of the symbol table to an ofstream.
+    void writeSymbolIndex(std::ofstream& ARFile);
+
     /// Writes one ArchiveMember to an ofstream. If an error occurs, returns
     /// false, otherwise true. If an error occurs and error is non-null then
     /// it will be set to an error message.
@@ -527,6 +558,10 @@ class Archive {
     SymTabType symTab;        ///< The symbol table
     std::string strtab;       ///< The string table for long file names
     unsigned symTabSize;      ///< Size in bytes of symbol table
+    const char* symTabData;   ///< Unparsed symbol table, when indexed
+    const char* symIndex;     ///< Buckets of the symbol table hash index
+    unsigned symIndexBuckets; ///< Number of buckets in symIndex
+    bool membersScanned;      ///< symTab was built by scanning the members
     unsigned firstFileOffset; ///< Offset to first normal file.
     ModuleMap modules;        ///< The modules loaded via symbol lookup.
     ArchiveMember* foreignST; ///< This holds the foreign symbol table.
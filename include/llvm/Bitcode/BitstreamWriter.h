@@ -17,6 +17,7 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Bitcode/BitCodes.h"
+#include "llvm/Support/raw_ostream.h"
 #include <vector>
 
 namespace llvm {
@@ -24,6 +25,17 @@ namespace llvm {
 class BitstreamWriter {
   std::vector<unsigned char> &Out;
 
+  /// FS - If non-null, the file that FlushToFile moves the bytes of Out to,
+  /// so that only the most recent part of the stream is kept in memory.
+  /// Words that were already moved are backpatched in the file.
+  raw_fd_ostream *FS;
+
+  /// FSStart - The position in FS of the start of the stream.
+  uint64_t FSStart;
+
+  /// FlushedBytes - The number of bytes moved from Out to FS.
+  uint64_t FlushedBytes;
+
   /// CurBit - Always between 0 and 31 inclusive, specifies the next bit to use.
   unsigned CurBit;
 
@@ -61,7 +73,17 @@ class BitstreamWriter {
 
 public:
   explicit BitstreamWriter(std::vector<unsigned char> &O)
-    : Out(O), CurBit(0), CurValue(0), CurCodeSize(2) {}
+    : Out(O), FS(0), FSStart(0), FlushedBytes(0), CurBit(0), CurValue(0),
+      CurCodeSize(2) {}
+
+  /// BitstreamWriter - Create a writer that buffers in O, and moves the
+  /// buffered words to FS when FlushToFile is called.  FS must support
+  /// seeking.
+  BitstreamWriter(std::vector<unsigned char> &O, raw_fd_ostream &fs)
+    : Out(O), FS(&fs), FSStart(fs.tell()), FlushedBytes(0), CurBit(0),
+      CurValue(0), CurCodeSize(2) {
+    assert(fs.supportsSeeking() && "Cannot backpatch a stream without seek!");
+  }
 
   ~BitstreamWriter() {
     assert(CurBit == 0 && "Unflused data remaining");
@@ -81,7 +103,21 @@ public:
   std::vector<unsigned char> &getBuffer() { return Out; }
 
   /// \brief Retrieve the current position in the stream, in bits.
-  uint64_t GetCurrentBitNo() const { return Out.size() * 8 + CurBit; }
+  uint64_t GetCurrentBitNo() const { return GetBufferOffset() * 8 + CurBit; }
+
+  /// GetBufferOffset - Return the number of complete bytes in the stream,
+  /// including those already moved to the file.
+  uint64_t GetBufferOffset() const { return FlushedBytes + Out.size(); }
+
+  /// FlushToFile - If the stream has a file, and more than Threshold bytes are
+  /// buffered, move them to the file.
+  void FlushToFile(size_t Threshold = 1 << 20) {
+    if (!FS || Out.size() <= Threshold)
+      return;
+    FS->write((const char*)&Out[0], Out.size());
+    FlushedBytes += Out.size();
+    Out.clear();
+  }
 
   //===--------------------------------------------------------------------===//
   // Basic Primitives for emitting bits to the stream.
@@ -166,7 +202,20 @@ public:
 
   // BackpatchWord - Backpatch a 32-bit word in the output with the specified
   // value.
-  void BackpatchWord(unsigned ByteNo, unsigned NewWord) {
+  void BackpatchWord(uint64_t ByteNo, unsigned NewWord) {
+    if (ByteNo < FlushedBytes) {
+      // The word was already moved to the file; overwrite it there.
+      char Bytes[4] = {
+        char(NewWord >> 0), char(NewWord >> 8), char(NewWord >> 16),
+        char(NewWord >> 24)
+      };
+      uint64_t End = FS->tell();
+      FS->seek(FSStart + ByteNo);
+      FS->write(Bytes, 4);
+      FS->seek(End);
+      return;
+    }
+    ByteNo -= FlushedBytes;
     Out[ByteNo++] = (unsigned char)(NewWord >>  0);
     Out[ByteNo++] = (unsigned char)(NewWord >>  8);
     Out[ByteNo++] = (unsigned char)(NewWord >> 16);
@@ -199,7 +248,7 @@ public:
     EmitVBR(CodeLen, bitc::CodeLenWidth);
     FlushToWord();
 
-    unsigned BlockSizeWordLoc = static_cast<unsigned>(Out.size());
+    unsigned BlockSizeWordLoc = static_cast<unsigned>(GetBufferOffset());
     unsigned OldCodeSize = CurCodeSize;
 
     // Emit a placeholder, which will be replaced when the block is popped.
@@ -239,8 +288,9 @@ public:
     FlushToWord();
 
     // Compute the size of the block, in words, not counting the size field.
-    unsigned SizeInWords= static_cast<unsigned>(Out.size())/4-B.StartSizeWord-1;
-    unsigned ByteNo = B.StartSizeWord*4;
+    unsigned SizeInWords =
+      static_cast<unsigned>(GetBufferOffset()/4) - B.StartSizeWord - 1;
+    uint64_t ByteNo = uint64_t(B.StartSizeWord)*4;
 
     // Update the block size field in the header of this sub-block.
     BackpatchWord(ByteNo, SizeInWords);
@@ -251,6 +301,28 @@ public:
     BlockScope.pop_back();
   }
 
+  /// EmitEncodedBlock - Emit a block whose contents, from after its header up
+  /// to and including its END_BLOCK, were encoded by another BitstreamWriter
+  /// that had the same block info, and are passed in [Begin, End).
+  void EmitEncodedBlock(unsigned BlockID, unsigned CodeLen,
+                        const unsigned char *Begin, const unsigned char *End) {
+    assert((End - Begin) % 4 == 0 && "Block contents are not whole words!");
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    Emit(static_cast<uint32_t>((End - Begin) / 4), bitc::BlockSizeWidth);
+
+    // Write large blocks straight to the file rather than copying them.
+    if (FS && size_t(End - Begin) > 4096) {
+      FlushToFile(0);
+      FS->write((const char*)Begin, End - Begin);
+      FlushedBytes += End - Begin;
+      return;
+    }
+    Out.insert(Out.end(), Begin, End);
+  }
+
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
@@ -35,7 +35,8 @@ namespace bitc {
     TYPE_SYMTAB_BLOCK_ID,
     VALUE_SYMTAB_BLOCK_ID,
     METADATA_BLOCK_ID,
-    METADATA_ATTACHMENT_ID
+    METADATA_ATTACHMENT_ID,
+    FUNCTION_INDEX_BLOCK_ID
   };
 
 
@@ -260,6 +261,19 @@ namespace bitc {
 
     FUNC_CODE_DEBUG_LOC2       = 35  // DEBUG_LOC2: [Line,Col,ScopeVal, IAVal]
   };
+
+  // The function index blocks (FUNCTION_INDEX_BLOCK_ID) let a reader find the
+  // function blocks of a module without walking over them.  One just before
+  // the function blocks holds the OFFSET of the other, which follows the
+  // function blocks and has an ENTRY for each of them, in order.
+  enum FunctionIndexCodes {
+    // OFFSET: [words from the end of this record to the index, fixed32]
+    FNINDEX_CODE_OFFSET = 1,
+    // ENTRY: [valueid, bits from the end of the previous block to the
+    //         function block, size in bits, sorted valueids of the global
+    //         values that it refers to]
+    FNINDEX_CODE_ENTRY  = 2
+  };
 } // End bitc namespace
 } // End llvm namespace
 
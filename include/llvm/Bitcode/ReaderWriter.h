@@ -23,6 +23,7 @@ namespace llvm {
   class BitstreamWriter;
   class LLVMContext;
   class raw_ostream;
+  class raw_fd_ostream;
   
   /// getLazyBitcodeModule - Read the header of the specified bitcode buffer
   /// and prepare for lazy deserialization of function bodies.  If successful,
@@ -48,11 +49,28 @@ namespace llvm {
   Module *ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
                            std::string *ErrMsg = 0);
 
+  /// ParseBitcodeFile - Read the specified bitcode file, decoding the
+  /// function blocks on the specified number of threads, or on one per
+  /// processor if it is zero, once llvm_start_multithreaded() has been
+  /// called.  The IR is built on the calling thread, in the same order as
+  /// with a single thread.  This method *never* takes ownership of Buffer.
+  Module *ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
+                           std::string *ErrMsg, unsigned Threads);
+
   /// WriteBitcodeToFile - Write the specified module to the specified
   /// raw output stream.  For streams where it matters, the given stream
   /// should be in "binary" mode.
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out);
 
+  /// WriteBitcodeToFile - Write the specified module to the specified file,
+  /// encoding function bodies on the specified number of threads, or on one
+  /// per processor if it is zero, once llvm_start_multithreaded() has been
+  /// called.  The function blocks are spliced into the file in order as they
+  /// are done.  If the file supports seeking, the bitcode is written out as
+  /// it is produced instead of being held in memory as a whole.
+  void WriteBitcodeToFile(const Module *M, raw_fd_ostream &Out,
+                          unsigned Threads);
+
   /// WriteBitcodeToStream - Write the specified module to the specified
   /// raw output stream.
   void WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream);
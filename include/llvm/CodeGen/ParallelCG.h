@@ -0,0 +1,92 @@
+//===-- llvm/CodeGen/ParallelCG.h - Parallel code generation ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares utilities for splitting a module into independently
+// compilable partitions and generating code for them on several threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_PARALLELCG_H
+#define LLVM_CODEGEN_PARALLELCG_H
+
+#include "llvm/Target/TargetMachine.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class Module;
+class Target;
+
+/// SplitModuleForCodeGen - Distribute the function definitions of \p M over
+/// \p NumParts partitions, balancing them by instruction count, and write
+/// each partition into Parts[i] as a self-contained bitcode module.  Global
+/// variables, aliases and appending globals such as llvm.global_ctors live
+/// in partition 0; every other partition refers to them through external
+/// declarations.  Internal symbols that end up referenced from a partition
+/// other than their own are given hidden visibility, external linkage and a
+/// module-unique name, which modifies \p M.
+///
+/// If \p ByCallGraph is set, functions that call each other directly are
+/// first merged into clusters no larger than the average partition, heaviest
+/// call edges first, and whole clusters are distributed.  This keeps callers
+/// next to their callees and keeps most functions in the same partition when
+/// the module changes elsewhere.  Declarations a partition does not use are
+/// left out of it.
+///
+/// The assignment only depends on the contents of \p M and on \p NumParts, so
+/// the same inputs always produce the same partitions.
+void SplitModuleForCodeGen(Module &M, unsigned NumParts,
+                           std::vector<std::string> &Parts,
+                           bool ByCallGraph = false);
+
+/// ParallelCodeGenOptions - Describes how each partition is compiled by
+/// CodeGenModulePartitions.
+struct ParallelCodeGenOptions {
+  const Target *TheTarget;
+  std::string TargetTriple;
+  std::string Features;
+  TargetMachine::CodeGenFileType FileType;
+  CodeGenOpt::Level OptLevel;
+  bool DisableVerify;
+
+  /// NumThreads - The number of worker threads, or zero to use one thread
+  /// per available processor.
+  unsigned NumThreads;
+
+  /// InitTargetMachine - If non-null, called on every freshly created
+  /// TargetMachine with InitOpaque before passes are added, so clients can
+  /// apply settings such as setMCRelaxAll.  It runs on a worker thread.
+  void (*InitTargetMachine)(TargetMachine &TM, void *Opaque);
+  void *InitOpaque;
+
+  ParallelCodeGenOptions()
+    : TheTarget(0), FileType(TargetMachine::CGFT_ObjectFile),
+      OptLevel(CodeGenOpt::Default), DisableVerify(true), NumThreads(0),
+      InitTargetMachine(0), InitOpaque(0) {}
+};
+
+/// CodeGenModulePartitions - Generate code for every bitcode module in
+/// \p Parts, as produced by SplitModuleForCodeGen.  Each partition is loaded
+/// into its own LLVMContext and compiled on a pool of worker threads, and
+/// its output is stored in Outputs[i].  Outputs are only ever filled in by
+/// index, so the result does not depend on the number of threads or on the
+/// order in which partitions finish.  Returns true and sets \p ErrMsg on
+/// failure.
+///
+/// Worker threads are only used if llvm_start_multithreaded() has been
+/// called; otherwise the partitions are compiled one after another.
+bool CodeGenModulePartitions(const std::vector<std::string> &Parts,
+                             const ParallelCodeGenOptions &Options,
+                             std::vector<std::string> &Outputs,
+                             std::string &ErrMsg);
+
+} // End llvm namespace
+
+#endif
@@ -105,6 +105,9 @@ class ExecutionEngine {
   /// Whether lazy JIT compilation is enabled.
   bool CompilingLazily;
 
+  /// Whether lazily compiled functions are compiled on a background thread.
+  bool CompilingInBackground;
+
   /// Whether JIT compilation of external global variables is allowed.
   bool GVCompilationDisabled;
 
@@ -126,6 +129,18 @@ protected:
   /// getMemoryforGV - Allocate memory for a global variable.
   virtual char *getMemoryForGV(const GlobalVariable *GV);
 
+  /// setTierUpEngine - Give this engine a JIT over a copy of its module, and
+  /// run each function that gets hot in it from its next call on.  Copies
+  /// maps the functions of the module to their copies, and a function is hot
+  /// once its calls and loop iterations reach Threshold.  On success the
+  /// engine takes ownership of TierUp; returns false if this engine does not
+  /// support tiered execution.
+  virtual bool setTierUpEngine(ExecutionEngine *TierUp,
+                            const DenseMap<const Function*, Function*> &Copies,
+                               unsigned Threshold) {
+    return false;
+  }
+
   // To avoid having libexecutionengine depend on the JIT and interpreter
   // libraries, the execution engine implementations set these functions to ctor
   // pointers at startup time if they are linked in.
@@ -350,6 +365,13 @@ public:
   virtual void RegisterJITEventListener(JITEventListener *) {}
   virtual void UnregisterJITEventListener(JITEventListener *) {}
 
+  /// setCodeCacheDirectory - Keep the machine code of compiled functions in
+  /// the directory Dir, and load functions from there instead of compiling
+  /// them when an earlier run compiled the same code for the same target.
+  /// An empty Dir turns the cache off.  Engines that do not generate code,
+  /// and targets whose code cannot be relocated, ignore this.
+  virtual void setCodeCacheDirectory(StringRef Dir) {}
+
   /// DisableLazyCompilation - When lazy compilation is off (the default), the
   /// JIT will eagerly compile every function reachable from the argument to
   /// getPointerToFunction.  If lazy compilation is turned on, the JIT will only
@@ -375,6 +397,22 @@ public:
     return !CompilingLazily;
   }
 
+  /// EnableBackgroundCompilation - When background compilation is on, and
+  /// lazy compilation is on as well, getPointerToFunction returns a lazy
+  /// stub immediately instead of compiling the function.  The function, and
+  /// every function whose stub is handed to compiled code, is queued for a
+  /// background thread, which compiles first the functions whose stubs were
+  /// requested most often and then redirects each stub to the new code.  A
+  /// stub that is called before its function is compiled compiles it on the
+  /// calling thread, as in plain lazy compilation.  This only takes effect
+  /// after llvm_start_multithreaded() has been called.
+  void EnableBackgroundCompilation(bool Enabled = true) {
+    CompilingInBackground = Enabled;
+  }
+  bool isCompilingInBackground() const {
+    return CompilingInBackground;
+  }
+
   /// DisableGVCompilation - If called, the JIT will abort if it's asked to
   /// allocate space and populate a GlobalVariable that is not internal to
   /// the module.
@@ -472,6 +510,7 @@ private:
   std::string MCPU;
   SmallVector<std::string, 4> MAttrs;
   bool UseMCJIT;
+  unsigned TierUpThreshold;
 
   /// InitEngine - Does the common initialization of default options.
   void InitEngine() {
@@ -482,6 +521,7 @@ private:
     AllocateGVsWithCode = false;
     CMModel = CodeModel::Default;
     UseMCJIT = false;
+    TierUpThreshold = 0;
   }
 
 public:
@@ -558,6 +598,17 @@ public:
     UseMCJIT = Value;
   }
 
+  /// setTierUpThreshold - With a nonzero threshold and EngineKind::Either,
+  /// create an interpreter that moves each function to the JIT once its
+  /// calls and loop iterations reach the threshold.  The JIT is created with
+  /// the options set on this builder, such as the optimization level.  If
+  /// the module cannot be run that way, create() falls back to a plain
+  /// interpreter.
+  EngineBuilder &setTierUpThreshold(unsigned Threshold) {
+    TierUpThreshold = Threshold;
+    return *this;
+  }
+
   /// setMAttrs - Set cpu-specific attributes.
   template<typename StringSequence>
   EngineBuilder &setMAttrs(const StringSequence &mattrs) {
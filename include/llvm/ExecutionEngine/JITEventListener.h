@@ -36,7 +36,8 @@ struct JITEvent_EmittedFunctionDetails {
     DebugLoc Loc;
   };
 
-  /// The machine function the struct contains information for.
+  /// The machine function the struct contains information for.  It is null
+  /// for code loaded from the JIT code cache, which has no LineStarts either.
   const MachineFunction *MF;
 
   /// The list of line boundary information, sorted by address.
@@ -33,6 +33,16 @@ public:
   /// CreateDefaultMemManager - This is used to create the default
   /// JIT Memory Manager if the client does not provide one to the JIT.
   static JITMemoryManager *CreateDefaultMemManager();
+
+  /// CreateSizeClassMemManager - This creates a memory manager meant for JITs
+  /// that free and recompile code continuously.  It allocates code, stubs and
+  /// data from separate slabs, hands out code from per-thread arenas with
+  /// free lists segregated by size, and reports how much of its memory is
+  /// fragmented.  If WriteXorExecute is true, code slabs are only writable
+  /// between setMemoryWritable and setMemoryExecutable, and are executable
+  /// the rest of the time; data slabs are never executable.  Stubs stay
+  /// writable and executable, because targets rewrite them while they run.
+  static JITMemoryManager *CreateSizeClassMemManager(bool WriteXorExecute);
   
   /// setMemoryWritable - When code generation is in progress,
   /// the code pages may need permissions changed.
@@ -47,6 +57,13 @@ public:
   /// debugging, and may be turned on by default in debug mode.
   virtual void setPoisonMemory(bool poison) = 0;
 
+  /// setCodeWritable - The JIT is about to overwrite Size bytes of code at
+  /// Addr that it emitted earlier, for example to forward a recompiled
+  /// function to its new code.  This is called between setMemoryWritable and
+  /// setMemoryExecutable.  Memory managers that make code read-only once it
+  /// is emitted must make it writable again until setMemoryExecutable.
+  virtual void setCodeWritable(void *Addr, size_t Size) {}
+
   //===--------------------------------------------------------------------===//
   // Global Offset Table Management
   //===--------------------------------------------------------------------===//
@@ -130,6 +147,30 @@ public:
   /// currently emitting an exception table.
   virtual void deallocateExceptionTable(void *ET) = 0;
 
+  //===--------------------------------------------------------------------===//
+  // Memory Usage Reporting
+  //===--------------------------------------------------------------------===//
+
+  /// getCommittedBytes - Return the number of bytes of memory mapped from the
+  /// system for code, stubs and data, or 0 if this is not tracked.
+  virtual size_t getCommittedBytes() {
+    return 0;
+  }
+
+  /// getAllocatedBytes - Return the number of committed bytes that are
+  /// handed out to the JIT and not freed, including the padding of each
+  /// allocation, or 0 if this is not tracked.
+  virtual size_t getAllocatedBytes() {
+    return 0;
+  }
+
+  /// getFreeBytes - Return the number of committed bytes that were freed and
+  /// wait to be reused, which is the fragmentation of the memory, or 0 if
+  /// this is not tracked.
+  virtual size_t getFreeBytes() {
+    return 0;
+  }
+
   /// CheckInvariants - For testing only.  Return true if all internal
   /// invariants are preserved, or return false and set ErrorStr to a helpful
   /// error message.
@@ -86,6 +86,7 @@ private:
   mutable ArgumentListType ArgumentList;  ///< The formal arguments
   ValueSymbolTable *SymTab;               ///< Symbol table of args/instructions
   AttrListPtr AttributeList;              ///< Parameter attributes
+  BumpPtrAllocator *Arena;                ///< Owner of arena instructions
 
   // HasLazyArguments is stored in Value::SubclassData.
   /*bool HasLazyArguments;*/
@@ -94,6 +95,7 @@ private:
   /*CallingConv::ID CallingConvention;*/
 
   friend class SymbolTableListTraits<Function, Module>;
+  friend class IRArenaScope;
 
   void setParent(Module *parent);
 
@@ -406,8 +408,22 @@ public:
   /// function, dropping all references deletes the entire body of the function,
   /// including any contained basic blocks.
   ///
+  /// If the function has an arena, the memory of the instructions that were
+  /// allocated from it is released in bulk once the body is gone.
+  ///
   void dropAllReferences();
 
+  /// getArena - Return the allocator backing the instructions created while
+  /// an IRArenaScope for this function was active, or null if there never was
+  /// one.  Its memory is released in bulk when the body of the function is
+  /// deleted (by dropAllReferences, deleteBody or the destructor), instead of
+  /// one instruction at a time.
+  BumpPtrAllocator *getArena() const { return Arena; }
+
+  /// isInArena - Return true if the memory of I comes from the arena of this
+  /// function.  This is meant for assertions.
+  bool isInArena(const Instruction *I) const;
+
   /// hasAddressTaken - returns true if there are any uses of this function
   /// other than direct calls or invokes to it. Optionally passes back the
   /// offending user for diagnostic purposes.
@@ -422,6 +438,28 @@ private:
   }
 };
 
+/// IRArenaScope - While an object of this class is live, instructions created
+/// on the current thread (including by clone) are bump pointer allocated from
+/// the arena of the given function, which is created on first use.  This makes
+/// building and throwing away many short-lived functions much cheaper, at the
+/// price of a contract: an arena allocated instruction may be erased, but it
+/// must not be moved into a different function, nor outlive the body of its
+/// function.  Constants, basic blocks and the resizable operand lists of PHI,
+/// switch and indirectbr instructions are still heap allocated.  Scopes nest.
+class IRArenaScope {
+  IRArenaScope(const IRArenaScope&);  // DO NOT IMPLEMENT
+  void operator=(const IRArenaScope&); // DO NOT IMPLEMENT
+  BumpPtrAllocator *Arena;
+  const IRArenaScope *Prev;
+public:
+  explicit IRArenaScope(Function &F);
+  ~IRArenaScope();
+
+  /// getCurrentArena - Return the arena of the innermost scope active on this
+  /// thread, or null if there is none.
+  static BumpPtrAllocator *getCurrentArena();
+};
+
 inline ValueSymbolTable *
 ilist_traits<BasicBlock>::getSymTab(Function *F) {
   return F ? &F->getValueSymbolTable() : 0;
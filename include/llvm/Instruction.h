@@ -32,7 +32,9 @@ class Instruction : public User, public ilist_node<Instruction> {
   Instruction(const Instruction &);        // Do not implement
 
   BasicBlock *Parent;
+#ifndef LLVM_COMPACT_IR
   DebugLoc DbgLoc;                         // 'dbg' Metadata cache.
+#endif
   
   enum {
     /// HasMetadataBit - This is a bit stored in the SubClassData field which
@@ -125,7 +127,11 @@ public:
   /// hasMetadata() - Return true if this instruction has any metadata attached
   /// to it.
   bool hasMetadata() const {
+#ifndef LLVM_COMPACT_IR
     return !DbgLoc.isUnknown() || hasMetadataHashEntry();
+#else
+    return HasDebugLocEntry || hasMetadataHashEntry();
+#endif
   }
   
   /// hasMetadataOtherThanDebugLoc - Return true if this instruction has
@@ -170,11 +176,20 @@ public:
   void setMetadata(unsigned KindID, MDNode *Node);
   void setMetadata(const char *Kind, MDNode *Node);
 
+#ifndef LLVM_COMPACT_IR
   /// setDebugLoc - Set the debug location information for this instruction.
   void setDebugLoc(const DebugLoc &Loc) { DbgLoc = Loc; }
   
   /// getDebugLoc - Return the debug location for this node as a DebugLoc.
   const DebugLoc &getDebugLoc() const { return DbgLoc; }
+#else
+  /// setDebugLoc - Set the debug location information for this instruction.
+  /// Known locations are kept in a side table of the context.
+  void setDebugLoc(const DebugLoc &Loc);
+
+  /// getDebugLoc - Return the debug location for this node as a DebugLoc.
+  DebugLoc getDebugLoc() const;
+#endif
   
 private:
   /// hasMetadataHashEntry - Return true if we have an entry in the on-the-side
@@ -370,6 +385,11 @@ protected:
   Instruction(const Type *Ty, unsigned iType, Use *Ops, unsigned NumOps,
               BasicBlock *InsertAtEnd);
   virtual Instruction *clone_impl() const = 0;
+
+  /// operator new - Allocate an instruction with Us prefixed operands.  While
+  /// an IRArenaScope is active on the current thread, the memory comes from
+  /// the arena of its function instead of the heap.
+  void *operator new(size_t s, unsigned Us);
   
 };
 
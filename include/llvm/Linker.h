@@ -58,6 +58,13 @@ class Linker {
       QuietErrors   = 4  ///< Don't print errors to stderr.
     };
 
+    /// This enumeration selects which definitions of the source module
+    /// LinkModules brings into the destination module.
+    enum LinkerMode {
+      LinkAll        = 0, ///< Link in every definition of the source module.
+      LinkOnlyNeeded = 1  ///< Only link in functions the destination needs.
+    };
+
   /// @}
   /// @name Constructors
   /// @{
@@ -261,6 +268,18 @@ class Linker {
     /// @brief Generically link two modules together.
     static bool LinkModules(Module* Dest, Module* Src, std::string* ErrorMsg);
 
+    /// Like the above, but \p Mode is one of the LinkerMode values.  If
+    /// \p Src was loaded lazily (e.g. with getLazyBitcodeModule), only the
+    /// function bodies that are linked in are read: those of externally
+    /// visible functions, or with LinkOnlyNeeded only those that \p Dest
+    /// declares, plus every function they, the global initializers and the
+    /// aliases refer to.  Function bodies that are never read are dropped.
+    /// LinkOnlyNeeded has no effect on a module that is fully in memory.
+    /// @returns True if an error occurs, false otherwise.
+    /// @brief Link the needed parts of a lazily loaded module.
+    static bool LinkModules(Module* Dest, Module* Src, unsigned Mode,
+                            std::string* ErrorMsg);
+
     /// This function looks through the Linker's LibPaths to find a library with
     /// the name \p Filename. If the library cannot be found, the returned path
     /// will be empty (i.e. sys::Path::isEmpty() will return true).
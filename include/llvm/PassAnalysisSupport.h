@@ -141,7 +141,14 @@ public:
   // Find pass that is implementing PI. Initialize pass for Function F.
   Pass *findImplPass(Pass *P, AnalysisID PI, Function &F);
 
+  // Record P as the pass implementing PI, replacing any earlier pair for PI.
   void addAnalysisImplsPair(AnalysisID PI, Pass *P) {
+    for (unsigned i = 0; i < AnalysisImpls.size() ; ++i) {
+      if (AnalysisImpls[i].first == PI) {
+        AnalysisImpls[i].second = P;
+        return;
+      }
+    }
     std::pair<AnalysisID, Pass*> pir = std::make_pair(PI,P);
     AnalysisImpls.push_back(pir);
   }
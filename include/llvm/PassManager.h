@@ -21,6 +21,7 @@
 
 namespace llvm {
 
+class AnalysisCache;
 class Pass;
 class Module;
 
@@ -53,6 +54,12 @@ public:
   /// will be destroyed as well, so there is no need to delete the pass.  This
   /// implies that all passes MUST be allocated with 'new'.
   void add(Pass *P);
+
+  /// setAnalysisCache - Keep the results of the function analyses that Cache
+  /// is told about in Cache, which must outlive this PassManager, instead of
+  /// recomputing them whenever a pass does not preserve them.  See
+  /// AnalysisCache.h.
+  void setAnalysisCache(AnalysisCache *Cache);
  
   /// run - Execute all of the passes scheduled for execution.  Keep track of
   /// whether any of the passes modifies the module, and if so, return true.
@@ -83,6 +90,11 @@ public:
   /// This implies that all passes MUST be allocated with 'new'.
   void add(Pass *P);
 
+  /// setAnalysisCache - Keep the results of the function analyses that Cache
+  /// is told about in Cache, which must outlive this FunctionPassManager.
+  /// See AnalysisCache.h.
+  void setAnalysisCache(AnalysisCache *Cache);
+
   /// run - Execute all of the passes scheduled for execution.  Keep
   /// track of whether any of the passes modifies the function, and if
   /// so, return true.
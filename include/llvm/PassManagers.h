@@ -91,6 +91,7 @@
 #include "llvm/Support/PrettyStackTrace.h"
 
 namespace llvm {
+  class AnalysisCache;
   class Module;
   class Pass;
   class StringRef;
@@ -224,6 +225,11 @@ public:
   void dumpPasses() const;
   void dumpArguments() const;
 
+  /// setAnalysisCache - Keep the function analyses that Cache is told about
+  /// in Cache, across runs, instead of in the passes scheduled here.
+  void setAnalysisCache(AnalysisCache *C) { Cache = C; }
+  AnalysisCache *getAnalysisCache() const { return Cache; }
+
   // Active Pass Managers
   PMStack activeStack;
 
@@ -251,6 +257,9 @@ private:
   SmallVector<ImmutablePass *, 8> ImmutablePasses;
 
   DenseMap<Pass *, AnalysisUsage *> AnUsageMap;
+
+  /// Analysis cache used by the managers, if any.
+  AnalysisCache *Cache;
 };
 
 
@@ -279,6 +288,10 @@ public:
 
   /// Remove Analysis that is not preserved by the pass
   void removeNotPreservedAnalysis(Pass *P);
+
+  /// Tell the analysis cache, if there is one, that pass P changed F, or
+  /// possibly any function if F is null.
+  void invalidateCachedAnalysis(Pass *P, Function *F);
   
   /// Remove dead passes used by P.
   void removeDeadPasses(Pass *P, StringRef Msg, 
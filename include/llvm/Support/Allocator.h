@@ -176,6 +176,10 @@ public:
 
   unsigned GetNumSlabs() const;
 
+  /// Owns - Return true if Ptr points into one of the slabs of this
+  /// allocator.  This walks every slab, so it is meant for assertions.
+  bool Owns(const void *Ptr) const;
+
   void PrintStats() const;
 };
 
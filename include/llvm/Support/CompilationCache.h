@@ -0,0 +1,78 @@
+//===-- llvm/Support/CompilationCache.h - On-disk output cache --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the CompilationCache class, a directory of compiler
+// outputs indexed by a hash of everything that determines them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_COMPILATIONCACHE_H
+#define LLVM_SUPPORT_COMPILATIONCACHE_H
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/MD5.h"
+#include <string>
+
+namespace llvm {
+
+class MemoryBuffer;
+
+/// CompilationCache - A directory holding one file per cached output.  The
+/// client computes a key that covers every input of the compilation, using
+/// CompilationCache::KeyBuilder, and the cache maps it to the bytes that were
+/// produced.  Entries are written to a temporary file and renamed into
+/// place, so several processes can share a cache directory.  The cache can
+/// be bounded in size, in which case the least recently used entries are
+/// evicted when an entry is stored.
+class CompilationCache {
+  std::string Directory;
+  uint64_t MaxSize;
+
+public:
+  /// KeyBuilder - Hashes the inputs of a compilation into a cache key.  Each
+  /// part is length prefixed, so ("ab", "c") and ("a", "bc") differ.
+  class KeyBuilder {
+    MD5 Hash;
+  public:
+    KeyBuilder &add(StringRef Part);
+    KeyBuilder &add(uint64_t Value);
+
+    /// getKey - Return the key as 32 hex digits.  The builder cannot be
+    /// used afterwards.
+    std::string getKey();
+  };
+
+  explicit CompilationCache(StringRef Dir) : Directory(Dir), MaxSize(0) {}
+
+  const std::string &getDirectory() const { return Directory; }
+
+  /// setMaxSize - Limit the total size of the entries to \p Bytes; zero
+  /// means no limit.
+  void setMaxSize(uint64_t Bytes) { MaxSize = Bytes; }
+  uint64_t getMaxSize() const { return MaxSize; }
+
+  /// lookup - If there is an entry for \p Key, load it into \p Result and
+  /// return true.  A hit marks the entry as recently used.
+  bool lookup(StringRef Key, OwningPtr<MemoryBuffer> &Result);
+
+  /// store - Make \p Data the entry for \p Key, creating the cache directory
+  /// if needed.  Returns true and sets \p ErrMsg on failure; a failure to
+  /// store does not affect the compilation itself.
+  bool store(StringRef Key, StringRef Data, std::string &ErrMsg);
+
+  /// prune - Remove the least recently used entries until the cache fits in
+  /// its size limit.  store() calls this when a limit is set.
+  void prune();
+};
+
+}
+
+#endif
@@ -71,14 +71,16 @@ namespace llvm {
   /// If the given MemoryBuffer holds a bitcode image, return a Module
   /// for it.  Otherwise, attempt to parse it as LLVM Assembly and return
   /// a Module for it. This function *always* takes ownership of the given
-  /// MemoryBuffer.
+  /// MemoryBuffer.  The function blocks of a bitcode image are decoded on
+  /// the given number of threads, as by ParseBitcodeFile.
   inline Module *ParseIR(MemoryBuffer *Buffer,
                          SMDiagnostic &Err,
-                         LLVMContext &Context) {
+                         LLVMContext &Context,
+                         unsigned Threads = 1) {
     if (isBitcode((const unsigned char *)Buffer->getBufferStart(),
                   (const unsigned char *)Buffer->getBufferEnd())) {
       std::string ErrMsg;
-      Module *M = ParseBitcodeFile(Buffer, Context, &ErrMsg);
+      Module *M = ParseBitcodeFile(Buffer, Context, &ErrMsg, Threads);
       if (M == 0)
         Err = SMDiagnostic(Buffer->getBufferIdentifier(), ErrMsg);
       // ParseBitcodeFile does not take ownership of the Buffer.
@@ -94,7 +96,8 @@ namespace llvm {
   /// for it.
   inline Module *ParseIRFile(const std::string &Filename,
                              SMDiagnostic &Err,
-                             LLVMContext &Context) {
+                             LLVMContext &Context,
+                             unsigned Threads = 1) {
     OwningPtr<MemoryBuffer> File;
     if (error_code ec = MemoryBuffer::getFileOrSTDIN(Filename.c_str(), File)) {
       Err = SMDiagnostic(Filename,
@@ -102,7 +105,7 @@ namespace llvm {
       return 0;
     }
 
-    return ParseIR(File.take(), Err, Context);
+    return ParseIR(File.take(), Err, Context, Threads);
   }
 
 }
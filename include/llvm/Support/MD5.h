@@ -0,0 +1,57 @@
+//===-- llvm/Support/MD5.h - MD5 message digest -----------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the MD5 class, an implementation of the MD5 message
+// digest (RFC 1321).  It is used to derive content-based keys, for example
+// for caches of generated code, and must not be used for anything that needs
+// cryptographic strength.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_MD5_H
+#define LLVM_SUPPORT_MD5_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+
+namespace llvm {
+
+class MD5 {
+  uint32_t a, b, c, d;
+  uint32_t hi, lo;
+  uint8_t buffer[64];
+  uint32_t block[16];
+
+public:
+  typedef uint8_t MD5Result[16];
+
+  MD5();
+
+  /// update - Add \p Data to the hash.
+  void update(ArrayRef<uint8_t> Data);
+
+  /// update - Add the bytes of \p Str to the hash.
+  void update(StringRef Str);
+
+  /// final - Finish the hash and place the digest in \p Result.  The object
+  /// must not be updated afterwards.
+  void final(MD5Result &Result);
+
+  /// stringifyResult - Translate \p Result into 32 lower case hex digits.
+  static void stringifyResult(MD5Result &Result, SmallString<32> &Str);
+
+private:
+  const uint8_t *body(ArrayRef<uint8_t> Data);
+};
+
+}
+
+#endif
@@ -89,6 +89,16 @@ namespace sys {
     /// setRangeWritable - Mark the page containing a range of addresses
     /// as writable.
     static bool setRangeWritable(const void *Addr, size_t Size);
+
+    /// protectRange - Make a block of memory allocated with AllocateRWX
+    /// readable and executable if \p Executable is true, or readable and
+    /// writable otherwise, so that it is never writable and executable at
+    /// once.
+    ///
+    /// On success, this returns false, otherwise it returns true and fills
+    /// in *ErrMsg.
+    static bool protectRange(MemoryBlock &M, bool Executable,
+                             std::string *ErrMsg = 0);
   };
 }
 }
@@ -31,7 +31,11 @@ template<class T> class OwningPtr;
 /// The '\0' guarantee is needed to support an optimization -- it's intended to
 /// be more efficient for clients which are reading all the data to stop
 /// reading when they encounter a '\0' than to continually check the file
-/// position to see if it has reached the end of the file.
+/// position to see if it has reached the end of the file.  Clients that never
+/// read past the end, such as the bitcode reader and the object file readers,
+/// can waive the guarantee, which lets the buffer refer to memory that is not
+/// followed by a null byte (e.g. a member inside a mapped archive, or a file
+/// whose size is a multiple of the page size) instead of a copy of it.
 class MemoryBuffer {
   const char *BufferStart; // Start of the buffer.
   const char *BufferEnd;   // End of the buffer.
@@ -40,7 +44,8 @@ class MemoryBuffer {
   MemoryBuffer &operator=(const MemoryBuffer &); // DO NOT IMPLEMENT
 protected:
   MemoryBuffer() {}
-  void init(const char *BufStart, const char *BufEnd);
+  void init(const char *BufStart, const char *BufEnd,
+            bool RequiresNullTerminator);
 public:
   virtual ~MemoryBuffer();
 
@@ -61,23 +66,30 @@ public:
   /// getFile - Open the specified file as a MemoryBuffer, returning a new
   /// MemoryBuffer if successful, otherwise returning null.  If FileSize is
   /// specified, this means that the client knows that the file exists and that
-  /// it has the specified size.
+  /// it has the specified size.  If RequiresNullTerminator is false, the file
+  /// is mapped into memory whenever it is large enough, and the buffer may not
+  /// be followed by a null byte.
   static error_code getFile(StringRef Filename, OwningPtr<MemoryBuffer> &result,
-                            int64_t FileSize = -1);
+                            int64_t FileSize = -1,
+                            bool RequiresNullTerminator = true);
   static error_code getFile(const char *Filename,
                             OwningPtr<MemoryBuffer> &result,
-                            int64_t FileSize = -1);
+                            int64_t FileSize = -1,
+                            bool RequiresNullTerminator = true);
 
   /// getOpenFile - Given an already-open file descriptor, read the file and
   /// return a MemoryBuffer.
   static error_code getOpenFile(int FD, const char *Filename,
                                 OwningPtr<MemoryBuffer> &result,
-                                int64_t FileSize = -1);
+                                int64_t FileSize = -1,
+                                bool RequiresNullTerminator = true);
 
   /// getMemBuffer - Open the specified memory range as a MemoryBuffer.  Note
-  /// that InputData must be null terminated.
+  /// that InputData must be null terminated if RequiresNullTerminator is true.
+  /// The memory is not copied, and must outlive the buffer.
   static MemoryBuffer *getMemBuffer(StringRef InputData,
-                                    StringRef BufferName = "");
+                                    StringRef BufferName = "",
+                                    bool RequiresNullTerminator = true);
 
   /// getMemBufferCopy - Open the specified memory range as a MemoryBuffer,
   /// copying the contents and taking ownership of it.  InputData does not
@@ -108,10 +120,12 @@ public:
   /// ec.
   static error_code getFileOrSTDIN(StringRef Filename,
                                    OwningPtr<MemoryBuffer> &result,
-                                   int64_t FileSize = -1);
+                                   int64_t FileSize = -1,
+                                   bool RequiresNullTerminator = true);
   static error_code getFileOrSTDIN(const char *Filename,
                                    OwningPtr<MemoryBuffer> &result,
-                                   int64_t FileSize = -1);
+                                   int64_t FileSize = -1,
+                                   bool RequiresNullTerminator = true);
 };
 
 } // end namespace llvm
@@ -0,0 +1,67 @@
+//===-- llvm/Support/ThreadPool.h - A pool of worker threads ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a simple fixed-size pool of worker threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_THREADPOOL_H
+#define LLVM_SUPPORT_THREADPOOL_H
+
+namespace llvm {
+
+  /// ThreadPool - A fixed number of worker threads draining a FIFO queue of
+  /// tasks.  If LLVM has not been put into multithreaded mode with
+  /// llvm_start_multithreaded(), if threading support is not compiled in, or
+  /// if the pool was created with a single thread and is not asynchronous,
+  /// tasks are executed synchronously on the calling thread inside async().
+  /// Clients therefore do not need a separate serial code path.
+  class ThreadPool {
+  public:
+    typedef void (*TaskFn)(void *);
+
+  private:
+    /// Impl - Opaque pointer to the platform specific state, or null if the
+    /// pool runs tasks on the calling thread.
+    void *Impl;
+    unsigned NumThreads;
+
+    ThreadPool(const ThreadPool &);    // DO NOT IMPLEMENT
+    void operator=(const ThreadPool &); // DO NOT IMPLEMENT
+  public:
+    /// ThreadPool - Create a pool of \arg Threads workers.  A value of zero
+    /// selects getHardwareConcurrency().  If \arg Asynchronous is true, a
+    /// single worker is still started, for clients that need async() to
+    /// return before the task has run.
+    explicit ThreadPool(unsigned Threads = 0, bool Asynchronous = false);
+
+    /// ~ThreadPool - Wait for all queued tasks and join the workers.
+    ~ThreadPool();
+
+    /// async - Queue \arg Fn to be called with \arg Arg on some worker.
+    void async(TaskFn Fn, void *Arg);
+
+    /// wait - Block until every task queued so far has finished.
+    void wait();
+
+    /// getNumThreads - Return the number of worker threads, which is one for
+    /// a pool that runs tasks on the calling thread.
+    unsigned getNumThreads() const { return NumThreads; }
+
+    /// isParallel - Return true if tasks are run on separate threads.
+    bool isParallel() const { return Impl != 0; }
+
+    /// getHardwareConcurrency - Return the number of processors available to
+    /// this process, or 1 if it cannot be determined.
+    static unsigned getHardwareConcurrency();
+  };
+
+}
+
+#endif
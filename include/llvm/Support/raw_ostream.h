@@ -305,6 +305,10 @@ class raw_fd_ostream : public raw_ostream {
   /// possible.
   bool UseAtomicWrites;
 
+  /// SupportsSeeking - True if seek() can reposition the stream, so that
+  /// bytes already written can be overwritten.
+  bool SupportsSeeking;
+
   uint64_t pos;
 
   /// write_impl - See raw_ostream::write_impl.
@@ -365,6 +369,10 @@ public:
   /// position to the offset specified from the beginning of the file.
   uint64_t seek(uint64_t off);
 
+  /// supportsSeeking - Return true if seek() can be used on this stream.  It
+  /// cannot on pipes, on standard output, or on files opened for appending.
+  bool supportsSeeking() const { return SupportsSeeking; }
+
   /// SetUseAtomicWrite - Set the stream to attempt to use atomic writes for
   /// individual output routines where possible.
   ///
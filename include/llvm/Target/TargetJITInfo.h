@@ -72,6 +72,15 @@ namespace llvm {
       return 0;
     }
 
+    /// retargetFunctionStub - Atomically redirect the lazy-compilation stub at
+    /// Stub, created by emitFunctionStub, to the code at Target: a thread
+    /// running the stub concurrently either still enters the lazy resolver or
+    /// jumps straight to Target.  Returns false, leaving the stub unchanged,
+    /// if this cannot be done atomically.
+    virtual bool retargetFunctionStub(void *Stub, void *Target) {
+      return false;
+    }
+
     /// getPICJumpTableEntry - Returns the value of the jumptable entry for the
     /// specific basic block.
     virtual uintptr_t getPICJumpTableEntry(uintptr_t BB, uintptr_t JTBase) {
@@ -134,6 +143,13 @@ namespace llvm {
     /// separately allocated heap memory rather than in the same
     /// code memory allocated by JITCodeEmitter.
     virtual bool allocateSeparateGVMemory() const { return false; }
+
+    /// isCodeRelocatable - Returns true if the code emitted for a function
+    /// depends on its address only through the relocations handed to
+    /// relocate(), and relocate() needs no state saved while emitting it.
+    /// Such code can be copied to another address and relocated there, which
+    /// the JIT code cache relies on.
+    virtual bool isCodeRelocatable() const { return false; }
   protected:
     bool useGOT;
   };
@@ -37,9 +37,10 @@ template<typename T> class SmallVectorImpl;
 /// ConstantFoldTerminator - If a terminator instruction is predicated on a
 /// constant value, convert it into an unconditional branch to the constant
 /// destination.  This is a nontrivial operation because the successors of this
-/// basic block must have their PHI nodes updated.
+/// basic block must have their PHI nodes updated.  If P is given and a
+/// DominatorTree is available, it is updated for the deleted edges.
 ///
-bool ConstantFoldTerminator(BasicBlock *BB);
+bool ConstantFoldTerminator(BasicBlock *BB, Pass *P = 0);
 
 //===----------------------------------------------------------------------===//
 //  Local dead code elimination.
@@ -97,7 +98,8 @@ void RemovePredecessorAndSimplify(BasicBlock *BB, BasicBlock *Pred,
 /// MergeBasicBlockIntoOnlyPred - BB is a block with one predecessor and its
 /// predecessor is known to have one successor (BB!).  Eliminate the edge
 /// between them, moving the instructions in the predecessor into BB.  This
-/// deletes the predecessor block.
+/// deletes the predecessor block.  If the predecessor was the entry block, BB
+/// is moved to the entry position.
 ///
 void MergeBasicBlockIntoOnlyPred(BasicBlock *BB, Pass *P = 0);
     
@@ -106,8 +108,9 @@ void MergeBasicBlockIntoOnlyPred(BasicBlock *BB, Pass *P = 0);
 /// unconditional branch, and contains no instructions other than PHI nodes,
 /// potential debug intrinsics and the branch.  If possible, eliminate BB by
 /// rewriting all the predecessors to branch to the successor block and return
-/// true.  If we can't transform, return false.
-bool TryToSimplifyUncondBranchFromEmptyBlock(BasicBlock *BB);
+/// true.  If we can't transform, return false.  If P is given and a
+/// DominatorTree is available, it is kept up to date.
+bool TryToSimplifyUncondBranchFromEmptyBlock(BasicBlock *BB, Pass *P = 0);
 
 /// EliminateDuplicatePHINodes - Check for and eliminate duplicate PHI
 /// nodes in this block. This doesn't try to be clever about PHI nodes
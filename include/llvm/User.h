@@ -29,6 +29,8 @@ namespace llvm {
 template <class>
 struct OperandTraits;
 
+class BumpPtrAllocator;
+
 class User : public Value {
   User(const User &);             // Do not implement
   void *operator new(size_t);     // Do not implement
@@ -42,13 +44,26 @@ protected:
   /// allocated and should be destroyed by the classes' virtual dtor.
   Use *OperandList;
 
-  /// NumOperands - The number of values used by this User.
+#ifndef LLVM_COMPACT_IR
+  /// NumOperands - The number of values used by this User.  In the compact
+  /// layout this and ArenaAllocated are bitfields of Value.
   ///
   unsigned NumOperands;
 
+  /// ArenaAllocated - True if this User and its prefixed operands were carved
+  /// out of a BumpPtrAllocator, which then owns the memory.  Instructions set
+  /// it when they are constructed inside an IRArenaScope.
+  bool ArenaAllocated;
+#endif
+
   void *operator new(size_t s, unsigned Us);
+  void *operator new(size_t s, unsigned Us, BumpPtrAllocator &Arena);
   User(const Type *ty, unsigned vty, Use *OpList, unsigned NumOps)
-    : Value(ty, vty), OperandList(OpList), NumOperands(NumOps) {}
+    : Value(ty, vty), OperandList(OpList) {
+    NumOperands = NumOps;
+    assert(NumOperands == NumOps && "Too many operands!");
+    ArenaAllocated = false;
+  }
   Use *allocHungoffUses(unsigned) const;
   void dropHungoffUses() {
     Use::zap(OperandList, OperandList + NumOperands, true);
@@ -70,6 +85,14 @@ public:
   void operator delete(void*, unsigned, bool) {
     assert(0 && "Constructor throws?");
   }
+  /// placement delete - required by std, but never called.
+  void operator delete(void*, unsigned, BumpPtrAllocator&) {
+    assert(0 && "Constructor throws?");
+  }
+
+  /// isArenaAllocated - Return true if the memory of this User is owned by an
+  /// arena (see IRArenaScope) rather than released by operator delete.
+  bool isArenaAllocated() const { return ArenaAllocated; }
 protected:
   template <int Idx, typename U> static Use &OpFrom(const U *that) {
     return Idx < 0
@@ -77,14 +77,37 @@ private:
   /// This field is initialized to zero by the ctor.
   unsigned short SubclassData;
 
+#ifdef LLVM_COMPACT_IR
+  // With LLVM_COMPACT_IR defined, the word that pads the fields above on
+  // 64-bit hosts holds the flags and operand count below, and names and debug
+  // locations live in side tables of the LLVMContext, so that the common
+  // unnamed value without a location does not pay a pointer for them.
+
+  /// HasName - True if this value has an entry in the name side table.
+  unsigned HasName : 1;
+protected:
+  /// ArenaAllocated, HasDebugLocEntry and NumOperands belong to the User and
+  /// Instruction subclasses; see there.
+  unsigned ArenaAllocated : 1;
+  unsigned HasDebugLocEntry : 1;
+  unsigned NumOperands : 29;
+private:
+#endif
+
   PATypeHolder VTy;
   Use *UseList;
 
   friend class ValueSymbolTable; // Allow ValueSymbolTable to directly mod Name.
   friend class ValueHandleBase;
   friend class AbstractTypeUser;
+#ifndef LLVM_COMPACT_IR
   ValueName *Name;
 
+  void setValueName(ValueName *VN) { Name = VN; }
+#else
+  void setValueName(ValueName *VN);
+#endif
+
   void operator=(const Value &);     // Do not implement
   Value(const Value &);              // Do not implement
 
@@ -113,8 +136,13 @@ public:
   LLVMContext &getContext() const;
 
   // All values can potentially be named...
+#ifndef LLVM_COMPACT_IR
   inline bool hasName() const { return Name != 0; }
   ValueName *getValueName() const { return Name; }
+#else
+  inline bool hasName() const { return HasName; }
+  ValueName *getValueName() const;
+#endif
   
   /// getName() - Return a constant reference to the value's name. This is cheap
   /// and guaranteed to return the same reference as long as the value is not
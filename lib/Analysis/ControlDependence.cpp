@@ -0,0 +1,166 @@
+//===- ControlDependence.cpp - Control Dependence Graph -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ControlDependenceGraph analysis.  The post-dominance
+// frontier of each block is computed bottom-up over the post-dominator tree as
+// in Cytron et al., "Efficiently Computing Static Single Assignment Form and
+// the Control Dependence Graph", and turned into edges as it is found.  A
+// frontier is only kept until its parent in the tree has been processed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/ControlDependence.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Assembly/Writer.h"
+#include "llvm/Function.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include <algorithm>
+using namespace llvm;
+
+char ControlDependenceGraph::ID = 0;
+INITIALIZE_PASS_BEGIN(ControlDependenceGraph, "cdg",
+                      "Control Dependence Graph Construction", true, true)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_END(ControlDependenceGraph, "cdg",
+                    "Control Dependence Graph Construction", true, true)
+
+FunctionPass *llvm::createControlDependenceGraphPass() {
+  return new ControlDependenceGraph();
+}
+
+void ControlDependenceGraph::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<PostDominatorTree>();
+}
+
+void ControlDependenceGraph::releaseMemory() {
+  Blocks.clear();
+  BlockNumbers.clear();
+  Dependents.clear();
+  DependentBegin.clear();
+  Controllers.clear();
+  ControllerBegin.clear();
+}
+
+/// buildAdjacency - Lay out Edges, sorted by their first member, as the
+/// adjacency arrays List and Begin for NumBlocks blocks.
+static void buildAdjacency(std::vector<std::pair<unsigned, unsigned> > &Edges,
+                           unsigned NumBlocks, std::vector<unsigned> &List,
+                           std::vector<unsigned> &Begin) {
+  std::sort(Edges.begin(), Edges.end());
+  Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+  List.reserve(Edges.size());
+  Begin.reserve(NumBlocks + 1);
+  for (unsigned i = 0, e = Edges.size(); i != e; ++i) {
+    while (Begin.size() <= Edges[i].first)
+      Begin.push_back(List.size());
+    List.push_back(Edges[i].second);
+  }
+  while (Begin.size() <= NumBlocks)
+    Begin.push_back(List.size());
+}
+
+bool ControlDependenceGraph::runOnFunction(Function &F) {
+  releaseMemory();
+  PostDominatorTree &PDT = getAnalysis<PostDominatorTree>();
+
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    BlockNumbers[BB] = Blocks.size();
+    Blocks.push_back(BB);
+  }
+  unsigned NumBlocks = Blocks.size();
+
+  // (controller, dependent) pairs.
+  std::vector<std::pair<unsigned, unsigned> > Edges;
+
+  // Frontiers[N] - The post-dominance frontier of block N, while it is still
+  // needed.  Seen[X] is the last block whose frontier X was added to.
+  std::vector<SmallVector<unsigned, 4> > Frontiers(NumBlocks);
+  std::vector<unsigned> Seen(NumBlocks, ~0U);
+
+  if (DomTreeNode *Root = PDT.getRootNode())
+    for (po_iterator<DomTreeNode*> I = po_begin(Root), E = po_end(Root);
+         I != E; ++I) {
+      DomTreeNode *Node = *I;
+      BasicBlock *BB = Node->getBlock();
+      if (!BB) // The virtual exit node of a function with several exits.
+        continue;
+      unsigned Y = BlockNumbers[BB];
+      SmallVector<unsigned, 4> &Frontier = Frontiers[Y];
+
+      // The predecessors that BB does not immediately post-dominate.
+      for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE;
+           ++PI) {
+        DomTreeNode *PredNode = PDT.getNode(*PI);
+        if (!PredNode || PredNode->getIDom() == Node)
+          continue;
+        unsigned X = BlockNumbers[*PI];
+        if (Seen[X] != Y) {
+          Seen[X] = Y;
+          Frontier.push_back(X);
+        }
+      }
+
+      // What the children leave in their frontiers and BB does not
+      // immediately post-dominate.  The children are done with them now.
+      for (DomTreeNode::iterator CI = Node->begin(), CE = Node->end();
+           CI != CE; ++CI) {
+        SmallVector<unsigned, 4> &ChildFrontier =
+          Frontiers[BlockNumbers[(*CI)->getBlock()]];
+        for (unsigned i = 0, e = ChildFrontier.size(); i != e; ++i) {
+          unsigned X = ChildFrontier[i];
+          if (Seen[X] != Y && PDT.getNode(Blocks[X])->getIDom() != Node) {
+            Seen[X] = Y;
+            Frontier.push_back(X);
+          }
+        }
+        SmallVector<unsigned, 4>().swap(ChildFrontier);
+      }
+
+      for (unsigned i = 0, e = Frontier.size(); i != e; ++i)
+        Edges.push_back(std::make_pair(Frontier[i], Y));
+    }
+
+  buildAdjacency(Edges, NumBlocks, Dependents, DependentBegin);
+  for (unsigned i = 0, e = Edges.size(); i != e; ++i)
+    std::swap(Edges[i].first, Edges[i].second);
+  buildAdjacency(Edges, NumBlocks, Controllers, ControllerBegin);
+  return false;
+}
+
+bool ControlDependenceGraph::isControlDependent(
+    const BasicBlock *Dependent, const BasicBlock *Controller) const {
+  DenseMap<const BasicBlock*, unsigned>::const_iterator
+    DI = BlockNumbers.find(Dependent), CI = BlockNumbers.find(Controller);
+  if (DI == BlockNumbers.end() || CI == BlockNumbers.end() ||
+      Dependents.empty())
+    return false;
+  const unsigned *Begin = &Dependents[0] + DependentBegin[CI->second];
+  const unsigned *End = &Dependents[0] + DependentBegin[CI->second + 1];
+  return std::binary_search(Begin, End, DI->second);
+}
+
+void ControlDependenceGraph::print(raw_ostream &OS, const Module *) const {
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i) {
+    if (DependentBegin[i] == DependentBegin[i + 1])
+      continue;
+    OS << "  Control dependent on ";
+    WriteAsOperand(OS, Blocks[i], false);
+    OS << ":";
+    for (block_iterator I = dependent_begin(Blocks[i]),
+         E = dependent_end(Blocks[i]); I != E; ++I) {
+      OS << ' ';
+      WriteAsOperand(OS, *I, false);
+    }
+    OS << '\n';
+  }
+}
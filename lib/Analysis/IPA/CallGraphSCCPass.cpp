@@ -395,8 +395,14 @@ bool CGPassManager::RunAllPassesOnSCC(CallGraphSCC &CurSCC, CallGraph &CG,
     initializeAnalysisImpl(P);
     
     // Actually run this pass on the current SCC.
-    Changed |= RunPassOnSCC(P, CurSCC, CG,
-                            CallGraphUpToDate, DevirtualizedCall);
+    bool LocalChanged = RunPassOnSCC(P, CurSCC, CG,
+                                     CallGraphUpToDate, DevirtualizedCall);
+    Changed |= LocalChanged;
+
+    // A CallGraphSCCPass may change the callers of the SCC as well.  The
+    // function passes tell the analysis cache themselves what they changed.
+    if (LocalChanged && P->getPassKind() == PT_CallGraphSCC)
+      invalidateCachedAnalysis(P, 0);
     
     if (Changed)
       dumpPassInfo(P, MODIFICATION_MSG, ON_CG_MSG, "");
@@ -0,0 +1,258 @@
+//===-- IRMemoryUsage.cpp - Per-class breakdown of IR memory --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass estimates how much memory the IR of a module takes, broken down by
+// the class of the objects: instructions by their C++ class, constants by
+// kind, globals, arguments, basic blocks, and the value names, debug locations
+// and metadata attachments hanging off them.  Each object is charged its
+// sizeof plus its operand list; allocator overhead, types, metadata nodes and
+// the capacity reserved for growing PHI and switch operands are not counted.
+//
+// Run it from opt with the -analyze option to print the table:
+//
+//   opt -analyze -ir-memory foo.bc
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Constants.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/DebugLoc.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ValueHandle.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+using namespace llvm;
+
+namespace {
+  /// ClassUsage - The number of objects of one class and what they take.
+  struct ClassUsage {
+    uint64_t Count;
+    uint64_t Bytes;
+    ClassUsage() : Count(0), Bytes(0) {}
+  };
+
+  typedef std::pair<const char*, ClassUsage> UsageEntry;
+
+  struct UsageEntryGreater {
+    bool operator()(const UsageEntry &L, const UsageEntry &R) const {
+      if (L.second.Bytes != R.second.Bytes)
+        return L.second.Bytes > R.second.Bytes;
+      return strcmp(L.first, R.first) < 0;
+    }
+  };
+
+  class IRMemoryUsage : public ModulePass {
+    StringMap<ClassUsage> Usage;
+    SmallPtrSet<const Constant*, 256> SeenConstants;
+    uint64_t NumInstructions;
+    uint64_t InstructionBytes;
+    std::string ModuleName;
+
+    void add(const char *Class, uint64_t Bytes, uint64_t Count = 1) {
+      ClassUsage &U = Usage[Class];
+      U.Count += Count;
+      U.Bytes += Bytes;
+    }
+    uint64_t addValue(const Value &V, const char *Class, size_t Size);
+    void addOperands(const User &U);
+    void addConstant(const Constant *C);
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    IRMemoryUsage() : ModulePass(ID) {
+      initializeIRMemoryUsagePass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnModule(Module &M);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+    virtual void print(raw_ostream &O, const Module *M) const;
+    virtual void releaseMemory() {
+      Usage.clear();
+      SeenConstants.clear();
+    }
+  };
+}
+
+char IRMemoryUsage::ID = 0;
+INITIALIZE_PASS(IRMemoryUsage, "ir-memory",
+                "Print a per-class breakdown of IR memory", false, true)
+
+ModulePass *llvm::createIRMemoryUsagePass() { return new IRMemoryUsage(); }
+
+/// getOperandBytes - Return the size of the operand list of U.
+static uint64_t getOperandBytes(const User &U) {
+  unsigned N = U.getNumOperands();
+  if (N == 0)
+    return 0;
+  uint64_t Bytes = N * sizeof(Use);
+  // Operand lists that do not precede their User end in a pointer to it.
+  if (U.op_begin() != reinterpret_cast<const Use*>(&U) - N)
+    Bytes += sizeof(AugmentedUse) - sizeof(Use);
+  return Bytes;
+}
+
+/// addValue - Charge V to Class along with its name, and return the bytes
+/// charged to Class.
+uint64_t IRMemoryUsage::addValue(const Value &V, const char *Class,
+                                 size_t Size) {
+  uint64_t Bytes = Size;
+  if (const User *U = dyn_cast<User>(&V))
+    Bytes += getOperandBytes(*U);
+  add(Class, Bytes);
+
+  if (V.hasName()) {
+    uint64_t NameBytes = sizeof(ValueName) + V.getName().size() + 1;
+#ifdef LLVM_COMPACT_IR
+    NameBytes += sizeof(std::pair<const Value*, ValueName*>);
+#endif
+    add("(value names)", NameBytes);
+    if (isa<Instruction>(V))
+      InstructionBytes += NameBytes;
+  }
+  return Bytes;
+}
+
+/// addConstant - Charge C and the constants it refers to, once each.
+void IRMemoryUsage::addConstant(const Constant *C) {
+  SmallVector<const Constant*, 16> Worklist;
+  Worklist.push_back(C);
+  while (!Worklist.empty()) {
+    C = Worklist.pop_back_val();
+    if (isa<GlobalValue>(C) || !SeenConstants.insert(C))
+      continue;
+
+    switch (C->getValueID()) {
+    default:
+      addValue(*C, "Constant", sizeof(Constant));
+      break;
+#define HANDLE_CONSTANT(CLASS) \
+    case Value::CLASS##Val: addValue(*C, #CLASS, sizeof(CLASS)); break;
+    HANDLE_CONSTANT(UndefValue)
+    HANDLE_CONSTANT(BlockAddress)
+    HANDLE_CONSTANT(ConstantExpr)
+    HANDLE_CONSTANT(ConstantAggregateZero)
+    HANDLE_CONSTANT(ConstantInt)
+    HANDLE_CONSTANT(ConstantFP)
+    HANDLE_CONSTANT(ConstantArray)
+    HANDLE_CONSTANT(ConstantStruct)
+    HANDLE_CONSTANT(ConstantVector)
+    HANDLE_CONSTANT(ConstantPointerNull)
+#undef HANDLE_CONSTANT
+    }
+
+    for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E;
+         ++I)
+      if (const Constant *Op = dyn_cast<Constant>(*I))
+        Worklist.push_back(Op);
+  }
+}
+
+/// addOperands - Charge the constants that U refers to.
+void IRMemoryUsage::addOperands(const User &U) {
+  for (User::const_op_iterator I = U.op_begin(), E = U.op_end(); I != E; ++I)
+    if (const Constant *C = dyn_cast<Constant>(*I))
+      addConstant(C);
+}
+
+bool IRMemoryUsage::runOnModule(Module &M) {
+  NumInstructions = InstructionBytes = 0;
+  ModuleName = M.getModuleIdentifier();
+
+  for (Module::global_iterator GV = M.global_begin(), E = M.global_end();
+       GV != E; ++GV) {
+    addValue(*GV, "GlobalVariable", sizeof(GlobalVariable));
+    addOperands(*GV);
+  }
+  for (Module::alias_iterator GA = M.alias_begin(), E = M.alias_end();
+       GA != E; ++GA) {
+    addValue(*GA, "GlobalAlias", sizeof(GlobalAlias));
+    addOperands(*GA);
+  }
+
+  SmallVector<std::pair<unsigned, MDNode*>, 4> MDs;
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+    addValue(*F, "Function", sizeof(Function));
+    for (Function::arg_iterator A = F->arg_begin(), AE = F->arg_end();
+         A != AE; ++A)
+      addValue(*A, "Argument", sizeof(Argument));
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+      addValue(*BB, "BasicBlock", sizeof(BasicBlock));
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE;
+           ++I) {
+        ++NumInstructions;
+        switch (I->getOpcode()) {
+        default: assert(0 && "Unknown instruction!");
+#define HANDLE_INST(N, OPC, CLASS)                                          \
+        case Instruction::OPC:                                              \
+          InstructionBytes += addValue(*I, #CLASS, sizeof(CLASS));          \
+          break;
+#include "llvm/Instruction.def"
+        }
+        addOperands(*I);
+
+#ifdef LLVM_COMPACT_IR
+        if (!I->getDebugLoc().isUnknown()) {
+          uint64_t Bytes = sizeof(std::pair<const Instruction*, DebugLoc>);
+          add("(debug locations)", Bytes);
+          InstructionBytes += Bytes;
+        }
+#endif
+        MDs.clear();
+        I->getAllMetadataOtherThanDebugLoc(MDs);
+        if (!MDs.empty()) {
+          uint64_t Bytes =
+            MDs.size() * sizeof(std::pair<unsigned, TrackingVH<MDNode> >);
+          add("(metadata attachments)", Bytes, MDs.size());
+          InstructionBytes += Bytes;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void IRMemoryUsage::print(raw_ostream &O, const Module *) const {
+  std::vector<UsageEntry> Entries;
+  uint64_t TotalCount = 0, TotalBytes = 0;
+  for (StringMap<ClassUsage>::const_iterator I = Usage.begin(),
+       E = Usage.end(); I != E; ++I) {
+    Entries.push_back(UsageEntry(I->getKeyData(), I->getValue()));
+    TotalCount += I->getValue().Count;
+    TotalBytes += I->getValue().Bytes;
+  }
+  std::sort(Entries.begin(), Entries.end(), UsageEntryGreater());
+
+  O << "IR memory of module '" << ModuleName << "':\n";
+  O << "       Count        Bytes  Bytes/Each  Class\n";
+  for (unsigned i = 0, e = Entries.size(); i != e; ++i) {
+    const ClassUsage &U = Entries[i].second;
+    O << format("%12llu %12llu", (unsigned long long)U.Count,
+                (unsigned long long)U.Bytes)
+      << format(" %11.1f  ", double(U.Bytes) / U.Count)
+      << Entries[i].first << '\n';
+  }
+  O << format("%12llu %12llu", (unsigned long long)TotalCount,
+              (unsigned long long)TotalBytes)
+    << "              Total\n";
+  if (NumInstructions)
+    O << format("%.1f bytes per instruction, including operands, names and "
+                "attachments\n", double(InstructionBytes) / NumInstructions);
+}
@@ -15,6 +15,7 @@
 
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Assembly/PrintModulePass.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
 using namespace llvm;
@@ -234,6 +235,11 @@ bool LPPassManager::runOnFunction(Function &F) {
   if (LQ.empty()) // No loops, skip calling finalizers
     return false;
 
+  // The passes that changed F.  The analyses of F kept in an analysis cache
+  // are only invalidated once all loops are done, since LI and the analyses
+  // the loop passes were given must stay alive until then.
+  SmallPtrSet<Pass*, 4> ChangingPasses;
+
   // Initialization
   for (std::deque<Loop *>::const_iterator I = LQ.begin(), E = LQ.end();
        I != E; ++I) {
@@ -261,12 +267,16 @@ bool LPPassManager::runOnFunction(Function &F) {
 
       initializeAnalysisImpl(P);
 
+      bool LocalChanged;
       {
         PassManagerPrettyStackEntry X(P, *CurrentLoop->getHeader());
         TimeRegion PassTimer(getPassTimer(P));
 
-        Changed |= P->runOnLoop(CurrentLoop, *this);
+        LocalChanged = P->runOnLoop(CurrentLoop, *this);
       }
+      Changed |= LocalChanged;
+      if (LocalChanged)
+        ChangingPasses.insert(P);
 
       if (Changed)
         dumpPassInfo(P, MODIFICATION_MSG, ON_LOOP_MSG,
@@ -323,6 +333,10 @@ bool LPPassManager::runOnFunction(Function &F) {
     Changed |= P->doFinalization();
   }
 
+  for (SmallPtrSet<Pass*, 4>::iterator I = ChangingPasses.begin(),
+       E = ChangingPasses.end(); I != E; ++I)
+    invalidateCachedAnalysis(*I, &F);
+
   return Changed;
 }
 
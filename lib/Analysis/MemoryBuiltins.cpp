@@ -35,7 +35,8 @@ static bool isMallocCall(const CallInst *CI) {
     return false;
 
   Function *Callee = CI->getCalledFunction();
-  if (Callee == 0 || !Callee->isDeclaration() || Callee->getName() != "malloc")
+  if (Callee == 0 || !Callee->isDeclaration() || Callee->isMaterializable() ||
+      Callee->getName() != "malloc")
     return false;
 
   // Check malloc prototype.
@@ -189,7 +190,8 @@ const CallInst *llvm::isFreeCall(const Value *I) {
   if (!CI)
     return 0;
   Function *Callee = CI->getCalledFunction();
-  if (Callee == 0 || !Callee->isDeclaration() || Callee->getName() != "free")
+  if (Callee == 0 || !Callee->isDeclaration() || Callee->isMaterializable() ||
+      Callee->getName() != "free")
     return 0;
 
   // Check free prototype.
@@ -15,6 +15,7 @@
 //===----------------------------------------------------------------------===//
 #include "llvm/Analysis/RegionPass.h"
 #include "llvm/Analysis/RegionIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/Timer.h"
 
 #define DEBUG_TYPE "regionpassmgr"
@@ -62,6 +63,10 @@ bool RGPassManager::runOnFunction(Function &F) {
   if (RQ.empty()) // No regions, skip calling finalizers
     return false;
 
+  // The passes that changed F.  Like RI, the analyses of F kept in an analysis
+  // cache must stay alive until all regions are done.
+  SmallPtrSet<Pass*, 4> ChangingPasses;
+
   // Initialization
   for (std::deque<Region *>::const_iterator I = RQ.begin(), E = RQ.end();
        I != E; ++I) {
@@ -89,12 +94,16 @@ bool RGPassManager::runOnFunction(Function &F) {
 
       initializeAnalysisImpl(P);
 
+      bool LocalChanged;
       {
         PassManagerPrettyStackEntry X(P, *CurrentRegion->getEntry());
 
         TimeRegion PassTimer(getPassTimer(P));
-        Changed |= P->runOnRegion(CurrentRegion, *this);
+        LocalChanged = P->runOnRegion(CurrentRegion, *this);
       }
+      Changed |= LocalChanged;
+      if (LocalChanged)
+        ChangingPasses.insert(P);
 
       if (Changed)
         dumpPassInfo(P, MODIFICATION_MSG, ON_REGION_MSG,
@@ -154,6 +163,10 @@ bool RGPassManager::runOnFunction(Function &F) {
     Changed |= P->doFinalization();
   }
 
+  for (SmallPtrSet<Pass*, 4>::iterator I = ChangingPasses.begin(),
+       E = ChangingPasses.end(); I != E; ++I)
+    invalidateCachedAnalysis(*I, &F);
+
   // Print the region tree after all pass.
   DEBUG(
     dbgs() << "\nRegion tree of function " << F.getName()
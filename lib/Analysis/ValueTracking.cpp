@@ -1177,7 +1177,7 @@ bool llvm::CannotBeNegativeZero(const Value *V, unsigned Depth) {
   
   if (const CallInst *CI = dyn_cast<CallInst>(I))
     if (const Function *F = CI->getCalledFunction()) {
-      if (F->isDeclaration()) {
+      if (F->isDeclaration() && !F->isMaterializable()) {
         // abs(x) != -0.0
         if (F->getName() == "abs") return true;
         // fabs[lf](x) != -0.0
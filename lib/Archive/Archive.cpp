@@ -144,13 +144,18 @@ bool ArchiveMember::replaceWith(const sys::Path& newFile, std::string* ErrMsg) {
 // initializes and maps the file into memory, if requested.
 Archive::Archive(const sys::Path& filename, LLVMContext& C)
   : archPath(filename), members(), mapfile(0), base(0), symTab(), strtab(),
-    symTabSize(0), firstFileOffset(0), modules(), foreignST(0), Context(C) {
+    symTabSize(0), symTabData(0), symIndex(0), symIndexBuckets(0),
+    membersScanned(false), firstFileOffset(0), modules(), foreignST(0),
+    Context(C) {
 }
 
 bool
 Archive::mapToMemory(std::string* ErrMsg) {
   OwningPtr<MemoryBuffer> File;
-  if (error_code ec = MemoryBuffer::getFile(archPath.c_str(), File)) {
+  // The members are handed to the bitcode reader in place, so the archive is
+  // mapped without a trailing null byte whenever it is large enough.
+  if (error_code ec = MemoryBuffer::getFile(archPath.c_str(), File, -1,
+                                            false)) {
     if (ErrMsg)
       *ErrMsg = ec.message();
     return true;
@@ -161,6 +166,15 @@ Archive::mapToMemory(std::string* ErrMsg) {
 }
 
 void Archive::cleanUpMemory() {
+  // Delete any Modules and ArchiveMember's we've allocated as a result of
+  // symbol table searches.  Lazily loaded modules refer to the file mapping,
+  // so this has to happen first.
+  for (ModuleMap::iterator I=modules.begin(), E=modules.end(); I != E; ++I ) {
+    delete I->second.first;
+    delete I->second.second;
+  }
+  modules.clear();
+
   // Shutdown the file mapping
   delete mapfile;
   mapfile = 0;
@@ -169,6 +183,10 @@ void Archive::cleanUpMemory() {
   // Forget the entire symbol table
   symTab.clear();
   symTabSize = 0;
+  symTabData = 0;
+  symIndex = 0;
+  symIndexBuckets = 0;
+  membersScanned = false;
 
   firstFileOffset = 0;
 
@@ -177,13 +195,6 @@ void Archive::cleanUpMemory() {
     delete foreignST;
     foreignST = 0;
   }
-
-  // Delete any Modules and ArchiveMember's we've allocated as a result of
-  // symbol table searches.
-  for (ModuleMap::iterator I=modules.begin(), E=modules.end(); I != E; ++I ) {
-    delete I->second.first;
-    delete I->second.second;
-  }
 }
 
 // Archive destructor - just clean up memory
@@ -200,9 +211,11 @@ static void getSymbols(Module*M, std::vector<std::string>& symbols) {
       if (!GI->getName().empty())
         symbols.push_back(GI->getName());
 
-  // Loop over functions
+  // Loop over functions. The module may be lazily loaded, in which case the
+  // functions with bodies are still materializable.
   for (Module::iterator FI = M->begin(), FE = M->end(); FI != FE; ++FI)
-    if (!FI->isDeclaration() && !FI->hasLocalLinkage())
+    if ((!FI->isDeclaration() || FI->isMaterializable()) &&
+        !FI->hasLocalLinkage())
       if (!FI->getName().empty())
         symbols.push_back(FI->getName());
 
@@ -220,7 +233,8 @@ bool llvm::GetBitcodeSymbols(const sys::Path& fName,
                              std::vector<std::string>& symbols,
                              std::string* ErrMsg) {
   OwningPtr<MemoryBuffer> Buffer;
-  if (error_code ec = MemoryBuffer::getFileOrSTDIN(fName.c_str(), Buffer)) {
+  if (error_code ec = MemoryBuffer::getFileOrSTDIN(fName.c_str(), Buffer, -1,
+                                                   false)) {
     if (ErrMsg) *ErrMsg = "Could not open file '" + fName.str() + "'" + ": "
                         + ec.message();
     return true;
@@ -244,11 +258,13 @@ llvm::GetBitcodeSymbols(const char *BufPtr, unsigned Length,
                         LLVMContext& Context,
                         std::vector<std::string>& symbols,
                         std::string* ErrMsg) {
-  // Get the module.
-  OwningPtr<MemoryBuffer> Buffer(
-    MemoryBuffer::getMemBufferCopy(StringRef(BufPtr, Length),ModuleID.c_str()));
+  // Get the module.  The bitcode is read in place and only the global
+  // declarations are parsed; the function bodies are never needed here.
+  MemoryBuffer *Buffer =
+    MemoryBuffer::getMemBuffer(StringRef(BufPtr, Length), ModuleID.c_str(),
+                               false);
 
-  Module *M = ParseBitcodeFile(Buffer.get(), Context, ErrMsg);
+  Module *M = getLazyBitcodeModule(Buffer, Context, ErrMsg);
   if (!M)
     return 0;
 
@@ -256,6 +272,6 @@ llvm::GetBitcodeSymbols(const char *BufPtr, unsigned Length,
   getSymbols(M, symbols);
 
   // Done with the module. Note that it's the caller's responsibility to delete
-  // the Module.
+  // the Module, which also frees Buffer.
   return M;
 }
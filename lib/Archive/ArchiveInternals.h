@@ -24,6 +24,7 @@
 #define ARFILE_MAGIC_LEN (sizeof(ARFILE_MAGIC)-1)  ///< length of magic string
 #define ARFILE_SVR4_SYMTAB_NAME "/               " ///< SVR4 symtab entry name
 #define ARFILE_LLVM_SYMTAB_NAME "#_LLVM_SYM_TAB_#" ///< LLVM symtab entry name
+#define ARFILE_LLVM_SYMIDX_NAME "#_LLVM_SYM_IDX_#" ///< LLVM symtab hash index
 #define ARFILE_BSD4_SYMTAB_NAME "__.SYMDEF SORTED" ///< BSD4 symtab entry name
 #define ARFILE_STRTAB_NAME      "//              " ///< Name of string table
 #define ARFILE_PAD "\n"                            ///< inter-file align padding
@@ -71,12 +72,25 @@ namespace llvm {
     }
   };
   
+  /// HashArchiveSymbol - The hash function used by the LLVM symbol table
+  /// index.  This is the Bernstein hash; it is part of the archive format and
+  /// must not change.
+  static inline unsigned HashArchiveSymbol(const char *Name, unsigned Len) {
+    unsigned Result = 0;
+    for (unsigned i = 0; i != Len; ++i)
+      Result = Result * 33 + (unsigned char)Name[i];
+    return Result;
+  }
+
   // Get just the externally visible defined symbols from the bitcode
   bool GetBitcodeSymbols(const sys::Path& fName,
                           LLVMContext& Context,
                           std::vector<std::string>& symbols,
                           std::string* ErrMsg);
   
+  // Get the externally visible defined symbols from the bitcode in Buffer,
+  // which is read in place. The returned module is lazily loaded and still
+  // refers to Buffer; it's the caller's responsibility to delete it.
   Module* GetBitcodeSymbols(const char *Buffer, unsigned Length,
                             const std::string& ModuleID,
                             LLVMContext& Context,
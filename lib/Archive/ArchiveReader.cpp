@@ -14,6 +14,8 @@
 #include "ArchiveInternals.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
 #include <cstdlib>
 #include <memory>
@@ -64,6 +66,67 @@ Archive::parseSymbolTable(const void* data, unsigned size, std::string* error) {
   return true;
 }
 
+/// Read a 32-bit little endian integer.
+static inline unsigned readLE32(const char* At) {
+  const unsigned char* P = (const unsigned char*)At;
+  return P[0] | (P[1] << 8) | (P[2] << 16) | ((unsigned)P[3] << 24);
+}
+
+// Check the hash index of the symbol table and start using it for lookups.
+bool
+Archive::setSymbolIndex(const char* data, unsigned size) {
+  if (size < 4)
+    return false;
+  unsigned NumBuckets = readLE32(data);
+  if (NumBuckets == 0 || (NumBuckets & (NumBuckets - 1)) != 0 ||
+      NumBuckets > (size - 4) / 4)
+    return false;
+  symIndex = data + 4;
+  symIndexBuckets = NumBuckets;
+  return true;
+}
+
+// Find a symbol in the symbol table, using the hash index when there is one.
+bool
+Archive::lookupSymbol(const std::string& symbol, unsigned& offset) {
+  if (!symIndex) {
+    SymTabType::iterator SI = symTab.find(symbol);
+    if (SI == symTab.end())
+      return false;
+    offset = SI->second;
+    return true;
+  }
+
+  const char* End = symTabData + symTabSize;
+  unsigned Mask = symIndexBuckets - 1;
+  unsigned Bucket = HashArchiveSymbol(symbol.data(), symbol.length()) & Mask;
+  for (unsigned Probes = 0; Probes != symIndexBuckets; ++Probes) {
+    unsigned Entry = readLE32(symIndex + 4 * Bucket);
+    // An empty bucket ends the probe sequence; an entry that doesn't point
+    // into the symbol table means the index is corrupt.
+    if (Entry == 0 || Entry > symTabSize)
+      return false;
+    const char* At = symTabData + Entry - 1;
+    unsigned EntryOffset = readInteger(At, End);
+    unsigned Length = readInteger(At, End);
+    if (Length == symbol.length() && At + Length <= End &&
+        memcmp(At, symbol.data(), Length) == 0) {
+      offset = EntryOffset;
+      return true;
+    }
+    Bucket = (Bucket + 1) & Mask;
+  }
+  return false;
+}
+
+const Archive::SymTabType&
+Archive::getSymbolTable() {
+  // An indexed symbol table is only parsed when someone wants to walk it.
+  if (symTab.empty() && symTabData)
+    parseSymbolTable(symTabData, symTabSize, 0);
+  return symTab;
+}
+
 // This member parses an ArchiveMemberHeader that is presumed to be pointed to
 // by At. The At pointer is updated to the byte just after the header, which
 // can be variable in size.
@@ -140,6 +203,10 @@ Archive::parseMemberHeader(const char*& At, const char* End, std::string* error)
         // the member's data. The pathname already has the #1/ stripped.
         pathname.assign(ARFILE_LLVM_SYMTAB_NAME);
         flags |= ArchiveMember::LLVMSymbolTableFlag;
+      } else if (Hdr->name[1] == '_' &&
+                 (0 == memcmp(Hdr->name, ARFILE_LLVM_SYMIDX_NAME, 16))) {
+        pathname.assign(ARFILE_LLVM_SYMIDX_NAME);
+        flags |= ArchiveMember::LLVMSymbolIndexFlag;
       }
       break;
     case '/':
@@ -255,6 +322,9 @@ Archive::loadArchive(std::string* error) {
   // Set up parsing
   members.clear();
   symTab.clear();
+  symTabData = 0;
+  symIndex = 0;
+  membersScanned = false;
   const char *At = base;
   const char *End = mapfile->getBufferEnd();
 
@@ -310,6 +380,13 @@ Archive::loadArchive(std::string* error) {
       if ((intptr_t(At) & 1) == 1)
         At++;
       delete mbr; // We don't need this member in the list of members.
+    } else if (mbr->isLLVMSymbolIndex()) {
+      // The symbol table has been parsed in full, so its index isn't needed.
+      // It is rebuilt whenever the symbol table is written.
+      At += mbr->getSize();
+      if ((intptr_t(At) & 1) == 1)
+        At++;
+      delete mbr;
     } else {
       // This is just a regular file. If its the first one, save its offset.
       // Otherwise just push it on the list and move on to the next file.
@@ -348,8 +425,8 @@ Archive::getAllModules(std::vector<Module*>& Modules,
       std::string FullMemberName = archPath.str() +
         "(" + I->getPath().str() + ")";
       MemoryBuffer *Buffer =
-        MemoryBuffer::getMemBufferCopy(StringRef(I->getData(), I->getSize()),
-                                       FullMemberName.c_str());
+        MemoryBuffer::getMemBuffer(StringRef(I->getData(), I->getSize()),
+                                   FullMemberName.c_str(), false);
       
       Module *M = ParseBitcodeFile(Buffer, Context, ErrMessage);
       delete Buffer;
@@ -369,6 +446,9 @@ Archive::loadSymbolTable(std::string* ErrorMsg) {
   // Set up parsing
   members.clear();
   symTab.clear();
+  symTabData = 0;
+  symIndex = 0;
+  membersScanned = false;
   const char *At = base;
   const char *End = mapfile->getBufferEnd();
 
@@ -418,17 +498,37 @@ Archive::loadSymbolTable(std::string* ErrorMsg) {
 
   // See if its the symbol table
   if (mbr->isLLVMSymbolTable()) {
-    if (!parseSymbolTable(mbr->getData(), mbr->getSize(), ErrorMsg)) {
-      delete mbr;
-      return false;
-    }
-
+    const char* SymTabData = (const char*)mbr->getData();
+    unsigned SymTabSize = mbr->getSize();
     At += mbr->getSize();
     if ((intptr_t(At) & 1) == 1)
       At++;
     delete mbr;
-    // Can't be any more symtab headers so just advance
     FirstFile = At;
+
+    // If the symbol table is followed by its hash index, symbols are looked
+    // up through the index and the table itself is only parsed on demand.
+    // Otherwise parse the whole table now.
+    mbr = At < End ? parseMemberHeader(At, End, 0) : 0;
+    if (mbr && mbr->isLLVMSymbolIndex() &&
+        setSymbolIndex((const char*)mbr->getData(), mbr->getSize())) {
+      symTabData = SymTabData;
+      symTabSize = SymTabSize;
+      At += mbr->getSize();
+      if ((intptr_t(At) & 1) == 1)
+        At++;
+      FirstFile = At;
+    } else if (!parseSymbolTable(SymTabData, SymTabSize, ErrorMsg)) {
+      delete mbr;
+      return false;
+    } else if (mbr && mbr->isLLVMSymbolIndex()) {
+      // A malformed index is ignored, but it still isn't a "real" file.
+      At += mbr->getSize();
+      if ((intptr_t(At) & 1) == 1)
+        At++;
+      FirstFile = At;
+    }
+    delete mbr;
   } else {
     // There's no symbol table in the file. We have to rebuild it from scratch
     // because the intent of this method is to get the symbol table loaded so
@@ -458,8 +558,8 @@ Archive* Archive::OpenAndLoadSymbols(const sys::Path& file,
 Module*
 Archive::findModuleDefiningSymbol(const std::string& symbol, 
                                   std::string* ErrMsg) {
-  SymTabType::iterator SI = symTab.find(symbol);
-  if (SI == symTab.end())
+  unsigned symOffset;
+  if (!lookupSymbol(symbol, symOffset))
     return 0;
 
   // The symbol table was previously constructed assuming that the members were
@@ -469,7 +569,7 @@ Archive::findModuleDefiningSymbol(const std::string& symbol,
   // We now have to account for this by adjusting the offset by the size of the
   // symbol table and its header.
   unsigned fileOffset =
-    SI->second +                // offset in symbol-table-less file
+    symOffset +                 // offset in symbol-table-less file
     firstFileOffset;            // add offset to first "real" file in archive
 
   // See if the module is already loaded
@@ -487,9 +587,11 @@ Archive::findModuleDefiningSymbol(const std::string& symbol,
   // Now, load the bitcode module to get the Module.
   std::string FullMemberName = archPath.str() + "(" +
     mbr->getPath().str() + ")";
+  // The lazily loaded module reads its function bodies straight from the
+  // file mapping, which lives as long as the module.
   MemoryBuffer *Buffer =
-    MemoryBuffer::getMemBufferCopy(StringRef(mbr->getData(), mbr->getSize()),
-                                   FullMemberName.c_str());
+    MemoryBuffer::getMemBuffer(StringRef(mbr->getData(), mbr->getSize()),
+                               FullMemberName.c_str(), false);
   
   Module *m = getLazyBitcodeModule(Buffer, Context, ErrMsg);
   if (!m)
@@ -500,6 +602,94 @@ Archive::findModuleDefiningSymbol(const std::string& symbol,
   return m;
 }
 
+namespace {
+  /// MemberSymbols - The symbols defined by one bitcode member, computed by
+  /// a ScanMember task.
+  struct MemberSymbols {
+    const char* Data;
+    unsigned Size;
+    unsigned Offset;
+    std::string Name;
+    std::vector<std::string> Symbols;
+    std::string Error;
+    bool Failed;
+  };
+}
+
+/// ScanMember - Read the symbols of one bitcode member. Each task reads the
+/// member into a private context so that members can be scanned
+/// concurrently; only the global declarations are parsed.
+static void ScanMember(void* P) {
+  MemberSymbols* MS = static_cast<MemberSymbols*>(P);
+  LLVMContext Context;
+  Module* M = GetBitcodeSymbols(MS->Data, MS->Size, MS->Name, Context,
+                                MS->Symbols, &MS->Error);
+  MS->Failed = M == 0;
+  delete M;
+}
+
+// Build the symbol table of an archive that doesn't have one.
+bool
+Archive::scanMemberSymbols(std::string* error) {
+  std::vector<MemberSymbols> Members;
+
+  // Get a pointer to the first file
+  const char* At  = base + firstFileOffset;
+  const char* End = mapfile->getBufferEnd();
+
+  while (At < End) {
+    // Compute the offset to be put in the symbol table
+    unsigned offset = At - base - firstFileOffset;
+
+    // Parse the file's header
+    ArchiveMember* mbr = parseMemberHeader(At, End, error);
+    if (!mbr)
+      return false;
+
+    if (mbr->isBitcode()) {
+      Members.push_back(MemberSymbols());
+      MemberSymbols& MS = Members.back();
+      MS.Data = At;
+      MS.Size = mbr->getSize();
+      MS.Offset = offset;
+      MS.Name = archPath.str() + "(" + mbr->getPath().str() + ")";
+      MS.Failed = false;
+    }
+
+    // Go to the next file location
+    At += mbr->getSize();
+    if ((intptr_t(At) & 1) == 1)
+      At++;
+    delete mbr;
+  }
+
+  // Members are independent, so read them all at once. The pool runs the
+  // tasks in place unless LLVM is multithreaded.
+  {
+    ThreadPool Pool(Members.size() > 1 ? 0 : 1);
+    for (unsigned i = 0, e = Members.size(); i != e; ++i)
+      Pool.async(ScanMember, &Members[i]);
+    Pool.wait();
+  }
+
+  // Insert the symbols in member order so that the first member defining a
+  // symbol wins, as it does in a symbol table written by llvm-ranlib. The
+  // modules themselves are loaded lazily by findModuleDefiningSymbol.
+  for (unsigned i = 0, e = Members.size(); i != e; ++i) {
+    MemberSymbols& MS = Members[i];
+    if (MS.Failed) {
+      if (error)
+        *error = "Can't parse bitcode member: " + MS.Name + ": " + MS.Error;
+      return false;
+    }
+    for (std::vector<std::string>::iterator I = MS.Symbols.begin(),
+         E = MS.Symbols.end(); I != E; ++I)
+      symTab.insert(std::make_pair(*I, MS.Offset));
+  }
+  membersScanned = true;
+  return true;
+}
+
 // Look up multiple symbols in the symbol table and return a set of
 // Modules that define those symbols.
 bool
@@ -512,59 +702,12 @@ Archive::findModulesDefiningSymbols(std::set<std::string>& symbols,
     return false;
   }
 
-  if (symTab.empty()) {
-    // We don't have a symbol table, so we must build it now but lets also
-    // make sure that we populate the modules table as we do this to ensure
-    // that we don't load them twice when findModuleDefiningSymbol is called
-    // below.
-
-    // Get a pointer to the first file
-    const char* At  = base + firstFileOffset;
-    const char* End = mapfile->getBufferEnd();
-
-    while ( At < End) {
-      // Compute the offset to be put in the symbol table
-      unsigned offset = At - base - firstFileOffset;
-
-      // Parse the file's header
-      ArchiveMember* mbr = parseMemberHeader(At, End, error);
-      if (!mbr)
-        return false;
-
-      // If it contains symbols
-      if (mbr->isBitcode()) {
-        // Get the symbols
-        std::vector<std::string> symbols;
-        std::string FullMemberName = archPath.str() + "(" +
-          mbr->getPath().str() + ")";
-        Module* M = 
-          GetBitcodeSymbols(At, mbr->getSize(), FullMemberName, Context,
-                            symbols, error);
-
-        if (M) {
-          // Insert the module's symbols into the symbol table
-          for (std::vector<std::string>::iterator I = symbols.begin(),
-               E=symbols.end(); I != E; ++I ) {
-            symTab.insert(std::make_pair(*I, offset));
-          }
-          // Insert the Module and the ArchiveMember into the table of
-          // modules.
-          modules.insert(std::make_pair(offset, std::make_pair(M, mbr)));
-        } else {
-          if (error)
-            *error = "Can't parse bitcode member: " + 
-              mbr->getPath().str() + ": " + *error;
-          delete mbr;
-          return false;
-        }
-      }
-
-      // Go to the next file location
-      At += mbr->getSize();
-      if ((intptr_t(At) & 1) == 1)
-        At++;
-    }
-  }
+  // If we don't have a symbol table, we must build it now. Only do this
+  // once: an archive that defines no symbols would otherwise be rescanned on
+  // every call.
+  if (symTab.empty() && !symIndex && !membersScanned)
+    if (!scanMemberSymbols(error))
+      return false;
 
   // At this point we have a valid symbol table (one way or another) so we
   // just use it to quickly find the symbols requested.
@@ -591,13 +734,13 @@ Archive::findModulesDefiningSymbols(std::set<std::string>& symbols,
 bool Archive::isBitcodeArchive() {
   // Make sure the symTab has been loaded. In most cases this should have been
   // done when the archive was constructed, but still,  this is just in case.
-  if (symTab.empty())
+  if (symTab.empty() && !symIndex)
     if (!loadSymbolTable(0))
       return false;
 
   // Now that we know it's been loaded, return true
   // if it has a size
-  if (symTab.size()) return true;
+  if (symTab.size() || symIndex) return true;
 
   // We still can't be sure it isn't a bitcode archive
   if (!loadArchive(0))
@@ -616,8 +759,8 @@ bool Archive::isBitcodeArchive() {
       archPath.str() + "(" + I->getPath().str() + ")";
 
     MemoryBuffer *Buffer =
-      MemoryBuffer::getMemBufferCopy(StringRef(I->getData(), I->getSize()),
-                                     FullMemberName.c_str());
+      MemoryBuffer::getMemBuffer(StringRef(I->getData(), I->getSize()),
+                                 FullMemberName.c_str(), false);
     Module *M = ParseBitcodeFile(Buffer, Context);
     delete Buffer;
     if (!M)
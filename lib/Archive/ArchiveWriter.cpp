@@ -218,7 +218,8 @@ Archive::writeMember(
   MemoryBuffer *mFile = 0;
   if (!data) {
     OwningPtr<MemoryBuffer> File;
-    if (error_code ec = MemoryBuffer::getFile(member.getPath().c_str(), File)) {
+    if (error_code ec = MemoryBuffer::getFile(member.getPath().c_str(), File,
+                                              -1, false)) {
       if (ErrMsg)
         *ErrMsg = ec.message();
       return true;
@@ -289,14 +290,21 @@ Archive::writeMember(
   return false;
 }
 
-// Write out the LLVM symbol table as an archive member to the file.
-void
-Archive::writeSymbolTable(std::ofstream& ARFile) {
+// Write a 32-bit integer in little endian byte order.
+static inline void writeLE32(unsigned num, std::ofstream& ARFile) {
+  char bytes[4];
+  bytes[0] = (char)(num & 0xFF);
+  bytes[1] = (char)((num >> 8) & 0xFF);
+  bytes[2] = (char)((num >> 16) & 0xFF);
+  bytes[3] = (char)((num >> 24) & 0xFF);
+  ARFile.write(bytes, 4);
+}
 
-  // Construct the symbol table's header
-  ArchiveMemberHeader Hdr;
+// Fill in the header of one of the LLVM symbol table members.
+static void fillSymbolTableHeader(ArchiveMemberHeader& Hdr, const char* name,
+                                  unsigned size) {
   Hdr.init();
-  memcpy(Hdr.name,ARFILE_LLVM_SYMTAB_NAME,16);
+  memcpy(Hdr.name,name,16);
   uint64_t secondsSinceEpoch = sys::TimeValue::now().toEpochTime();
   char buffer[32];
   sprintf(buffer, "%-8o", 0644);
@@ -307,8 +315,17 @@ Archive::writeSymbolTable(std::ofstream& ARFile) {
   memcpy(Hdr.gid,buffer,6);
   sprintf(buffer,"%-12u", unsigned(secondsSinceEpoch));
   memcpy(Hdr.date,buffer,12);
-  sprintf(buffer,"%-10u",symTabSize);
+  sprintf(buffer,"%-10u",size);
   memcpy(Hdr.size,buffer,10);
+}
+
+// Write out the LLVM symbol table as an archive member to the file.
+void
+Archive::writeSymbolTable(std::ofstream& ARFile) {
+
+  // Construct the symbol table's header
+  ArchiveMemberHeader Hdr;
+  fillSymbolTableHeader(Hdr, ARFILE_LLVM_SYMTAB_NAME, symTabSize);
 
   // Write the header
   ARFile.write((char*)&Hdr, sizeof(Hdr));
@@ -344,6 +361,40 @@ Archive::writeSymbolTable(std::ofstream& ARFile) {
     ARFile << ARFILE_PAD;
 }
 
+// Write out the hash index of the LLVM symbol table as an archive member to
+// the file. Each bucket holds one plus the offset of a symbol's entry in the
+// symbol table, or zero if the bucket is empty. Collisions are resolved by
+// linear probing and the table is kept at most half full.
+void
+Archive::writeSymbolIndex(std::ofstream& ARFile) {
+  unsigned NumBuckets = 1;
+  while (NumBuckets < 2 * symTab.size())
+    NumBuckets <<= 1;
+
+  std::vector<unsigned> Buckets(NumBuckets, 0);
+  unsigned EntryOffset = 0;
+  for (Archive::SymTabType::iterator I = symTab.begin(), E = symTab.end();
+       I != E; ++I) {
+    unsigned Bucket = HashArchiveSymbol(I->first.data(), I->first.length());
+    Bucket &= NumBuckets - 1;
+    while (Buckets[Bucket])
+      Bucket = (Bucket + 1) & (NumBuckets - 1);
+    Buckets[Bucket] = EntryOffset + 1;
+    EntryOffset += numVbrBytes(I->second) + numVbrBytes(I->first.length()) +
+                   I->first.length();
+  }
+  assert(EntryOffset == symTabSize && "Invalid symTabSize computation");
+
+  // Construct and write the index's header, then the buckets.
+  ArchiveMemberHeader Hdr;
+  fillSymbolTableHeader(Hdr, ARFILE_LLVM_SYMIDX_NAME, 4 * (NumBuckets + 1));
+  ARFile.write((char*)&Hdr, sizeof(Hdr));
+
+  writeLE32(NumBuckets, ARFile);
+  for (unsigned i = 0; i != NumBuckets; ++i)
+    writeLE32(Buckets[i], ARFile);
+}
+
 // Write the entire archive to the file specified when the archive was created.
 // This writes to a temporary file first. Options are for creating a symbol
 // table, flattening the file names (no directories, 15 chars max) and
@@ -416,7 +467,8 @@ Archive::writeToDisk(bool CreateSymbolTable, bool TruncateNames, bool Compress,
     // Map in the archive we just wrote.
     {
     OwningPtr<MemoryBuffer> arch;
-    if (error_code ec = MemoryBuffer::getFile(TmpArchive.c_str(), arch)) {
+    if (error_code ec = MemoryBuffer::getFile(TmpArchive.c_str(), arch, -1,
+                                              false)) {
       if (ErrMsg)
         *ErrMsg = ec.message();
       return true;
@@ -453,8 +505,11 @@ Archive::writeToDisk(bool CreateSymbolTable, bool TruncateNames, bool Compress,
       }
     }
 
-    // Put out the LLVM symbol table now.
+    // Put out the LLVM symbol table now, followed by its hash index so that
+    // linkers can look symbols up without parsing the whole table.
     writeSymbolTable(FinalFile);
+    if (!symTab.empty())
+      writeSymbolIndex(FinalFile);
 
     // Copy the temporary file contents being sure to skip the file's magic
     // number.
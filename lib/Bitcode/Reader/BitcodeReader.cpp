@@ -20,11 +20,15 @@
 #include "llvm/Module.h"
 #include "llvm/Operator.h"
 #include "llvm/AutoUpgrade.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/OperandTraits.h"
+#include <algorithm>
 using namespace llvm;
 
 void BitcodeReader::FreeState() {
@@ -1276,6 +1280,139 @@ bool BitcodeReader::RememberAndSkipFunctionBody() {
   return false;
 }
 
+/// ParseFunctionIndex - Read the function index block that comes before the
+/// function blocks.  If the index that it points to lists all of them, where
+/// each one is is taken from there, and the function blocks are not walked.
+bool BitcodeReader::ParseFunctionIndex() {
+  if (Stream.EnterSubBlock(bitc::FUNCTION_INDEX_BLOCK_ID))
+    return Error("Malformed block record");
+
+  // The start of the index, or zero if this block does not point to one.
+  uint64_t IndexBit = 0;
+
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    unsigned Code = Stream.ReadCode();
+    if (Code == bitc::END_BLOCK) {
+      if (Stream.ReadBlockEnd())
+        return Error("Error at end of function index block");
+      break;
+    }
+    if (Code == bitc::ENTER_SUBBLOCK) {
+      Stream.ReadSubBlockID();
+      if (Stream.SkipBlock())
+        return Error("Malformed block record");
+      continue;
+    }
+    if (Code == bitc::DEFINE_ABBREV) {
+      Stream.ReadAbbrevRecord();
+      continue;
+    }
+
+    Record.clear();
+    switch (Stream.ReadRecord(Code, Record)) {
+    default: break;  // Default behavior, ignore unknown content.
+    case bitc::FNINDEX_CODE_OFFSET:  // OFFSET: [words]
+      if (Record.size() < 1)
+        return Error("Invalid FNINDEX_CODE_OFFSET record");
+      IndexBit = Stream.GetCurrentBitNo() + Record[0] * 32;
+      break;
+    }
+  }
+
+  // The function blocks follow this block.
+  if (IndexBit)
+    return ReadFunctionIndex(IndexBit, Stream.GetCurrentBitNo());
+  return false;
+}
+
+/// ReadFunctionIndex - Read the function index that starts at IndexBit, for
+/// the function blocks that start at FirstBit, where the stream is.  If it
+/// has an entry for each of the function blocks that are still to be found,
+/// in order, remember where they are and leave the stream after the index.
+/// Otherwise leave the stream where it was, so that the function blocks are
+/// walked over as usual.
+bool BitcodeReader::ReadFunctionIndex(uint64_t IndexBit, uint64_t FirstBit) {
+  const BitstreamReader &StreamFile = *Stream.getBitStreamReader();
+  if (IndexBit % 32 != 0 ||
+      IndexBit / 8 >= uint64_t(StreamFile.getLastChar() -
+                               StreamFile.getFirstChar()))
+    return false;
+
+  // RememberAndSkipFunctionBody leaves the stream after the ENTER_SUBBLOCK
+  // code and the block ID of a function block.
+  unsigned HeaderBits = Stream.GetAbbrevIDWidth() + bitc::BlockIDWidth;
+
+  Stream.JumpToBit(IndexBit);
+  if (Stream.ReadCode() != bitc::ENTER_SUBBLOCK ||
+      Stream.ReadSubBlockID() != bitc::FUNCTION_INDEX_BLOCK_ID) {
+    Stream.JumpToBit(FirstBit);
+    return false;
+  }
+  if (Stream.EnterSubBlock(bitc::FUNCTION_INDEX_BLOCK_ID))
+    return Error("Malformed block record");
+
+  if (!HasReversedFunctionsWithBodies) {
+    std::reverse(FunctionsWithBodies.begin(), FunctionsWithBodies.end());
+    HasReversedFunctionsWithBodies = true;
+  }
+
+  // The function blocks are in the reverse order of FunctionsWithBodies.
+  std::vector<uint64_t> FunctionBits;
+  uint64_t PrevEndBit = FirstBit;
+  bool Matches = true;
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    unsigned Code = Stream.ReadCode();
+    if (Code == bitc::END_BLOCK) {
+      if (Stream.ReadBlockEnd())
+        return Error("Error at end of function index block");
+      break;
+    }
+    if (Code == bitc::ENTER_SUBBLOCK) {
+      Stream.ReadSubBlockID();
+      if (Stream.SkipBlock())
+        return Error("Malformed block record");
+      continue;
+    }
+    if (Code == bitc::DEFINE_ABBREV) {
+      Stream.ReadAbbrevRecord();
+      continue;
+    }
+
+    Record.clear();
+    switch (Stream.ReadRecord(Code, Record)) {
+    default: break;  // Default behavior, ignore unknown content.
+    case bitc::FNINDEX_CODE_ENTRY: {  // ENTRY: [valueid, gap, size, refs]
+      if (Record.size() < 3)
+        return Error("Invalid FNINDEX_CODE_ENTRY record");
+      size_t Idx = FunctionBits.size();
+      uint64_t StartBit = PrevEndBit + Record[1];
+      PrevEndBit = StartBit + Record[2];
+      if (Idx >= FunctionsWithBodies.size() ||
+          Record[0] >= ValueList.size() ||
+          ValueList[Record[0]] !=
+            FunctionsWithBodies[FunctionsWithBodies.size() - Idx - 1] ||
+          PrevEndBit > IndexBit) {
+        Matches = false;
+        break;
+      }
+      FunctionBits.push_back(StartBit + HeaderBits);
+      break;
+    }
+    }
+  }
+
+  if (!Matches || FunctionBits.size() != FunctionsWithBodies.size()) {
+    Stream.JumpToBit(FirstBit);
+    return false;
+  }
+  for (unsigned i = 0, e = FunctionBits.size(); i != e; ++i)
+    DeferredFunctionInfo[FunctionsWithBodies[e - i - 1]] = FunctionBits[i];
+  FunctionsWithBodies.clear();
+  return false;
+}
+
 bool BitcodeReader::ParseModule() {
   if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
     return Error("Malformed block record");
@@ -1365,6 +1502,16 @@ bool BitcodeReader::ParseModule() {
         if (RememberAndSkipFunctionBody())
           return true;
         break;
+      case bitc::FUNCTION_INDEX_BLOCK_ID:
+        // Once the function blocks have been found, the index is of no use.
+        if (HasReversedFunctionsWithBodies) {
+          if (Stream.SkipBlock())
+            return Error("Malformed block record");
+          break;
+        }
+        if (ParseFunctionIndex())
+          return true;
+        break;
       }
       continue;
     }
@@ -2592,16 +2739,289 @@ void BitcodeReader::Dematerialize(GlobalValue *GV) {
 }
 
 
+/// DecodeField - Read a field of an abbreviated record, as ReadRecord does.
+static uint64_t DecodeField(BitstreamCursor &Stream,
+                            const BitCodeAbbrevOp &Op) {
+  if (Op.isLiteral())
+    return Op.getLiteralValue();
+  switch (Op.getEncoding()) {
+  default:
+  case BitCodeAbbrevOp::Fixed:
+    return Stream.Read((unsigned)Op.getEncodingData());
+  case BitCodeAbbrevOp::VBR:
+    return Stream.ReadVBR64((unsigned)Op.getEncodingData());
+  case BitCodeAbbrevOp::Char6:
+    return BitCodeAbbrevOp::DecodeChar6(Stream.Read(6));
+  }
+}
+
+/// DecodeRecord - Read the record with the specified abbrev ID into Record,
+/// as ReadRecord does, and return its code.  Since the decoding runs ahead of
+/// the checks of the parser, a record that uses an abbrev that is not defined
+/// or claims more elements than there are bits left before EndBit sets
+/// Failed instead of being read.
+static unsigned DecodeRecord(BitstreamCursor &Stream, unsigned AbbrevID,
+                             unsigned NumAbbrevs, uint64_t EndBit,
+                             SmallVectorImpl<uint64_t> &Record,
+                             bool &Failed) {
+  if (AbbrevID == bitc::UNABBREV_RECORD) {
+    unsigned Code = Stream.ReadVBR(6);
+    unsigned NumElts = Stream.ReadVBR(6);
+    if (NumElts > EndBit - Stream.GetCurrentBitNo()) {
+      Failed = true;
+      return 0;
+    }
+    for (unsigned i = 0; i != NumElts; ++i)
+      Record.push_back(Stream.ReadVBR64(6));
+    return Code;
+  }
+
+  if (AbbrevID - bitc::FIRST_APPLICATION_ABBREV >= NumAbbrevs) {
+    Failed = true;
+    return 0;
+  }
+  const BitCodeAbbrev *Abbv = Stream.getAbbrev(AbbrevID);
+  for (unsigned i = 0, e = Abbv->getNumOperandInfos(); i != e; ++i) {
+    const BitCodeAbbrevOp &Op = Abbv->getOperandInfo(i);
+    if (Op.isLiteral() || Op.getEncoding() != BitCodeAbbrevOp::Array) {
+      // The writer does not put blobs into function blocks.
+      if (!Op.isLiteral() && Op.getEncoding() == BitCodeAbbrevOp::Blob) {
+        Failed = true;
+        return 0;
+      }
+      Record.push_back(DecodeField(Stream, Op));
+      continue;
+    }
+
+    unsigned NumElts = Stream.ReadVBR(6);
+    if (i+2 != e || NumElts > EndBit - Stream.GetCurrentBitNo()) {
+      Failed = true;
+      return 0;
+    }
+    const BitCodeAbbrevOp &EltEnc = Abbv->getOperandInfo(++i);
+    for (; NumElts; --NumElts)
+      Record.push_back(DecodeField(Stream, EltEnc));
+  }
+
+  if (Record.empty()) {
+    Failed = true;
+    return 0;
+  }
+  unsigned Code = (unsigned)Record[0];
+  Record.erase(Record.begin());
+  return Code;
+}
+
+/// getNumBlockInfoAbbrevs - Return the number of abbrevs that the block info
+/// defines for the specified block ID.
+static unsigned getNumBlockInfoAbbrevs(const BitstreamReader &StreamFile,
+                                       unsigned BlockID) {
+  if (const BitstreamReader::BlockInfo *Info = StreamFile.getBlockInfo(BlockID))
+    return Info->Abbrevs.size();
+  return 0;
+}
+
+/// DecodeFunctionBlock - Decode the function block whose header has just
+/// been read into the form that BitcodeReaderCursor replays.  Return true if
+/// the block is malformed, or uses anything that the writer does not put into
+/// function blocks, in which case it is left for ParseFunctionBody to read
+/// from the stream and report on.
+static bool DecodeFunctionBlock(BitstreamCursor &Stream,
+                                std::vector<uint64_t> &Words) {
+  const BitstreamReader &StreamFile = *Stream.getBitStreamReader();
+  Words.clear();
+  Words.push_back(bitc::ENTER_SUBBLOCK);
+  Words.push_back(bitc::FUNCTION_BLOCK_ID);
+  Words.push_back(0);
+  unsigned NumWords;
+  if (Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID, &NumWords))
+    return true;
+  uint64_t EndBit = Stream.GetCurrentBitNo() + uint64_t(NumWords) * 32;
+
+  // The indices of the end words of the blocks that are open, with the
+  // number of abbrevs of each.  The abbrevs all come from the block info.
+  SmallVector<std::pair<size_t, unsigned>, 4> Open;
+  Open.push_back(std::make_pair(Words.size() - 1,
+                    getNumBlockInfoAbbrevs(StreamFile,
+                                           bitc::FUNCTION_BLOCK_ID)));
+
+  SmallVector<uint64_t, 64> Record;
+  while (!Open.empty()) {
+    if (Stream.GetCurrentBitNo() >= EndBit)
+      return true;
+
+    unsigned Code = Stream.ReadCode();
+    if (Code == bitc::END_BLOCK) {
+      if (Stream.ReadBlockEnd())
+        return true;
+      Words.push_back(bitc::END_BLOCK);
+      Words[Open.back().first] = Words.size();
+      Open.pop_back();
+      continue;
+    }
+
+    if (Code == bitc::ENTER_SUBBLOCK) {
+      if (Open.size() != 1)
+        return true;
+      unsigned BlockID = Stream.ReadSubBlockID();
+      Words.push_back(bitc::ENTER_SUBBLOCK);
+      Words.push_back(BlockID);
+      Words.push_back(0);
+      switch (BlockID) {
+      default:  // ParseFunctionBody skips unknown content.
+        if (Stream.SkipBlock())
+          return true;
+        Words.back() = Words.size();
+        break;
+      case bitc::CONSTANTS_BLOCK_ID:
+      case bitc::VALUE_SYMTAB_BLOCK_ID:
+      case bitc::METADATA_ATTACHMENT_ID:
+      case bitc::METADATA_BLOCK_ID:
+        if (Stream.EnterSubBlock(BlockID))
+          return true;
+        Open.push_back(std::make_pair(Words.size() - 1,
+                          getNumBlockInfoAbbrevs(StreamFile, BlockID)));
+        break;
+      }
+      continue;
+    }
+
+    if (Code == bitc::DEFINE_ABBREV)
+      return true;
+
+    Record.clear();
+    bool Failed = false;
+    unsigned RecordCode = DecodeRecord(Stream, Code, Open.back().second,
+                                       EndBit, Record, Failed);
+    if (Failed)
+      return true;
+    Words.push_back(bitc::UNABBREV_RECORD);
+    Words.push_back(RecordCode);
+    Words.push_back(Record.size());
+    Words.insert(Words.end(), Record.begin(), Record.end());
+  }
+  return false;
+}
+
+namespace {
+  /// DecodeJob - A function block decoded on a worker thread, to be replayed
+  /// on the thread that builds the IR.  Failed is set if the block has to be
+  /// read from the stream instead.  Each job has a reader of its own, so
+  /// that the reference counts of the block info abbrevs are never touched
+  /// by two threads at once.
+  struct DecodeJob {
+    BitstreamReader StreamFile;
+    Function *F;
+    uint64_t BitNo;
+    std::vector<uint64_t> Words;
+    bool Failed;
+  };
+}
+
+/// CopyBlockInfo - Give To its own copy of the abbrevs that the block info of
+/// From defines for the blocks that may appear in a function block.
+static void CopyBlockInfo(const BitstreamReader &From, BitstreamReader &To) {
+  static const unsigned BlockIDs[] = {
+    bitc::FUNCTION_BLOCK_ID, bitc::CONSTANTS_BLOCK_ID,
+    bitc::VALUE_SYMTAB_BLOCK_ID, bitc::METADATA_ATTACHMENT_ID,
+    bitc::METADATA_BLOCK_ID
+  };
+  for (unsigned i = 0; i != array_lengthof(BlockIDs); ++i) {
+    const BitstreamReader::BlockInfo *Info = From.getBlockInfo(BlockIDs[i]);
+    if (!Info)
+      continue;
+    BitstreamReader::BlockInfo &Copy = To.getOrCreateBlockInfo(BlockIDs[i]);
+    for (unsigned j = 0, e = Info->Abbrevs.size(); j != e; ++j) {
+      BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+      const BitCodeAbbrev *Orig = Info->Abbrevs[j];
+      for (unsigned k = 0, ke = Orig->getNumOperandInfos(); k != ke; ++k)
+        Abbv->Add(Orig->getOperandInfo(k));
+      Copy.Abbrevs.push_back(Abbv);
+    }
+  }
+}
+
+static void DecodeFunction(void *Arg) {
+  DecodeJob &Job = *static_cast<DecodeJob*>(Arg);
+  BitstreamCursor Stream(Job.StreamFile);
+  Stream.JumpToBit(Job.BitNo);
+  Job.Failed = DecodeFunctionBlock(Stream, Job.Words);
+}
+
+/// QueueDecodeJobs - Queue the decoding of up to NumJobs of the functions
+/// that are still on disk, starting at I, and return how many were queued.
+static unsigned
+QueueDecodeJobs(ThreadPool &Pool, DecodeJob *Jobs, unsigned NumJobs,
+                Module::iterator &I, Module::iterator E,
+                const DenseMap<Function*, uint64_t> &DeferredFunctionInfo) {
+  unsigned N = 0;
+  for (; I != E && N != NumJobs; ++I)
+    if (I->isMaterializable()) {
+      Jobs[N].F = I;
+      Jobs[N].BitNo = DeferredFunctionInfo.find(I)->second;
+      Pool.async(DecodeFunction, &Jobs[N++]);
+    }
+  return N;
+}
+
+/// MaterializeInParallel - Read every function body that is still on disk.
+/// The uniquing tables of the context are not safe for concurrent use, so
+/// only the decoding of the bitstream is done on the worker threads: the
+/// records of a window of functions are decoded while the IR for the
+/// previous window is built from its records on the calling thread.  The
+/// functions are built in module order, as MaterializeModule does.
+bool BitcodeReader::MaterializeInParallel(std::string *ErrInfo) {
+  ThreadPool Pool(MaterializeThreads);
+  unsigned Window = Pool.getNumThreads() * 8;
+  // Each job keeps its reader and buffer from one window to the next.
+  OwningArrayPtr<DecodeJob> Jobs(new DecodeJob[Window * 2]);
+  for (unsigned i = 0; i != Window * 2; ++i) {
+    Jobs[i].StreamFile.init(StreamFile.getFirstChar(),
+                            StreamFile.getLastChar());
+    CopyBlockInfo(StreamFile, Jobs[i].StreamFile);
+  }
+  DecodeJob *Ready = &Jobs[0], *Next = &Jobs[Window];
+
+  Module::iterator I = TheModule->begin(), E = TheModule->end();
+  unsigned NumReady = QueueDecodeJobs(Pool, Ready, Window, I, E,
+                                      DeferredFunctionInfo);
+  Pool.wait();
+  while (NumReady) {
+    unsigned NumNext = QueueDecodeJobs(Pool, Next, Window, I, E,
+                                       DeferredFunctionInfo);
+    for (unsigned i = 0; i != NumReady; ++i) {
+      if (!Ready[i].Failed)
+        Stream.replay(Ready[i].Words);
+      bool Failed = Materialize(Ready[i].F, ErrInfo);
+      Stream.stopReplay();
+      if (Failed) {
+        // The workers still use the jobs.
+        Pool.wait();
+        return true;
+      }
+    }
+    Pool.wait();
+    std::swap(Ready, Next);
+    NumReady = NumNext;
+  }
+  return false;
+}
+
 bool BitcodeReader::MaterializeModule(Module *M, std::string *ErrInfo) {
   assert(M == TheModule &&
          "Can only Materialize the Module this BitcodeReader is attached to.");
   // Iterate over the module, deserializing any functions that are still on
   // disk.
-  for (Module::iterator F = TheModule->begin(), E = TheModule->end();
-       F != E; ++F)
-    if (F->isMaterializable() &&
-        Materialize(F, ErrInfo))
+  if (MaterializeThreads != 1) {
+    if (MaterializeInParallel(ErrInfo))
       return true;
+  } else {
+    for (Module::iterator F = TheModule->begin(), E = TheModule->end();
+         F != E; ++F)
+      if (F->isMaterializable() &&
+          Materialize(F, ErrInfo))
+        return true;
+  }
 
   // Upgrade any intrinsic calls that slipped through (should not happen!) and
   // delete the old functions to clean up. We can't do this unless the entire
@@ -2657,12 +3077,19 @@ Module *llvm::getLazyBitcodeModule(MemoryBuffer *Buffer,
 /// If an error occurs, return null and fill in *ErrMsg if non-null.
 Module *llvm::ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
                                std::string *ErrMsg){
+  return ParseBitcodeFile(Buffer, Context, ErrMsg, 1);
+}
+
+Module *llvm::ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
+                               std::string *ErrMsg, unsigned Threads) {
   Module *M = getLazyBitcodeModule(Buffer, Context, ErrMsg);
   if (!M) return 0;
 
   // Don't let the BitcodeReader dtor delete 'Buffer', regardless of whether
   // there was an error.
-  static_cast<BitcodeReader*>(M->getMaterializer())->setBufferOwned(false);
+  BitcodeReader *R = static_cast<BitcodeReader*>(M->getMaterializer());
+  R->setBufferOwned(false);
+  R->setMaterializeThreads(Threads);
 
   // Read in the entire module, and destroy the BitcodeReader.
   if (M->MaterializeAllPermanently(ErrMsg)) {
@@ -121,13 +121,74 @@ public:
   void AssignValue(Value *V, unsigned Idx);
 };
 
+//===----------------------------------------------------------------------===//
+//                          BitcodeReaderCursor Class
+//===----------------------------------------------------------------------===//
+
+/// BitcodeReaderCursor - A cursor over the bitstream that can also replay a
+/// function block that was decoded ahead of time, possibly on another thread.
+/// A decoded block is a flat list of words in which a record is
+/// [UNABBREV_RECORD, code, numops, op0, op1...], the start of a block is
+/// [ENTER_SUBBLOCK, blockid, index just past the end of the block] and the
+/// end of a block is [END_BLOCK].  Abbreviations have already been applied
+/// and their definitions are left out.  Blocks that the reader skips are
+/// recorded without contents.
+class BitcodeReaderCursor : public BitstreamCursor {
+  const std::vector<uint64_t> *Decoded;
+  size_t Pos;
+public:
+  BitcodeReaderCursor() : Decoded(0), Pos(0) {}
+
+  /// replay - Read from the specified decoded function block until
+  /// stopReplay() is called.  The ENTER_SUBBLOCK code and block ID of the
+  /// function block count as already read, as they do when the cursor is
+  /// positioned at the bit number of a deferred function body.
+  void replay(const std::vector<uint64_t> &Words) {
+    Decoded = &Words;
+    Pos = 2;
+  }
+  void stopReplay() { Decoded = 0; }
+
+  unsigned ReadCode() {
+    if (!Decoded) return BitstreamCursor::ReadCode();
+    return unsigned((*Decoded)[Pos++]);
+  }
+  unsigned ReadSubBlockID() {
+    if (!Decoded) return BitstreamCursor::ReadSubBlockID();
+    return unsigned((*Decoded)[Pos++]);
+  }
+  bool SkipBlock() {
+    if (!Decoded) return BitstreamCursor::SkipBlock();
+    Pos = size_t((*Decoded)[Pos]);
+    return false;
+  }
+  bool EnterSubBlock(unsigned BlockID, unsigned *NumWordsP = 0) {
+    if (!Decoded) return BitstreamCursor::EnterSubBlock(BlockID, NumWordsP);
+    ++Pos;
+    return false;
+  }
+  bool ReadBlockEnd() {
+    if (!Decoded) return BitstreamCursor::ReadBlockEnd();
+    return false;
+  }
+  unsigned ReadRecord(unsigned AbbrevID, SmallVectorImpl<uint64_t> &Vals) {
+    if (!Decoded) return BitstreamCursor::ReadRecord(AbbrevID, Vals);
+    assert(AbbrevID == bitc::UNABBREV_RECORD && "Not a decoded record!");
+    unsigned Code = unsigned((*Decoded)[Pos++]);
+    size_t NumElts = size_t((*Decoded)[Pos++]);
+    Vals.append(Decoded->begin() + Pos, Decoded->begin() + Pos + NumElts);
+    Pos += NumElts;
+    return Code;
+  }
+};
+
 class BitcodeReader : public GVMaterializer {
   LLVMContext &Context;
   Module *TheModule;
   MemoryBuffer *Buffer;
   bool BufferOwned;
   BitstreamReader StreamFile;
-  BitstreamCursor Stream;
+  BitcodeReaderCursor Stream;
   
   const char *ErrorString;
   
@@ -179,12 +240,16 @@ class BitcodeReader : public GVMaterializer {
   /// for compatibility.
   /// FIXME: Remove in LLVM 3.0.
   bool LLVM2_7MetadataDetected;
+
+  /// MaterializeThreads - The number of threads MaterializeModule decodes
+  /// function blocks on, or zero for one per processor.
+  unsigned MaterializeThreads;
   
 public:
   explicit BitcodeReader(MemoryBuffer *buffer, LLVMContext &C)
     : Context(C), TheModule(0), Buffer(buffer), BufferOwned(false),
       ErrorString(0), ValueList(C), MDValueList(C),
-      LLVM2_7MetadataDetected(false) {
+      LLVM2_7MetadataDetected(false), MaterializeThreads(1) {
     HasReversedFunctionsWithBodies = false;
   }
   ~BitcodeReader() {
@@ -196,6 +261,13 @@ public:
   /// setBufferOwned - If this is true, the reader will destroy the MemoryBuffer
   /// when the reader is destroyed.
   void setBufferOwned(bool Owned) { BufferOwned = Owned; }
+
+  /// setMaterializeThreads - Have MaterializeModule decode the remaining
+  /// function blocks on the specified number of threads, or on one per
+  /// processor if it is zero, while it builds the IR for them on the calling
+  /// thread.  This only takes effect once llvm_start_multithreaded() has been
+  /// called.
+  void setMaterializeThreads(unsigned Threads) { MaterializeThreads = Threads; }
   
   virtual bool isMaterializable(const GlobalValue *GV) const;
   virtual bool isDematerializable(const GlobalValue *GV) const;
@@ -270,7 +342,10 @@ private:
   bool ParseValueSymbolTable();
   bool ParseConstants();
   bool RememberAndSkipFunctionBody();
+  bool ParseFunctionIndex();
+  bool ReadFunctionIndex(uint64_t IndexBit, uint64_t FirstBit);
   bool ParseFunctionBody(Function *F);
+  bool MaterializeInParallel(std::string *ErrInfo);
   bool ResolveGlobalAndAliasInits();
   bool ParseMetadata();
   bool ParseMetadataAttachment();
@@ -23,13 +23,21 @@
 #include "llvm/Operator.h"
 #include "llvm/TypeSymbolTable.h"
 #include "llvm/ValueSymbolTable.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
 #include <cctype>
 using namespace llvm;
 
+static cl::opt<bool>
+EnableFunctionIndex("bitcode-function-index",
+  cl::desc("Write an index of the function bodies into bitcode files"));
+
 /// These are manifest constants used by the bitcode writer. They do not need to
 /// be kept in sync with the reader, but need to be consistent within this file.
 enum {
@@ -54,7 +62,10 @@ enum {
   FUNCTION_INST_CAST_ABBREV,
   FUNCTION_INST_RET_VOID_ABBREV,
   FUNCTION_INST_RET_VAL_ABBREV,
-  FUNCTION_INST_UNREACHABLE_ABBREV
+  FUNCTION_INST_UNREACHABLE_ABBREV,
+
+  // FUNCTION_INDEX_BLOCK abbrev id's.
+  FNINDEX_OFFSET_ABBREV = bitc::FIRST_APPLICATION_ABBREV
 };
 
 
@@ -683,10 +694,9 @@ static void WriteConstants(unsigned FirstVal, unsigned LastVal,
 
   SmallVector<uint64_t, 64> Record;
 
-  const ValueEnumerator::ValueList &Vals = VE.getValues();
   const Type *LastTy = 0;
   for (unsigned i = FirstVal; i != LastVal; ++i) {
-    const Value *V = Vals[i].first;
+    const Value *V = VE.getValue(i);
     // If we need to switch types, do so now.
     if (V->getType() != LastTy) {
       LastTy = V->getType();
@@ -1321,8 +1331,8 @@ static void WriteTypeSymbolTable(const TypeSymbolTable &TST,
 // Emit blockinfo, which defines the standard abbreviations etc.
 static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   // We only want to emit block info records for blocks that have multiple
-  // instances: CONSTANTS_BLOCK, FUNCTION_BLOCK and VALUE_SYMTAB_BLOCK.  Other
-  // blocks can defined their abbrevs inline.
+  // instances: CONSTANTS_BLOCK, FUNCTION_BLOCK, VALUE_SYMTAB_BLOCK and
+  // FUNCTION_INDEX_BLOCK.  Other blocks can defined their abbrevs inline.
   Stream.EnterBlockInfoBlock(2);
 
   { // 8-bit fixed-width VST_ENTRY/VST_BBENTRY strings.
@@ -1476,12 +1486,192 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
       llvm_unreachable("Unexpected abbrev ordering!");
   }
 
+  if (EnableFunctionIndex) { // OFFSET abbrev for FUNCTION_INDEX_BLOCK.
+    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(bitc::FNINDEX_CODE_OFFSET));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+    if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_INDEX_BLOCK_ID,
+                                   Abbv) != FNINDEX_OFFSET_ABBREV)
+      llvm_unreachable("Unexpected abbrev ordering!");
+  }
+
+  Stream.ExitBlock();
+}
+
+
+namespace {
+  /// FunctionIndexEntry - Where the block of a function body was written.
+  struct FunctionIndexEntry {
+    const Function *F;
+    uint64_t StartBit, EndBit;
+  };
+}
+
+/// WriteFunctionIndexOffset - Emit the function index block that goes before
+/// the function blocks.  Return the bit just after its OFFSET field, which
+/// WriteFunctionIndex fills in.
+static uint64_t WriteFunctionIndexOffset(BitstreamWriter &Stream) {
+  // With 32-bit abbrev IDs the field that follows one is word aligned, so it
+  // can be backpatched.
+  Stream.EnterSubblock(bitc::FUNCTION_INDEX_BLOCK_ID, 32);
+  SmallVector<unsigned, 1> Vals;
+  Vals.push_back(0);
+  Stream.EmitRecord(bitc::FNINDEX_CODE_OFFSET, Vals, FNINDEX_OFFSET_ABBREV);
+  uint64_t OffsetEndBit = Stream.GetCurrentBitNo();
+  Stream.ExitBlock();
+  return OffsetEndBit;
+}
+
+/// GetReferencedGlobals - Add the value IDs of the global values that the
+/// body of F uses, directly or through constants, to Refs, sorted.
+static void GetReferencedGlobals(const Function &F, const ValueEnumerator &VE,
+                                 SmallVectorImpl<uint64_t> &Refs) {
+  unsigned NumRefs = Refs.size();
+  SmallPtrSet<const Constant*, 32> Visited;
+  SmallVector<const Constant*, 32> Worklist;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE;
+         ++I)
+      for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+        if (const Constant *C = dyn_cast<Constant>(I->getOperand(i)))
+          if (Visited.insert(C))
+            Worklist.push_back(C);
+
+  while (!Worklist.empty()) {
+    const Constant *C = Worklist.pop_back_val();
+    if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+      Refs.push_back(VE.getValueID(GV));
+      continue;
+    }
+    // The operands of a constant are constants, except for the block of a
+    // blockaddress.
+    for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+      if (const Constant *Op = dyn_cast<Constant>(C->getOperand(i)))
+        if (Visited.insert(Op))
+          Worklist.push_back(Op);
+  }
+  std::sort(Refs.begin() + NumRefs, Refs.end());
+}
+
+/// WriteFunctionIndex - Emit the function index block that follows the
+/// function blocks, with an entry for each of them, and point the OFFSET
+/// field that ends at OffsetEndBit at it.  FirstBit is the end of the block
+/// that holds the field.
+static void WriteFunctionIndex(const std::vector<FunctionIndexEntry> &Index,
+                               uint64_t OffsetEndBit, uint64_t FirstBit,
+                               const ValueEnumerator &VE,
+                               BitstreamWriter &Stream) {
+  // The function blocks end on a word boundary, so the index starts on one.
+  uint64_t IndexBit = Stream.GetCurrentBitNo();
+  Stream.BackpatchWord(OffsetEndBit / 8 - 4,
+                       unsigned((IndexBit - OffsetEndBit) / 32));
+
+  Stream.EnterSubblock(bitc::FUNCTION_INDEX_BLOCK_ID, 3);
+  // The blocks are written one after another, so the gaps are small, where
+  // bit offsets would take several VBR chunks.
+  SmallVector<uint64_t, 64> Vals;
+  uint64_t PrevEndBit = FirstBit;
+  for (unsigned i = 0, e = Index.size(); i != e; ++i) {
+    Vals.push_back(VE.getValueID(Index[i].F));
+    Vals.push_back(Index[i].StartBit - PrevEndBit);
+    Vals.push_back(Index[i].EndBit - Index[i].StartBit);
+    PrevEndBit = Index[i].EndBit;
+    GetReferencedGlobals(*Index[i].F, VE, Vals);
+    Stream.EmitRecord(bitc::FNINDEX_CODE_ENTRY, Vals);
+    Vals.clear();
+  }
   Stream.ExitBlock();
 }
 
+namespace {
+  /// FunctionJob - A function body encoded on a thread of its own, into a
+  /// buffer that is spliced into the module stream afterwards.
+  struct FunctionJob {
+    const Function *F;
+    const ValueEnumerator *ModuleVE;
+    std::vector<unsigned char> Buffer;
+    /// Begin, End - The range of Buffer that holds the contents of the
+    /// function block, after its header.
+    size_t Begin, End;
+  };
+}
+
+/// EncodeFunction - Encode the body of the function of a FunctionJob into its
+/// buffer.
+static void EncodeFunction(void *Arg) {
+  FunctionJob &Job = *static_cast<FunctionJob*>(Arg);
+  Job.Buffer.clear();
+  BitstreamWriter Stream(Job.Buffer);
+
+  // Start the stream as the module stream starts, so that the function block
+  // gets the same abbrevs.
+  Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
+  WriteBlockInfo(*Job.ModuleVE, Stream);
+
+  // The block info block ends on a word boundary, so the function block
+  // header is one word and the block size another.
+  Job.Begin = Job.Buffer.size() + 8;
+  ValueEnumerator VE(Job.ModuleVE);
+  WriteFunction(*Job.F, VE, Stream);
+  Job.End = Job.Buffer.size();
+  Stream.ExitBlock();
+}
+
+/// WriteFunctionBodies - Emit the bodies of the functions of the module.  If
+/// Threads is not one, they are encoded in parallel into buffers of their
+/// own, a window of functions at a time, and spliced into the stream in
+/// order.  The window bounds how much encoded code is held in memory.  Where
+/// each block was written is added to Index.
+static void WriteFunctionBodies(const Module *M, ValueEnumerator &VE,
+                                BitstreamWriter &Stream, unsigned Threads,
+                                std::vector<FunctionIndexEntry> &Index) {
+  FunctionIndexEntry Entry;
+  if (Threads == 1) {
+    for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
+      if (!I->isDeclaration()) {
+        Entry.F = I;
+        Entry.StartBit = Stream.GetCurrentBitNo();
+        WriteFunction(*I, VE, Stream);
+        Entry.EndBit = Stream.GetCurrentBitNo();
+        Index.push_back(Entry);
+        Stream.FlushToFile();
+      }
+    return;
+  }
+
+  ThreadPool Pool(Threads);
+  // Each job keeps its buffer from one window to the next, so it is
+  // allocated once and stays warm in the cache.
+  std::vector<FunctionJob> Jobs(Pool.getNumThreads() * 8);
+  for (unsigned i = 0, e = Jobs.size(); i != e; ++i)
+    Jobs[i].ModuleVE = &VE;
+
+  Module::const_iterator I = M->begin(), E = M->end();
+  while (I != E) {
+    unsigned NumJobs = 0;
+    for (; I != E && NumJobs != Jobs.size(); ++I)
+      if (!I->isDeclaration()) {
+        Jobs[NumJobs].F = I;
+        Pool.async(EncodeFunction, &Jobs[NumJobs++]);
+      }
+    Pool.wait();
+
+    for (unsigned i = 0; i != NumJobs; ++i) {
+      const unsigned char *Buffer = &Jobs[i].Buffer[0];
+      Entry.F = Jobs[i].F;
+      Entry.StartBit = Stream.GetCurrentBitNo();
+      Stream.EmitEncodedBlock(bitc::FUNCTION_BLOCK_ID, 4,
+                              Buffer + Jobs[i].Begin, Buffer + Jobs[i].End);
+      Entry.EndBit = Stream.GetCurrentBitNo();
+      Index.push_back(Entry);
+      Stream.FlushToFile();
+    }
+  }
+}
 
 /// WriteModule - Emit the specified module to the bitstream.
-static void WriteModule(const Module *M, BitstreamWriter &Stream) {
+static void WriteModule(const Module *M, BitstreamWriter &Stream,
+                        unsigned Threads) {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
   // Emit the version number if it is non-zero.
@@ -1513,10 +1703,25 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   // Emit metadata.
   WriteModuleMetadata(M, VE, Stream);
 
-  // Emit function bodies.
+  // Emit function bodies, between the two blocks of their index if one was
+  // asked for.  The index makes the file a few percent larger and only pays
+  // off for readers that load a small part of the bodies.
+  bool HasBodies = false;
   for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
-    if (!I->isDeclaration())
-      WriteFunction(*I, VE, Stream);
+    if (!I->isDeclaration()) {
+      HasBodies = true;
+      break;
+    }
+  if (HasBodies) {
+    std::vector<FunctionIndexEntry> Index;
+    uint64_t OffsetEndBit = 0;
+    if (EnableFunctionIndex)
+      OffsetEndBit = WriteFunctionIndexOffset(Stream);
+    uint64_t FirstBit = Stream.GetCurrentBitNo();
+    WriteFunctionBodies(M, VE, Stream, Threads, Index);
+    if (EnableFunctionIndex)
+      WriteFunctionIndex(Index, OffsetEndBit, FirstBit, VE, Stream);
+  }
 
   // Emit metadata.
   WriteModuleMetadataStore(M, Stream);
@@ -1631,23 +1836,10 @@ static void EmitDarwinBCTrailer(BitstreamWriter &Stream, unsigned BufferSize) {
 }
 
 
-/// WriteBitcodeToFile - Write the specified module to the specified output
-/// stream.
-void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out) {
-  std::vector<unsigned char> Buffer;
-  BitstreamWriter Stream(Buffer);
-
-  Buffer.reserve(256*1024);
-
-  WriteBitcodeToStream( M, Stream );
-
-  // Write the generated bitstream to "Out".
-  Out.write((char*)&Buffer.front(), Buffer.size());
-}
-
-/// WriteBitcodeToStream - Write the specified module to the specified output
-/// stream.
-void llvm::WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream) {
+/// WriteBitcode - Write the specified module to the specified bitstream,
+/// encoding function bodies on the specified number of threads.
+static void WriteBitcode(const Module *M, BitstreamWriter &Stream,
+                         unsigned Threads) {
   // If this is darwin or another generic macho target, emit a file header and
   // trailer if needed.
   bool isMacho =
@@ -1665,8 +1857,47 @@ void llvm::WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream) {
   Stream.Emit(0xD, 4);
 
   // Emit the module.
-  WriteModule(M, Stream);
+  WriteModule(M, Stream, Threads);
 
   if (isMacho)
-    EmitDarwinBCTrailer(Stream, Stream.getBuffer().size());
+    EmitDarwinBCTrailer(Stream, Stream.GetBufferOffset());
+}
+
+/// WriteBitcodeToFile - Write the specified module to the specified output
+/// stream.
+void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out) {
+  std::vector<unsigned char> Buffer;
+  BitstreamWriter Stream(Buffer);
+
+  Buffer.reserve(256*1024);
+
+  WriteBitcodeToStream( M, Stream );
+
+  // Write the generated bitstream to "Out".
+  Out.write((char*)&Buffer.front(), Buffer.size());
+}
+
+/// WriteBitcodeToFile - Write the specified module to the specified file,
+/// encoding function bodies on the specified number of threads.  If the file
+/// can seek, the bitstream is written out as it is produced.
+void llvm::WriteBitcodeToFile(const Module *M, raw_fd_ostream &Out,
+                              unsigned Threads) {
+  std::vector<unsigned char> Buffer;
+  if (!Out.supportsSeeking()) {
+    BitstreamWriter Stream(Buffer);
+    Buffer.reserve(256*1024);
+    WriteBitcode(M, Stream, Threads);
+    Out.write((char*)&Buffer.front(), Buffer.size());
+    return;
+  }
+
+  BitstreamWriter Stream(Buffer, Out);
+  WriteBitcode(M, Stream, Threads);
+  Stream.FlushToFile(0);
+}
+
+/// WriteBitcodeToStream - Write the specified module to the specified output
+/// stream.
+void llvm::WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream) {
+  WriteBitcode(M, Stream, 1);
 }
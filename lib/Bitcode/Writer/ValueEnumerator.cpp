@@ -38,7 +38,8 @@ static bool CompareByFrequency(const std::pair<const llvm::Type*,
 }
 
 /// ValueEnumerator - Enumerate module-level information.
-ValueEnumerator::ValueEnumerator(const Module *M) {
+ValueEnumerator::ValueEnumerator(const Module *M)
+  : ModuleVE(0), FirstValueID(0), FirstMDValueID(0) {
   // Enumerate the global variables.
   for (Module::const_global_iterator I = M->global_begin(),
          E = M->global_end(); I != E; ++I)
@@ -134,6 +135,16 @@ ValueEnumerator::ValueEnumerator(const Module *M) {
     TypeMap[Types[i].first] = i+1;
 }
 
+/// ValueEnumerator - Make an enumerator for the function bodies of the module
+/// enumerated by MVE.
+ValueEnumerator::ValueEnumerator(const ValueEnumerator *MVE)
+  : ModuleVE(MVE), InstructionCount(0), NumModuleValues(0),
+    NumModuleMDValues(0), FirstValueID(MVE->Values.size()),
+    FirstMDValueID(MVE->MDValues.size()), FirstFuncConstantID(0),
+    FirstInstID(0) {
+  assert(!MVE->ModuleVE && "Not a module enumerator!");
+}
+
 unsigned ValueEnumerator::getInstructionID(const Instruction *Inst) const {
   InstructionMapType::const_iterator I = InstructionMap.find(Inst);
   assert (I != InstructionMap.end() && "Instruction is not mapped!");
@@ -147,11 +158,15 @@ void ValueEnumerator::setInstructionID(const Instruction *I) {
 unsigned ValueEnumerator::getValueID(const Value *V) const {
   if (isa<MDNode>(V) || isa<MDString>(V)) {
     ValueMapType::const_iterator I = MDValueMap.find(V);
+    if (I == MDValueMap.end() && ModuleVE)
+      return ModuleVE->getValueID(V);
     assert(I != MDValueMap.end() && "Value not in slotcalculator!");
     return I->second-1;
   }
 
   ValueMapType::const_iterator I = ValueMap.find(V);
+  if (I == ValueMap.end() && ModuleVE)
+    return ModuleVE->getValueID(V);
   assert(I != ValueMap.end() && "Value not in slotcalculator!");
   return I->second-1;
 }
@@ -177,17 +192,18 @@ namespace {
 void ValueEnumerator::OptimizeConstants(unsigned CstStart, unsigned CstEnd) {
   if (CstStart == CstEnd || CstStart+1 == CstEnd) return;
 
+  ValueList::iterator Begin = Values.begin() + (CstStart - FirstValueID);
+  ValueList::iterator End = Values.begin() + (CstEnd - FirstValueID);
   CstSortPredicate P(*this);
-  std::stable_sort(Values.begin()+CstStart, Values.begin()+CstEnd, P);
+  std::stable_sort(Begin, End, P);
 
   // Ensure that integer constants are at the start of the constant pool.  This
   // is important so that GEP structure indices come before gep constant exprs.
-  std::partition(Values.begin()+CstStart, Values.begin()+CstEnd,
-                 isIntegerValue);
+  std::partition(Begin, End, isIntegerValue);
 
   // Rebuild the modified portion of ValueMap.
-  for (; CstStart != CstEnd; ++CstStart)
-    ValueMap[Values[CstStart].first] = CstStart+1;
+  for (; Begin != End; ++Begin)
+    ValueMap[Begin->first] = ++CstStart;
 }
 
 
@@ -277,11 +293,11 @@ void ValueEnumerator::EnumerateFunctionLocalMetadata(const MDNode *N) {
   unsigned &MDValueID = MDValueMap[N];
   if (MDValueID) {
     // Increment use count.
-    MDValues[MDValueID-1].second++;
+    MDValues[MDValueID-1-FirstMDValueID].second++;
     return;
   }
   MDValues.push_back(std::make_pair(N, 1U));
-  MDValueID = MDValues.size();
+  MDValueID = FirstMDValueID + MDValues.size();
 
   // To incoroporate function-local information visit all function-local
   // MDNodes and all function-local values they reference.
@@ -303,11 +319,15 @@ void ValueEnumerator::EnumerateValue(const Value *V) {
   assert(!isa<MDNode>(V) && !isa<MDString>(V) &&
          "EnumerateValue doesn't handle Metadata!");
 
+  // Module-level values keep the IDs given by the module enumerator.
+  if (ModuleVE && ModuleVE->ValueMap.count(V))
+    return;
+
   // Check to see if it's already in!
   unsigned &ValueID = ValueMap[V];
   if (ValueID) {
     // Increment use count.
-    Values[ValueID-1].second++;
+    Values[ValueID-1-FirstValueID].second++;
     return;
   }
 
@@ -338,18 +358,22 @@ void ValueEnumerator::EnumerateValue(const Value *V) {
       // Finally, add the value.  Doing this could make the ValueID reference be
       // dangling, don't reuse it.
       Values.push_back(std::make_pair(V, 1U));
-      ValueMap[V] = Values.size();
+      ValueMap[V] = FirstValueID + Values.size();
       return;
     }
   }
 
   // Add the value.
   Values.push_back(std::make_pair(V, 1U));
-  ValueID = Values.size();
+  ValueID = FirstValueID + Values.size();
 }
 
 
 void ValueEnumerator::EnumerateType(const Type *Ty) {
+  // The module enumerator has numbered all the types of function bodies.
+  if (ModuleVE)
+    return;
+
   unsigned &TypeID = TypeMap[Ty];
 
   if (TypeID) {
@@ -400,7 +424,7 @@ void ValueEnumerator::EnumerateOperandType(const Value *V) {
 }
 
 void ValueEnumerator::EnumerateAttributes(const AttrListPtr &PAL) {
-  if (PAL.isEmpty()) return;  // null is always 0.
+  if (PAL.isEmpty() || ModuleVE) return;  // null is always 0.
   // Do a lookup.
   unsigned &Entry = AttributeMap[PAL.getRawPointer()];
   if (Entry == 0) {
@@ -421,7 +445,7 @@ void ValueEnumerator::incorporateFunction(const Function &F) {
        I != E; ++I)
     EnumerateValue(I);
 
-  FirstFuncConstantID = Values.size();
+  FirstFuncConstantID = FirstValueID + Values.size();
 
   // Add all function-level constants to the value table.
   for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
@@ -437,13 +461,13 @@ void ValueEnumerator::incorporateFunction(const Function &F) {
   }
 
   // Optimize the constant layout.
-  OptimizeConstants(FirstFuncConstantID, Values.size());
+  OptimizeConstants(FirstFuncConstantID, FirstValueID + Values.size());
 
   // Add the function's parameter attributes so they are available for use in
   // the function's instruction.
   EnumerateAttributes(F.getAttributes());
 
-  FirstInstID = Values.size();
+  FirstInstID = FirstValueID + Values.size();
 
   SmallVector<MDNode *, 8> FnLocalMDVector;
   // Add all of the instructions.
@@ -42,6 +42,12 @@ public:
   // For each value, we remember its Value* and occurrence frequency.
   typedef std::vector<std::pair<const Value*, unsigned> > ValueList;
 private:
+  /// ModuleVE - For an enumerator made to incorporate functions on a thread of
+  /// its own, the enumerator of their module, which numbers the types,
+  /// attributes and module-level values.  This enumerator then only holds the
+  /// values of the incorporated function, numbered after those of ModuleVE.
+  const ValueEnumerator *ModuleVE;
+
   typedef DenseMap<const Type*, unsigned> TypeMapType;
   TypeMapType TypeMap;
   TypeList Types;
@@ -77,6 +83,12 @@ private:
   /// before incorporation.
   unsigned NumModuleMDValues;
 
+  /// FirstValueID, FirstMDValueID - The IDs of the first entries of Values and
+  /// MDValues, which are the numbers of module-level values and metadata of
+  /// ModuleVE, or zero.
+  unsigned FirstValueID;
+  unsigned FirstMDValueID;
+
   unsigned FirstFuncConstantID;
   unsigned FirstInstID;
   
@@ -85,9 +97,23 @@ private:
 public:
   ValueEnumerator(const Module *M);
 
+  /// ValueEnumerator - Make an enumerator that incorporates functions of the
+  /// module enumerated by MVE, without changing MVE, so that several of them
+  /// can incorporate functions on different threads.
+  explicit ValueEnumerator(const ValueEnumerator *MVE);
+
   unsigned getValueID(const Value *V) const;
 
+  /// getValue - Return the value with the specified ID.
+  const Value *getValue(unsigned ID) const {
+    if (ID < FirstValueID)
+      return ModuleVE->getValue(ID);
+    return Values[ID - FirstValueID].first;
+  }
+
   unsigned getTypeID(const Type *T) const {
+    if (ModuleVE)
+      return ModuleVE->getTypeID(T);
     TypeMapType::const_iterator I = TypeMap.find(T);
     assert(I != TypeMap.end() && "Type not in ValueEnumerator!");
     return I->second-1;
@@ -98,6 +124,8 @@ public:
 
   unsigned getAttributeID(const AttrListPtr &PAL) const {
     if (PAL.isEmpty()) return 0;  // Null maps to zero.
+    if (ModuleVE)
+      return ModuleVE->getAttributeID(PAL);
     AttributeMapType::const_iterator I = AttributeMap.find(PAL.getRawPointer());
     assert(I != AttributeMap.end() && "Attribute not in ValueEnumerator!");
     return I->second;
@@ -115,7 +143,9 @@ public:
   const SmallVector<const MDNode *, 8> &getFunctionLocalMDValues() const { 
     return FunctionLocalMDs;
   }
-  const TypeList &getTypes() const { return Types; }
+  const TypeList &getTypes() const {
+    return ModuleVE ? ModuleVE->getTypes() : Types;
+  }
   const std::vector<const BasicBlock*> &getBasicBlocks() const {
     return BasicBlocks; 
   }
@@ -0,0 +1,466 @@
+//===-- ParallelCG.cpp - Parallel code generation -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements SplitModuleForCodeGen and CodeGenModulePartitions.
+//
+// Code generation in this version of LLVM shares per-context state (types,
+// constants, the MachineModuleInfo, the MCContext) between all functions of a
+// module, so functions of a single module cannot be lowered concurrently.
+// Instead, the module is cut into partitions which are serialized to bitcode
+// and each loaded into a private LLVMContext on a worker thread.  Only the
+// splitting and the final write out of the partition buffers happen on the
+// calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetRegistry.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+typedef DenseMap<const GlobalValue*, unsigned> PartitionMap;
+
+/// getPartition - Return the partition that defines GV.  Everything that is
+/// not a function definition lives in partition 0.
+static unsigned getPartition(const GlobalValue *GV, const PartitionMap &Owner) {
+  PartitionMap::const_iterator I = Owner.find(GV);
+  return I == Owner.end() ? 0 : I->second;
+}
+
+/// isReferencedOutside - Return true if V is used, directly or through
+/// constant expressions, from a partition other than Part.
+static bool isReferencedOutside(const Value *V, unsigned Part,
+                                const PartitionMap &Owner,
+                                SmallPtrSet<const Value*, 16> &Visited) {
+  for (Value::const_use_iterator UI = V->use_begin(), E = V->use_end();
+       UI != E; ++UI) {
+    const User *U = *UI;
+    if (const Instruction *I = dyn_cast<Instruction>(U)) {
+      if (getPartition(I->getParent()->getParent(), Owner) != Part)
+        return true;
+    } else if (const GlobalValue *GV = dyn_cast<GlobalValue>(U)) {
+      if (getPartition(GV, Owner) != Part)
+        return true;
+    } else if (Visited.insert(U) &&
+               isReferencedOutside(U, Part, Owner, Visited)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace {
+  /// FunctionSize - Orders clusters of function definitions by decreasing
+  /// size, keeping module order among equally sized clusters.
+  struct FunctionSize {
+    unsigned Index;
+    unsigned Size;
+    bool operator<(const FunctionSize &RHS) const {
+      if (Size != RHS.Size)
+        return Size > RHS.Size;
+      return Index < RHS.Index;
+    }
+  };
+}
+
+static unsigned countInstructions(const Function &F) {
+  unsigned Size = 0;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Size += BB->size();
+  return Size;
+}
+
+/// findLeader - Return the representative of the cluster containing I.
+static unsigned findLeader(std::vector<unsigned> &Leader, unsigned I) {
+  while (Leader[I] != I)
+    I = Leader[I] = Leader[Leader[I]];
+  return I;
+}
+
+namespace {
+  /// CallEdge - The number of direct calls from one function definition to
+  /// another.
+  struct CallEdge {
+    unsigned Caller, Callee, Count;
+    bool operator<(const CallEdge &RHS) const {
+      if (Count != RHS.Count)
+        return Count > RHS.Count;
+      if (Caller != RHS.Caller)
+        return Caller < RHS.Caller;
+      return Callee < RHS.Callee;
+    }
+  };
+}
+
+/// clusterByCalls - Merge the clusters of functions that call each other,
+/// heaviest call edges first, as long as a cluster does not grow beyond the
+/// average partition size.
+static void clusterByCalls(const std::vector<Function*> &Defs,
+                           const std::vector<unsigned> &Sizes,
+                           unsigned NumParts, std::vector<unsigned> &Leader) {
+  DenseMap<const Function*, unsigned> Index;
+  uint64_t Total = 0;
+  for (unsigned i = 0, e = Defs.size(); i != e; ++i) {
+    Index[Defs[i]] = i;
+    Total += Sizes[i];
+  }
+  uint64_t Cap = std::max<uint64_t>(Total / NumParts, 1);
+
+  std::vector<CallEdge> Edges;
+  for (unsigned i = 0, e = Defs.size(); i != e; ++i) {
+    DenseMap<unsigned, unsigned> Calls;
+    for (Function::iterator BB = Defs[i]->begin(), BE = Defs[i]->end();
+         BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE;
+           ++I) {
+        CallSite CS(cast<Value>(I));
+        if (!CS)
+          continue;
+        Function *Callee = CS.getCalledFunction();
+        DenseMap<const Function*, unsigned>::iterator CI;
+        if (Callee && (CI = Index.find(Callee)) != Index.end() &&
+            CI->second != i)
+          ++Calls[CI->second];
+      }
+    for (DenseMap<unsigned, unsigned>::iterator CI = Calls.begin(),
+           CE = Calls.end(); CI != CE; ++CI) {
+      CallEdge Edge = { i, CI->first, CI->second };
+      Edges.push_back(Edge);
+    }
+  }
+  std::sort(Edges.begin(), Edges.end());
+
+  std::vector<uint64_t> ClusterSize(Sizes.begin(), Sizes.end());
+  for (unsigned i = 0, e = Edges.size(); i != e; ++i) {
+    unsigned A = findLeader(Leader, Edges[i].Caller);
+    unsigned B = findLeader(Leader, Edges[i].Callee);
+    if (A == B || ClusterSize[A] + ClusterSize[B] > Cap)
+      continue;
+    if (B < A)
+      std::swap(A, B);
+    Leader[B] = A;
+    ClusterSize[A] += ClusterSize[B];
+  }
+}
+
+/// assignPartitions - Greedily place the largest remaining cluster of
+/// functions into the least loaded partition.  Unless \p ByCallGraph is set,
+/// every function is a cluster of its own.
+static void assignPartitions(Module &M, unsigned NumParts, bool ByCallGraph,
+                             PartitionMap &Owner) {
+  // Aliases must stay next to their aliasee, and aliases live in partition 0.
+  SmallPtrSet<const GlobalValue*, 8> Pinned;
+  for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end();
+       I != E; ++I)
+    if (const GlobalValue *GV = I->getAliasedGlobal())
+      Pinned.insert(GV);
+
+  std::vector<Function*> Defs;
+  std::vector<unsigned> Sizes;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    Defs.push_back(F);
+    Sizes.push_back(countInstructions(*F));
+  }
+
+  std::vector<unsigned> Leader(Defs.size());
+  for (unsigned i = 0, e = Defs.size(); i != e; ++i)
+    Leader[i] = i;
+  if (ByCallGraph && NumParts > 1)
+    clusterByCalls(Defs, Sizes, NumParts, Leader);
+
+  // Sum up the clusters.  Each function adds one to the load of its
+  // partition on top of its size.
+  std::vector<unsigned> ClusterSize(Defs.size()), ClusterCount(Defs.size());
+  std::vector<bool> ClusterPinned(Defs.size());
+  for (unsigned i = 0, e = Defs.size(); i != e; ++i) {
+    unsigned L = findLeader(Leader, i);
+    ClusterSize[L] += Sizes[i];
+    ++ClusterCount[L];
+    if (Pinned.count(Defs[i]))
+      ClusterPinned[L] = true;
+  }
+
+  std::vector<FunctionSize> Clusters;
+  for (unsigned i = 0, e = Defs.size(); i != e; ++i)
+    if (Leader[i] == i) {
+      FunctionSize FS = { i, ClusterSize[i] };
+      Clusters.push_back(FS);
+    }
+  std::sort(Clusters.begin(), Clusters.end());
+
+  std::vector<uint64_t> Load(NumParts);
+  std::vector<unsigned> ClusterPart(Defs.size());
+  for (unsigned i = 0, e = Clusters.size(); i != e; ++i) {
+    unsigned L = Clusters[i].Index;
+    unsigned Part = 0;
+    if (!ClusterPinned[L])
+      for (unsigned p = 1; p != NumParts; ++p)
+        if (Load[p] < Load[Part])
+          Part = p;
+    Load[Part] += ClusterSize[L] + ClusterCount[L];
+    ClusterPart[L] = Part;
+  }
+
+  for (unsigned i = 0, e = Defs.size(); i != e; ++i)
+    Owner[Defs[i]] = ClusterPart[findLeader(Leader, i)];
+}
+
+/// getModuleSuffix - Return a suffix used to give externalized local symbols
+/// a name that is unlikely to clash with those of other modules.
+static std::string getModuleSuffix(const Module &M) {
+  // FNV-1a over the module identifier.
+  uint64_t Hash = 14695981039346656037ULL;
+  const std::string &Id = M.getModuleIdentifier();
+  for (unsigned i = 0, e = Id.size(); i != e; ++i) {
+    Hash ^= (unsigned char)Id[i];
+    Hash *= 1099511628211ULL;
+  }
+  return ".llvm.part." + utohexstr(Hash);
+}
+
+/// externalizeIfShared - Give GV hidden external linkage if it is local and
+/// used from outside the partition that defines it.
+static void externalizeIfShared(GlobalValue *GV, const PartitionMap &Owner,
+                                const std::string &Suffix) {
+  if (!GV->hasLocalLinkage() || GV->isDeclaration())
+    return;
+  SmallPtrSet<const Value*, 16> Visited;
+  if (!isReferencedOutside(GV, getPartition(GV, Owner), Owner, Visited))
+    return;
+
+  std::string Name = GV->hasName() ? GV->getName().str() : "__unnamed";
+  GV->setName(Name + Suffix);
+  GV->setLinkage(GlobalValue::ExternalLinkage);
+  GV->setVisibility(GlobalValue::HiddenVisibility);
+}
+
+/// removeUnusedDeclarations - Erase the declarations nothing in M refers to.
+/// They do not affect the generated code, and leaving them out makes the
+/// bitcode of a partition independent of the functions in other partitions.
+static void removeUnusedDeclarations(Module &M) {
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ) {
+    Function *F = I++;
+    if (F->isDeclaration()) {
+      F->removeDeadConstantUsers();
+      if (F->use_empty())
+        F->eraseFromParent();
+    }
+  }
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ) {
+    GlobalVariable *GV = I++;
+    if (GV->isDeclaration()) {
+      GV->removeDeadConstantUsers();
+      if (GV->use_empty())
+        GV->eraseFromParent();
+    }
+  }
+}
+
+/// stripToFunctions - Remove the aliases, global variable definitions and
+/// module level inline asm of a partition other than partition 0, leaving
+/// declarations in place of the definitions.
+static void stripToFunctions(Module &M) {
+  // Symbols the inline asm defines must only be emitted once.
+  M.setModuleInlineAsm("");
+
+  // Replace aliases with declarations of the symbol they define.
+  for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end();
+       I != E; ) {
+    GlobalAlias *GA = I++;
+    const Type *Ty = GA->getType()->getElementType();
+    GlobalValue *Decl;
+    if (const FunctionType *FTy = dyn_cast<FunctionType>(Ty))
+      Decl = Function::Create(FTy, GlobalValue::ExternalLinkage, "", &M);
+    else
+      Decl = new GlobalVariable(M, Ty, false, GlobalValue::ExternalLinkage,
+                                0, "", 0, false,
+                                GA->getType()->getAddressSpace());
+    Decl->setVisibility(GA->getVisibility());
+    Decl->takeName(GA);
+    GA->replaceAllUsesWith(Decl);
+    GA->eraseFromParent();
+  }
+
+  // Turn variable definitions into declarations.  Appending globals such as
+  // llvm.global_ctors are emitted by partition 0 only.
+  std::vector<GlobalVariable*> Dead;
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I) {
+    if (I->hasAppendingLinkage()) {
+      Dead.push_back(I);
+      continue;
+    }
+    if (I->isDeclaration())
+      continue;
+    I->setInitializer(0);
+    if (I->hasLocalLinkage())
+      Dead.push_back(I);
+    else
+      I->setLinkage(GlobalValue::ExternalLinkage);
+  }
+
+  // Local variables that were not externalized are only used by partition 0
+  // and are dead here once the other bodies and initializers are gone.
+  for (unsigned i = 0, e = Dead.size(); i != e; ++i) {
+    GlobalVariable *GV = Dead[i];
+    GV->removeDeadConstantUsers();
+    if (GV->use_empty())
+      GV->eraseFromParent();
+    else
+      GV->setLinkage(GlobalValue::ExternalLinkage);
+  }
+}
+
+/// buildPartition - Return a copy of M that only defines the functions owned
+/// by Part, and global variables if Part is zero.
+static Module *buildPartition(const Module &M, unsigned Part,
+                              const PartitionMap &Owner) {
+  ValueToValueMapTy VMap;
+  Module *MPart = CloneModule(&M, VMap);
+
+  for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration() && getPartition(F, Owner) != Part)
+      cast<Function>(VMap[F])->deleteBody();
+
+  if (Part != 0)
+    stripToFunctions(*MPart);
+  removeUnusedDeclarations(*MPart);
+  return MPart;
+}
+
+void llvm::SplitModuleForCodeGen(Module &M, unsigned NumParts,
+                                 std::vector<std::string> &Parts,
+                                 bool ByCallGraph) {
+  assert(NumParts != 0 && "Cannot split into zero partitions!");
+  Parts.clear();
+  Parts.resize(NumParts);
+
+  PartitionMap Owner;
+  assignPartitions(M, NumParts, ByCallGraph, Owner);
+
+  if (NumParts > 1) {
+    std::string Suffix = getModuleSuffix(M);
+    for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+      externalizeIfShared(I, Owner, Suffix);
+    for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+         I != E; ++I)
+      externalizeIfShared(I, Owner, Suffix);
+    for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end();
+         I != E; ++I)
+      externalizeIfShared(I, Owner, Suffix);
+  }
+
+  for (unsigned Part = 0; Part != NumParts; ++Part) {
+    OwningPtr<Module> MPart(buildPartition(M, Part, Owner));
+    raw_string_ostream OS(Parts[Part]);
+    WriteBitcodeToFile(MPart.get(), OS);
+  }
+}
+
+namespace {
+  /// PartitionJob - The input and output of one worker task.
+  struct PartitionJob {
+    const std::string *Bitcode;
+    const ParallelCodeGenOptions *Options;
+    std::string *Output;
+    std::string Error;
+  };
+}
+
+static void CodeGenPartition(void *Arg) {
+  PartitionJob &Job = *static_cast<PartitionJob*>(Arg);
+  const ParallelCodeGenOptions &Opts = *Job.Options;
+
+  LLVMContext Context;
+  OwningPtr<MemoryBuffer> Buffer(MemoryBuffer::getMemBuffer(*Job.Bitcode));
+  OwningPtr<Module> M(ParseBitcodeFile(Buffer.get(), Context, &Job.Error));
+  if (!M)
+    return;
+
+  OwningPtr<TargetMachine>
+    TM(Opts.TheTarget->createTargetMachine(Opts.TargetTriple, Opts.Features));
+  if (!TM) {
+    Job.Error = "could not allocate target machine";
+    return;
+  }
+  if (Opts.InitTargetMachine)
+    Opts.InitTargetMachine(*TM, Opts.InitOpaque);
+
+  PassManager PM;
+  if (const TargetData *TD = TM->getTargetData())
+    PM.add(new TargetData(*TD));
+  else
+    PM.add(new TargetData(M.get()));
+
+  raw_string_ostream OS(*Job.Output);
+  {
+    formatted_raw_ostream FOS(OS);
+    if (TM->addPassesToEmitFile(PM, FOS, Opts.FileType, Opts.OptLevel,
+                                Opts.DisableVerify)) {
+      Job.Error = "target does not support generation of this file type";
+      return;
+    }
+    PM.run(*M);
+  }
+  OS.flush();
+}
+
+bool llvm::CodeGenModulePartitions(const std::vector<std::string> &Parts,
+                                   const ParallelCodeGenOptions &Options,
+                                   std::vector<std::string> &Outputs,
+                                   std::string &ErrMsg) {
+  assert(Options.TheTarget && "No target to generate code for!");
+  Outputs.clear();
+  Outputs.resize(Parts.size());
+
+  std::vector<PartitionJob> Jobs(Parts.size());
+  {
+    unsigned Threads = Options.NumThreads;
+    if (Threads == 0)
+      Threads = ThreadPool::getHardwareConcurrency();
+    ThreadPool Pool(std::min<unsigned>(Threads, Parts.size()));
+    for (unsigned i = 0, e = Parts.size(); i != e; ++i) {
+      Jobs[i].Bitcode = &Parts[i];
+      Jobs[i].Options = &Options;
+      Jobs[i].Output = &Outputs[i];
+      Pool.async(CodeGenPartition, &Jobs[i]);
+    }
+    Pool.wait();
+  }
+
+  for (unsigned i = 0, e = Jobs.size(); i != e; ++i) {
+    if (!Jobs[i].Error.empty()) {
+      ErrMsg = "partition " + utostr(i) + ": " + Jobs[i].Error;
+      return true;
+    }
+  }
+  return false;
+}
@@ -29,6 +29,7 @@
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include <cmath>
 #include <cstring>
 using namespace llvm;
@@ -65,6 +66,7 @@ ExecutionEngine::ExecutionEngine(Module *M)
     ExceptionTableRegister(0),
     ExceptionTableDeregister(0) {
   CompilingLazily         = false;
+  CompilingInBackground   = false;
   GVCompilationDisabled   = false;
   SymbolSearchingDisabled = false;
   Modules.push_back(M);
@@ -427,17 +429,55 @@ ExecutionEngine *EngineBuilder::create() {
 
   // If the user specified a memory manager but didn't specify which engine to
   // create, we assume they only want the JIT, and we fail if they only want
-  // the interpreter.
+  // the interpreter.  With tiered execution, the memory manager is for the
+  // JIT that the interpreter tiers up to.
   if (JMM) {
-    if (WhichEngine & EngineKind::JIT)
-      WhichEngine = EngineKind::JIT;
-    else {
+    if (WhichEngine & EngineKind::JIT) {
+      if (!TierUpThreshold)
+        WhichEngine = EngineKind::JIT;
+    } else {
       if (ErrorStr)
         *ErrorStr = "Cannot create an interpreter with a memory manager.";
       return 0;
     }
   }
 
+  // Tiered execution: start in the interpreter, and let it move the hot
+  // functions to a JIT.  The JIT compiles a copy of the module, since code
+  // generation rewrites the IR that the interpreter may be executing, but it
+  // shares the interpreter's global variables.
+  if (TierUpThreshold && WhichEngine == EngineKind::Either &&
+      ExecutionEngine::JITCtor && ExecutionEngine::InterpCtor) {
+    ExecutionEngine *EE = ExecutionEngine::InterpCtor(M, ErrorStr);
+    if (!EE)
+      return 0;
+
+    ValueToValueMapTy VMap;
+    Module *Copy = CloneModule(M, VMap);
+    std::string JITError;
+    ExecutionEngine *TierUp =
+      ExecutionEngine::JITCtor(Copy, &JITError, JMM, OptLevel,
+                               AllocateGVsWithCode, CMModel,
+                               MArch, MCPU, MAttrs);
+    if (!TierUp) {
+      delete Copy;
+      return EE;
+    }
+
+    for (Module::global_iterator I = M->global_begin(), E = M->global_end();
+         I != E; ++I)
+      if (!I->isDeclaration())
+        TierUp->addGlobalMapping(cast<GlobalValue>(VMap[I]),
+                                 EE->getPointerToGlobal(I));
+    DenseMap<const Function*, Function*> Copies;
+    for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I)
+      Copies[I] = cast<Function>(VMap[I]);
+
+    if (!EE->setTierUpEngine(TierUp, Copies, TierUpThreshold))
+      delete TierUp;
+    return EE;
+  }
+
   // Unless the interpreter was explicitly selected or the JIT is not linked,
   // try making a JIT.
   if (WhichEngine & EngineKind::JIT) {
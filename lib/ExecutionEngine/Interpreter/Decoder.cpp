@@ -0,0 +1,373 @@
+//===-- Decoder.cpp - Lower functions into the form the interpreter runs --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file lowers each function, once, into a DecodedFunction: an array of
+// instructions whose operands are resolved to register file slots and to a
+// pool of evaluated constants.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "interpreter"
+#include "Interpreter.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/IntrinsicLowering.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+using namespace llvm;
+
+STATISTIC(NumDecodedFunctions, "Number of functions decoded");
+
+namespace {
+  /// FunctionDecoder - Builds the DecodedFunction of a function.
+  class FunctionDecoder {
+    DecodedFunction &DF;
+    const TargetData &TD;
+    DenseMap<const BasicBlock*, unsigned> BlockStart;
+
+  public:
+    /// PooledConstants - The constants of the pool, which the interpreter
+    /// evaluates.
+    std::vector<Value*> PooledConstants;
+
+    FunctionDecoder(DecodedFunction &DF, const TargetData &TD)
+      : DF(DF), TD(TD) {}
+
+    void decode(Function &F);
+
+  private:
+    unsigned getOperand(Value *V);
+    unsigned getEdge(BasicBlock *From, BasicBlock *To);
+    void decodeInst(Instruction &I, DecodedInst &DI);
+    bool decodeGEP(GetElementPtrInst &GEP, DecodedInst &DI);
+  };
+}
+
+/// getOperand - Return the encoding of V, adding it to PooledConstants if it
+/// is a constant seen for the first time.
+unsigned FunctionDecoder::getOperand(Value *V) {
+  std::pair<DenseMap<const Value*, unsigned>::iterator, bool> Entry =
+    DF.OperandOf.insert(std::make_pair(V, 0U));
+  if (Entry.second) {
+    assert(isa<Constant>(V) && "Operand without a slot is not a constant!");
+    Entry.first->second =
+      PooledConstants.size() | DecodedFunction::ConstantBit;
+    PooledConstants.push_back(V);
+  }
+  return Entry.first->second;
+}
+
+/// getEdge - Return the index of the edge from From to To, making it and the
+/// copies of the PHI nodes of To if needed.
+unsigned FunctionDecoder::getEdge(BasicBlock *From, BasicBlock *To) {
+  std::pair<DenseMap<std::pair<const BasicBlock*, const BasicBlock*>,
+                     unsigned>::iterator, bool> Entry =
+    DF.EdgeOf.insert(std::make_pair(std::make_pair(From, To), 0U));
+  if (!Entry.second)
+    return Entry.first->second;
+
+  DecodedEdge E;
+  E.From = From;
+  E.To = To;
+  E.Target = BlockStart[To];
+  E.CopyBegin = DF.Copies.size();
+  E.ParallelCopies = false;
+  for (BasicBlock::iterator I = To->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+       ++I) {
+    // A copy that reads a PHI node of To an earlier copy writes must read it
+    // first.
+    Value *Incoming = PN->getIncomingValueForBlock(From);
+    if (PHINode *Src = dyn_cast<PHINode>(Incoming))
+      E.ParallelCopies |= Src->getParent() == To && Src != PN;
+    unsigned Slot = DF.getSlot(PN);
+    DF.Copies.push_back(std::make_pair(Slot, getOperand(Incoming)));
+  }
+  E.CopyEnd = DF.Copies.size();
+
+  Entry.first->second = DF.Edges.size();
+  DF.Edges.push_back(E);
+  return Entry.first->second;
+}
+
+/// decodeGEP - Fold the constant indices of GEP into one offset.  Return false
+/// if an index has a width the interpreter does not handle.
+bool FunctionDecoder::decodeGEP(GetElementPtrInst &GEP, DecodedInst &DI) {
+  DecodedIndex Offset;
+  Offset.Operand = DecodedFunction::NoOperand;
+  Offset.Is32Bit = false;
+  Offset.Scale = 0;
+  SmallVector<DecodedIndex, 4> Variable;
+
+  for (gep_type_iterator I = gep_type_begin(GEP), E = gep_type_end(GEP);
+       I != E; ++I) {
+    if (const StructType *STy = dyn_cast<StructType>(*I)) {
+      unsigned Field = unsigned(cast<ConstantInt>(I.getOperand())
+                                  ->getZExtValue());
+      Offset.Scale += TD.getStructLayout(STy)->getElementOffset(Field);
+      continue;
+    }
+    int64_t Size = TD.getTypeAllocSize(cast<SequentialType>(*I)
+                                         ->getElementType());
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(I.getOperand())) {
+      Offset.Scale += Size * CI->getSExtValue();
+      continue;
+    }
+    unsigned BitWidth =
+      cast<IntegerType>(I.getOperand()->getType())->getBitWidth();
+    if (BitWidth != 32 && BitWidth != 64)
+      return false;
+    DecodedIndex Index;
+    Index.Operand = getOperand(I.getOperand());
+    Index.Is32Bit = BitWidth == 32;
+    Index.Scale = Size;
+    Variable.push_back(Index);
+  }
+
+  DI.Ops[0] = getOperand(GEP.getPointerOperand());
+  DI.Ops[1] = DF.Indices.size();
+  if (Offset.Scale)
+    DF.Indices.push_back(Offset);
+  DF.Indices.insert(DF.Indices.end(), Variable.begin(), Variable.end());
+  DI.Ops[2] = DF.Indices.size();
+  return true;
+}
+
+/// isTrivialCast - Return true if the cast I does not change the bits of its
+/// operand, as the interpreter represents them.
+static bool isTrivialCast(const CastInst &I) {
+  if (!isa<BitCastInst>(I))
+    return false;
+  const Type *SrcTy = I.getOperand(0)->getType(), *DstTy = I.getType();
+  return (SrcTy->isPointerTy() && DstTy->isPointerTy()) ||
+         (SrcTy->isIntegerTy() && DstTy->isIntegerTy());
+}
+
+void FunctionDecoder::decodeInst(Instruction &I, DecodedInst &DI) {
+  DI.Op = DecodedInst::Generic;
+  DI.SubOp = 0;
+  DI.Dest = I.getType()->isVoidTy() ? unsigned(DecodedFunction::NoOperand)
+                                    : DF.getSlot(&I);
+  DI.Ops[0] = DI.Ops[1] = DI.Ops[2] = DecodedFunction::NoOperand;
+  DI.Ty = I.getNumOperands() ? I.getOperand(0)->getType() : 0;
+  DI.Inst = &I;
+
+  // Vector operations are left to visit*.
+  if (I.getNumOperands() && DI.Ty->isVectorTy())
+    return;
+
+  switch (I.getOpcode()) {
+  default:
+    return;
+  case Instruction::Add:  DI.Op = DecodedInst::Add; break;
+  case Instruction::Sub:  DI.Op = DecodedInst::Sub; break;
+  case Instruction::Mul:  DI.Op = DecodedInst::Mul; break;
+  case Instruction::And:  DI.Op = DecodedInst::And; break;
+  case Instruction::Or:   DI.Op = DecodedInst::Or;  break;
+  case Instruction::Xor:  DI.Op = DecodedInst::Xor; break;
+  case Instruction::UDiv: case Instruction::SDiv:
+  case Instruction::URem: case Instruction::SRem:
+  case Instruction::Shl:  case Instruction::LShr: case Instruction::AShr:
+  case Instruction::FAdd: case Instruction::FSub: case Instruction::FMul:
+  case Instruction::FDiv: case Instruction::FRem:
+    DI.Op = DecodedInst::BinOp;
+    DI.SubOp = I.getOpcode();
+    break;
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    DI.Op = DecodedInst::Cmp;
+    DI.SubOp = cast<CmpInst>(I).getPredicate();
+    break;
+  case Instruction::Select:
+    if (!I.getOperand(0)->getType()->isIntegerTy())
+      return;
+    DI.Op = DecodedInst::Select;
+    DI.Ops[2] = getOperand(I.getOperand(2));
+    break;
+  case Instruction::Br: {
+    BranchInst &BI = cast<BranchInst>(I);
+    if (BI.isUnconditional()) {
+      DI.Op = DecodedInst::Br;
+      DI.Ops[0] = getEdge(BI.getParent(), BI.getSuccessor(0));
+    } else {
+      DI.Op = DecodedInst::CondBr;
+      DI.Ops[0] = getOperand(BI.getCondition());
+      DI.Ops[1] = getEdge(BI.getParent(), BI.getSuccessor(0));
+      DI.Ops[2] = getEdge(BI.getParent(), BI.getSuccessor(1));
+    }
+    return;
+  }
+  case Instruction::Ret:
+    DI.Op = DecodedInst::Ret;
+    if (I.getNumOperands())
+      DI.Ops[0] = getOperand(I.getOperand(0));
+    else
+      DI.Ty = I.getType();
+    return;
+  case Instruction::Load:
+    if (cast<LoadInst>(I).isVolatile())
+      return;
+    DI.Op = DecodedInst::Load;
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    DI.Ty = I.getType();
+    return;
+  case Instruction::Store:
+    if (cast<StoreInst>(I).isVolatile())
+      return;
+    DI.Op = DecodedInst::Store;
+    break;
+  case Instruction::GetElementPtr:
+    if (decodeGEP(cast<GetElementPtrInst>(I), DI))
+      DI.Op = DecodedInst::GEP;
+    return;
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    DI.Op = I.getOpcode() == Instruction::Trunc ? DecodedInst::Trunc :
+            I.getOpcode() == Instruction::ZExt ? DecodedInst::ZExt :
+                                                  DecodedInst::SExt;
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    DI.Ops[1] = cast<IntegerType>(I.getType())->getBitWidth();
+    return;
+  case Instruction::BitCast:
+    if (!isTrivialCast(cast<CastInst>(I)))
+      return;
+    DI.Op = DecodedInst::Move;
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    return;
+  case Instruction::Call:
+  case Instruction::Invoke: {
+    // Intrinsics are left to visitCallSite, which lowers them.
+    CallSite CS(&I);
+    Function *Callee = CS.getCalledFunction();
+    if (Callee && Callee->isDeclaration() && Callee->getIntrinsicID())
+      return;
+    DI.Op = DecodedInst::Call;
+    DI.Ops[0] = getOperand(CS.getCalledValue());
+    DI.Ops[1] = DF.Args.size();
+    for (CallSite::arg_iterator AI = CS.arg_begin(), AE = CS.arg_end();
+         AI != AE; ++AI)
+      DF.Args.push_back(getOperand(*AI));
+    DI.Ops[2] = DF.Args.size();
+    return;
+  }
+  }
+
+  // The binary operators, compares, selects and stores.
+  DI.Ops[0] = getOperand(I.getOperand(0));
+  DI.Ops[1] = getOperand(I.getOperand(1));
+}
+
+void FunctionDecoder::decode(Function &F) {
+  // Give a slot to each argument and instruction result, and find where the
+  // code of each block starts once its PHI nodes are left out.
+  unsigned NumSlots = 0, NumInsts = 0;
+  for (Function::arg_iterator AI = F.arg_begin(), E = F.arg_end();
+       AI != E; ++AI)
+    DF.OperandOf[AI] = NumSlots++;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    BasicBlock::iterator I = BB->begin();
+    for (; isa<PHINode>(I); ++I)
+      DF.OperandOf[I] = NumSlots++;
+    BlockStart[BB] = NumInsts;
+    for (BasicBlock::iterator IE = BB->end(); I != IE; ++I, ++NumInsts)
+      if (!I->getType()->isVoidTy())
+        DF.OperandOf[I] = NumSlots++;
+  }
+  DF.NumSlots = NumSlots;
+
+  DF.Insts.resize(NumInsts);
+  unsigned Index = 0;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    for (BasicBlock::iterator I = BB->getFirstNonPHI(), IE = BB->end();
+         I != IE; ++I)
+      decodeInst(*I, DF.Insts[Index++]);
+
+    // Switches, indirect branches, and invokes when the callee returns or
+    // unwinds, look their edges up by block.
+    TerminatorInst *TI = BB->getTerminator();
+    for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i)
+      getEdge(BB, TI->getSuccessor(i));
+  }
+}
+
+DecodedFunction *Interpreter::decodeFunction(Function *F) {
+  ++NumDecodedFunctions;
+  DecodedFunction *DF = new DecodedFunction();
+  FunctionDecoder Decoder(*DF, TD);
+  Decoder.decode(*F);
+
+  // Constants are evaluated without a frame.
+  ExecutionContext Dummy;
+  Dummy.CurFunction = F;
+  Dummy.Code = 0;
+  const std::vector<Value*> &Pooled = Decoder.PooledConstants;
+  DF->Constants.reserve(Pooled.size());
+  for (unsigned i = 0, e = Pooled.size(); i != e; ++i)
+    DF->Constants.push_back(getOperandValue(Pooled[i], Dummy));
+  return DF;
+}
+
+const DecodedFunction *Interpreter::getDecodedFunction(Function *F) {
+  DecodedFunction *&DF = DecodedFunctions[F];
+  if (!DF)
+    DF = decodeFunction(F);
+  return DF;
+}
+
+void Interpreter::freeMachineCodeForFunction(Function *F) {
+  DenseMap<const Function*, DecodedFunction*>::iterator I =
+    DecodedFunctions.find(F);
+  if (I == DecodedFunctions.end())
+    return;
+  delete I->second;
+  DecodedFunctions.erase(I);
+}
+
+void Interpreter::lowerIntrinsicCall(CallInst *CI, ExecutionContext &SF) {
+  Function *F = SF.CurFunction;
+  DecodedFunction *Old = DecodedFunctions[F];
+
+  // Run the first instruction lowering inserts, if any, or the one after CI.
+  BasicBlock::iterator Me(CI);
+  BasicBlock *Parent = CI->getParent();
+  bool AtBegin = Parent->begin() == Me;
+  if (!AtBegin)
+    --Me;
+  IL->LowerIntrinsicCall(CI);
+  Instruction *Resume = AtBegin ? Parent->begin() : llvm::next(Me);
+
+  DecodedFunction *New = decodeFunction(F);
+  DenseMap<const Instruction*, unsigned> IndexOf;
+  for (unsigned i = 0, e = New->Insts.size(); i != e; ++i)
+    IndexOf[New->Insts[i].Inst] = i;
+
+  // The other frames running F are stopped after a call, at an instruction
+  // that is still there.  CI itself is gone, so its old slot is dropped.
+  for (unsigned i = 0, e = ECStack.size(); i != e; ++i) {
+    ExecutionContext &Frame = ECStack[i];
+    if (Frame.Code != Old)
+      continue;
+    Instruction *Next = &Frame == &SF ? Resume : Old->Insts[Frame.PC].Inst;
+    Frame.PC = IndexOf[Next];
+
+    ValuePlaneTy Values(New->NumSlots);
+    for (DenseMap<const Value*, unsigned>::iterator I = Old->OperandOf.begin(),
+           E = Old->OperandOf.end(); I != E; ++I)
+      if (I->first != CI && !(I->second & DecodedFunction::ConstantBit))
+        Values[New->getSlot(I->first)] = Frame.Values[I->second];
+    Frame.Values.swap(Values);
+    Frame.Code = New;
+  }
+
+  delete Old;
+  DecodedFunctions[F] = New;
+}
@@ -24,11 +24,13 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include <algorithm>
 #include <cmath>
 using namespace llvm;
 
 STATISTIC(NumDynamicInsts, "Number of dynamic instructions executed");
+STATISTIC(NumTierUpCalls,  "Number of calls run by the tier up engine");
 
 static cl::opt<bool> PrintVolatile("interpreter-print-volatile", cl::Hidden,
           cl::desc("make the interpreter print every volatile load and store"));
@@ -38,7 +40,15 @@ static cl::opt<bool> PrintVolatile("interpreter-print-volatile", cl::Hidden,
 //===----------------------------------------------------------------------===//
 
 static void SetValue(Value *V, GenericValue Val, ExecutionContext &SF) {
-  SF.Values[V] = Val;
+  SF.Values[SF.Code->getSlot(V)] = Val;
+}
+
+/// getDecodedOperand - Return the value of an operand of SF.Code.
+static inline const GenericValue &getDecodedOperand(unsigned Op,
+                                                    const ExecutionContext &SF) {
+  if (Op & DecodedFunction::ConstantBit)
+    return SF.Code->Constants[Op & ~DecodedFunction::ConstantBit];
+  return SF.Values[Op];
 }
 
 //===----------------------------------------------------------------------===//
@@ -518,14 +528,13 @@ static GenericValue executeCmpInst(unsigned predicate, GenericValue Src1,
   }
 }
 
-void Interpreter::visitBinaryOperator(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
-  const Type *Ty    = I.getOperand(0)->getType();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+static GenericValue executeBinaryInst(unsigned Opcode,
+                                      const GenericValue &Src1,
+                                      const GenericValue &Src2,
+                                      const Type *Ty) {
   GenericValue R;   // Result
 
-  switch (I.getOpcode()) {
+  switch (Opcode) {
   case Instruction::Add:   R.IntVal = Src1.IntVal + Src2.IntVal; break;
   case Instruction::Sub:   R.IntVal = Src1.IntVal - Src2.IntVal; break;
   case Instruction::Mul:   R.IntVal = Src1.IntVal * Src2.IntVal; break;
@@ -541,12 +550,38 @@ void Interpreter::visitBinaryOperator(BinaryOperator &I) {
   case Instruction::And:   R.IntVal = Src1.IntVal & Src2.IntVal; break;
   case Instruction::Or:    R.IntVal = Src1.IntVal | Src2.IntVal; break;
   case Instruction::Xor:   R.IntVal = Src1.IntVal ^ Src2.IntVal; break;
+  case Instruction::Shl:
+    if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
+      R.IntVal = Src1.IntVal.shl(Src2.IntVal.getZExtValue());
+    else
+      R.IntVal = Src1.IntVal;
+    break;
+  case Instruction::LShr:
+    if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
+      R.IntVal = Src1.IntVal.lshr(Src2.IntVal.getZExtValue());
+    else
+      R.IntVal = Src1.IntVal;
+    break;
+  case Instruction::AShr:
+    if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
+      R.IntVal = Src1.IntVal.ashr(Src2.IntVal.getZExtValue());
+    else
+      R.IntVal = Src1.IntVal;
+    break;
   default:
-    dbgs() << "Don't know how to handle this binary operator!\n-->" << I;
+    dbgs() << "Don't know how to handle binary operator "
+           << Instruction::getOpcodeName(Opcode) << "\n";
     llvm_unreachable(0);
   }
+  return R;
+}
 
-  SetValue(&I, R, SF);
+void Interpreter::visitBinaryOperator(BinaryOperator &I) {
+  ExecutionContext &SF = ECStack.back();
+  const Type *Ty    = I.getOperand(0)->getType();
+  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
+  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
+  SetValue(&I, executeBinaryInst(I.getOpcode(), Src1, Src2, Ty), SF);
 }
 
 static GenericValue executeSelectInst(GenericValue Src1, GenericValue Src2,
@@ -685,42 +720,49 @@ void Interpreter::visitIndirectBrInst(IndirectBrInst &I) {
 }
 
 
-// SwitchToNewBasicBlock - This method is used to jump to a new basic block.
-// This function handles the actual updating of block and instruction iterators
-// as well as execution of all of the PHI nodes in the destination block.
-//
-// This method does this because all of the PHI nodes must be executed
-// atomically, reading their inputs before any of the results are updated.  Not
-// doing this can cause problems if the PHI nodes depend on other PHI nodes for
-// their inputs.  If the input PHI node is updated before it is read, incorrect
-// results can happen.  Thus we use a two phase approach.
+// SwitchToNewBasicBlock - This method is used to jump to a new basic block,
+// from the block SF is running.
 //
 void Interpreter::SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF){
-  BasicBlock *PrevBB = SF.CurBB;      // Remember where we came from...
-  SF.CurBB   = Dest;                  // Update CurBB to branch destination
-  SF.CurInst = SF.CurBB->begin();     // Update new instruction ptr...
-
-  if (!isa<PHINode>(SF.CurInst)) return;  // Nothing fancy to do
-
-  // Loop over all of the PHI nodes in the current block, reading their inputs.
-  std::vector<GenericValue> ResultValues;
-
-  for (; PHINode *PN = dyn_cast<PHINode>(SF.CurInst); ++SF.CurInst) {
-    // Search for the value corresponding to this previous bb...
-    int i = PN->getBasicBlockIndex(PrevBB);
-    assert(i != -1 && "PHINode doesn't contain entry for predecessor??");
-    Value *IncomingValue = PN->getIncomingValue(i);
+  takeEdge(SF.Code->Edges[SF.Code->getEdge(SF.CurBB, Dest)], SF);
+}
 
-    // Save the incoming value for this PHI node...
-    ResultValues.push_back(getOperandValue(IncomingValue, SF));
+// takeEdge - This function handles the actual updating of the block and the
+// instruction index, as well as execution of all of the PHI nodes in the
+// destination block.
+//
+// All of the PHI nodes must be executed atomically, reading their inputs
+// before any of the results are updated.  Not doing this can cause problems if
+// the PHI nodes depend on other PHI nodes for their inputs.  If the input PHI
+// node is updated before it is read, incorrect results can happen.  The
+// decoder marks the edges where this can happen, and only these use a two
+// phase approach.
+//
+void Interpreter::takeEdge(const DecodedEdge &E, ExecutionContext &SF) {
+  SF.CurBB = E.To;
+  SF.PC = E.Target;
+
+  // Loop iterations count towards moving the function to the tier up engine,
+  // which happens at its next call.
+  if (TierUp && BackEdges.count(std::make_pair((const BasicBlock*)E.From,
+                                               (const BasicBlock*)E.To))) {
+    unsigned &Count = TierUpCounts[SF.CurFunction];
+    if (Count < TierUpThreshold)
+      ++Count;
   }
 
-  // Now loop over all of the PHI nodes setting their values...
-  SF.CurInst = SF.CurBB->begin();
-  for (unsigned i = 0; isa<PHINode>(SF.CurInst); ++SF.CurInst, ++i) {
-    PHINode *PN = cast<PHINode>(SF.CurInst);
-    SetValue(PN, ResultValues[i], SF);
+  const std::vector<std::pair<unsigned, unsigned> > &Copies = SF.Code->Copies;
+  if (!E.ParallelCopies) {
+    for (unsigned i = E.CopyBegin; i != E.CopyEnd; ++i)
+      SF.Values[Copies[i].first] = getDecodedOperand(Copies[i].second, SF);
+    return;
   }
+
+  SmallVector<GenericValue, 8> ResultValues;
+  for (unsigned i = E.CopyBegin; i != E.CopyEnd; ++i)
+    ResultValues.push_back(getDecodedOperand(Copies[i].second, SF));
+  for (unsigned i = E.CopyBegin; i != E.CopyEnd; ++i)
+    SF.Values[Copies[i].first] = ResultValues[i - E.CopyBegin];
 }
 
 //===----------------------------------------------------------------------===//
@@ -854,21 +896,7 @@ void Interpreter::visitCallSite(CallSite CS) {
       // If it is an unknown intrinsic function, use the intrinsic lowering
       // class to transform it into hopefully tasty LLVM code.
       //
-      BasicBlock::iterator me(CS.getInstruction());
-      BasicBlock *Parent = CS.getInstruction()->getParent();
-      bool atBegin(Parent->begin() == me);
-      if (!atBegin)
-        --me;
-      IL->LowerIntrinsicCall(cast<CallInst>(CS.getInstruction()));
-
-      // Restore the CurInst pointer to the first instruction newly inserted, if
-      // any.
-      if (atBegin) {
-        SF.CurInst = Parent->begin();
-      } else {
-        SF.CurInst = me;
-        ++SF.CurInst;
-      }
+      lowerIntrinsicCall(cast<CallInst>(CS.getInstruction()), SF);
       return;
     }
 
@@ -891,42 +919,15 @@ void Interpreter::visitCallSite(CallSite CS) {
 }
 
 void Interpreter::visitShl(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
-  GenericValue Dest;
-  if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
-    Dest.IntVal = Src1.IntVal.shl(Src2.IntVal.getZExtValue());
-  else
-    Dest.IntVal = Src1.IntVal;
-  
-  SetValue(&I, Dest, SF);
+  visitBinaryOperator(I);
 }
 
 void Interpreter::visitLShr(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
-  GenericValue Dest;
-  if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
-    Dest.IntVal = Src1.IntVal.lshr(Src2.IntVal.getZExtValue());
-  else
-    Dest.IntVal = Src1.IntVal;
-  
-  SetValue(&I, Dest, SF);
+  visitBinaryOperator(I);
 }
 
 void Interpreter::visitAShr(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
-  GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
-  GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
-  GenericValue Dest;
-  if (Src2.IntVal.getZExtValue() < Src1.IntVal.getBitWidth())
-    Dest.IntVal = Src1.IntVal.ashr(Src2.IntVal.getZExtValue());
-  else
-    Dest.IntVal = Src1.IntVal;
-  
-  SetValue(&I, Dest, SF);
+  visitBinaryOperator(I);
 }
 
 GenericValue Interpreter::executeTruncInst(Value *SrcVal, const Type *DstTy,
@@ -1257,6 +1258,15 @@ GenericValue Interpreter::getConstantExprValue (ConstantExpr *CE,
 }
 
 GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
+  // The operands of the instructions of the running function have been
+  // decoded, only the operands of constant expressions have not.
+  if (SF.Code) {
+    DenseMap<const Value*, unsigned>::const_iterator I =
+      SF.Code->OperandOf.find(V);
+    if (I != SF.Code->OperandOf.end())
+      return getDecodedOperand(I->second, SF);
+  }
+
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
     return getConstantExprValue(CE, SF);
   } else if (Constant *CPV = dyn_cast<Constant>(V)) {
@@ -1264,7 +1274,8 @@ GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
   } else if (GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
     return PTOGV(getPointerToGlobal(GV));
   } else {
-    return SF.Values[V];
+    llvm_unreachable("Value has no slot!");
+    return GenericValue();
   }
 }
 
@@ -1272,6 +1283,30 @@ GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
 //                        Dispatch and Execution Code
 //===----------------------------------------------------------------------===//
 
+// isHot - Count a call to F, and return true if F should now run in the tier
+// up engine.
+//
+bool Interpreter::isHot(Function *F) {
+  std::pair<DenseMap<const Function*, unsigned>::iterator, bool> Entry =
+    TierUpCounts.insert(std::make_pair(F, 0U));
+  unsigned &Count = Entry.first->second;
+  if (Entry.second) {
+    if (!TierUpCopies.count(F) || !canCallTierUpFunction(F)) {
+      Count = NeverTierUp;
+      return false;
+    }
+    SmallVector<std::pair<const BasicBlock*, const BasicBlock*>, 8> Edges;
+    FindFunctionBackedges(*F, Edges);
+    for (unsigned i = 0, e = Edges.size(); i != e; ++i)
+      BackEdges.insert(Edges[i]);
+  }
+  if (Count == NeverTierUp)
+    return false;
+  if (Count < TierUpThreshold)
+    ++Count;
+  return Count >= TierUpThreshold;
+}
+
 //===----------------------------------------------------------------------===//
 // callFunction - Execute the specified function...
 //
@@ -1284,6 +1319,7 @@ void Interpreter::callFunction(Function *F,
   ECStack.push_back(ExecutionContext());
   ExecutionContext &StackFrame = ECStack.back();
   StackFrame.CurFunction = F;
+  StackFrame.Code = 0;
 
   // Special handling for external functions.
   if (F->isDeclaration()) {
@@ -1293,58 +1329,173 @@ void Interpreter::callFunction(Function *F,
     return;
   }
 
-  // Get pointers to first LLVM BB & Instruction in function.
+  // Hot functions run in the tier up engine, and return right away too.
+  if (TierUp && isHot(F)) {
+    ++NumTierUpCalls;
+    GenericValue Result = callTierUpFunction(F, ArgVals);
+    popStackAndReturnValueToCaller(F->getReturnType(), Result);
+    return;
+  }
+
+  // Start at the first instruction of the decoded function, with a register
+  // file for its values.
+  StackFrame.Code      = getDecodedFunction(F);
   StackFrame.CurBB     = F->begin();
-  StackFrame.CurInst   = StackFrame.CurBB->begin();
+  StackFrame.PC        = 0;
+  StackFrame.Values.resize(StackFrame.Code->NumSlots);
 
   // Run through the function arguments and initialize their values...
   assert((ArgVals.size() == F->arg_size() ||
          (ArgVals.size() > F->arg_size() && F->getFunctionType()->isVarArg()))&&
          "Invalid number of values passed to function invocation!");
 
-  // Handle non-varargs arguments...
+  // Handle non-varargs arguments, which have the first slots...
   unsigned i = 0;
-  for (Function::arg_iterator AI = F->arg_begin(), E = F->arg_end(); 
-       AI != E; ++AI, ++i)
-    SetValue(AI, ArgVals[i], StackFrame);
+  for (unsigned e = F->arg_size(); i != e; ++i)
+    StackFrame.Values[i] = ArgVals[i];
 
   // Handle varargs arguments...
   StackFrame.VarArgs.assign(ArgVals.begin()+i, ArgVals.end());
 }
 
-
+// run - Execute the decoded instructions of the frame on top of the stack
+// until the stack is empty.  With GCC, each handler jumps straight to the
+// handler of the next instruction through a table of label addresses; other
+// compilers get a switch.  Handlers that may push or pop frames, and the
+// instructions left to the visit* methods, go back to the top of the loop to
+// find the frame to run.
+//
 void Interpreter::run() {
+#if defined(__GNUC__)
+  static void *const Handlers[DecodedInst::NumOpcodes] = {
+    &&Generic, &&Add, &&Sub, &&Mul, &&And, &&Or, &&Xor, &&BinOp, &&Cmp,
+    &&Select, &&Br, &&CondBr, &&Ret, &&Load, &&Store, &&GEP, &&Trunc, &&ZExt,
+    &&SExt, &&Move, &&Call
+  };
+#define INTERP_CASE(Name)  Name:
+#define INTERP_DISPATCH    goto *Handlers[DI->Op];
+#define INTERP_NEXT        { INTERP_FETCH; INTERP_DISPATCH }
+#else
+#define INTERP_CASE(Name)  case DecodedInst::Name:
+#define INTERP_DISPATCH    switch (DI->Op)
+#define INTERP_NEXT        continue
+#endif
+#define INTERP_FETCH                                                   \
+  DI = &SF->Code->Insts[SF->PC++];     /* Increment before execute */ \
+  ++NumDynamicInsts;                                                   \
+  DEBUG(dbgs() << "About to interpret: " << *DI->Inst)
+#define OPERAND(i) getDecodedOperand(DI->Ops[i], *SF)
+#define RESULT     SF->Values[DI->Dest]
+
+  ExecutionContext *SF;
+  const DecodedInst *DI;
   while (!ECStack.empty()) {
-    // Interpret a single instruction & increment the "PC".
-    ExecutionContext &SF = ECStack.back();  // Current stack frame
-    Instruction &I = *SF.CurInst++;         // Increment before execute
-
-    // Track the number of dynamic instructions executed.
-    ++NumDynamicInsts;
-
-    DEBUG(dbgs() << "About to interpret: " << I);
-    visit(I);   // Dispatch to one of the visit* methods...
-#if 0
-    // This is not safe, as visiting the instruction could lower it and free I.
-DEBUG(
-    if (!isa<CallInst>(I) && !isa<InvokeInst>(I) && 
-        I.getType() != Type::VoidTy) {
-      dbgs() << "  --> ";
-      const GenericValue &Val = SF.Values[&I];
-      switch (I.getType()->getTypeID()) {
-      default: llvm_unreachable("Invalid GenericValue Type");
-      case Type::VoidTyID:    dbgs() << "void"; break;
-      case Type::FloatTyID:   dbgs() << "float " << Val.FloatVal; break;
-      case Type::DoubleTyID:  dbgs() << "double " << Val.DoubleVal; break;
-      case Type::PointerTyID: dbgs() << "void* " << intptr_t(Val.PointerVal);
-        break;
-      case Type::IntegerTyID: 
-        dbgs() << "i" << Val.IntVal.getBitWidth() << " "
-               << Val.IntVal.toStringUnsigned(10)
-               << " (0x" << Val.IntVal.toStringUnsigned(16) << ")\n";
-        break;
+    SF = &ECStack.back();  // Current stack frame
+    INTERP_FETCH;
+    INTERP_DISPATCH {
+    INTERP_CASE(Generic)
+      visit(*DI->Inst);    // Dispatch to one of the visit* methods...
+      continue;
+    INTERP_CASE(Add)
+      RESULT.IntVal = OPERAND(0).IntVal + OPERAND(1).IntVal;
+      INTERP_NEXT;
+    INTERP_CASE(Sub)
+      RESULT.IntVal = OPERAND(0).IntVal - OPERAND(1).IntVal;
+      INTERP_NEXT;
+    INTERP_CASE(Mul)
+      RESULT.IntVal = OPERAND(0).IntVal * OPERAND(1).IntVal;
+      INTERP_NEXT;
+    INTERP_CASE(And)
+      RESULT.IntVal = OPERAND(0).IntVal & OPERAND(1).IntVal;
+      INTERP_NEXT;
+    INTERP_CASE(Or)
+      RESULT.IntVal = OPERAND(0).IntVal | OPERAND(1).IntVal;
+      INTERP_NEXT;
+    INTERP_CASE(Xor)
+      RESULT.IntVal = OPERAND(0).IntVal ^ OPERAND(1).IntVal;
+      INTERP_NEXT;
+    INTERP_CASE(BinOp)
+      RESULT = executeBinaryInst(DI->SubOp, OPERAND(0), OPERAND(1), DI->Ty);
+      INTERP_NEXT;
+    INTERP_CASE(Cmp)
+      RESULT = executeCmpInst(DI->SubOp, OPERAND(0), OPERAND(1), DI->Ty);
+      INTERP_NEXT;
+    INTERP_CASE(Select)
+      RESULT = OPERAND(0).IntVal == 0 ? OPERAND(2) : OPERAND(1);
+      INTERP_NEXT;
+    INTERP_CASE(Br)
+      takeEdge(SF->Code->Edges[DI->Ops[0]], *SF);
+      INTERP_NEXT;
+    INTERP_CASE(CondBr)
+      takeEdge(SF->Code->Edges[OPERAND(0).IntVal == 0 ? DI->Ops[2]
+                                                       : DI->Ops[1]], *SF);
+      INTERP_NEXT;
+    INTERP_CASE(Ret) {
+      const Type *RetTy = DI->Ty;
+      GenericValue Result;
+      if (DI->Ops[0] != DecodedFunction::NoOperand)
+        Result = OPERAND(0);
+      popStackAndReturnValueToCaller(RetTy, Result);
+      continue;
+    }
+    INTERP_CASE(Load)
+      LoadValueFromMemory(RESULT, (GenericValue*)GVTOP(OPERAND(0)), DI->Ty);
+      INTERP_NEXT;
+    INTERP_CASE(Store)
+      StoreValueToMemory(OPERAND(0), (GenericValue*)GVTOP(OPERAND(1)),
+                         DI->Ty);
+      INTERP_NEXT;
+    INTERP_CASE(GEP) {
+      char *Ptr = (char*)OPERAND(0).PointerVal;
+      for (unsigned i = DI->Ops[1]; i != DI->Ops[2]; ++i) {
+        const DecodedIndex &Index = SF->Code->Indices[i];
+        if (Index.Operand == DecodedFunction::NoOperand) {
+          Ptr += Index.Scale;
+          continue;
+        }
+        uint64_t Idx = getDecodedOperand(Index.Operand, *SF)
+                         .IntVal.getZExtValue();
+        Ptr += Index.Scale * (Index.Is32Bit ? (int64_t)(int32_t)Idx
+                                            : (int64_t)Idx);
       }
-    });
+      RESULT.PointerVal = Ptr;
+      INTERP_NEXT;
+    }
+    INTERP_CASE(Trunc)
+      RESULT.IntVal = OPERAND(0).IntVal.trunc(DI->Ops[1]);
+      INTERP_NEXT;
+    INTERP_CASE(ZExt)
+      RESULT.IntVal = OPERAND(0).IntVal.zext(DI->Ops[1]);
+      INTERP_NEXT;
+    INTERP_CASE(SExt)
+      RESULT.IntVal = OPERAND(0).IntVal.sext(DI->Ops[1]);
+      INTERP_NEXT;
+    INTERP_CASE(Move)
+      RESULT = OPERAND(0);
+      INTERP_NEXT;
+    INTERP_CASE(Call) {
+      std::vector<GenericValue> ArgVals;
+      ArgVals.reserve(DI->Ops[2] - DI->Ops[1]);
+      for (unsigned i = DI->Ops[1]; i != DI->Ops[2]; ++i)
+        ArgVals.push_back(getDecodedOperand(SF->Code->Args[i], *SF));
+      // To handle indirect calls, we must get the pointer value from the
+      // argument and treat it as a function pointer.
+      Function *F = (Function*)GVTOP(OPERAND(0));
+      SF->Caller = CallSite(DI->Inst);
+      callFunction(F, ArgVals);
+      continue;
+    }
+#if !defined(__GNUC__)
+    default:
+      llvm_unreachable("Unknown decoded opcode!");
 #endif
+    }
   }
+
+#undef INTERP_CASE
+#undef INTERP_DISPATCH
+#undef INTERP_NEXT
+#undef INTERP_FETCH
+#undef OPERAND
+#undef RESULT
 }
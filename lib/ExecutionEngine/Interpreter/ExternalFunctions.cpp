@@ -292,6 +292,62 @@ GenericValue Interpreter::callExternalFunction(Function *F,
   return GenericValue();
 }
 
+/// canCallTierUpFunction - Return true if the code compiled for F can be
+/// called with interpreter values without any code generation per call.
+bool Interpreter::canCallTierUpFunction(const Function *F) {
+  const FunctionType *FTy = F->getFunctionType();
+  if (FTy->isVarArg())
+    return false;
+#ifdef USE_LIBFFI
+  for (unsigned i = 0, e = FTy->getNumParams() + 1; i != e; ++i) {
+    const Type *Ty = i ? FTy->getParamType(i - 1) : FTy->getReturnType();
+    if (Ty->isIntegerTy(8) || Ty->isIntegerTy(16) || Ty->isIntegerTy(32) ||
+        Ty->isIntegerTy(64) || Ty->isFloatTy() || Ty->isDoubleTy() ||
+        Ty->isPointerTy() || (i == 0 && Ty->isVoidTy()))
+      continue;
+    return false;
+  }
+  return true;
+#else
+  // Without libffi, only the signatures that JIT::runFunction calls directly
+  // are cheap; any other one would compile a new stub function per call.
+  const Type *RetTy = FTy->getReturnType();
+  switch (FTy->getNumParams()) {
+  case 0:
+    return RetTy->isVoidTy() || RetTy->isFloatTy() || RetTy->isDoubleTy() ||
+           RetTy->isPointerTy() ||
+           (RetTy->isIntegerTy() &&
+            cast<IntegerType>(RetTy)->getBitWidth() <= 64);
+  case 3:
+    if (!FTy->getParamType(2)->isPointerTy())
+      return false;
+    // FALLTHROUGH
+  case 2:
+    if (!FTy->getParamType(1)->isPointerTy())
+      return false;
+    // FALLTHROUGH
+  case 1:
+    return (RetTy->isIntegerTy(32) || RetTy->isVoidTy()) &&
+           FTy->getParamType(0)->isIntegerTy(32);
+  default:
+    return false;
+  }
+#endif
+}
+
+/// callTierUpFunction - Call the code that the tier up engine compiles for F.
+GenericValue Interpreter::callTierUpFunction(Function *F,
+                                     const std::vector<GenericValue> &ArgVals) {
+  Function *Copy = TierUpCopies.lookup(F);
+#ifdef USE_LIBFFI
+  RawFunc RawFn = (RawFunc)(intptr_t)TierUp->getPointerToFunction(Copy);
+  GenericValue Result;
+  if (ffiInvoke(RawFn, Copy, ArgVals, getTargetData(), Result))
+    return Result;
+#endif
+  return TierUp->runFunction(Copy, ArgVals);
+}
+
 
 //===----------------------------------------------------------------------===//
 //  Functions "exported" to the running application...
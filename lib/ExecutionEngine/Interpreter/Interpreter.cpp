@@ -17,6 +17,7 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Module.h"
+#include "llvm/ADT/STLExtras.h"
 #include <cstring>
 using namespace llvm;
 
@@ -45,7 +46,7 @@ ExecutionEngine *Interpreter::create(Module *M, std::string* ErrStr) {
 // Interpreter ctor - Initialize stuff
 //
 Interpreter::Interpreter(Module *M)
-  : ExecutionEngine(M), TD(M) {
+  : ExecutionEngine(M), TD(M), TierUp(0), TierUpThreshold(0) {
       
   memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
   setTargetData(&TD);
@@ -58,9 +59,56 @@ Interpreter::Interpreter(Module *M)
 }
 
 Interpreter::~Interpreter() {
+  for (DenseMap<const Function*, DecodedFunction*>::iterator
+         I = DecodedFunctions.begin(), E = DecodedFunctions.end(); I != E; ++I)
+    delete I->second;
+  delete TierUp;
   delete IL;
 }
 
+/// haveSameLayout - Return true if A and B lay out the scalar types and the
+/// aggregates the same way.
+static bool haveSameLayout(const TargetData &A, const TargetData &B,
+                           LLVMContext &C) {
+  if (A.isLittleEndian() != B.isLittleEndian())
+    return false;
+  const Type *Tys[] = {
+    Type::getInt1Ty(C), Type::getInt8Ty(C), Type::getInt16Ty(C),
+    Type::getInt32Ty(C), Type::getInt64Ty(C), Type::getFloatTy(C),
+    Type::getDoubleTy(C), Type::getX86_FP80Ty(C), Type::getInt8PtrTy(C),
+    VectorType::get(Type::getInt32Ty(C), 4),
+    VectorType::get(Type::getDoubleTy(C), 2),
+    StructType::get(C, false)
+  };
+  for (unsigned i = 0; i != array_lengthof(Tys); ++i)
+    if (A.getTypeAllocSize(Tys[i]) != B.getTypeAllocSize(Tys[i]) ||
+        A.getABITypeAlignment(Tys[i]) != B.getABITypeAlignment(Tys[i]) ||
+        A.getPrefTypeAlignment(Tys[i]) != B.getPrefTypeAlignment(Tys[i]))
+      return false;
+  return true;
+}
+
+bool Interpreter::setTierUpEngine(ExecutionEngine *JIT,
+                            const DenseMap<const Function*, Function*> &Copies,
+                                  unsigned Threshold) {
+  // Compiled code works on the global variables laid out by the interpreter.
+  if (!haveSameLayout(*JIT->getTargetData(), TD, Modules[0]->getContext()))
+    return false;
+  for (unsigned i = 0, e = Modules.size(); i != e; ++i)
+    for (Module::iterator I = Modules[i]->begin(), E = Modules[i]->end();
+         I != E; ++I)
+      if (I->hasAddressTaken())
+        return false;
+
+  delete TierUp;
+  TierUp = JIT;
+  TierUpThreshold = Threshold;
+  TierUpCopies = Copies;
+  TierUpCounts.clear();
+  BackEdges.clear();
+  return true;
+}
+
 void Interpreter::runAtExitHandlers () {
   while (!AtExitHandlers.empty()) {
     callFunction(AtExitHandlers.back(), std::vector<GenericValue>());
@@ -17,6 +17,8 @@
 #include "llvm/Function.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/DataTypes.h"
@@ -64,14 +66,98 @@ public:
 
 typedef std::vector<GenericValue> ValuePlaneTy;
 
+// DecodedInst - One instruction of a DecodedFunction.  The operands are
+// encoded as described in DecodedFunction, except for the branches, whose
+// operands after the condition are indices in DecodedFunction::Edges.
+//
+struct DecodedInst {
+  enum Opcode {
+    Generic,              // Run Inst through the visit* methods
+    Add, Sub, Mul, And, Or, Xor,
+    BinOp,                // Any other binary operator, SubOp is its opcode
+    Cmp,                  // SubOp is the predicate
+    Select, Br, CondBr, Ret, Load, Store, GEP, Trunc, ZExt, SExt,
+    Move,                 // A cast that does not change the value
+    Call,
+    NumOpcodes
+  };
+
+  unsigned char Op;       // The DecodedInst::Opcode
+  unsigned char SubOp;
+  unsigned Dest;          // The slot of the result
+  unsigned Ops[3];
+  const Type *Ty;         // The type the operation works on
+  Instruction *Inst;      // The instruction this was decoded from
+};
+
+// DecodedIndex - An index of a decoded getelementptr, which adds Scale times
+// the value of Operand to the pointer, or just Scale if Operand is NoOperand.
+//
+struct DecodedIndex {
+  unsigned Operand;
+  bool Is32Bit;           // Operand is sign extended from 32 bits
+  int64_t Scale;
+};
+
+// DecodedEdge - A control flow edge of a DecodedFunction, with the copies
+// that run the PHI nodes of its destination.
+//
+struct DecodedEdge {
+  BasicBlock *From, *To;
+  unsigned Target;        // The index of the first instruction to run in To
+  unsigned CopyBegin, CopyEnd;
+  bool ParallelCopies;    // A copy reads a PHI node written by another one
+};
+
+// DecodedFunction - A function lowered once into the form the interpreter
+// executes.  Each argument and instruction result has a slot in the register
+// file of a stack frame, and the constants the function uses are evaluated
+// once into a pool.  An operand is a slot number, or a pool index with
+// ConstantBit set.  PHI nodes are not in the instruction array: taking an edge
+// copies their incoming values.
+//
+struct DecodedFunction {
+  enum { ConstantBit = 1U << 31, NoOperand = ~0U };
+
+  std::vector<DecodedInst> Insts;
+  std::vector<DecodedEdge> Edges;
+  std::vector<std::pair<unsigned, unsigned> > Copies;  // (Slot, Operand)
+  std::vector<DecodedIndex> Indices;                    // Of the GEPs
+  std::vector<unsigned> Args;                           // Of the calls
+  std::vector<GenericValue> Constants;
+  unsigned NumSlots;
+
+  // OperandOf - The encoding of every argument, instruction result and
+  // constant that the function uses.
+  DenseMap<const Value*, unsigned> OperandOf;
+
+  // EdgeOf - The index in Edges of each control flow edge.
+  DenseMap<std::pair<const BasicBlock*, const BasicBlock*>, unsigned> EdgeOf;
+
+  unsigned getSlot(const Value *V) const {
+    DenseMap<const Value*, unsigned>::const_iterator I = OperandOf.find(V);
+    assert(I != OperandOf.end() && !(I->second & ConstantBit) &&
+           "Value has no slot!");
+    return I->second;
+  }
+
+  unsigned getEdge(const BasicBlock *From, const BasicBlock *To) const {
+    DenseMap<std::pair<const BasicBlock*, const BasicBlock*>,
+             unsigned>::const_iterator I = EdgeOf.find(std::make_pair(From, To));
+    assert(I != EdgeOf.end() && "Branch to a block that is not a successor!");
+    return I->second;
+  }
+};
+
 // ExecutionContext struct - This struct represents one stack frame currently
 // executing.
 //
 struct ExecutionContext {
   Function             *CurFunction;// The currently executing function
+  const DecodedFunction *Code;      // CurFunction as the interpreter runs it
   BasicBlock           *CurBB;      // The currently executing BB
-  BasicBlock::iterator  CurInst;    // The next instruction to execute
-  std::map<Value *, GenericValue> Values; // LLVM values used in this invocation
+  unsigned              PC;         // The index in Code of the next instruction
+  ValuePlaneTy          Values;     // The register file, indexed by slot
   std::vector<GenericValue>  VarArgs; // Values passed through an ellipsis
   CallSite             Caller;     // Holds the call that called subframes.
                                    // NULL if main func or debugger invoked fn
@@ -93,6 +179,24 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // Tiered execution, see setTierUpEngine.  TierUp is null unless enabled.
+  ExecutionEngine *TierUp;
+  unsigned TierUpThreshold;
+  DenseMap<const Function*, Function*> TierUpCopies;
+
+  // TierUpCounts - The number of calls and loop back-edges executed by each
+  // function called so far, or NeverTierUp for the functions that must stay
+  // in the interpreter.
+  DenseMap<const Function*, unsigned> TierUpCounts;
+  enum { NeverTierUp = ~0U };
+
+  // BackEdges - The loop back-edges of the functions in TierUpCounts.
+  DenseSet<std::pair<const BasicBlock*, const BasicBlock*> > BackEdges;
+
+  // DecodedFunctions - The functions called so far, as the interpreter runs
+  // them.
+  DenseMap<const Function*, DecodedFunction*> DecodedFunctions;
+
 public:
   explicit Interpreter(Module *M);
   ~Interpreter();
@@ -116,15 +220,33 @@ public:
                                    const std::vector<GenericValue> &ArgValues);
 
   /// recompileAndRelinkFunction - For the interpreter, functions are always
-  /// up-to-date.
+  /// up-to-date: the decoded form of F is dropped, and made again from the
+  /// current body of F at its next call.
   ///
   virtual void *recompileAndRelinkFunction(Function *F) {
+    freeMachineCodeForFunction(F);
     return getPointerToFunction(F);
   }
 
-  /// freeMachineCodeForFunction - The interpreter does not generate any code.
+  /// freeMachineCodeForFunction - The interpreter does not generate any code,
+  /// but drops the decoded form of F.
   ///
-  void freeMachineCodeForFunction(Function *F) { }
+  void freeMachineCodeForFunction(Function *F);
+
+  /// setTierUpEngine - Run the functions that get hot in TierUp.  This is
+  /// refused if TierUp lays out data differently, or if the program takes the
+  /// address of a function, since the interpreter represents function
+  /// pointers by the Function itself.
+  virtual bool setTierUpEngine(ExecutionEngine *TierUp,
+                            const DenseMap<const Function*, Function*> &Copies,
+                               unsigned Threshold);
+
+  /// setCodeCacheDirectory - The interpreter does not generate any code, but
+  /// the engine it tiers up to may.
+  virtual void setCodeCacheDirectory(StringRef Dir) {
+    if (TierUp)
+      TierUp->setCodeCacheDirectory(Dir);
+  }
 
   // Methods used to execute code:
   // Place a call on the stack
@@ -180,6 +302,9 @@ public:
 
   GenericValue callExternalFunction(Function *F,
                                     const std::vector<GenericValue> &ArgVals);
+  GenericValue callTierUpFunction(Function *F,
+                                  const std::vector<GenericValue> &ArgVals);
+  static bool canCallTierUpFunction(const Function *F);
   void exitCalled(GenericValue GV);
 
   void addAtExitHandler(Function *F) {
@@ -200,6 +325,23 @@ private:  // Helper functions
   //
   void SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF);
 
+  // isHot - Count a call to F, and return true if F should now run in the
+  // tier up engine.
+  bool isHot(Function *F);
+
+  // getDecodedFunction - Return F as the interpreter runs it, decoding it at
+  // its first call.
+  const DecodedFunction *getDecodedFunction(Function *F);
+  DecodedFunction *decodeFunction(Function *F);
+
+  // lowerIntrinsicCall - Replace CI, which the frame SF is running, by the
+  // code IntrinsicLowering makes for it, and carry the frames that run its
+  // function over to the new decoded form.
+  void lowerIntrinsicCall(CallInst *CI, ExecutionContext &SF);
+
+  // takeEdge - Continue in the destination of an edge of SF.Code.
+  void takeEdge(const DecodedEdge &E, ExecutionContext &SF);
+
   void *getPointerToFunction(Function *F) { return (void*)F; }
   void *getPointerToBasicBlock(BasicBlock *BB) { return (void*)BB; }
 
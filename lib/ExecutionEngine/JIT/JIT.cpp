@@ -18,6 +18,7 @@
 #include "llvm/Function.h"
 #include "llvm/GlobalVariable.h"
 #include "llvm/Instructions.h"
+#include "llvm/Module.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/CodeGen/JITCodeEmitter.h"
 #include "llvm/CodeGen/MachineCodeInfo.h"
@@ -26,11 +27,15 @@
 #include "llvm/Target/TargetData.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetJITInfo.h"
+#include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Config/config.h"
 
 using namespace llvm;
@@ -218,6 +223,32 @@ ExecutionEngine *ExecutionEngine::createJIT(Module *M,
                         MArch, MCPU, MAttrs);
 }
 
+/// getCodeCacheTarget - Describe everything besides the IR that determines
+/// the code the JIT generates, for the keys of the code cache.
+static std::string
+getCodeCacheTarget(const Module &M, TargetMachine &TM,
+                   CodeGenOpt::Level OptLevel, CodeModel::Model CMM,
+                   StringRef MArch, StringRef MCPU,
+                   const SmallVectorImpl<std::string> &MAttrs) {
+  std::string Desc;
+  raw_string_ostream OS(Desc);
+  OS << (M.getTargetTriple().empty() ? sys::getHostTriple()
+                                     : M.getTargetTriple())
+     << ' ' << MArch << ' ' << MCPU << ' ' << sys::getHostCPUName();
+  for (unsigned i = 0, e = MAttrs.size(); i != e; ++i)
+    OS << ' ' << MAttrs[i];
+  OS << ' ' << OptLevel << ' ' << CMM << ' ' << TM.getRelocationModel()
+     << ' ' << TM.getTargetData()->getStringRepresentation();
+
+  // The options that change code generation.
+  OS << ' ' << NoFramePointerElim << NoFramePointerElimNonLeaf
+     << UnsafeFPMath << NoInfsFPMath << NoNaNsFPMath << UseSoftFloat
+     << FloatABIType << GuaranteedTailCallOpt << RealignStack
+     << DisableJumpTables << EnableFastISel << StrongPHIElim
+     << ' ' << StackAlignment;
+  return OS.str();
+}
+
 ExecutionEngine *JIT::createJIT(Module *M,
                                 std::string *ErrorStr,
                                 JITMemoryManager *JMM,
@@ -237,7 +268,10 @@ ExecutionEngine *JIT::createJIT(Module *M,
 
   // If the target supports JIT code generation, create a the JIT.
   if (TargetJITInfo *TJ = TM->getJITInfo()) {
-    return new JIT(M, *TM, *TJ, JMM, OptLevel, GVsWithCode);
+    JIT *TheJIT = new JIT(M, *TM, *TJ, JMM, OptLevel, GVsWithCode);
+    TheJIT->CodeCacheTarget = getCodeCacheTarget(*M, *TM, OptLevel, CMM, MArch,
+                                                 MCPU, MAttrs);
+    return TheJIT;
   } else {
     if (ErrorStr)
       *ErrorStr = "target does not support JIT code generation";
@@ -291,7 +325,8 @@ extern "C" {
 JIT::JIT(Module *M, TargetMachine &tm, TargetJITInfo &tji,
          JITMemoryManager *JMM, CodeGenOpt::Level OptLevel, bool GVsWithCode)
   : ExecutionEngine(M), TM(tm), TJI(tji), AllocateGVsWithCode(GVsWithCode),
-    isAlreadyCodeGenerating(false) {
+    isAlreadyCodeGenerating(false), NextBackgroundOrder(0),
+    BackgroundCompiler(0), BackgroundShutdown(false) {
   setTargetData(TM.getTargetData());
 
   jitstate = new JITState(M);
@@ -338,6 +373,15 @@ JIT::JIT(Module *M, TargetMachine &tm, TargetJITInfo &tji,
 }
 
 JIT::~JIT() {
+  // Stop the background compiler before tearing anything down.  The tasks
+  // still queued see BackgroundShutdown and return without compiling.
+  if (BackgroundCompiler) {
+    {
+      MutexGuard locked(lock);
+      BackgroundShutdown = true;
+    }
+    delete BackgroundCompiler;
+  }
   // Unregister all exception tables registered by this JIT.
   DeregisterAllTables();
   // Cleanup.
@@ -409,7 +453,7 @@ GenericValue JIT::runFunction(Function *F,
                               const std::vector<GenericValue> &ArgValues) {
   assert(F && "Function *F was null at entry to run()");
 
-  void *FPtr = getPointerToFunction(F);
+  void *FPtr = getPointerToCompiledFunction(F);
   assert(FPtr && "Pointer to fn's code was null after getPointerToFunction");
   const FunctionType *FTy = F->getFunctionType();
   const Type *RetTy = FTy->getReturnType();
@@ -554,15 +598,20 @@ GenericValue JIT::runFunction(Function *F,
     Args.push_back(C);
   }
 
-  CallInst *TheCall = CallInst::Create(F, Args.begin(), Args.end(),
-                                       "", StubBB);
-  TheCall->setCallingConv(F->getCallingConv());
-  TheCall->setTailCall();
-  if (!TheCall->getType()->isVoidTy())
-    // Return result of the call.
-    ReturnInst::Create(F->getContext(), TheCall, StubBB);
-  else
-    ReturnInst::Create(F->getContext(), StubBB);           // Just return void.
+  // The stub is erased right after it has run, so its instructions can come
+  // from an arena that is freed along with it.
+  {
+    IRArenaScope StubArena(*Stub);
+    CallInst *TheCall = CallInst::Create(F, Args.begin(), Args.end(),
+                                         "", StubBB);
+    TheCall->setCallingConv(F->getCallingConv());
+    TheCall->setTailCall();
+    if (!TheCall->getType()->isVoidTy())
+      // Return result of the call.
+      ReturnInst::Create(F->getContext(), TheCall, StubBB);
+    else
+      ReturnInst::Create(F->getContext(), StubBB);         // Just return void.
+  }
 
   // Finally, call our nullary stub function.
   GenericValue Result = runFunction(Stub, std::vector<GenericValue>());
@@ -658,18 +707,64 @@ void JIT::runJITOnFunctionUnlocked(Function *F, const MutexGuard &locked) {
 
 void JIT::jitTheFunction(Function *F, const MutexGuard &locked) {
   isAlreadyCodeGenerating = true;
+  if (CodeCache) {
+    // Load the code compiled by an earlier JIT if there is any.  Otherwise
+    // the emitter stores the code under this key once it is generated.
+    std::string Key = CodeCache->getKey(*F);
+    JITCodeCache::Entry Cached;
+    if (!Key.empty() && CodeCache->lookup(Key, Cached) &&
+        loadCachedFunction(F, Cached)) {
+      isAlreadyCodeGenerating = false;
+      return;
+    }
+    CodeCacheKey = Key;
+  }
   jitstate->getPM(locked).run(*F);
+  CodeCacheKey.clear();
   isAlreadyCodeGenerating = false;
 
   // clear basic block addresses after this function is done
   getBasicBlockAddressMap(locked).clear();
 }
 
+void JIT::setCodeCacheDirectory(StringRef Dir) {
+  MutexGuard locked(lock);
+  // Globals allocated along with the code of a function would be cached
+  // with it.
+  if (Dir.empty() || !TJI.isCodeRelocatable() || AllocateGVsWithCode)
+    CodeCache.reset();
+  else
+    CodeCache.reset(new JITCodeCache(Dir, CodeCacheTarget));
+}
+
 /// getPointerToFunction - This method is used to get the address of the
-/// specified function, compiling it if neccesary.
+/// specified function, compiling it if neccesary.  When compiling in the
+/// background, the caller gets a lazy stub right away and the function is
+/// queued for the background compiler.
 ///
 void *JIT::getPointerToFunction(Function *F) {
 
+  if (void *Addr = getPointerToGlobalIfAvailable(F))
+    return Addr;   // Check if function already code gen'd
+
+  if (isCompilingInBackground() && isCompilingLazily() &&
+      !F->isDeclaration() && !F->hasAvailableExternallyLinkage()) {
+    MutexGuard locked(lock);
+    requestBackgroundCompilation(F);
+    // Without a background thread to hand the function to, compile it here.
+    if (BackgroundRequests.count(F))
+      return getPointerToFunctionOrStub(F);
+  }
+
+  return getPointerToCompiledFunction(F);
+}
+
+/// getPointerToCompiledFunction - This method is used to get the address of
+/// the code of the specified function, compiling it on this thread if
+/// neccesary.
+///
+void *JIT::getPointerToCompiledFunction(Function *F) {
+
   if (void *Addr = getPointerToGlobalIfAvailable(F))
     return Addr;   // Check if function already code gen'd
 
@@ -696,11 +791,79 @@ void *JIT::getPointerToFunction(Function *F) {
 
   runJITOnFunctionUnlocked(F, locked);
 
+  // The function no longer needs the background compiler.
+  BackgroundRequests.erase(F);
+
   void *Addr = getPointerToGlobalIfAvailable(F);
   assert(Addr && "Code generation didn't add function to GlobalAddress table!");
   return Addr;
 }
 
+/// requestBackgroundCompilation - Queue F for the background compiler, or
+/// raise its priority if it is already queued.  The thread is started by the
+/// first request; if threads are not available, nothing is queued and the
+/// JIT keeps compiling lazily on the calling thread.
+///
+void JIT::requestBackgroundCompilation(Function *F) {
+  if (!isCompilingInBackground() || !isCompilingLazily() ||
+      F->isDeclaration() || F->hasAvailableExternallyLinkage())
+    return;
+
+  MutexGuard locked(lock);
+  if (BackgroundShutdown || getPointerToGlobalIfAvailable(F))
+    return;
+
+  if (!BackgroundCompiler) {
+    if (!llvm_is_multithreaded())
+      return;
+    BackgroundCompiler = new ThreadPool(1, /*Asynchronous=*/true);
+  }
+  if (!BackgroundCompiler->isParallel())
+    return;
+
+  unsigned &Requests = BackgroundRequests[F];
+  BackgroundRequest R = { ++Requests, NextBackgroundOrder++, F };
+  BackgroundQueue.push(R);
+
+  // Schedule one task per queued function.  Each task compiles whatever
+  // function is the most requested one at the time it runs.
+  if (Requests == 1)
+    BackgroundCompiler->async(BackgroundCompileTask, this);
+}
+
+void JIT::BackgroundCompileTask(void *TheJIT) {
+  static_cast<JIT*>(TheJIT)->compileNextInBackground();
+}
+
+/// compileNextInBackground - Compile the most requested queued function and
+/// point its stub at the code, so that callers stop going through the lazy
+/// resolver.
+///
+void JIT::compileNextInBackground() {
+  MutexGuard locked(lock);
+  if (BackgroundShutdown || !jitstate)
+    return;
+
+  Function *F = 0;
+  while (!F && !BackgroundQueue.empty()) {
+    BackgroundRequest R = BackgroundQueue.top();
+    BackgroundQueue.pop();
+    // Skip the entries superseded by a later request, and the functions that
+    // were compiled or deleted since they were queued.
+    ValueMap<Function*, unsigned, BackgroundQueueConfig>::iterator I =
+      BackgroundRequests.find(R.F);
+    if (I == BackgroundRequests.end() || I->second != R.Requests)
+      continue;
+    BackgroundRequests.erase(I);
+    F = R.F;
+  }
+  if (!F || getPointerToGlobalIfAvailable(F))
+    return;
+
+  void *Addr = getPointerToCompiledFunction(F);
+  retargetFunctionStub(F, Addr);
+}
+
 void JIT::addPointerToBasicBlock(const BasicBlock *BB, void *Addr) {
   MutexGuard locked(lock);
   
@@ -720,7 +883,7 @@ void JIT::clearPointerToBasicBlock(const BasicBlock *BB) {
 
 void *JIT::getPointerToBasicBlock(BasicBlock *BB) {
   // make sure it's function is compiled by JIT
-  (void)getPointerToFunction(BB->getParent());
+  (void)getPointerToCompiledFunction(BB->getParent());
 
   // resolve basic block address
   MutexGuard locked(lock);
@@ -777,7 +940,7 @@ void *JIT::recompileAndRelinkFunction(Function *F) {
   void *OldAddr = getPointerToGlobalIfAvailable(F);
 
   // If it's not already compiled there is no reason to patch it up.
-  if (OldAddr == 0) { return getPointerToFunction(F); }
+  if (OldAddr == 0) { return getPointerToCompiledFunction(F); }
 
   // Delete the old function mapping.
   addGlobalMapping(F, 0);
@@ -788,7 +951,7 @@ void *JIT::recompileAndRelinkFunction(Function *F) {
   // Update state, forward the old function to the new function.
   void *Addr = getPointerToGlobalIfAvailable(F);
   assert(Addr && "Code generation didn't add function to GlobalAddress table!");
-  TJI.replaceMachineCodeForFunction(OldAddr, Addr);
+  relinkFunction(OldAddr, Addr);
   return Addr;
 }
 
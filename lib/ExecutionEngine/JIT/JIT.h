@@ -14,9 +14,12 @@
 #ifndef JIT_H
 #define JIT_H
 
+#include "JITCodeCache.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/PassManager.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/Support/ValueHandle.h"
+#include <queue>
 
 namespace llvm {
 
@@ -26,6 +29,7 @@ class MachineCodeEmitter;
 class MachineCodeInfo;
 class TargetJITInfo;
 class TargetMachine;
+class ThreadPool;
 
 class JITState {
 private:
@@ -76,6 +80,53 @@ class JIT : public ExecutionEngine {
   /// taken.
   BasicBlockAddressMapTy BasicBlockAddressMap;
 
+  /// BackgroundRequest - An entry of the background compilation queue.  A
+  /// function is pushed again every time it is requested, so the queue may
+  /// hold stale entries; only the one whose Requests matches the count in
+  /// BackgroundRequests is live.
+  struct BackgroundRequest {
+    unsigned Requests;
+    unsigned Order;
+    Function *F;
+
+    /// Most requested first, then first come first served.
+    bool operator<(const BackgroundRequest &RHS) const {
+      if (Requests != RHS.Requests)
+        return Requests < RHS.Requests;
+      return Order > RHS.Order;
+    }
+  };
+
+  /// BackgroundQueueConfig - Forget queued functions that are deleted.
+  struct BackgroundQueueConfig : public ValueMapConfig<Function*> {
+    enum { FollowRAUW = false };
+  };
+
+  /// BackgroundRequests - The functions waiting for the background compiler,
+  /// with the number of times their stub was requested.  Guarded by lock.
+  ValueMap<Function*, unsigned, BackgroundQueueConfig> BackgroundRequests;
+  std::priority_queue<BackgroundRequest> BackgroundQueue;
+  unsigned NextBackgroundOrder;
+
+  /// BackgroundCompiler - The thread compiling queued functions, started by
+  /// the first request.
+  ThreadPool *BackgroundCompiler;
+
+  /// BackgroundShutdown - Set by the destructor to discard the queue.
+  bool BackgroundShutdown;
+
+  /// CodeCache - The machine code of functions compiled by earlier JITs, if
+  /// setCodeCacheDirectory turned it on.
+  OwningPtr<JITCodeCache> CodeCache;
+
+  /// CodeCacheTarget - The target and code generation options, which are part
+  /// of every key of CodeCache.
+  std::string CodeCacheTarget;
+
+  /// CodeCacheKey - The key under which the function being compiled is to be
+  /// stored in CodeCache, or empty.  Guarded by lock.
+  std::string CodeCacheKey;
+
 
   JIT(Module *M, TargetMachine &tm, TargetJITInfo &tji,
       JITMemoryManager *JMM, CodeGenOpt::Level OptLevel,
@@ -133,10 +184,24 @@ public:
   static void CompilationCallback();
 
   /// getPointerToFunction - This returns the address of the specified function,
-  /// compiling it if necessary.
+  /// compiling it if necessary.  With background compilation, this returns a
+  /// lazy stub and queues the function instead.
   ///
   void *getPointerToFunction(Function *F);
 
+  /// getPointerToCompiledFunction - This returns the address of the code of
+  /// the specified function, compiling it on the calling thread if necessary.
+  /// Unlike getPointerToFunction, it never returns a stub for a function
+  /// defined in the module.
+  ///
+  void *getPointerToCompiledFunction(Function *F);
+
+  /// requestBackgroundCompilation - Note that the stub of F was handed out,
+  /// and queue F for the background compiler if background compilation is
+  /// on and F has not been compiled yet.
+  ///
+  void requestBackgroundCompilation(Function *F);
+
   /// addPointerToBasicBlock - Adds address of the specific basic block.
   void addPointerToBasicBlock(const BasicBlock *BB, void *Addr);
 
@@ -199,6 +264,19 @@ public:
                                     StringRef MCPU,
                                     const SmallVectorImpl<std::string>& MAttrs);
 
+  /// setCodeCacheDirectory - Turn on the code cache if the target can
+  /// relocate its code and globals are not allocated with the code.
+  virtual void setCodeCacheDirectory(StringRef Dir);
+
+  /// getCodeCache - Return the code cache, or null if it is off.
+  JITCodeCache *getCodeCache() const { return CodeCache.get(); }
+
+  /// getCodeCacheKey - Return the key under which the code of the function
+  /// being compiled should be stored, or an empty string.
+  const std::string &getCodeCacheKey(const MutexGuard &) const {
+    return CodeCacheKey;
+  }
+
   // Run the JIT on F and return information about the generated code
   void runJITOnFunction(Function *F, MachineCodeInfo *MCI = 0);
 
@@ -223,7 +301,12 @@ private:
                                        TargetMachine &tm);
   void runJITOnFunctionUnlocked(Function *F, const MutexGuard &locked);
   void updateFunctionStub(Function *F);
+  void retargetFunctionStub(Function *F, void *Addr);
+  void relinkFunction(void *OldAddr, void *Addr);
   void jitTheFunction(Function *F, const MutexGuard &locked);
+  bool loadCachedFunction(Function *F, const JITCodeCache::Entry &Cached);
+  static void BackgroundCompileTask(void *TheJIT);
+  void compileNextInBackground();
 
 protected:
 
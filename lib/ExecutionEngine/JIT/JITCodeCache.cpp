@@ -0,0 +1,253 @@
+//===-- JITCodeCache.cpp - On-disk cache of JIT compiled code -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the JITCodeCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "JITCodeCache.h"
+#include "llvm/Attributes.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/GlobalAlias.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/TypeSymbolTable.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+/// The first bytes of every entry.  The version changes with the layout.
+static const char EntryMagic[] = "LLVMJITC";
+static const uint64_t EntryVersion = 1;
+
+/// isCacheable - Return true if the code of F depends on nothing but what
+/// getKey hashes and the addresses the relocations refer to.  Calls to
+/// constant addresses are encoded relative to the call site without a
+/// relocation, and block addresses are resolved while the code is emitted.
+static bool isCacheable(const Function &F) {
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end();
+         I != IE; ++I) {
+      ImmutableCallSite CS(I);
+      if (CS) {
+        const Value *Callee = CS.getCalledValue()->stripPointerCasts();
+        if (isa<Constant>(Callee) && !isa<GlobalValue>(Callee))
+          return false;
+      }
+      for (User::const_op_iterator OI = I->op_begin(), OE = I->op_end();
+           OI != OE; ++OI)
+        if (isa<BlockAddress>(*OI))
+          return false;
+    }
+  return true;
+}
+
+/// addDeclaration - Add to Key what code generation may use of GV when it
+/// compiles a reference to it.
+static void addDeclaration(CompilationCache::KeyBuilder &Key,
+                           const GlobalValue &GV) {
+  std::string Str;
+  raw_string_ostream OS(Str);
+  if (const Function *F = dyn_cast<Function>(&GV)) {
+    // The body of a callee does not matter, only how it is called.
+    OS << F->getName() << ' ' << F->getType()->getDescription() << ' '
+       << F->getLinkage() << ' ' << F->getVisibility() << ' '
+       << F->getCallingConv() << ' ' << F->isDeclaration() << ' '
+       << F->hasAvailableExternallyLinkage() << ' '
+       << Attribute::getAsString(F->getAttributes().getFnAttributes());
+  } else {
+    GV.print(OS);
+  }
+  Key.add(OS.str());
+}
+
+std::string JITCodeCache::getKey(const Function &F) const {
+  if (!isCacheable(F))
+    return "";
+
+  CompilationCache::KeyBuilder Key;
+  Key.add("jit-function").add(PACKAGE_VERSION).add(TargetDescription);
+
+  // The function only names the types of its module, so add their layouts.
+  const TypeSymbolTable &TST = F.getParent()->getTypeSymbolTable();
+  Key.add(uint64_t(TST.size()));
+  for (TypeSymbolTable::const_iterator I = TST.begin(), E = TST.end();
+       I != E; ++I)
+    Key.add(I->first).add(I->second->getDescription());
+
+  std::string Body;
+  raw_string_ostream OS(Body);
+  F.print(OS);
+  Key.add(OS.str());
+
+  // Add the globals the function refers to, in the order they are reached.
+  SmallVector<const User*, 16> Worklist;
+  SmallPtrSet<const User*, 32> Visited;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end();
+         I != IE; ++I)
+      Worklist.push_back(I);
+  std::reverse(Worklist.begin(), Worklist.end());
+  while (!Worklist.empty()) {
+    const User *U = Worklist.pop_back_val();
+    for (unsigned i = U->getNumOperands(); i != 0; --i) {
+      const Value *Op = U->getOperand(i - 1);
+      if (const GlobalValue *GV = dyn_cast<GlobalValue>(Op)) {
+        if (GV != &F && Visited.insert(GV))
+          addDeclaration(Key, *GV);
+      } else if (const Constant *C = dyn_cast<Constant>(Op)) {
+        if (Visited.insert(C))
+          Worklist.push_back(C);
+      }
+    }
+  }
+  return Key.getKey();
+}
+
+namespace {
+  /// EntryWriter - Serializes an entry as a sequence of little endian 64-bit
+  /// words and length prefixed strings.
+  class EntryWriter {
+    std::string &Out;
+  public:
+    explicit EntryWriter(std::string &Out) : Out(Out) {}
+
+    void write(uint64_t Value) {
+      for (unsigned i = 0; i != 8; ++i)
+        Out += char(Value >> (8 * i));
+    }
+    void write(StringRef Str) {
+      write(uint64_t(Str.size()));
+      Out.append(Str.begin(), Str.end());
+    }
+  };
+
+  /// EntryReader - Reads what EntryWriter wrote.  Reading past the end makes
+  /// the reader fail and return zeros from then on.
+  class EntryReader {
+    const char *Cur, *End;
+    bool Failed;
+  public:
+    explicit EntryReader(StringRef Buffer)
+      : Cur(Buffer.begin()), End(Buffer.end()), Failed(false) {}
+
+    bool hasFailed() const { return Failed; }
+    bool atEnd() const { return Cur == End; }
+
+    uint64_t readWord() {
+      if (End - Cur < 8) {
+        Failed = true;
+        Cur = End;
+        return 0;
+      }
+      uint64_t Value = 0;
+      for (unsigned i = 0; i != 8; ++i)
+        Value |= uint64_t((unsigned char)Cur[i]) << (8 * i);
+      Cur += 8;
+      return Value;
+    }
+    StringRef readString() {
+      uint64_t Size = readWord();
+      if (uint64_t(End - Cur) < Size) {
+        Failed = true;
+        Cur = End;
+        return StringRef();
+      }
+      StringRef Str(Cur, Size);
+      Cur += Size;
+      return Str;
+    }
+  };
+}
+
+bool JITCodeCache::lookup(StringRef Key, Entry &Result) {
+  OwningPtr<MemoryBuffer> Buffer;
+  if (!Cache.lookup(Key, Buffer))
+    return false;
+
+  EntryReader R(Buffer->getBuffer());
+  if (R.readString() != EntryMagic || R.readWord() != EntryVersion)
+    return false;
+
+  Result.Image = R.readString();
+  Result.Bias = R.readWord();
+  Result.CodeOffset = R.readWord();
+  Result.CodeSize = R.readWord();
+  uint64_t Size = Result.Image.size();
+  if (R.hasFailed() || Result.Bias >= ImageAlignment ||
+      Result.CodeOffset > Size || Result.CodeSize > Size - Result.CodeOffset)
+    return false;
+
+  // Every field that is patched must lie in the image.
+  uint64_t NumSlots = R.readWord();
+  Result.AbsoluteSlots.clear();
+  for (uint64_t i = 0; i != NumSlots && !R.hasFailed(); ++i) {
+    uint64_t Offset = R.readWord();
+    if (Offset > Size || Size - Offset < sizeof(void*))
+      return false;
+    Result.AbsoluteSlots.push_back(Offset);
+  }
+
+  uint64_t NumRelocations = R.readWord();
+  Result.Relocations.clear();
+  for (uint64_t i = 0; i != NumRelocations && !R.hasFailed(); ++i) {
+    Relocation Rel;
+    Rel.Offset = R.readWord();
+    Rel.Type = unsigned(R.readWord());
+    Rel.ConstantVal = int64_t(R.readWord());
+    uint64_t Kind = R.readWord();
+    Rel.MayNeedFarStub = R.readWord() != 0;
+    Rel.Symbol = R.readString();
+    Rel.ImageOffset = R.readWord();
+    if (Rel.Offset >= Size || Kind > Relocation::Image ||
+        (Kind == Relocation::Image && Rel.ImageOffset > Size))
+      return false;
+    Rel.Kind = Relocation::TargetKind(Kind);
+    Result.Relocations.push_back(Rel);
+  }
+  return !R.hasFailed() && R.atEnd();
+}
+
+void JITCodeCache::store(StringRef Key, const Entry &E) {
+  std::string Data;
+  EntryWriter W(Data);
+  W.write(StringRef(EntryMagic));
+  W.write(EntryVersion);
+  W.write(E.Image);
+  W.write(E.Bias);
+  W.write(E.CodeOffset);
+  W.write(E.CodeSize);
+
+  W.write(uint64_t(E.AbsoluteSlots.size()));
+  for (unsigned i = 0, e = E.AbsoluteSlots.size(); i != e; ++i)
+    W.write(E.AbsoluteSlots[i]);
+
+  W.write(uint64_t(E.Relocations.size()));
+  for (unsigned i = 0, e = E.Relocations.size(); i != e; ++i) {
+    const Relocation &Rel = E.Relocations[i];
+    W.write(Rel.Offset);
+    W.write(uint64_t(Rel.Type));
+    W.write(uint64_t(Rel.ConstantVal));
+    W.write(uint64_t(Rel.Kind));
+    W.write(uint64_t(Rel.MayNeedFarStub));
+    W.write(Rel.Symbol);
+    W.write(Rel.ImageOffset);
+  }
+
+  std::string ErrMsg;
+  Cache.store(Key, Data, ErrMsg);
+}
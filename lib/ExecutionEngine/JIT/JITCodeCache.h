@@ -0,0 +1,92 @@
+//===-- JITCodeCache.h - On-disk cache of JIT compiled code -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the JITCodeCache class, which keeps the machine code of
+// JIT compiled functions on disk so that a later JIT, in the same process or
+// in another one, can load it instead of compiling the function again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef JITCODECACHE_H
+#define JITCODECACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CompilationCache.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class Function;
+
+/// JITCodeCache - A CompilationCache of relocatable function images.  The key
+/// of a function covers its IR, the declarations of the globals it refers
+/// to, the named types of its module and a description of the target, so an
+/// entry is only reused where code generation would produce the same bytes.
+class JITCodeCache {
+public:
+  /// Relocation - A relocation of a cached function.  Its target is described
+  /// by name or by offset in the image, not by address, so that it can be
+  /// resolved again in another process.
+  struct Relocation {
+    enum TargetKind { ExternalSymbol, GlobalValue, IndirectSymbol, Image };
+
+    uint64_t Offset;        // Offset of the relocated field in the image.
+    unsigned Type;          // Target specific relocation type.
+    int64_t ConstantVal;
+    TargetKind Kind;
+    bool MayNeedFarStub;
+    std::string Symbol;     // The symbol or global value, by name.
+    uint64_t ImageOffset;   // The target of an Image relocation.
+  };
+
+  /// Entry - The memory block of a compiled function, before relocation.
+  struct Entry {
+    /// Image - The constant pool, jump tables and code of the function.
+    std::string Image;
+
+    /// Bias - The address of the image modulo ImageAlignment.  The image is
+    /// loaded at an address with the same bias, which keeps its contents
+    /// aligned.
+    uint64_t Bias;
+
+    uint64_t CodeOffset, CodeSize;
+
+    /// AbsoluteSlots - The offsets of the pointer sized fields that hold an
+    /// offset in the image, and must be rebased to the address of the image.
+    std::vector<uint64_t> AbsoluteSlots;
+
+    std::vector<Relocation> Relocations;
+  };
+
+  enum { ImageAlignment = 64 };
+
+  JITCodeCache(StringRef Directory, StringRef TargetDescription)
+    : Cache(Directory), TargetDescription(TargetDescription) {}
+
+  /// getKey - Return the key under which the code of F is cached.
+  std::string getKey(const Function &F) const;
+
+  /// lookup - Load the entry for Key into Result, returning false if there is
+  /// no such entry or it cannot be read.
+  bool lookup(StringRef Key, Entry &Result);
+
+  /// store - Save E as the entry for Key.  Failures are ignored, since the
+  /// function is compiled anyway.
+  void store(StringRef Key, const Entry &E);
+
+private:
+  CompilationCache Cache;
+  std::string TargetDescription;
+};
+
+} // End llvm namespace
+
+#endif
@@ -58,6 +58,7 @@ using namespace llvm;
 STATISTIC(NumBytes, "Number of bytes of machine code compiled");
 STATISTIC(NumRelos, "Number of relocations applied");
 STATISTIC(NumRetries, "Number of retries with more memory");
+STATISTIC(NumCacheLoads, "Number of functions loaded from the code cache");
 
 
 // A declaration may stop being a declaration once it's fully read from bitcode.
@@ -358,13 +359,19 @@ namespace {
 
     DebugLoc PrevDL;
 
+    /// UsedAbsoluteAddresses - Set when the target asks for the address of a
+    /// block, constant or jump table while emitting the current function,
+    /// whose code then depends on its address in ways the relocations do not
+    /// describe.
+    mutable bool UsedAbsoluteAddresses;
+
     /// Instance of the JIT
     JIT *TheJIT;
 
   public:
     JITEmitter(JIT &jit, JITMemoryManager *JMM, TargetMachine &TM)
       : SizeEstimate(0), Resolver(jit, *this), MMI(0), CurFn(0),
-        EmittedFunctions(this), TheJIT(&jit) {
+        EmittedFunctions(this), UsedAbsoluteAddresses(false), TheJIT(&jit) {
       MemMgr = JMM ? JMM : JITMemoryManager::CreateDefaultMemManager();
       if (jit.getJITInfo().needsGOT()) {
         MemMgr->AllocateGOT();
@@ -388,10 +395,16 @@ namespace {
     static inline bool classof(const MachineCodeEmitter*) { return true; }
 
     JITResolver &getJITResolver() { return Resolver; }
+    JITMemoryManager *getMemMgr() const { return MemMgr; }
 
     virtual void startFunction(MachineFunction &F);
     virtual bool finishFunction(MachineFunction &F);
 
+    /// loadCachedFunction - Load the code of F from an entry of the code
+    /// cache, as if it had just been emitted.  Returns false, having changed
+    /// nothing, if the entry cannot be used.
+    bool loadCachedFunction(Function *F, const JITCodeCache::Entry &Cached);
+
     void emitConstantPool(MachineConstantPool *MCP);
     void initJumpTableInfo(MachineJumpTableInfo *MJTI);
     void emitJumpTableInfo(MachineJumpTableInfo *MJTI);
@@ -434,6 +447,7 @@ namespace {
     virtual uintptr_t getMachineBasicBlockAddress(MachineBasicBlock *MBB) const{
       assert(MBBLocations.size() > (unsigned)MBB->getNumber() &&
              MBBLocations[MBB->getNumber()] && "MBB not emitted!");
+      UsedAbsoluteAddresses = true;
       return MBBLocations[MBB->getNumber()];
     }
 
@@ -470,6 +484,12 @@ namespace {
     void *getPointerToGlobal(GlobalValue *GV, void *Reference,
                              bool MayNeedFarStub);
     void *getPointerToGVIndirectSym(GlobalValue *V, void *Reference);
+
+    bool canCacheFunction(MachineFunction &F);
+    void startCacheEntry(MachineFunction &F, uint8_t *FnStart, uint8_t *FnEnd,
+                         JITCodeCache::Entry &Cached);
+    bool addCachedRelocation(const MachineRelocation &MR, void *ResultPtr,
+                             uint8_t *FnEnd, JITCodeCache::Entry &Cached);
   };
 }
 
@@ -667,7 +687,7 @@ void *JITResolver::JITCompilerFn(void *Stub) {
           << "' In stub ptr = " << Stub << " actual ptr = "
           << ActualPtr << "\n");
 
-    Result = JR->TheJIT->getPointerToFunction(F);
+    Result = JR->TheJIT->getPointerToCompiledFunction(F);
   }
 
   // Reacquire the lock to update the GOT map.
@@ -711,7 +731,9 @@ void *JITEmitter::getPointerToGlobal(GlobalValue *V, void *Reference,
     // Return the function stub if it's already created.  We do this first so
     // that we're returning the same address for the function as any previous
     // call.  TODO: Yes, this is wrong. The lazy stub isn't guaranteed to be
-    // close enough to call.
+    // close enough to call.  Every reference to a function that is not
+    // compiled yet raises its priority for the background compiler.
+    TheJIT->requestBackgroundCompilation(F);
     return FnStub;
   }
 
@@ -731,7 +753,9 @@ void *JITEmitter::getPointerToGlobal(GlobalValue *V, void *Reference,
   // Otherwise, we may need a to emit a stub, and, conservatively, we always do
   // so.  Note that it's possible to return null from getLazyFunctionStub in the
   // case of a weak extern that fails to resolve.
-  return Resolver.getLazyFunctionStub(F);
+  void *Stub = Resolver.getLazyFunctionStub(F);
+  TheJIT->requestBackgroundCompilation(F);
+  return Stub;
 }
 
 void *JITEmitter::getPointerToGVIndirectSym(GlobalValue *V, void *Reference) {
@@ -805,6 +829,7 @@ void JITEmitter::startFunction(MachineFunction &F) {
   EmittedFunctions[F.getFunction()].Code = CurBufferPtr;
 
   MBBLocations.clear();
+  UsedAbsoluteAddresses = false;
 
   EmissionDetails.MF = &F;
   EmissionDetails.LineStarts.clear();
@@ -819,6 +844,10 @@ bool JITEmitter::finishFunction(MachineFunction &F) {
     return true;
   }
 
+  // Whether the code can be cached must be decided before the jump tables
+  // ask for the addresses of the blocks.
+  bool Cacheable = canCacheFunction(F);
+
   if (MachineJumpTableInfo *MJTI = F.getJumpTableInfo())
     emitJumpTableInfo(MJTI);
 
@@ -830,6 +859,11 @@ bool JITEmitter::finishFunction(MachineFunction &F) {
   // FnEnd is the end of the function's machine code.
   uint8_t *FnEnd = CurBufferPtr;
 
+  // Copy the code for the code cache before it is relocated.
+  JITCodeCache::Entry Cached;
+  if (Cacheable)
+    startCacheEntry(F, FnStart, FnEnd, Cached);
+
   if (!Relocations.empty()) {
     CurFn = F.getFunction();
     NumRelos += Relocations.size();
@@ -865,6 +899,8 @@ bool JITEmitter::finishFunction(MachineFunction &F) {
           ResultPtr=(void*)getJumpTableEntryAddress(MR.getJumpTableIndex());
         }
 
+        if (Cacheable)
+          Cacheable = addCachedRelocation(MR, ResultPtr, FnEnd, Cached);
         MR.setResultPointer(ResultPtr);
       }
 
@@ -914,6 +950,11 @@ bool JITEmitter::finishFunction(MachineFunction &F) {
   BufferBegin = CurBufferPtr = 0;
   NumBytes += FnEnd-FnStart;
 
+  if (Cacheable) {
+    MutexGuard locked(TheJIT->lock);
+    TheJIT->getCodeCache()->store(TheJIT->getCodeCacheKey(locked), Cached);
+  }
+
   // Invalidate the icache if necessary.
   sys::Memory::InvalidateInstructionCache(FnStart, FnEnd-FnStart);
 
@@ -1004,6 +1045,236 @@ bool JITEmitter::finishFunction(MachineFunction &F) {
   return false;
 }
 
+/// containsGlobal - Return true if the value of C depends on the address of a
+/// global.
+static bool containsGlobal(const Constant *C) {
+  if (isa<GlobalValue>(C) || isa<BlockAddress>(C))
+    return true;
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    if (containsGlobal(cast<Constant>(C->getOperand(i))))
+      return true;
+  return false;
+}
+
+/// canCacheFunction - Return true if the code of F, which has just been
+/// emitted, can be stored in the code cache.  This is the case if the target
+/// can relocate it, and if the constant pool, jump tables and relocations are
+/// all laid out in a way that the cache can describe.
+bool JITEmitter::canCacheFunction(MachineFunction &F) {
+  if (!TheJIT->getCodeCache() || UsedAbsoluteAddresses ||
+      JITExceptionHandling || JITEmitDebugInfo || MemMgr->isManagingGOT())
+    return false;
+  {
+    MutexGuard locked(TheJIT->lock);
+    if (TheJIT->getCodeCacheKey(locked).empty())
+      return false;
+  }
+
+  TargetJITInfo &TJI = TheJIT->getJITInfo();
+  if (TJI.hasCustomConstantPool() || TJI.hasCustomJumpTables())
+    return false;
+
+  // A block whose address is taken must be known to the JIT, which only
+  // records it while the block is emitted.
+  for (MachineFunction::iterator MBB = F.begin(), E = F.end(); MBB != E; ++MBB)
+    if (MBB->hasAddressTaken())
+      return false;
+
+  // The image is placed at the same address modulo ImageAlignment, which
+  // keeps its contents aligned up to that.
+  MachineConstantPool *MCP = F.getConstantPool();
+  if (MCP->getConstantPoolAlignment() > JITCodeCache::ImageAlignment ||
+      F.getFunction()->getAlignment() > JITCodeCache::ImageAlignment)
+    return false;
+
+  // The constants are copied as they are, so they must not hold addresses.
+  const std::vector<MachineConstantPoolEntry> &Constants = MCP->getConstants();
+  for (unsigned i = 0, e = Constants.size(); i != e; ++i)
+    if (Constants[i].isMachineConstantPoolEntry() ||
+        containsGlobal(Constants[i].Val.ConstVal))
+      return false;
+
+  if (MachineJumpTableInfo *MJTI = F.getJumpTableInfo())
+    switch (MJTI->getEntryKind()) {
+    case MachineJumpTableInfo::EK_Inline:
+    case MachineJumpTableInfo::EK_BlockAddress:
+    case MachineJumpTableInfo::EK_LabelDifference32:
+      break;
+    default:
+      return false;
+    }
+
+  // The targets resolved by TargetJITInfo::relocate are not described.
+  for (unsigned i = 0, e = Relocations.size(); i != e; ++i)
+    if (Relocations[i].letTargetResolve())
+      return false;
+  return true;
+}
+
+/// startCacheEntry - Copy the code of F, and its constant pool and jump
+/// tables, into the code cache entry Cached.  Jump tables of block addresses
+/// are stored as offsets in the image, to be rebased when it is loaded.
+void JITEmitter::startCacheEntry(MachineFunction &F, uint8_t *FnStart,
+                                 uint8_t *FnEnd, JITCodeCache::Entry &Cached) {
+  Cached.Image.assign((char*)BufferBegin, (char*)FnEnd);
+  Cached.Bias = (uintptr_t)BufferBegin % JITCodeCache::ImageAlignment;
+  Cached.CodeOffset = FnStart - BufferBegin;
+  Cached.CodeSize = FnEnd - FnStart;
+
+  MachineJumpTableInfo *MJTI = F.getJumpTableInfo();
+  if (!MJTI || MJTI->getEntryKind() != MachineJumpTableInfo::EK_BlockAddress ||
+      MJTI->getJumpTables().empty() || JumpTableBase == 0)
+    return;
+
+  const std::vector<MachineJumpTableEntry> &JT = MJTI->getJumpTables();
+  uintptr_t SlotOffset = (uint8_t*)JumpTableBase - BufferBegin;
+  for (unsigned i = 0, e = JT.size(); i != e; ++i)
+    for (unsigned mi = 0, me = JT[i].MBBs.size(); mi != me; ++mi) {
+      uintptr_t Slot;
+      memcpy(&Slot, &Cached.Image[SlotOffset], sizeof(Slot));
+      Slot -= (uintptr_t)BufferBegin;
+      memcpy(&Cached.Image[SlotOffset], &Slot, sizeof(Slot));
+      Cached.AbsoluteSlots.push_back(SlotOffset);
+      SlotOffset += sizeof(Slot);
+    }
+}
+
+/// addCachedRelocation - Describe the relocation MR, which is about to be
+/// resolved to ResultPtr, in the code cache entry Cached.  Returns false if it
+/// cannot be described.
+bool JITEmitter::addCachedRelocation(const MachineRelocation &MR,
+                                     void *ResultPtr, uint8_t *FnEnd,
+                                     JITCodeCache::Entry &Cached) {
+  JITCodeCache::Relocation Rel;
+  Rel.Offset = MR.getMachineCodeOffset();
+  Rel.Type = MR.getRelocationType();
+  Rel.ConstantVal = MR.getConstantVal();
+  Rel.MayNeedFarStub = MR.mayNeedFarStub();
+  Rel.ImageOffset = 0;
+  if (MR.isExternalSymbol()) {
+    Rel.Kind = JITCodeCache::Relocation::ExternalSymbol;
+    Rel.Symbol = MR.getExternalSymbol();
+  } else if (MR.isGlobalValue() || MR.isIndirectSymbol()) {
+    // Globals are found again by name.
+    if (!MR.getGlobalValue()->hasName())
+      return false;
+    Rel.Kind = MR.isGlobalValue() ? JITCodeCache::Relocation::GlobalValue
+                                  : JITCodeCache::Relocation::IndirectSymbol;
+    Rel.Symbol = MR.getGlobalValue()->getName();
+  } else {
+    // Blocks, constants and jump tables are in the image.
+    uint8_t *Target = (uint8_t*)ResultPtr;
+    if (Target < BufferBegin || Target > FnEnd)
+      return false;
+    Rel.Kind = JITCodeCache::Relocation::Image;
+    Rel.ImageOffset = Target - BufferBegin;
+  }
+  Cached.Relocations.push_back(Rel);
+  return true;
+}
+
+bool JITEmitter::loadCachedFunction(Function *F,
+                                    const JITCodeCache::Entry &Cached) {
+  if (JITExceptionHandling || JITEmitDebugInfo || MemMgr->isManagingGOT())
+    return false;
+
+  // Resolve the relocations first, so that nothing is allocated for an entry
+  // that refers to a global that does not exist anymore.
+  Module *M = F->getParent();
+  const std::vector<JITCodeCache::Relocation> &Relocs = Cached.Relocations;
+  SmallVector<GlobalValue*, 16> Globals;
+  for (unsigned i = 0, e = Relocs.size(); i != e; ++i) {
+    GlobalValue *GV = 0;
+    if (Relocs[i].Kind == JITCodeCache::Relocation::GlobalValue ||
+        Relocs[i].Kind == JITCodeCache::Relocation::IndirectSymbol) {
+      GV = M->getNamedValue(Relocs[i].Symbol);
+      if (!GV)
+        return false;
+    }
+    if (Relocs[i].Type & ~63U)
+      return false;
+    Globals.push_back(GV);
+  }
+
+  std::vector<MachineRelocation> MRs;
+  for (unsigned i = 0, e = Relocs.size(); i != e; ++i) {
+    const JITCodeCache::Relocation &Rel = Relocs[i];
+    void *ResultPtr = 0;
+    switch (Rel.Kind) {
+    case JITCodeCache::Relocation::ExternalSymbol:
+      ResultPtr = TheJIT->getPointerToNamedFunction(Rel.Symbol, false);
+      if (Rel.MayNeedFarStub)
+        ResultPtr = Resolver.getExternalFunctionStub(ResultPtr);
+      break;
+    case JITCodeCache::Relocation::GlobalValue:
+      ResultPtr = getPointerToGlobal(Globals[i], 0, Rel.MayNeedFarStub);
+      break;
+    case JITCodeCache::Relocation::IndirectSymbol:
+      ResultPtr = getPointerToGVIndirectSym(Globals[i], 0);
+      break;
+    case JITCodeCache::Relocation::Image:
+      break;
+    }
+    // The kind of target does not matter to TargetJITInfo::relocate.
+    MRs.push_back(MachineRelocation::getBB(Rel.Offset, Rel.Type, 0,
+                                           Rel.ConstantVal));
+    MRs.back().setResultPointer(ResultPtr);
+  }
+
+  // Place the image at the same address modulo ImageAlignment as the one it
+  // was emitted at.
+  MemMgr->setMemoryWritable();
+  uintptr_t Size = Cached.Image.size();
+  uintptr_t ActualSize = Size + JITCodeCache::ImageAlignment;
+  uint8_t *Block = MemMgr->startFunctionBody(F, ActualSize);
+  uint8_t *Base = Block + ((Cached.Bias - (uintptr_t)Block) &
+                           (JITCodeCache::ImageAlignment - 1));
+  if (ActualSize < Size + JITCodeCache::ImageAlignment) {
+    MemMgr->endFunctionBody(F, Block, Block);
+    MemMgr->deallocateFunctionBody(Block);
+    MemMgr->setMemoryExecutable();
+    return false;
+  }
+  memcpy(Base, Cached.Image.data(), Size);
+
+  for (unsigned i = 0, e = Cached.AbsoluteSlots.size(); i != e; ++i) {
+    uintptr_t Slot;
+    memcpy(&Slot, Base + Cached.AbsoluteSlots[i], sizeof(Slot));
+    Slot += (uintptr_t)Base;
+    memcpy(Base + Cached.AbsoluteSlots[i], &Slot, sizeof(Slot));
+  }
+
+  for (unsigned i = 0, e = Relocs.size(); i != e; ++i)
+    if (Relocs[i].Kind == JITCodeCache::Relocation::Image)
+      MRs[i].setResultPointer(Base + Relocs[i].ImageOffset);
+  NumRelos += MRs.size();
+  if (!MRs.empty())
+    TheJIT->getJITInfo().relocate(Base, &MRs[0], MRs.size(),
+                                  MemMgr->getGOTBase());
+
+  uint8_t *FnStart = Base + Cached.CodeOffset;
+  uint8_t *FnEnd = FnStart + Cached.CodeSize;
+  EmittedFunctions[F].FunctionBody = Block;
+  EmittedFunctions[F].Code = FnStart;
+  TheJIT->updateGlobalMapping(F, FnStart);
+  MemMgr->endFunctionBody(F, Block, FnEnd);
+  ++NumCacheLoads;
+
+  sys::Memory::InvalidateInstructionCache(FnStart, FnEnd-FnStart);
+
+  // There is no machine function for code that was not generated here.
+  JITEvent_EmittedFunctionDetails Details;
+  Details.MF = 0;
+  TheJIT->NotifyFunctionEmitted(*F, FnStart, FnEnd-FnStart, Details);
+
+  DEBUG(dbgs() << "JIT: Loaded [" << (void*)FnStart << "] Function: "
+        << F->getName() << ": " << (FnEnd-FnStart) << " bytes of text, "
+        << MRs.size() << " relocations from the code cache\n");
+
+  MemMgr->setMemoryExecutable();
+  return true;
+}
+
 void JITEmitter::retryWithMoreMemory(MachineFunction &F) {
   DEBUG(dbgs() << "JIT: Ran out of space for native code.  Reattempting.\n");
   Relocations.clear();  // Clear the old relocations or we'll reapply them.
@@ -1220,6 +1491,7 @@ void *JITEmitter::allocIndirectGV(const GlobalValue *GV,
 uintptr_t JITEmitter::getConstantPoolEntryAddress(unsigned ConstantNum) const {
   assert(ConstantNum < ConstantPool->getConstants().size() &&
          "Invalid ConstantPoolIndex!");
+  UsedAbsoluteAddresses = true;
   return ConstPoolAddresses[ConstantNum];
 }
 
@@ -1229,6 +1501,7 @@ uintptr_t JITEmitter::getConstantPoolEntryAddress(unsigned ConstantNum) const {
 uintptr_t JITEmitter::getJumpTableEntryAddress(unsigned Index) const {
   const std::vector<MachineJumpTableEntry> &JT = JumpTable->getJumpTables();
   assert(Index < JT.size() && "Invalid jump table index!");
+  UsedAbsoluteAddresses = true;
 
   unsigned EntrySize = JumpTable->getEntrySize(*TheJIT->getTargetData());
 
@@ -1276,6 +1549,11 @@ void *JIT::getPointerToFunctionOrStub(Function *F) {
   return JE->getJITResolver().getLazyFunctionStub(F);
 }
 
+bool JIT::loadCachedFunction(Function *F, const JITCodeCache::Entry &Cached) {
+  assert(isa<JITEmitter>(JCE) && "Unexpected MCE?");
+  return cast<JITEmitter>(JCE)->loadCachedFunction(F, Cached);
+}
+
 void JIT::updateFunctionStub(Function *F) {
   // Get the empty stub we generated earlier.
   assert(isa<JITEmitter>(JCE) && "Unexpected MCE?");
@@ -1292,6 +1570,29 @@ void JIT::updateFunctionStub(Function *F) {
   JE->finishGVStub();
 }
 
+/// retargetFunctionStub - Point the lazy stub handed out for F, if any, at the
+/// code at Addr, if the target can do so while other threads may be running
+/// the stub.  Otherwise the stub keeps calling the lazy resolver, which finds
+/// the code already there.
+void JIT::retargetFunctionStub(Function *F, void *Addr) {
+  assert(isa<JITEmitter>(JCE) && "Unexpected MCE?");
+  JITEmitter *JE = cast<JITEmitter>(getCodeEmitter());
+  if (void *Stub = JE->getJITResolver().getLazyFunctionStubIfAvailable(F))
+    getJITInfo().retargetFunctionStub(Stub, Addr);
+}
+
+/// relinkFunction - Overwrite the entry of the old code of a recompiled
+/// function, at OldAddr, with a branch to its new code at Addr.
+void JIT::relinkFunction(void *OldAddr, void *Addr) {
+  assert(isa<JITEmitter>(JCE) && "Unexpected MCE?");
+  JITMemoryManager *MemMgr = cast<JITEmitter>(JCE)->getMemMgr();
+  MemMgr->setMemoryWritable();
+  // The branch is no larger than a stub.
+  MemMgr->setCodeWritable(OldAddr, getJITInfo().getStubLayout().Size);
+  getJITInfo().replaceMachineCodeForFunction(OldAddr, Addr);
+  MemMgr->setMemoryExecutable();
+}
+
 /// freeMachineCodeForFunction - release machine code memory for given Function.
 ///
 void JIT::freeMachineCodeForFunction(Function *F) {
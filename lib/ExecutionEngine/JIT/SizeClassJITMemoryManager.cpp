@@ -0,0 +1,808 @@
+//===-- SizeClassJITMemoryManager.cpp - Size segregated JIT memory --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the memory manager returned by
+// JITMemoryManager::CreateSizeClassMemManager.  Unlike DefaultJITMemoryManager,
+// which keeps all code in one address ordered free list under one lock, it
+// gives every thread an arena of its own and keeps freed code in free lists
+// segregated by size class, so JITs that recompile functions continuously
+// reuse the memory of the old code in constant time.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "jit"
+#include "llvm/ExecutionEngine/JITMemoryManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Memory.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+using namespace llvm;
+
+STATISTIC(NumSizeClassSlabs, "Number of slabs mapped for JIT size classes");
+STATISTIC(NumFreeListHits,   "Number of JIT blocks reused from a free list");
+STATISTIC(NumProtections,    "Number of JIT memory protection changes");
+
+namespace {
+  /// AllocKind - The kinds of memory the JIT asks for.  Each arena allocates
+  /// each kind from a region of its own.
+  enum AllocKind {
+    CodeKind,    // Function bodies, freed by deallocateFunctionBody.
+    TableKind,   // Exception tables, freed by deallocateExceptionTable.
+    StubKind,    // Function stubs, never freed.
+    DataKind,    // Globals, constant pools and jump tables, never freed.
+    NumKinds
+  };
+
+  /// NumBlockKinds - The kinds up to here are allocated in blocks with a
+  /// header, and can be freed.
+  const unsigned NumBlockKinds = StubKind;
+
+  /// SlabPool - Each slab holds one pool, which determines its protection.
+  enum SlabPool {
+    CodePool,    // Writable and executable, or one of them with W^X.
+    StubPool,    // Always writable and executable.
+    DataPool     // Writable and executable, or only writable with W^X.
+  };
+
+  /// BlockHeader - The header in front of each code and exception table
+  /// block.  It is only written when the block is handed out, so freeing a
+  /// block never writes to code memory.
+  struct BlockHeader {
+    /// Size - The size of the block in bytes, including this header.
+    uintptr_t Size;
+
+    /// Slab - The index of the slab of the block.
+    unsigned Slab;
+
+    /// Arena - The index of the arena whose free lists the block goes back
+    /// to.
+    unsigned short Arena;
+
+    /// Kind - CodeKind or TableKind.
+    unsigned char Kind;
+
+    /// Large - True if the block has a slab to itself, which is unmapped when
+    /// the block is freed.
+    bool Large;
+  };
+
+  /// HeaderSize - The space taken by a BlockHeader, which keeps blocks 16
+  /// byte aligned.
+  const size_t HeaderSize = (sizeof(BlockHeader) + 15) & ~size_t(15);
+
+  // Blocks come in size classes: multiples of 16 bytes up to 128 bytes, then
+  // four classes for every power of two up to LargeBlockSize.  Blocks larger
+  // than that get a slab of their own.
+  const unsigned NumSizeClasses = 44;
+  const size_t LargeBlockSize = 64 * 1024;
+
+  /// MinBlockSize - The smallest block worth keeping in a free list.
+  const size_t MinBlockSize = HeaderSize + 16;
+
+  /// FreeBlock - A free block in a free list.  The lists live outside of the
+  /// slabs, so that code slabs need not be writable to free a block.
+  struct FreeBlock {
+    uint8_t *Start;
+    uintptr_t Size;
+    unsigned Slab;
+    FreeBlock(uint8_t *start, uintptr_t size, unsigned slab)
+      : Start(start), Size(size), Slab(slab) {}
+  };
+
+  /// Region - The end of a slab that an arena hands out by bumping a pointer.
+  struct Region {
+    uint8_t *Cur, *End;
+    unsigned Slab;
+    Region() : Cur(0), End(0), Slab(0) {}
+    size_t size() const { return End - Cur; }
+  };
+
+  /// Arena - The memory allocated by one thread.  Blocks freed by any thread
+  /// go back to the free lists of the arena they came from.
+  struct Arena {
+    /// Lock - Guards everything below; the arena's thread only contends for
+    /// it with threads freeing blocks.
+    sys::Mutex Lock;
+
+    unsigned Index;
+    Region Regions[NumKinds];
+    std::vector<FreeBlock> FreeLists[NumBlockKinds][NumSizeClasses];
+
+    /// CurBlock - The block handed out by the last startFunctionBody or
+    /// startExceptionTable, until the matching end call.
+    BlockHeader *CurBlock;
+
+    /// CurBlockIsRegion - True if CurBlock is the rest of its region, which
+    /// the end call trims to size.
+    bool CurBlockIsRegion;
+
+    size_t AllocatedBytes, FreeBytes;
+
+    explicit Arena(unsigned index)
+      : Index(index), CurBlock(0), CurBlockIsRegion(false), AllocatedBytes(0),
+        FreeBytes(0) {}
+  };
+
+  /// Slab - A block of memory mapped from the system.
+  struct Slab {
+    sys::MemoryBlock Block;
+    SlabPool Pool;
+
+    /// Writable - For code slabs with W^X, true if the slab is writable
+    /// rather than executable.
+    bool Writable;
+
+    /// Dirty - For code slabs with W^X, true if the slab is writable and
+    /// must be made executable by the next setMemoryExecutable.
+    bool Dirty;
+
+    Slab(sys::MemoryBlock B, SlabPool P)
+      : Block(B), Pool(P), Writable(true), Dirty(false) {}
+  };
+
+  /// SizeClassJITMemoryManager - Manage JIT memory in per-thread arenas of
+  /// slabs segregated by kind, with size class free lists for code.
+  class SizeClassJITMemoryManager : public JITMemoryManager {
+    /// WriteXorExecute - Whether code slabs are either writable or
+    /// executable, and data slabs never executable.
+    bool WriteXorExecute;
+
+    /// PoisonMemory - Whether to write garbage over freed memory.
+    bool PoisonMemory;
+
+    /// Lock - Guards the slabs, the arena list, the size hints and the W^X
+    /// state.  An arena lock may be held while taking it, not the other way
+    /// around.
+    sys::Mutex Lock;
+
+    std::vector<Slab> Slabs;
+
+    /// FreeSlabs - Indices of unmapped large slabs, for reuse.
+    std::vector<unsigned> FreeSlabs;
+
+    /// LastSlab - The last slab mapped, to ask for the next one near it.
+    sys::MemoryBlock LastSlab;
+
+    std::vector<Arena*> Arenas;
+    sys::ThreadLocal<const Arena> ThreadArena;
+
+    /// SizeHints - The size of the last body and exception table emitted for
+    /// each function, to find a free block for it when it is recompiled.
+    DenseMap<const Function*, uintptr_t> SizeHints[NumBlockKinds];
+
+    /// WriteDepth - The number of setMemoryWritable calls not yet matched by
+    /// setMemoryExecutable.
+    unsigned WriteDepth;
+
+    /// DirtySlabs - The code slabs made writable since the last
+    /// setMemoryExecutable.
+    std::vector<unsigned> DirtySlabs;
+
+    size_t CommittedBytes;
+
+    uint8_t *GOTBase;
+
+  public:
+    explicit SizeClassJITMemoryManager(bool WXE);
+    ~SizeClassJITMemoryManager();
+
+    /// CodeSlabSize, TableSlabSize, StubSlabSize, DataSlabSize - Map memory
+    /// for each kind in slabs of these sizes unless more is requested.
+    static const size_t CodeSlabSize, TableSlabSize, StubSlabSize,
+                        DataSlabSize;
+
+    /// MinCodeRegion - A function of unknown size is emitted at the end of
+    /// the current code slab only if at least this much of it is left.
+    static const size_t MinCodeRegion;
+
+    void AllocateGOT();
+    uint8_t *getGOTBase() const { return GOTBase; }
+
+    void setMemoryWritable();
+    void setMemoryExecutable();
+    void setCodeWritable(void *Addr, size_t Size);
+
+    void setPoisonMemory(bool poison) { PoisonMemory = poison; }
+
+    uint8_t *startFunctionBody(const Function *F, uintptr_t &ActualSize) {
+      return startBlock(CodeKind, F, ActualSize);
+    }
+    void endFunctionBody(const Function *F, uint8_t *FunctionStart,
+                         uint8_t *FunctionEnd) {
+      endBlock(CodeKind, F, FunctionStart, FunctionEnd);
+    }
+    void deallocateFunctionBody(void *Body) {
+      deallocateBlock(Body);
+    }
+
+    uint8_t *startExceptionTable(const Function *F, uintptr_t &ActualSize) {
+      return startBlock(TableKind, F, ActualSize);
+    }
+    void endExceptionTable(const Function *F, uint8_t *TableStart,
+                           uint8_t *TableEnd, uint8_t *FrameRegister) {
+      endBlock(TableKind, F, TableStart, TableEnd);
+    }
+    void deallocateExceptionTable(void *ET) {
+      deallocateBlock(ET);
+    }
+
+    uint8_t *allocateStub(const GlobalValue *F, unsigned StubSize,
+                          unsigned Alignment) {
+      return allocateBump(StubKind, StubSize, Alignment);
+    }
+    uint8_t *allocateSpace(intptr_t Size, unsigned Alignment) {
+      return allocateBump(DataKind, Size, Alignment);
+    }
+    uint8_t *allocateGlobal(uintptr_t Size, unsigned Alignment) {
+      return allocateBump(DataKind, Size, Alignment);
+    }
+
+    size_t getCommittedBytes();
+    size_t getAllocatedBytes();
+    size_t getFreeBytes();
+
+    // Testing methods.
+    virtual bool CheckInvariants(std::string &ErrorStr);
+    size_t GetDefaultCodeSlabSize() { return CodeSlabSize; }
+    size_t GetDefaultDataSlabSize() { return DataSlabSize; }
+    size_t GetDefaultStubSlabSize() { return StubSlabSize; }
+    unsigned GetNumCodeSlabs() { return getNumSlabs(CodePool); }
+    unsigned GetNumDataSlabs() { return getNumSlabs(DataPool); }
+    unsigned GetNumStubSlabs() { return getNumSlabs(StubPool); }
+
+  private:
+    Arena &getArena();
+    Arena &getArenaOf(const BlockHeader *Hdr);
+
+    unsigned mapSlab(SlabPool Pool, size_t Size);
+    void unmapSlab(unsigned SlabNo);
+    void protect(Slab &S, bool Executable);
+    void makeWritable(unsigned SlabNo);
+    void flushDirtySlabs();
+    unsigned getNumSlabs(SlabPool Pool);
+
+    void startRegion(Arena &A, AllocKind Kind, size_t MinSize);
+    void retireRegion(Arena &A, AllocKind Kind);
+
+    uint8_t *startBlock(AllocKind Kind, const Function *F,
+                        uintptr_t &ActualSize);
+    void endBlock(AllocKind Kind, const Function *F, uint8_t *Start,
+                  uint8_t *End);
+    void deallocateBlock(void *Body);
+    uint8_t *allocateBump(AllocKind Kind, uintptr_t Size, unsigned Alignment);
+  };
+}
+
+// Map code in slabs of 256K, and stubs and data in slabs of 64K.
+const size_t SizeClassJITMemoryManager::CodeSlabSize = 256 * 1024;
+const size_t SizeClassJITMemoryManager::TableSlabSize = 64 * 1024;
+const size_t SizeClassJITMemoryManager::StubSlabSize = 64 * 1024;
+const size_t SizeClassJITMemoryManager::DataSlabSize = 64 * 1024;
+
+// Emit a function of unknown size into at least 16K.
+const size_t SizeClassJITMemoryManager::MinCodeRegion = 16 * 1024;
+
+/// getPool - Return the pool of the slabs for Kind.
+static SlabPool getPool(AllocKind Kind) {
+  switch (Kind) {
+  case CodeKind: return CodePool;
+  case StubKind: return StubPool;
+  default:       return DataPool;
+  }
+}
+
+/// getClassSize - Return the size of the blocks of size class Class.
+static size_t getClassSize(unsigned Class) {
+  if (Class < 8)
+    return (Class + 1) * 16;
+  unsigned K = (Class - 8) / 4, Step = (Class - 8) % 4;
+  return (5 + Step) * (size_t(32) << K);
+}
+
+/// getSizeClass - Return the smallest size class whose blocks hold Size
+/// bytes.
+static unsigned getSizeClass(size_t Size) {
+  assert(Size && Size <= LargeBlockSize && "Block has no size class!");
+  if (Size <= 128)
+    return (Size + 15) / 16 - 1;
+  unsigned K = Log2_64(Size - 1) - 7;
+  return 8 + 4 * K + unsigned(((Size - 1) >> (K + 5)) - 4);
+}
+
+/// getFreeListClass - Return the largest size class whose blocks fit in
+/// Size bytes.  A free block of that size goes in its free list.
+static unsigned getFreeListClass(size_t Size) {
+  unsigned Class = getSizeClass(std::min(Size, LargeBlockSize));
+  return getClassSize(Class) > Size ? Class - 1 : Class;
+}
+
+/// getSlabSize - Return the size of the slabs mapped for Kind.
+static size_t getSlabSize(AllocKind Kind) {
+  switch (Kind) {
+  case CodeKind:  return SizeClassJITMemoryManager::CodeSlabSize;
+  case TableKind: return SizeClassJITMemoryManager::TableSlabSize;
+  case StubKind:  return SizeClassJITMemoryManager::StubSlabSize;
+  default:        return SizeClassJITMemoryManager::DataSlabSize;
+  }
+}
+
+SizeClassJITMemoryManager::SizeClassJITMemoryManager(bool WXE)
+  : WriteXorExecute(WXE),
+#ifdef NDEBUG
+    PoisonMemory(false),
+#else
+    PoisonMemory(true),
+#endif
+    LastSlab(0, 0), WriteDepth(0), CommittedBytes(0), GOTBase(0) {
+}
+
+SizeClassJITMemoryManager::~SizeClassJITMemoryManager() {
+  for (unsigned i = 0, e = Slabs.size(); i != e; ++i)
+    sys::Memory::ReleaseRWX(Slabs[i].Block);
+  for (unsigned i = 0, e = Arenas.size(); i != e; ++i)
+    delete Arenas[i];
+  delete[] GOTBase;
+}
+
+void SizeClassJITMemoryManager::AllocateGOT() {
+  assert(GOTBase == 0 && "Cannot allocate the got multiple times");
+  GOTBase = new uint8_t[sizeof(void*) * 8192];
+  HasGOT = true;
+}
+
+/// getArena - Return the arena of the calling thread, creating it on its
+/// first allocation.
+Arena &SizeClassJITMemoryManager::getArena() {
+  if (const Arena *A = ThreadArena.get())
+    return *const_cast<Arena*>(A);
+  MutexGuard Locked(Lock);
+  assert(Arenas.size() < 0x10000 && "Too many threads allocate JIT memory!");
+  Arena *A = new Arena(Arenas.size());
+  Arenas.push_back(A);
+  ThreadArena.set(A);
+  return *A;
+}
+
+Arena &SizeClassJITMemoryManager::getArenaOf(const BlockHeader *Hdr) {
+  MutexGuard Locked(Lock);
+  return *Arenas[Hdr->Arena];
+}
+
+/// mapSlab - Map a slab of at least Size bytes for Pool, and return its
+/// index.  Lock must be held.
+unsigned SizeClassJITMemoryManager::mapSlab(SlabPool Pool, size_t Size) {
+  std::string ErrMsg;
+  sys::MemoryBlock *Near = LastSlab.base() ? &LastSlab : 0;
+  sys::MemoryBlock B = sys::Memory::AllocateRWX(Size, Near, &ErrMsg);
+  if (B.base() == 0)
+    report_fatal_error("Allocation failed when allocating new memory in the"
+                       " JIT\n" + Twine(ErrMsg));
+  LastSlab = B;
+  CommittedBytes += B.size();
+  ++NumSizeClassSlabs;
+
+  // Initialize the slab to garbage when debugging.
+  if (PoisonMemory)
+    memset(B.base(), 0xCD, B.size());
+
+  unsigned SlabNo = Slabs.size();
+  if (!FreeSlabs.empty()) {
+    SlabNo = FreeSlabs.back();
+    FreeSlabs.pop_back();
+    Slabs[SlabNo] = Slab(B, Pool);
+  } else {
+    Slabs.push_back(Slab(B, Pool));
+  }
+
+  if (WriteXorExecute && Pool != StubPool) {
+    protect(Slabs[SlabNo], false);
+    if (Pool == CodePool) {
+      Slabs[SlabNo].Dirty = true;
+      DirtySlabs.push_back(SlabNo);
+    }
+  }
+  return SlabNo;
+}
+
+/// unmapSlab - Unmap the slab of a large block.  Lock must be held.
+void SizeClassJITMemoryManager::unmapSlab(unsigned SlabNo) {
+  Slab &S = Slabs[SlabNo];
+  if (S.Dirty)
+    DirtySlabs.erase(std::find(DirtySlabs.begin(), DirtySlabs.end(), SlabNo));
+  CommittedBytes -= S.Block.size();
+  sys::Memory::ReleaseRWX(S.Block);
+  S.Block = sys::MemoryBlock(0, 0);
+  S.Dirty = false;
+  FreeSlabs.push_back(SlabNo);
+}
+
+void SizeClassJITMemoryManager::protect(Slab &S, bool Executable) {
+  std::string ErrMsg;
+  if (sys::Memory::protectRange(S.Block, Executable, &ErrMsg))
+    report_fatal_error("Cannot change the protection of JIT memory\n" +
+                       Twine(ErrMsg));
+  S.Writable = !Executable;
+  ++NumProtections;
+}
+
+/// makeWritable - The arena is about to write into a slab; with W^X, make it
+/// writable until the next setMemoryExecutable.  Lock must be held.
+void SizeClassJITMemoryManager::makeWritable(unsigned SlabNo) {
+  Slab &S = Slabs[SlabNo];
+  if (!WriteXorExecute || S.Pool != CodePool)
+    return;
+  if (!S.Writable)
+    protect(S, false);
+  if (!S.Dirty) {
+    S.Dirty = true;
+    DirtySlabs.push_back(SlabNo);
+  }
+}
+
+namespace {
+  /// SlabAddressLess - Order slab indices by the address of the slabs.
+  struct SlabAddressLess {
+    const std::vector<Slab> &Slabs;
+    explicit SlabAddressLess(const std::vector<Slab> &slabs) : Slabs(slabs) {}
+    bool operator()(unsigned LHS, unsigned RHS) const {
+      return Slabs[LHS].Block.base() < Slabs[RHS].Block.base();
+    }
+  };
+}
+
+/// flushDirtySlabs - Make the dirty code slabs executable, with one
+/// protection change for each run of adjacent slabs.  Lock must be held.
+void SizeClassJITMemoryManager::flushDirtySlabs() {
+  std::sort(DirtySlabs.begin(), DirtySlabs.end(), SlabAddressLess(Slabs));
+  for (unsigned i = 0, e = DirtySlabs.size(); i != e; ) {
+    Slab &First = Slabs[DirtySlabs[i]];
+    uint8_t *Start = (uint8_t*)First.Block.base();
+    uint8_t *End = Start + First.Block.size();
+    unsigned j = i;
+    for (; j != e; ++j) {
+      Slab &S = Slabs[DirtySlabs[j]];
+      if (j != i && (uint8_t*)S.Block.base() != End)
+        break;
+      End = (uint8_t*)S.Block.base() + S.Block.size();
+      S.Dirty = false;
+    }
+    Slab Run(sys::MemoryBlock(Start, End - Start), CodePool);
+    protect(Run, true);
+    for (; i != j; ++i)
+      Slabs[DirtySlabs[i]].Writable = false;
+  }
+  DirtySlabs.clear();
+}
+
+void SizeClassJITMemoryManager::setMemoryWritable() {
+  MutexGuard Locked(Lock);
+  ++WriteDepth;
+}
+
+void SizeClassJITMemoryManager::setMemoryExecutable() {
+  MutexGuard Locked(Lock);
+  assert(WriteDepth && "setMemoryExecutable without setMemoryWritable!");
+  if (--WriteDepth == 0 && !DirtySlabs.empty())
+    flushDirtySlabs();
+}
+
+void SizeClassJITMemoryManager::setCodeWritable(void *Addr, size_t Size) {
+  MutexGuard Locked(Lock);
+  uint8_t *Start = (uint8_t*)Addr, *End = Start + Size;
+  for (unsigned i = 0, e = Slabs.size(); i != e; ++i) {
+    uint8_t *Base = (uint8_t*)Slabs[i].Block.base();
+    if (Base < End && Start < Base + Slabs[i].Block.size())
+      makeWritable(i);
+  }
+}
+
+unsigned SizeClassJITMemoryManager::getNumSlabs(SlabPool Pool) {
+  MutexGuard Locked(Lock);
+  unsigned NumSlabs = 0;
+  for (unsigned i = 0, e = Slabs.size(); i != e; ++i)
+    if (Slabs[i].Pool == Pool && Slabs[i].Block.base())
+      ++NumSlabs;
+  return NumSlabs;
+}
+
+/// startRegion - Start allocating Kind from a new slab with room for at least
+/// MinSize bytes.  The arena lock must be held.
+void SizeClassJITMemoryManager::startRegion(Arena &A, AllocKind Kind,
+                                            size_t MinSize) {
+  if (Kind < NumBlockKinds)
+    retireRegion(A, Kind);
+  MutexGuard Locked(Lock);
+  unsigned SlabNo = mapSlab(getPool(Kind),
+                            std::max(getSlabSize(Kind), MinSize));
+  Region &R = A.Regions[Kind];
+  R.Cur = (uint8_t*)Slabs[SlabNo].Block.base();
+  R.End = R.Cur + Slabs[SlabNo].Block.size();
+  R.Slab = SlabNo;
+}
+
+/// retireRegion - Put the rest of the region of a block kind in the free
+/// lists, before the arena moves on to a new slab.
+void SizeClassJITMemoryManager::retireRegion(Arena &A, AllocKind Kind) {
+  Region &R = A.Regions[Kind];
+  while (R.size() >= MinBlockSize) {
+    size_t Size = getClassSize(getFreeListClass(R.size()));
+    A.FreeLists[Kind][getFreeListClass(Size)]
+      .push_back(FreeBlock(R.Cur, Size, R.Slab));
+    A.FreeBytes += Size;
+    R.Cur += Size;
+  }
+}
+
+uint8_t *SizeClassJITMemoryManager::startBlock(AllocKind Kind,
+                                               const Function *F,
+                                               uintptr_t &ActualSize) {
+  Arena &A = getArena();
+  MutexGuard Locked(A.Lock);
+  assert(!A.CurBlock && "Block started before the last one ended!");
+
+  // A function of unknown size that was emitted before probably needs about
+  // as much space as last time, which the rounding up to its size class
+  // leaves a little room over.
+  uintptr_t Wanted = ActualSize;
+  if (Wanted == 0 && F) {
+    MutexGuard Locked(Lock);
+    Wanted = SizeHints[Kind].lookup(F);
+  }
+
+  uint8_t *Start = 0;
+  uintptr_t Size = 0;
+  unsigned SlabNo = 0;
+  bool Large = false;
+  A.CurBlockIsRegion = false;
+
+  // Reuse a free block of the wanted size, or of one of the next two sizes.
+  if (Wanted && HeaderSize + Wanted <= LargeBlockSize) {
+    unsigned Class = getSizeClass(HeaderSize + Wanted);
+    for (unsigned Last = std::min(Class + 3, NumSizeClasses); Class != Last;
+         ++Class) {
+      std::vector<FreeBlock> &FreeList = A.FreeLists[Kind][Class];
+      if (FreeList.empty())
+        continue;
+      Start = FreeList.back().Start;
+      Size = FreeList.back().Size;
+      SlabNo = FreeList.back().Slab;
+      FreeList.pop_back();
+      A.FreeBytes -= Size;
+      ++NumFreeListHits;
+      break;
+    }
+  }
+
+  if (Start) {
+    // Reuse the free block.
+  } else if (HeaderSize + ActualSize > LargeBlockSize) {
+    // Give large blocks a slab of their own.
+    MutexGuard Locked(Lock);
+    SlabNo = mapSlab(getPool(Kind), HeaderSize + ActualSize);
+    Start = (uint8_t*)Slabs[SlabNo].Block.base();
+    Size = Slabs[SlabNo].Block.size();
+    Large = true;
+  } else {
+    // Otherwise hand out the rest of the region, to be trimmed by endBlock.
+    Region &R = A.Regions[Kind];
+    size_t MinSize = ActualSize ? HeaderSize + ActualSize
+                                : (Kind == CodeKind ? MinCodeRegion
+                                                    : MinBlockSize);
+    if (R.size() < MinSize)
+      startRegion(A, Kind, MinSize);
+    Start = R.Cur;
+    Size = R.size();
+    SlabNo = R.Slab;
+    A.CurBlockIsRegion = true;
+  }
+
+  {
+    MutexGuard Locked(Lock);
+    makeWritable(SlabNo);
+  }
+  BlockHeader *Hdr = (BlockHeader*)Start;
+  Hdr->Size = Size;
+  Hdr->Slab = SlabNo;
+  Hdr->Arena = A.Index;
+  Hdr->Kind = Kind;
+  Hdr->Large = Large;
+  A.CurBlock = Hdr;
+
+  ActualSize = Size - HeaderSize;
+  return Start + HeaderSize;
+}
+
+void SizeClassJITMemoryManager::endBlock(AllocKind Kind, const Function *F,
+                                         uint8_t *Start, uint8_t *End) {
+  Arena &A = getArena();
+  MutexGuard Locked(A.Lock);
+  BlockHeader *Hdr = A.CurBlock;
+  assert(Hdr && Start == (uint8_t*)Hdr + HeaderSize && End >= Start &&
+         "Mismatched block start/end!");
+
+  // Trim a block taken from a region to its size class, and leave the rest
+  // of the region for the next block.
+  if (A.CurBlockIsRegion) {
+    Region &R = A.Regions[Kind];
+    assert((uint8_t*)Hdr == R.Cur && "Region changed during a block!");
+    size_t Used = std::max(size_t(End - R.Cur), MinBlockSize);
+    size_t Size = Used <= LargeBlockSize ? getClassSize(getSizeClass(Used))
+                                         : RoundUpToAlignment(Used, 16);
+    Hdr->Size = std::min(Size, R.size());
+    R.Cur += Hdr->Size;
+  }
+  A.AllocatedBytes += Hdr->Size;
+  A.CurBlock = 0;
+
+  if (F) {
+    MutexGuard Locked(Lock);
+    SizeHints[Kind][F] = End - Start;
+  }
+}
+
+void SizeClassJITMemoryManager::deallocateBlock(void *Body) {
+  if (!Body)
+    return;
+  BlockHeader *Hdr = (BlockHeader*)((uint8_t*)Body - HeaderSize);
+  Arena &A = getArenaOf(Hdr);
+  MutexGuard Locked(A.Lock);
+  A.AllocatedBytes -= Hdr->Size;
+
+  if (Hdr->Large) {
+    MutexGuard Locked(Lock);
+    unmapSlab(Hdr->Slab);
+    return;
+  }
+
+  // Fill the block with garbage, unless it is read-only code.
+  if (PoisonMemory && (!WriteXorExecute || Hdr->Kind != CodeKind))
+    memset(Body, 0xCD, Hdr->Size - HeaderSize);
+
+  A.FreeLists[Hdr->Kind][getFreeListClass(Hdr->Size)]
+    .push_back(FreeBlock((uint8_t*)Hdr, Hdr->Size, Hdr->Slab));
+  A.FreeBytes += Hdr->Size;
+}
+
+uint8_t *SizeClassJITMemoryManager::allocateBump(AllocKind Kind,
+                                                 uintptr_t Size,
+                                                 unsigned Alignment) {
+  Arena &A = getArena();
+  MutexGuard Locked(A.Lock);
+  if (Alignment == 0) Alignment = 1;
+  Region &R = A.Regions[Kind];
+  uint8_t *Result = (uint8_t*)RoundUpToAlignment((uintptr_t)R.Cur, Alignment);
+  if (R.Cur == 0 || Result + Size > R.End) {
+    // Waste at most a quarter of a slab at its end.
+    if (Size + Alignment > getSlabSize(Kind) / 4) {
+      MutexGuard Locked(Lock);
+      unsigned SlabNo = mapSlab(getPool(Kind), Size + Alignment);
+      Result = (uint8_t*)RoundUpToAlignment(
+        (uintptr_t)Slabs[SlabNo].Block.base(), Alignment);
+      A.AllocatedBytes += Size;
+      return Result;
+    }
+    startRegion(A, Kind, Size + Alignment);
+    Result = (uint8_t*)RoundUpToAlignment((uintptr_t)R.Cur, Alignment);
+  }
+  A.AllocatedBytes += Result + Size - R.Cur;
+  R.Cur = Result + Size;
+  return Result;
+}
+
+size_t SizeClassJITMemoryManager::getCommittedBytes() {
+  MutexGuard Locked(Lock);
+  return CommittedBytes;
+}
+
+size_t SizeClassJITMemoryManager::getAllocatedBytes() {
+  std::vector<Arena*> ArenaList;
+  {
+    MutexGuard Locked(Lock);
+    ArenaList = Arenas;
+  }
+  size_t Bytes = 0;
+  for (unsigned i = 0, e = ArenaList.size(); i != e; ++i) {
+    MutexGuard Locked(ArenaList[i]->Lock);
+    Bytes += ArenaList[i]->AllocatedBytes;
+  }
+  return Bytes;
+}
+
+size_t SizeClassJITMemoryManager::getFreeBytes() {
+  std::vector<Arena*> ArenaList;
+  {
+    MutexGuard Locked(Lock);
+    ArenaList = Arenas;
+  }
+  size_t Bytes = 0;
+  for (unsigned i = 0, e = ArenaList.size(); i != e; ++i) {
+    MutexGuard Locked(ArenaList[i]->Lock);
+    Bytes += ArenaList[i]->FreeBytes;
+  }
+  return Bytes;
+}
+
+/// CheckInvariants - For testing only.  Check that every free block is in a
+/// slab of its pool and fits its size class, and that the byte counts add
+/// up.
+bool SizeClassJITMemoryManager::CheckInvariants(std::string &ErrorStr) {
+  raw_string_ostream Err(ErrorStr);
+  std::vector<Arena*> ArenaList;
+  {
+    MutexGuard Locked(Lock);
+    ArenaList = Arenas;
+  }
+
+  for (unsigned a = 0, ae = ArenaList.size(); a != ae; ++a) {
+    Arena &A = *ArenaList[a];
+    MutexGuard ArenaLocked(A.Lock);
+    size_t FreeBytes = 0;
+    for (unsigned Kind = 0; Kind != NumBlockKinds; ++Kind) {
+      for (unsigned Class = 0; Class != NumSizeClasses; ++Class) {
+        std::vector<FreeBlock> &FreeList = A.FreeLists[Kind][Class];
+        for (unsigned i = 0, e = FreeList.size(); i != e; ++i) {
+          const FreeBlock &FB = FreeList[i];
+          FreeBytes += FB.Size;
+          if (FB.Size < getClassSize(Class)) {
+            Err << "Free block of " << FB.Size << " bytes in the free list of"
+                << " size class " << getClassSize(Class);
+            return false;
+          }
+          MutexGuard Locked(Lock);
+          bool Found = false;
+          for (unsigned s = 0, se = Slabs.size(); s != se && !Found; ++s) {
+            uint8_t *Base = (uint8_t*)Slabs[s].Block.base();
+            Found = Slabs[s].Pool == getPool(AllocKind(Kind)) &&
+                    Base <= FB.Start &&
+                    FB.Start + FB.Size <= Base + Slabs[s].Block.size();
+          }
+          if (!Found) {
+            Err << "Free block at " << (void*)FB.Start
+                << " is not in a slab of its kind";
+            return false;
+          }
+        }
+      }
+    }
+    if (FreeBytes != A.FreeBytes) {
+      Err << "Arena " << a << " counts " << A.FreeBytes << " free bytes, but"
+          << " its free lists hold " << FreeBytes;
+      return false;
+    }
+  }
+
+  MutexGuard Locked(Lock);
+  size_t Committed = 0;
+  for (unsigned i = 0, e = Slabs.size(); i != e; ++i)
+    Committed += Slabs[i].Block.size();
+  if (Committed != CommittedBytes) {
+    Err << CommittedBytes << " committed bytes counted, but the slabs hold "
+        << Committed;
+    return false;
+  }
+  if (WriteXorExecute && WriteDepth == 0 && !DirtySlabs.empty()) {
+    Err << "Code slabs are writable outside of setMemoryWritable";
+    return false;
+  }
+  return true;
+}
+
+JITMemoryManager *JITMemoryManager::CreateSizeClassMemManager(bool WXE) {
+  return new SizeClassJITMemoryManager(WXE);
+}
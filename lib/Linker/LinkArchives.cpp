@@ -82,6 +82,42 @@ GetAllUndefinedSymbols(Module *M, std::set<std::string> &UndefinedSymbols) {
       ++I; // Keep this symbol in the undefined symbols list
 }
 
+/// AddDeclaredSymbols - add the names of the declarations in a module that is
+/// about to be linked in to a set of candidate undefined symbols.
+static void
+AddDeclaredSymbols(Module *M, std::set<std::string> &Symbols) {
+  for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I)
+    if (I->hasName() && I->isDeclaration())
+      Symbols.insert(I->getName());
+
+  for (Module::global_iterator I = M->global_begin(), E = M->global_end();
+       I != E; ++I)
+    if (I->hasName() && I->isDeclaration())
+      Symbols.insert(I->getName());
+}
+
+/// PruneDefinedSymbols - remove the symbols that are now defined in \p M
+/// from \p Symbols. Together with AddDeclaredSymbols, this keeps the set of
+/// undefined symbols up to date as archive members are linked in without
+/// rescanning the whole program, and gives the same answer as
+/// GetAllUndefinedSymbols.
+static void
+PruneDefinedSymbols(Module *M, std::set<std::string> &Symbols) {
+  for (std::set<std::string>::iterator I = Symbols.begin();
+       I != Symbols.end(); ) {
+    GlobalValue *GV = M->getNamedValue(*I);
+    bool Undefined;
+    if (!GV)
+      Undefined = *I == "main";
+    else
+      Undefined = GV->isDeclaration() && !isa<GlobalAlias>(GV);
+    if (Undefined)
+      ++I;
+    else
+      Symbols.erase(I++);
+  }
+}
+
 /// LinkInArchive - opens an archive library and link in all objects which
 /// provide symbols that are currently undefined.
 ///
@@ -168,6 +204,9 @@ Linker::LinkInArchive(const sys::Path &Filename, bool &is_native) {
         if (aModule->MaterializeAll(&moduleErrorMsg))
           return error("Could not load a module: " + moduleErrorMsg);
 
+        // Anything the member declares may become a new undefined symbol.
+        AddDeclaredSymbols(aModule, UndefinedSymbols);
+
         verbose("  Linking in module: " + aModule->getModuleIdentifier());
 
         // Link it in
@@ -177,9 +216,12 @@ Linker::LinkInArchive(const sys::Path &Filename, bool &is_native) {
       } 
     }
     
-    // Get the undefined symbols from the aggregate module. This recomputes the
-    // symbols we still need after the new modules have been linked in.
-    GetAllUndefinedSymbols(Composite, UndefinedSymbols);
+    // Update the undefined symbols of the aggregate module. Only the symbols
+    // that were undefined before and those declared by the modules just linked
+    // in can be undefined now, so there is no need to rescan the program.
+    UndefinedSymbols.insert(CurrentlyUndefinedSymbols.begin(),
+                            CurrentlyUndefinedSymbols.end());
+    PruneDefinedSymbols(Composite, UndefinedSymbols);
 
     // At this point we have two sets of undefined symbols: UndefinedSymbols
     // which holds the undefined symbols from all the modules, and
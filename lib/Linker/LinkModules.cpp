@@ -31,6 +31,8 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 using namespace llvm;
 
 // Error - Simple wrapper function to conditionally assign to E and return true.
@@ -863,6 +865,70 @@ static bool LinkGlobalInits(Module *Dest, const Module *Src,
   return false;
 }
 
+// AddReferencedFunctions - Push every function that V refers to, directly or
+// through constants and aliases, onto the Worklist.
+static void AddReferencedFunctions(Value *V,
+                                   SmallVectorImpl<Function*> &Worklist,
+                                   SmallPtrSet<Value*, 32> &Visited) {
+  if (!isa<Constant>(V) || !Visited.insert(V))
+    return;
+  if (Function *F = dyn_cast<Function>(V)) {
+    Worklist.push_back(F);
+  } else if (GlobalAlias *GA = dyn_cast<GlobalAlias>(V)) {
+    if (Constant *Aliasee = GA->getAliasee())
+      AddReferencedFunctions(Aliasee, Worklist, Visited);
+  } else if (!isa<GlobalValue>(V)) {
+    User *U = cast<User>(V);
+    for (User::op_iterator OI = U->op_begin(), OE = U->op_end(); OI != OE; ++OI)
+      AddReferencedFunctions(*OI, Worklist, Visited);
+  }
+}
+
+// MaterializeNeededBodies - If the Src module was loaded lazily, read in the
+// bodies of the functions that will be linked into Dest, and of every function
+// those refer to.  Functions with local linkage that nothing uses are left
+// unread.  If OnlyNeeded is set, the same goes for externally visible
+// functions that are not declared in Dest.
+static bool MaterializeNeededBodies(Module *Dest, Module *Src, bool OnlyNeeded,
+                                    std::string *Err) {
+  if (!Src->getMaterializer())
+    return false;
+
+  // The roots are the functions that global initializers and aliases use,
+  // and the definitions Dest should get.
+  SmallVector<Function*, 64> Worklist;
+  for (Module::iterator F = Src->begin(), E = Src->end(); F != E; ++F) {
+    if (!F->isMaterializable())
+      continue;
+    if (!F->use_empty())
+      Worklist.push_back(F);
+    else if (!F->hasLocalLinkage()) {
+      GlobalValue *DGV = Dest->getNamedValue(F->getName());
+      if (!OnlyNeeded || (DGV && DGV->isDeclaration()))
+        Worklist.push_back(F);
+    }
+  }
+
+  SmallPtrSet<Value*, 32> Visited;
+  while (!Worklist.empty()) {
+    Function *F = Worklist.pop_back_val();
+    if (!F->isMaterializable())
+      continue;
+
+    std::string ErrInfo;
+    if (F->Materialize(&ErrInfo))
+      return Error(Err, "Error reading function '" + F->getName() + "': " +
+                   ErrInfo);
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+             OI != OE; ++OI)
+          AddReferencedFunctions(*OI, Worklist, Visited);
+  }
+  return false;
+}
+
 // LinkFunctionProtos - Link the functions together between the two modules,
 // without doing function bodies... this just adds external function prototypes
 // to the Dest function...
@@ -877,6 +943,11 @@ static bool LinkFunctionProtos(Module *Dest, const Module *Src,
     const Function *SF = I;   // SrcFunction
     GlobalValue *DGV = 0;
 
+    // Bodies that MaterializeNeededBodies left unread are not linked in, and
+    // nothing that is linked in refers to them.
+    if (SF->isMaterializable())
+      continue;
+
     // Check to see if may have to link the function with the global, alias or
     // function.
     if (SF->hasName() && !SF->hasLocalLinkage())
@@ -1169,6 +1240,12 @@ static bool ResolveAliases(Module *Dest) {
 // shouldn't be relied on to be consistent.
 bool
 Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
+  return LinkModules(Dest, Src, LinkAll, ErrorMsg);
+}
+
+bool
+Linker::LinkModules(Module *Dest, Module *Src, unsigned Mode,
+                    std::string *ErrorMsg) {
   assert(Dest != 0 && "Invalid Destination module");
   assert(Src  != 0 && "Invalid Source Module");
 
@@ -1233,6 +1310,11 @@ Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
   if (LinkTypes(Dest, Src, ErrorMsg))
     return true;
 
+  // If the source module is read lazily, only read in the function bodies
+  // that are going to be linked.
+  if (MaterializeNeededBodies(Dest, Src, Mode == LinkOnlyNeeded, ErrorMsg))
+    return true;
+
   // ValueMap - Mapping of values from what they used to be in Src, to what they
   // are now in Dest.  ValueToValueMapTy is a ValueMap, which involves some
   // overhead due to the use of Value handles which the Linker doesn't actually
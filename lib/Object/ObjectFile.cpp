@@ -65,7 +65,7 @@ ObjectFile *ObjectFile::createObjectFile(MemoryBuffer *Object) {
 
 ObjectFile *ObjectFile::createObjectFile(StringRef ObjectPath) {
   OwningPtr<MemoryBuffer> File;
-  if (error_code ec = MemoryBuffer::getFile(ObjectPath, File))
+  if (error_code ec = MemoryBuffer::getFile(ObjectPath, File, -1, false))
     return NULL;
   return createObjectFile(File.take());
 }
@@ -136,6 +136,16 @@ unsigned BumpPtrAllocator::GetNumSlabs() const {
   return NumSlabs;
 }
 
+bool BumpPtrAllocator::Owns(const void *Ptr) const {
+  const char *P = static_cast<const char*>(Ptr);
+  for (MemSlab *Slab = CurSlab; Slab != 0; Slab = Slab->NextPtr) {
+    const char *Begin = reinterpret_cast<const char*>(Slab);
+    if (P >= Begin && P < Begin + Slab->Size)
+      return true;
+  }
+  return false;
+}
+
 void BumpPtrAllocator::PrintStats() const {
   unsigned NumSlabs = 0;
   size_t TotalMemory = 0;
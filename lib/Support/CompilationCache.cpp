@@ -0,0 +1,175 @@
+//===-- CompilationCache.cpp - On-disk output cache -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the CompilationCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "compilation-cache"
+#include "llvm/Support/CompilationCache.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <set>
+#include <vector>
+using namespace llvm;
+
+STATISTIC(NumHits,    "Number of compilation cache hits");
+STATISTIC(NumMisses,  "Number of compilation cache misses");
+STATISTIC(NumStores,  "Number of compilation cache entries stored");
+STATISTIC(NumEvicted, "Number of compilation cache entries evicted");
+
+CompilationCache::KeyBuilder &
+CompilationCache::KeyBuilder::add(uint64_t Value) {
+  uint8_t Bytes[8];
+  for (unsigned i = 0; i != 8; ++i)
+    Bytes[i] = uint8_t(Value >> (8 * i));
+  Hash.update(ArrayRef<uint8_t>(Bytes, 8));
+  return *this;
+}
+
+CompilationCache::KeyBuilder &
+CompilationCache::KeyBuilder::add(StringRef Part) {
+  add(uint64_t(Part.size()));
+  Hash.update(Part);
+  return *this;
+}
+
+std::string CompilationCache::KeyBuilder::getKey() {
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  return Str.str();
+}
+
+/// getEntryPath - Return the path of the file holding the entry for Key.
+static sys::Path getEntryPath(const std::string &Directory, StringRef Key) {
+  sys::Path Path(Directory);
+  Path.appendComponent(Key);
+  return Path;
+}
+
+bool CompilationCache::lookup(StringRef Key, OwningPtr<MemoryBuffer> &Result) {
+  sys::Path Path = getEntryPath(Directory, Key);
+  // Entries are only read, never modified in place, so they can be mapped.
+  if (MemoryBuffer::getFile(Path.c_str(), Result, -1, false)) {
+    ++NumMisses;
+    return false;
+  }
+  ++NumHits;
+
+  // Bump the modification time, which prune() uses as the time of last use.
+  sys::PathWithStatus Entry(Path);
+  if (const sys::FileStatus *FS = Entry.getFileStatus(false, 0)) {
+    sys::FileStatus Used = *FS;
+    Used.modTime = sys::TimeValue::now();
+    Entry.setStatusInfoOnDisk(Used, 0);
+  }
+  return true;
+}
+
+bool CompilationCache::store(StringRef Key, StringRef Data,
+                             std::string &ErrMsg) {
+  bool Existed;
+  if (error_code ec = sys::fs::create_directories(Directory, Existed)) {
+    ErrMsg = "cannot create cache directory '" + Directory + "': " +
+             ec.message();
+    return true;
+  }
+
+  // Write the entry next to its final location, then rename it into place
+  // so that no reader ever sees a partially written entry.
+  sys::Path Final = getEntryPath(Directory, Key);
+  sys::Path Temp(Final.str() + ".tmp");
+  if (Temp.createTemporaryFileOnDisk(false, &ErrMsg))
+    return true;
+
+  {
+    tool_output_file Out(Temp.c_str(), ErrMsg, raw_fd_ostream::F_Binary);
+    if (!ErrMsg.empty())
+      return true;
+    Out.os() << Data;
+    Out.os().close();
+    if (Out.os().has_error()) {
+      Out.os().clear_error();
+      ErrMsg = "cannot write cache entry '" + Temp.str() + "'";
+      return true;
+    }
+    Out.keep();
+  }
+
+  if (error_code ec = sys::fs::rename(Temp.str(), Final.str())) {
+    Temp.eraseFromDisk();
+    ErrMsg = "cannot install cache entry '" + Final.str() + "': " +
+             ec.message();
+    return true;
+  }
+  ++NumStores;
+
+  if (MaxSize)
+    prune();
+  return false;
+}
+
+namespace {
+  /// CacheEntry - An entry of the cache directory, ordered by last use.
+  struct CacheEntry {
+    sys::TimeValue LastUse;
+    uint64_t Size;
+    sys::Path Path;
+
+    CacheEntry(const sys::FileStatus &FS, const sys::Path &P)
+      : LastUse(FS.getTimestamp()), Size(FS.getSize()), Path(P) {}
+
+    bool operator<(const CacheEntry &RHS) const {
+      return LastUse < RHS.LastUse;
+    }
+  };
+}
+
+void CompilationCache::prune() {
+  if (MaxSize == 0)
+    return;
+
+  std::set<sys::Path> Files;
+  if (sys::Path(Directory).getDirectoryContents(Files, 0))
+    return;
+
+  std::vector<CacheEntry> Entries;
+  uint64_t Total = 0;
+  for (std::set<sys::Path>::iterator I = Files.begin(), E = Files.end();
+       I != E; ++I) {
+    // Leave alone the entries that are still being written.
+    if (sys::path::filename(I->str()).find(".tmp") != StringRef::npos)
+      continue;
+    sys::PathWithStatus Entry(*I);
+    const sys::FileStatus *FS = Entry.getFileStatus(false, 0);
+    if (!FS || FS->isDir)
+      continue;
+    Entries.push_back(CacheEntry(*FS, *I));
+    Total += FS->getSize();
+  }
+  if (Total <= MaxSize)
+    return;
+
+  // Another process may remove the same entries concurrently; an entry that
+  // is already gone simply does not count.
+  std::sort(Entries.begin(), Entries.end());
+  for (unsigned i = 0, e = Entries.size(); i != e && Total > MaxSize; ++i) {
+    if (Entries[i].Path.eraseFromDisk(false, 0))
+      continue;
+    Total -= Entries[i].Size;
+    ++NumEvicted;
+  }
+}
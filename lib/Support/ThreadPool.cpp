@@ -0,0 +1,181 @@
+//===-- ThreadPool.cpp - A pool of worker threads -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ThreadPool class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Config/config.h"
+#include <cassert>
+#include <deque>
+#include <vector>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+unsigned ThreadPool::getHardwareConcurrency() {
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  long N = ::sysconf(_SC_NPROCESSORS_ONLN);
+  if (N > 0)
+    return unsigned(N);
+#endif
+  return 1;
+}
+
+#if defined(LLVM_MULTITHREADED) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+
+namespace {
+  struct Task {
+    ThreadPool::TaskFn Fn;
+    void *Arg;
+  };
+
+  struct PoolState {
+    pthread_mutex_t Lock;
+    /// QueueCond - Signalled when a task is queued or the pool shuts down.
+    pthread_cond_t QueueCond;
+    /// DoneCond - Signalled when the last outstanding task completes.
+    pthread_cond_t DoneCond;
+    std::deque<Task> Queue;
+    std::vector<pthread_t> Workers;
+    /// Outstanding - Number of queued plus running tasks.
+    unsigned Outstanding;
+    bool ShuttingDown;
+  };
+}
+
+static void *WorkerMain(void *Arg) {
+  PoolState *S = static_cast<PoolState*>(Arg);
+  ::pthread_mutex_lock(&S->Lock);
+  while (true) {
+    while (S->Queue.empty() && !S->ShuttingDown)
+      ::pthread_cond_wait(&S->QueueCond, &S->Lock);
+    if (S->Queue.empty())
+      break;
+
+    Task T = S->Queue.front();
+    S->Queue.pop_front();
+    ::pthread_mutex_unlock(&S->Lock);
+    T.Fn(T.Arg);
+    ::pthread_mutex_lock(&S->Lock);
+
+    if (--S->Outstanding == 0)
+      ::pthread_cond_broadcast(&S->DoneCond);
+  }
+  ::pthread_mutex_unlock(&S->Lock);
+  return 0;
+}
+
+ThreadPool::ThreadPool(unsigned Threads, bool Asynchronous)
+  : Impl(0), NumThreads(1) {
+  if (Threads == 0)
+    Threads = getHardwareConcurrency();
+  if ((Threads < 2 && !Asynchronous) || !llvm_is_multithreaded())
+    return;
+
+  PoolState *S = new PoolState();
+  ::pthread_mutex_init(&S->Lock, 0);
+  ::pthread_cond_init(&S->QueueCond, 0);
+  ::pthread_cond_init(&S->DoneCond, 0);
+  S->Outstanding = 0;
+  S->ShuttingDown = false;
+
+  for (unsigned i = 0; i != Threads; ++i) {
+    pthread_t Thread;
+    if (::pthread_create(&Thread, 0, WorkerMain, S) != 0)
+      break;
+    S->Workers.push_back(Thread);
+  }
+
+  // If no worker could be started, fall back to running tasks inline.
+  if (S->Workers.empty()) {
+    ::pthread_cond_destroy(&S->DoneCond);
+    ::pthread_cond_destroy(&S->QueueCond);
+    ::pthread_mutex_destroy(&S->Lock);
+    delete S;
+    return;
+  }
+
+  Impl = S;
+  NumThreads = S->Workers.size();
+}
+
+ThreadPool::~ThreadPool() {
+  PoolState *S = static_cast<PoolState*>(Impl);
+  if (!S)
+    return;
+
+  ::pthread_mutex_lock(&S->Lock);
+  S->ShuttingDown = true;
+  ::pthread_cond_broadcast(&S->QueueCond);
+  ::pthread_mutex_unlock(&S->Lock);
+
+  // Workers drain the queue before honoring ShuttingDown.
+  for (unsigned i = 0, e = S->Workers.size(); i != e; ++i)
+    ::pthread_join(S->Workers[i], 0);
+
+  ::pthread_cond_destroy(&S->DoneCond);
+  ::pthread_cond_destroy(&S->QueueCond);
+  ::pthread_mutex_destroy(&S->Lock);
+  delete S;
+}
+
+void ThreadPool::async(TaskFn Fn, void *Arg) {
+  PoolState *S = static_cast<PoolState*>(Impl);
+  if (!S) {
+    Fn(Arg);
+    return;
+  }
+
+  Task T = { Fn, Arg };
+  ::pthread_mutex_lock(&S->Lock);
+  assert(!S->ShuttingDown && "Queueing work on a dying pool!");
+  S->Queue.push_back(T);
+  ++S->Outstanding;
+  ::pthread_cond_signal(&S->QueueCond);
+  ::pthread_mutex_unlock(&S->Lock);
+}
+
+void ThreadPool::wait() {
+  PoolState *S = static_cast<PoolState*>(Impl);
+  if (!S)
+    return;
+
+  ::pthread_mutex_lock(&S->Lock);
+  while (S->Outstanding != 0)
+    ::pthread_cond_wait(&S->DoneCond, &S->Lock);
+  ::pthread_mutex_unlock(&S->Lock);
+}
+
+#else
+
+// No non-pthread implementation, currently.  Every task runs on the calling
+// thread.
+
+ThreadPool::ThreadPool(unsigned Threads, bool Asynchronous)
+  : Impl(0), NumThreads(1) {
+  (void) Threads;
+  (void) Asynchronous;
+}
+
+ThreadPool::~ThreadPool() {}
+
+void ThreadPool::async(TaskFn Fn, void *Arg) {
+  Fn(Arg);
+}
+
+void ThreadPool::wait() {}
+
+#endif
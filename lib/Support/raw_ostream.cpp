@@ -417,7 +417,7 @@ void format_object_base::home() {
 /// if no error occurred.
 raw_fd_ostream::raw_fd_ostream(const char *Filename, std::string &ErrorInfo,
                                unsigned Flags)
-  : Error(false), UseAtomicWrites(false), pos(0)
+  : Error(false), UseAtomicWrites(false), SupportsSeeking(false), pos(0)
 {
   assert(Filename != 0 && "Filename is null");
   // Verify that we don't have both "append" and "excl".
@@ -463,6 +463,10 @@ raw_fd_ostream::raw_fd_ostream(const char *Filename, std::string &ErrorInfo,
 
   // Ok, we successfully opened the file, so it'll need to be closed.
   ShouldClose = true;
+
+  // Writes to a file opened for appending always go to its end.
+  SupportsSeeking = !(Flags & F_Append) &&
+                    ::lseek(FD, 0, SEEK_CUR) != (off_t)-1;
 }
 
 /// raw_fd_ostream ctor - FD is the file descriptor that this writes to.  If
@@ -483,6 +487,7 @@ raw_fd_ostream::raw_fd_ostream(int fd, bool shouldClose, bool unbuffered)
     pos = 0;
   else
     pos = static_cast<uint64_t>(loc);
+  SupportsSeeking = loc != (off_t)-1;
 }
 
 raw_fd_ostream::~raw_fd_ostream() {
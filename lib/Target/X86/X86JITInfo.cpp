@@ -463,8 +463,13 @@ TargetJITInfo::StubLayout X86JITInfo::getStubLayout() {
   //   call|jmp *r10  # 3 bytes
   // The 32-bit stub contains a 5-byte call|jmp.
   // If the stub is a call to the compilation callback, an extra byte is added
-  // to mark it as a stub.
+  // to mark it as a stub.  64-bit stubs are 8-byte aligned so that
+  // retargetFunctionStub can rewrite their start with a single store.
+#if defined (X86_64_JIT)
+  StubLayout Result = {14, 8};
+#else
   StubLayout Result = {14, 4};
+#endif
   return Result;
 }
 
@@ -478,7 +483,11 @@ void *X86JITInfo::emitFunctionStub(const Function* F, void *Target,
 #else
   bool NotCC = Target != (void*)(intptr_t)X86CompilationCallback;
 #endif
+#if defined (X86_64_JIT)
+  JCE.emitAlignment(8);
+#else
   JCE.emitAlignment(4);
+#endif
   void *Result = (void*)JCE.getCurrentPCValue();
   if (NotCC) {
 #if defined (X86_64_JIT)
@@ -517,6 +526,28 @@ void *X86JITInfo::emitFunctionStub(const Function* F, void *Target,
   return Result;
 }
 
+bool X86JITInfo::retargetFunctionStub(void *Stub, void *Target) {
+#if defined (X86_64_JIT)
+  // Overwrite the first eight bytes of the stub, the start of the movabs, with
+  // a jmp rel32 followed by the three bytes already there.  An aligned 8-byte
+  // store is atomic, so a concurrent caller sees either stub.
+  if ((intptr_t)Stub & 7)
+    return false;
+  intptr_t diff = (intptr_t)Target - ((intptr_t)Stub + 5);
+  if (diff < -2147483648LL || diff > 2147483647LL)
+    return false;
+
+  volatile uint64_t *Word = (volatile uint64_t *)Stub;
+  uint64_t Rest = *Word & ~0xFFFFFFFFFFULL;
+  *Word = Rest | 0xE9 | ((uint64_t)(uint32_t)diff << 8);
+  sys::ValgrindDiscardTranslations(Stub, 8);
+  return true;
+#else
+  // The 32-bit stub is not aligned for an 8-byte store.
+  return false;
+#endif
+}
+
 /// getPICJumpTableEntry - Returns the value of the jumptable entry for the
 /// specific basic block.
 uintptr_t X86JITInfo::getPICJumpTableEntry(uintptr_t BB, uintptr_t Entry) {
@@ -53,6 +53,11 @@ namespace llvm {
     virtual void *emitFunctionStub(const Function* F, void *Target,
                                    JITCodeEmitter &JCE);
 
+    /// retargetFunctionStub - Atomically turn the stub at Stub into a jump to
+    /// Target.  Only implemented for X86-64, and only if Target is within
+    /// 32-bit range of the stub.
+    virtual bool retargetFunctionStub(void *Stub, void *Target);
+
     /// getPICJumpTableEntry - Returns the value of the jumptable entry for the
     /// specific basic block.
     virtual uintptr_t getPICJumpTableEntry(uintptr_t BB, uintptr_t JTBase);
@@ -71,6 +76,11 @@ namespace llvm {
     /// meaningful to the target.
     virtual char* allocateThreadLocalMemory(size_t size);
 
+    /// isCodeRelocatable - X86 code only refers to other addresses through
+    /// relocations, or to its own constant pool and jump tables at addresses
+    /// the JIT keeps track of.
+    virtual bool isCodeRelocatable() const { return true; }
+
     /// setPICBase / getPICBase - Getter / setter of PICBase, used to compute
     /// PIC jumptable entry.
     void setPICBase(uintptr_t Base) { PICBase = Base; }
@@ -18,34 +18,425 @@
 #include "llvm/Function.h"
 #include "llvm/Instructions.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/type_traits.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Assembly/Writer.h"
 #include "llvm/Analysis/DebugInfo.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/ADT/DepthFirstIterator.h"
-#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ControlDependence.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 
+#include <algorithm>
+#include <queue>
 #include <vector>
 #include <utility>
 #include <fstream>
 
 using namespace llvm;
+
+static cl::opt<std::string>
+DiffModule("diff-module", cl::value_desc("filename"),
+           cl::desc("Make diffFinder diff every function of the module "
+                    "against the old version in this file"));
+
+static cl::opt<unsigned>
+DiffThreads("diff-threads", cl::init(1), cl::value_desc("N"),
+            cl::desc("Number of threads diffFinder matches functions with "
+                     "(0 uses every processor); only used if the tool runs "
+                     "multithreaded"));
+
+static cl::opt<bool>
+VerifyBlockReachability("verify-block-reachability",
+                        cl::desc("Check every answer of block-reachability "
+                                 "against a depth first search (slow)"));
+
+static cl::opt<std::string>
+DistanceTargets("distance-targets", cl::value_desc("filename"),
+                cl::desc("File listing the target blocks of target-distance, "
+                         "one \"function block\" pair per line"));
+
+static cl::opt<std::string>
+DistanceRetarget("distance-retarget", cl::value_desc("filename"),
+                 cl::desc("File listing the targets target-distance switches "
+                          "to, updating its distances, once it has computed "
+                          "them for -distance-targets"));
+
 namespace {
+  /// ReachabilityIndex - Answers whether one block of a function can reach
+  /// another.  The CFG is condensed into its strongly connected components
+  /// once, and the transitive closure of the condensed graph is kept as one
+  /// bit vector per component, so every query is two map lookups and a bit
+  /// test, however large the function is.
+  class ReachabilityIndex : public FunctionPass {
+    /// SCCNumbers - The component of each block.  Components are numbered in
+    /// reverse topological order: every successor of a component has a lower
+    /// number than the component itself, unless it is the same component.
+    DenseMap<const BasicBlock*, unsigned> SCCNumbers;
+
+    /// Reachable - Bit J of Reachable[I] is set if component J is reachable
+    /// from component I.  Every component reaches itself.
+    std::vector<BitVector> Reachable;
+
+    /// Fn - The function the index is for.
+    const Function *Fn;
+
+  public:
+    static char ID;
+    ReachabilityIndex() : FunctionPass(ID), Fn(0) {}
+
+    virtual bool runOnFunction(Function &F) {
+      releaseMemory();
+      Fn = &F;
+      std::vector<std::vector<BasicBlock*> > SCCs;
+      computeSCCs(F, SCCs);
+
+      // Components are visited after everything they reach, so the rows of
+      // their successors are complete when they are merged in.
+      unsigned NumSCCs = SCCs.size();
+      Reachable.resize(NumSCCs);
+      for (unsigned I = 0; I != NumSCCs; ++I) {
+        BitVector &Row = Reachable[I];
+        Row.resize(NumSCCs);
+        Row.set(I);
+        for (unsigned B = 0, BE = SCCs[I].size(); B != BE; ++B) {
+          BasicBlock *BB = SCCs[I][B];
+          for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE;
+               ++SI) {
+            unsigned Succ = SCCNumbers[*SI];
+            if (Succ != I && !Row.test(Succ))
+              Row |= Reachable[Succ];
+          }
+        }
+      }
+      if (VerifyBlockReachability)
+        verifyAnalysis();
+      return false;
+    }
+
+    /// isReachable - Return true if there is a path from From to To.  A block
+    /// always reaches itself.  Blocks of different functions never reach each
+    /// other.
+    bool isReachable(const BasicBlock *From, const BasicBlock *To) const {
+      DenseMap<const BasicBlock*, unsigned>::const_iterator
+        FI = SCCNumbers.find(From), TI = SCCNumbers.find(To);
+      if (FI == SCCNumbers.end() || TI == SCCNumbers.end())
+        return false;
+      return Reachable[FI->second].test(TI->second);
+    }
+
+    virtual void releaseMemory() {
+      SCCNumbers.clear();
+      Reachable.clear();
+      Fn = 0;
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+
+    /// verifyAnalysis - With -verify-block-reachability, check the answer for
+    /// every pair of blocks against a plain depth first search.
+    virtual void verifyAnalysis() const {
+      if (!VerifyBlockReachability || !Fn)
+        return;
+      for (Function::const_iterator From = Fn->begin(), E = Fn->end();
+           From != E; ++From) {
+        SmallPtrSet<const BasicBlock*, 32> Visited;
+        SmallVector<const BasicBlock*, 32> Worklist;
+        Worklist.push_back(From);
+        while (!Worklist.empty()) {
+          const BasicBlock *BB = Worklist.pop_back_val();
+          if (Visited.insert(BB))
+            Worklist.append(succ_begin(BB), succ_end(BB));
+        }
+        for (Function::const_iterator To = Fn->begin(); To != E; ++To)
+          if (isReachable(From, To) != Visited.count(To))
+            report_fatal_error("block-reachability disagrees with a depth "
+                               "first search from '" + From->getName() +
+                               "' to '" + To->getName() + "' in '" +
+                               Fn->getName() + "'");
+      }
+    }
+
+    virtual void print(raw_ostream &OS, const Module *) const {
+      if (!Fn)
+        return;
+      OS << "Reachability index for '" << Fn->getName() << "': "
+         << Reachable.size() << " strongly connected components\n";
+      for (Function::const_iterator From = Fn->begin(), E = Fn->end();
+           From != E; ++From) {
+        OS << "  ";
+        WriteAsOperand(OS, From, false);
+        OS << " reaches";
+        for (Function::const_iterator To = Fn->begin(); To != E; ++To)
+          if (isReachable(From, To)) {
+            OS << ' ';
+            WriteAsOperand(OS, To, false);
+          }
+        OS << '\n';
+      }
+    }
+
+  private:
+    /// computeSCCs - Number the strongly connected components of the CFG of F,
+    /// including those not reachable from the entry block, with Tarjan's
+    /// algorithm, and collect their blocks.  The walk keeps its own stack, so
+    /// deep CFGs do not overflow the native one.
+    void computeSCCs(Function &F,
+                     std::vector<std::vector<BasicBlock*> > &SCCs) {
+      const unsigned Unvisited = ~0U;
+      DenseMap<const BasicBlock*, unsigned> Order;
+      std::vector<unsigned> Low;
+      std::vector<BasicBlock*> Stack;
+      std::vector<std::pair<BasicBlock*, succ_iterator> > VisitStack;
+
+      for (Function::iterator Root = F.begin(), E = F.end(); Root != E;
+           ++Root) {
+        if (Order.count(Root))
+          continue;
+
+        Order[Root] = Low.size();
+        Low.push_back(Low.size());
+        Stack.push_back(Root);
+        VisitStack.push_back(std::make_pair(&*Root, succ_begin(Root)));
+
+        while (!VisitStack.empty()) {
+          BasicBlock *BB = VisitStack.back().first;
+          unsigned N = Order[BB];
+          if (VisitStack.back().second != succ_end(BB)) {
+            BasicBlock *Succ = *VisitStack.back().second++;
+            DenseMap<const BasicBlock*, unsigned>::iterator
+              SI = Order.find(Succ);
+            if (SI == Order.end()) {
+              Order[Succ] = Low.size();
+              Low.push_back(Low.size());
+              Stack.push_back(Succ);
+              VisitStack.push_back(std::make_pair(Succ, succ_begin(Succ)));
+            } else if (SI->second != Unvisited) {
+              // Still on the stack, so part of a component being built.
+              Low[N] = std::min(Low[N], SI->second);
+            }
+            continue;
+          }
+
+          VisitStack.pop_back();
+          if (!VisitStack.empty()) {
+            unsigned Parent = Order[VisitStack.back().first];
+            Low[Parent] = std::min(Low[Parent], Low[N]);
+          }
+          if (Low[N] != N)
+            continue;
+
+          // BB is the root of a component: pop its members off the stack.
+          // Their order number is cleared so that later edges into the
+          // component are not taken for back edges.
+          unsigned SCC = SCCs.size();
+          SCCs.push_back(std::vector<BasicBlock*>());
+          BasicBlock *Member;
+          do {
+            Member = Stack.back();
+            Stack.pop_back();
+            Order[Member] = Unvisited;
+            SCCNumbers[Member] = SCC;
+            SCCs.back().push_back(Member);
+          } while (Member != BB);
+        }
+      }
+    }
+  };
+
+  /// combineHash - Mix Value into Hash, FNV-1a style.
+  static unsigned combineHash(unsigned Hash, unsigned Value) {
+    return (Hash ^ Value) * 16777619U;
+  }
+
+  /// hashBlock - Hash the shape of a block: its opcodes, operand counts,
+  /// predicates and successor count, but not the values it uses, so that
+  /// blocks of two versions of a module can be compared.
+  static unsigned hashBlock(const BasicBlock *BB) {
+    unsigned Hash = 2166136261U;
+    for (BasicBlock::const_iterator I = BB->begin(), E = BB->end(); I != E;
+         ++I) {
+      Hash = combineHash(Hash, I->getOpcode());
+      Hash = combineHash(Hash, I->getNumOperands());
+      if (const CmpInst *CI = dyn_cast<CmpInst>(I))
+        Hash = combineHash(Hash, CI->getPredicate());
+    }
+    return combineHash(Hash, BB->getTerminator()->getNumSuccessors());
+  }
+
+  /// hashFunction - Hash the shape of a function, block by block.
+  static unsigned hashFunction(const Function &F) {
+    unsigned Hash = combineHash(2166136261U, F.arg_size());
+    Hash = combineHash(Hash, F.size());
+    for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+      Hash = combineHash(Hash, hashBlock(BB));
+    return Hash;
+  }
+
+  /// BlockMatcher - Pairs the blocks of two versions of a function by
+  /// aligning their CFGs rather than by position.  Entry blocks and blocks
+  /// with the same name and shape are paired first.  Pairs are extended
+  /// along matching terminators and single predecessors to blocks of the
+  /// same shape, then to blocks left over with a shape found once on each
+  /// side, or with the same name.  Last, pairs are extended to neighbours of
+  /// any shape, which pairs blocks that were edited in place.
+  class BlockMatcher {
+    DenseMap<BasicBlock*, BasicBlock*> OldToNew, NewToOld;
+    DenseMap<BasicBlock*, unsigned> Hashes;
+    std::vector<std::pair<BasicBlock*, BasicBlock*> > Pairs;
+    SmallVector<std::pair<BasicBlock*, BasicBlock*>, 16> Worklist;
+
+    bool tryMatch(BasicBlock *Old, BasicBlock *New, bool SameShape = false) {
+      if (OldToNew.count(Old) || NewToOld.count(New))
+        return false;
+      if (SameShape && getHash(Old) != getHash(New))
+        return false;
+      OldToNew[Old] = New;
+      NewToOld[New] = Old;
+      Pairs.push_back(std::make_pair(Old, New));
+      Worklist.push_back(std::make_pair(Old, New));
+      return true;
+    }
+
+    void propagate(bool SameShape) {
+      while (!Worklist.empty()) {
+        std::pair<BasicBlock*, BasicBlock*> Pair = Worklist.pop_back_val();
+        TerminatorInst *OT = Pair.first->getTerminator();
+        TerminatorInst *NT = Pair.second->getTerminator();
+        if (OT->getOpcode() == NT->getOpcode() &&
+            OT->getNumSuccessors() == NT->getNumSuccessors())
+          for (unsigned i = 0, e = OT->getNumSuccessors(); i != e; ++i)
+            tryMatch(OT->getSuccessor(i), NT->getSuccessor(i), SameShape);
+        BasicBlock *OP = Pair.first->getSinglePredecessor();
+        BasicBlock *NP = Pair.second->getSinglePredecessor();
+        if (OP && NP)
+          tryMatch(OP, NP, SameShape);
+      }
+    }
+
+    unsigned getHash(BasicBlock *BB) {
+      unsigned &Hash = Hashes[BB];
+      if (!Hash)
+        Hash = hashBlock(BB) | 1;
+      return Hash;
+    }
+
+  public:
+    void run(Function &Old, Function &New) {
+      tryMatch(&Old.getEntryBlock(), &New.getEntryBlock());
+      StringMap<BasicBlock*> OldByName;
+      for (Function::iterator BB = Old.begin(), E = Old.end(); BB != E; ++BB)
+        if (BB->hasName())
+          OldByName[BB->getName()] = BB;
+      for (Function::iterator BB = New.begin(), E = New.end(); BB != E; ++BB)
+        if (BasicBlock *OB = BB->hasName() ? OldByName.lookup(BB->getName())
+                                           : 0)
+          tryMatch(OB, BB, true);
+      propagate(true);
+
+      // Shapes that occur exactly once among the blocks left on each side.
+      std::map<unsigned, std::pair<BasicBlock*, unsigned> > OldShapes;
+      std::map<unsigned, std::pair<BasicBlock*, unsigned> > NewShapes;
+      for (Function::iterator BB = Old.begin(), E = Old.end(); BB != E; ++BB)
+        if (!OldToNew.count(BB)) {
+          std::pair<BasicBlock*, unsigned> &Entry = OldShapes[getHash(BB)];
+          Entry.first = BB;
+          ++Entry.second;
+        }
+      for (Function::iterator BB = New.begin(), E = New.end(); BB != E; ++BB)
+        if (!NewToOld.count(BB)) {
+          std::pair<BasicBlock*, unsigned> &Entry = NewShapes[getHash(BB)];
+          Entry.first = BB;
+          ++Entry.second;
+        }
+      for (std::map<unsigned, std::pair<BasicBlock*, unsigned> >::iterator
+           I = NewShapes.begin(), E = NewShapes.end(); I != E; ++I) {
+        std::pair<BasicBlock*, unsigned> &OldEntry = OldShapes[I->first];
+        if (I->second.second == 1 && OldEntry.second == 1)
+          tryMatch(OldEntry.first, I->second.first);
+      }
+      propagate(true);
+
+      for (Function::iterator BB = New.begin(), E = New.end(); BB != E; ++BB)
+        if (BasicBlock *OB = BB->hasName() ? OldByName.lookup(BB->getName())
+                                           : 0)
+          tryMatch(OB, BB);
+      propagate(true);
+
+      Worklist.append(Pairs.begin(), Pairs.end());
+      propagate(false);
+    }
+
+    /// getOld - Return the block of the old version paired with New, or null.
+    BasicBlock *getOld(BasicBlock *New) const { return NewToOld.lookup(New); }
+
+    /// getNew - Return the block of the new version paired with Old, or null.
+    BasicBlock *getNew(BasicBlock *Old) const { return OldToNew.lookup(Old); }
+  };
+
+  /// FunctionDiff - The block level differences between the old and new
+  /// version of a function.
+  struct FunctionDiff {
+    struct BlockDiff {
+      BasicBlock *Old, *New;
+      /// FirstDiff - The first instruction of New that differs, or its end
+      /// if the block only lost instructions.
+      BasicBlock::iterator FirstDiff;
+      bool Changed;
+    };
+
+    /// Old - The old version, or null if the function was added.
+    Function *Old;
+    Function *New;
+    std::vector<BlockDiff> Matched;
+    /// Added - The blocks of New that have no counterpart in Old.
+    std::vector<BasicBlock*> Added;
+
+    FunctionDiff(Function *Old, Function *New) : Old(Old), New(New) {}
+
+    bool isChanged() const {
+      if (!Old || !Added.empty())
+        return true;
+      for (unsigned i = 0, e = Matched.size(); i != e; ++i)
+        if (Matched[i].Changed)
+          return true;
+      return false;
+    }
+  };
+
+  class Hello;
+
+  /// DiffJob - One function pair for the thread pool to diff.
+  struct DiffJob {
+    Hello *Pass;
+    FunctionDiff *Diff;
+  };
+
   class Hello : public ModulePass {
   public:
     static char ID; 
@@ -56,7 +447,7 @@ namespace {
 
     std::vector<std::vector<BasicBlock*> > paths;
     std::vector<BasicBlock*> *my_diff_bbs;
-    DominatorTree* domTree;
+    ReachabilityIndex* reach;
     std::vector<Instruction*> write_vec;
     std::vector<Instruction*> cond_vec;
     std::set<BasicBlock*> ACN;
@@ -65,24 +456,29 @@ namespace {
     int my_tt;
     int *g;
     bool called_from_klee = false;
+    // Threads the whole module diff matches functions with, 0 for one per
+    // processor.  They are only started if the tool already runs
+    // multithreaded; the pass never calls llvm_start_multithreaded itself.
+    unsigned num_threads;
 
-    std::map<BasicBlock *, std::set<BasicBlock *> > controlDeps_;
+    ControlDependenceGraph* cdg;
 
-   Hello() : ModulePass(ID) {}
+   Hello() : ModulePass(ID), num_threads(DiffThreads) {}
 
     virtual bool runOnModule(Module &M) {
       errs() << "Starting my diff/control/data dependence Analysis" << "\n";
       if(!called_from_klee)
 	diff_bbs_vec=new std::vector<BasicBlock*>();
+      if (!DiffModule.empty())
+	return diffModules(M);
       // It is essential that both the original and modified version should be in same module
 
       Function *F1 = M.getFunction("func");
       Function *F2 = M.getFunction("func_2");
-      domTree = &getAnalysis<DominatorTree>(*F2); // For reachability
-      PostDominatorTree &PDT = getAnalysis<PostDominatorTree>(*F2); // For control dependance
+      reach = &getAnalysis<ReachabilityIndex>(*F2); // For reachability
+      cdg = &getAnalysis<ControlDependenceGraph>(*F2); // For control dependance
       MemoryDependenceAnalysis &MDA = getAnalysis<MemoryDependenceAnalysis>(*F2);  // For data depen
 
-      getControlDependencies(*F2, PDT);
       //  All the basic blocks for original version
       std::vector<BasicBlock*> temp_bbs;
       for (Function::iterator bb = F1->begin() , e = F1->end(); bb !=e ;++bb ){
@@ -104,141 +500,91 @@ namespace {
 	// This will update ACN and AWN sets
         diff(LL,RR);	
       }
-      bool updated;
       // Updating the ACN and AWN sets until it converges
-      typedef std::set<BasicBlock*>::iterator set_bb_iterator;
-      typedef std::vector<Instruction*>::iterator vec_inst_iterator;
-
-      // For each of the condition statement what is its data dependence
-      std::map<Instruction* , Instruction*> cond_dep;
-      for (vec_inst_iterator i_iter = cond_vec.begin(), i_iter_end = cond_vec.end();i_iter != i_iter_end ; i_iter++){
-	Instruction* II = *i_iter;
-	MemDepResult Res = MDA.getDependency(II);
-	Instruction* temp_i = Res.getInst();
-	cond_dep[II] = temp_i;
-      }
-      do{
-	updated = false;
-	// =======================================================================
-	//  if n_i E ACN and n_j E Cond and Controldep(n_i, n_j)
-	for (set_bb_iterator iter = ACN.begin(),iter_end=ACN.end();iter!=iter_end;iter++){
-	  BasicBlock* acn_bb = *iter;
-	  for (vec_inst_iterator i_iter = cond_vec.begin(), i_iter_end = cond_vec.end();i_iter != i_iter_end ; i_iter++){
-	    Instruction* II = *i_iter;
-	    BasicBlock* temp_bb = II->getParent();
-	    if(!ACN.count(temp_bb)){
-	      if(isControlDep(acn_bb,temp_bb)){
-		ACN.insert(temp_bb);
-		updated = true;
-	      }
-	    }
-	  }
-	} // outer loop for acn First condition
-
-	// =======================================================================
-	//  if n_i E ACN and n_j E write and Controldep(n_i, n_j)
-	for (set_bb_iterator iter = ACN.begin(),iter_end=ACN.end();iter!=iter_end;iter++){
-	  BasicBlock* acn_bb = *iter;
-	  for (vec_inst_iterator i_iter = write_vec.begin(), i_iter_end = write_vec.end();i_iter != i_iter_end ; i_iter++){
-	    Instruction* II = *i_iter;
-	    BasicBlock* temp_bb = II->getParent();
-	    if(!AWN.count(temp_bb)){
-	      if(isControlDep(acn_bb,temp_bb)){
-		AWN.insert(temp_bb);
-	      }
-	    }
-	  }
-	} // outer loop for awn Second condition
-
-	// == Data dependence ===================================================
-     
-	std::map<Instruction*,std::set<Instruction*> > writeUseMap;
-	for (set_bb_iterator iter = AWN.begin(),iter_end=AWN.end();iter!=iter_end;iter++){
-	  BasicBlock* awn_bb = *iter;
-	  for(BasicBlock::iterator inst = awn_bb->begin(), inst_end = awn_bb->end(); inst != inst_end ; inst++){
-	    Instruction * write_inst = inst;
-	    if(isa<StoreInst>(write_inst)){
-	      Value *second_op = write_inst->getOperand(1);
-	      std::set<Instruction*> temp_set;
-	      for(Value::use_iterator i = second_op->use_begin(), ie = second_op->use_end(); i!=ie; ++i){
-		if (Instruction *Inst = dyn_cast<Instruction>(*i)) {		  
-		  // Only if there is path from store to to use
-		  if(Ispotentiallyreachable(awn_bb,Inst->getParent(),domTree)){
-		    temp_set.insert(Inst);
-		  }
-		}
-	      } 
-	      writeUseMap[inst]=temp_set;
-	    } //if storeinst
-	  }
-	} // outer loop for datadepent
-	// Updating ACN
-	for(std::map<Instruction*,std::set<Instruction*> >::iterator  iter = writeUseMap.begin(), iter_end = writeUseMap.end();iter!=iter_end;iter++){
-	  std::set<Instruction*> temp_set = iter->second;
-	  for(std::map<Instruction*,Instruction*>::iterator cond_iter = cond_dep.begin(), cond_iter_end = cond_dep.end();cond_iter!=cond_iter_end;cond_iter++){
-	    Instruction* dep = cond_iter->second;
-	    if(temp_set.count(dep)){
-	      BasicBlock* start_cfg = iter->first->getParent();
-	      BasicBlock* end_cfg = cond_iter->first->getParent();
-	      if(Ispotentiallyreachable(start_cfg,end_cfg,domTree)){
-		if(!ACN.count(end_cfg)){
-		  ACN.insert(end_cfg);
-		  updated = true;
-		}
-	      }
-	    }
-	  }
-	}
-
-      }while(updated);
+      propagateAffectedSets(*F2, MDA);
       errs() << "Size of ACN and AWN vectors(updated) " << ACN.size()<<" --- " << AWN.size()  <<"\n" ;
      
       std:: ofstream diff_file("/tmp/diff_file.txt");
       diff_bbs_vec->clear();
-      for(std::set<BasicBlock*>::iterator iter = ACN.begin(), iter_end = ACN.end(); iter!=iter_end ; iter++){
-	BasicBlock* bb = *iter;
+      // Listed in block order, so the output does not depend on where the
+      // blocks were allocated.
+      for (Function::iterator bb = F2->begin(), e = F2->end(); bb != e; ++bb){
+	if (!ACN.count(bb))
+	  continue;
 	diff_bbs_vec->push_back(bb);
 	errs() << "ACN = " << bb->getName() << '\n';
 	std::string str = bb->getName();
 	diff_file << str << "\n";
       }
-      for(std::set<BasicBlock*>::iterator iter = AWN.begin(), iter_end = AWN.end(); iter!=iter_end ; iter++){
-	BasicBlock* bb = *iter;
-	errs() << "AWN = " << bb->getName() << '\n';
-      }
+      for (Function::iterator bb = F2->begin(), e = F2->end(); bb != e; ++bb)
+	if (AWN.count(bb))
+	  errs() << "AWN = " << bb->getName() << '\n';
       return false;
     } // runOnModule
     
     // ============= Finding instruction level differences and keeping track of them ========
     void diff(BasicBlock *L, BasicBlock *R) {
+      BasicBlock::iterator first_diff;
+      if (recordDifference(R, findDifference(L, R, first_diff), first_diff)) {
+	bbs.push_back(L->getName());
+	diff_bbs_vec->push_back(R);
+      }
+    }
+
+    // Is R different from L?  If so, first_diff is set to the first
+    // instruction of R that differs, or to its end if R only lacks some of
+    // the instructions of L.
+    bool findDifference(BasicBlock *L, BasicBlock *R,
+			BasicBlock::iterator &first_diff) {
       BasicBlock::iterator LI = L->begin(), LE = L->end();
-      BasicBlock::iterator RI = R->begin();
-      bool flag = false;
-      do {
-	assert(LI != LE && RI != R->end());
-	Instruction *LeftI = &*LI, *RightI = &*RI;
-	// Adding cond and write statements to vector
+      BasicBlock::iterator RI = R->begin(), RE = R->end();
+      for (; LI != LE && RI != RE; ++LI, ++RI)
+	if (diff(LI, RI, false))
+	  break;
+      first_diff = RI;
+      return LI != LE || RI != RE;
+    }
+
+    // Adding the cond and write statements of R up to its first difference
+    // to the vectors, and R to the affected sets if that difference is a
+    // cond or write.  Returns changed.
+    bool recordDifference(BasicBlock *R, bool changed,
+			  BasicBlock::iterator first_diff) {
+      BasicBlock::iterator RE = changed ? first_diff : R->end();
+      for (BasicBlock::iterator RI = R->begin(); RI != RE; ++RI)
+	recordInstruction(RI);
+      if (!changed || first_diff == R->end())
+	return changed;
+      recordInstruction(first_diff);
+      // Adding cond and write to affected sets
+      if(isa<StoreInst>(first_diff)){
+	AWN.insert(R);
+      }else if(isa<CmpInst>(first_diff)){
+	ACN.insert(R);
+      }
+      return true;
+    }
+
+    // Every statement of a block that was added is a difference.
+    void recordAddition(BasicBlock *R) {
+      for (BasicBlock::iterator RI = R->begin(), RE = R->end(); RI != RE;
+	   ++RI) {
+	recordInstruction(RI);
 	if(isa<StoreInst>(RI)){
-	  write_vec.push_back(RI);
+	  AWN.insert(R);
 	}else if(isa<CmpInst>(RI)){
-	  cond_vec.push_back(RI);
+	  ACN.insert(R);
 	}
+      }
+    }
 
-	if (diff(LeftI, RightI, flag)) {
-	  // Adding cond and write to affected sets
-	  if(isa<StoreInst>(RI)){
-	    AWN.insert(R);
-	  }else if(isa<CmpInst>(RI)){
-	    ACN.insert(R);
-	  }
-	  bbs.push_back(L->getName());
-	  diff_bbs_vec->push_back(R);
-	  return ;
-	}	
-	++LI, ++RI;
-	flag = false;
-      } while (LI != LE);
-
+    // Adding cond and write statements to vector
+    void recordInstruction(Instruction *I) {
+      if(isa<StoreInst>(I)){
+	write_vec.push_back(I);
+      }else if(isa<CmpInst>(I)){
+	cond_vec.push_back(I);
+      }
     }
 
     bool diff(Instruction *L, Instruction *R, bool complain) {
@@ -346,6 +692,11 @@ namespace {
       return true;
     } // equivalent .. ()
 
+    bool equivalentAsOperands(GlobalValue *L, GlobalValue *R) {
+      // Globals of two versions of a module are the same if named alike.
+      return L->getName() == R->getName();
+    } // equivalent .. ()
+
     bool equivalentAsOperands(Value *L, Value *R) {
       if (L->getValueID() != R->getValueID())
 	return false;
@@ -355,157 +706,298 @@ namespace {
       return true;
     } // equivalent() ..
 
-    // ================ Control Dependency findings ========================================
-    // is cond_bb control dependent on acn_bb
-    bool isControlDep(BasicBlock* acn_bb, BasicBlock* cond_bb){
-      // get all the basic blocks dependent on the acn
-      std::set<BasicBlock*> cont_dep = controlDeps_[acn_bb];
-      // check cond_bb exsit in set
-      if(cont_dep.count(cond_bb)){
-	return true;
+    // ================ ACN/AWN propagation ================================
+    // Grows ACN and AWN to their least fixed point, where
+    //  - a condition block control dependent on an ACN block is in ACN,
+    //  - a write block control dependent on an ACN block is in AWN,
+    //  - a condition block whose condition depends on memory written by a
+    //    store in an AWN block, and reachable from it, is in ACN.
+    // The rules are turned into edges between densely numbered blocks once,
+    // and the sets are bit vectors.  Each block enters the worklist at most
+    // once per set, and only its own edges are scanned when it leaves it.
+    void propagateAffectedSets(Function &F, MemoryDependenceAnalysis &MDA) {
+      DenseMap<BasicBlock*, unsigned> blockNums;
+      std::vector<BasicBlock*> blocks;
+      for (Function::iterator bb = F.begin(), e = F.end(); bb != e; ++bb) {
+	blockNums[bb] = blocks.size();
+	blocks.push_back(bb);
       }
-      return false;
-
-    }
-    std::vector<std::vector<BasicBlock*> > getNonPDomEdges(  Function &F, const PostDominatorTree &PDT) const {
-      std::vector<std::vector<BasicBlock*> > S;
-      for (Function::iterator BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi) {
-	BasicBlock *A = &(*BBi);
-	// Get the edge A->B, ie get the successors of A
-	//errs() << "HEAD --- " << A->getName()  << "\n";
-	for (succ_iterator Si = succ_begin(A), Se = succ_end(A); 
-	     Si != Se; ++ Si) {
-	  BasicBlock *B = *Si;
-	  //errs() << "SUCC --- " << B->getName()  << "\n";
-	  if (!PDT.properlyDominates(B, A)) {
-	    // B does not post-dominate A in the edge (A->B), this is the criteria
-	    // for being in the set S
-	    std::vector<BasicBlock*> temp_vec;
-	    temp_vec.push_back(B); //head
-	    temp_vec.push_back(A); // tail
-	    S.push_back(temp_vec);
+      unsigned numBlocks = blocks.size();
+
+      BitVector isCond(numBlocks), isWrite(numBlocks);
+      for (unsigned i = 0, e = cond_vec.size(); i != e; ++i)
+	isCond.set(blockNums[cond_vec[i]->getParent()]);
+      for (unsigned i = 0, e = write_vec.size(); i != e; ++i)
+	isWrite.set(blockNums[write_vec[i]->getParent()]);
+
+      // Edges out of an ACN block: the blocks control dependent on it.
+      std::vector<SmallVector<unsigned, 4> > depEdges(numBlocks);
+      for (unsigned i = 0; i != numBlocks; ++i)
+	for (ControlDependenceGraph::block_iterator
+	       dep = cdg->dependent_begin(blocks[i]),
+	       dep_end = cdg->dependent_end(blocks[i]); dep != dep_end; ++dep)
+	  depEdges[i].push_back(blockNums[*dep]);
+
+      // Edges out of an AWN block: the condition blocks that read what its
+      // stores write.  The memory dependence of a condition is a user of the
+      // stored-to pointer, so the stores are found from its operands.
+      std::vector<SmallVector<unsigned, 4> > dataEdges(numBlocks);
+      for (unsigned i = 0, e = cond_vec.size(); i != e; ++i) {
+	Instruction *cond = cond_vec[i];
+	Instruction *dep = MDA.getDependency(cond).getInst();
+	if (!dep)
+	  continue;
+	for (unsigned op = 0, op_end = dep->getNumOperands(); op != op_end;
+	     ++op) {
+	  Value *ptr = dep->getOperand(op);
+	  for (Value::use_iterator u = ptr->use_begin(), u_end = ptr->use_end();
+	       u != u_end; ++u) {
+	    StoreInst *store = dyn_cast<StoreInst>(*u);
+	    if (!store || store->getPointerOperand() != ptr ||
+		store->getParent()->getParent() != &F)
+	      continue;
+	    // Only if there is a path from the store to the use and on to the
+	    // condition.
+	    BasicBlock *write_bb = store->getParent();
+	    if (reach->isReachable(write_bb, dep->getParent()) &&
+		reach->isReachable(write_bb, cond->getParent()))
+	      dataEdges[blockNums[write_bb]].push_back(
+		blockNums[cond->getParent()]);
 	  }
 	}
       }
 
-      return S;
-    }
-
-    void updateControlDependencies(const std::vector<std::vector<BasicBlock*> > &S, 
-						      PostDominatorTree &PDT) {
-      BasicBlock *L;
-      for (std::vector<std::vector<BasicBlock*> >::size_type i = 0; i < S.size(); ++i) {
-	std::vector<BasicBlock*> curEdge;
-	curEdge = S[i];
-
-	BasicBlock *A;
-	BasicBlock *B;
-
-	A = curEdge.at(1); // tail
- 	B = curEdge.at(0); // head
+      BitVector inACN(numBlocks), inAWN(numBlocks);
+      SmallVector<unsigned, 32> acnWorklist, awnWorklist;
+      for (std::set<BasicBlock*>::iterator iter = ACN.begin(),
+	     iter_end = ACN.end(); iter != iter_end; ++iter) {
+	inACN.set(blockNums[*iter]);
+	acnWorklist.push_back(blockNums[*iter]);
+      }
+      for (std::set<BasicBlock*>::iterator iter = AWN.begin(),
+	     iter_end = AWN.end(); iter != iter_end; ++iter) {
+	inAWN.set(blockNums[*iter]);
+	awnWorklist.push_back(blockNums[*iter]);
+      }
 
-	L = PDT.findNearestCommonDominator(A, B);
-	if (L == NULL) {
+      while (!acnWorklist.empty() || !awnWorklist.empty()) {
+	if (!acnWorklist.empty()) {
+	  SmallVector<unsigned, 4> &edges =
+	    depEdges[acnWorklist.pop_back_val()];
+	  for (unsigned i = 0, e = edges.size(); i != e; ++i) {
+	    unsigned dep = edges[i];
+	    if (isCond.test(dep) && !inACN.test(dep)) {
+	      inACN.set(dep);
+	      acnWorklist.push_back(dep);
+	    }
+	    if (isWrite.test(dep) && !inAWN.test(dep)) {
+	      inAWN.set(dep);
+	      awnWorklist.push_back(dep);
+	    }
+	  }
 	  continue;
 	}
+	SmallVector<unsigned, 4> &edges = dataEdges[awnWorklist.pop_back_val()];
+	for (unsigned i = 0, e = edges.size(); i != e; ++i)
+	  if (!inACN.test(edges[i])) {
+	    inACN.set(edges[i]);
+	    acnWorklist.push_back(edges[i]);
+	  }
+      }
 
-	DomTreeNode *domNodeA;
-	domNodeA = PDT.getNode(A);
-
-	DomTreeNode *parentA;
-	parentA = domNodeA->getIDom();  // NULL?
-	DomTreeNode *domNodeB;
-	domNodeB = PDT.getNode(B);
-	DomTreeNode *curNode;
-	curNode = domNodeB;
-	std::set<BasicBlock *> &depSet = controlDeps_[A];
-
-	while (curNode != parentA) {
-
-	  errs() << "[DEBUG] Iterating up post dom tree\n";
-
-	  // Mark each node visited on our way to the parent of A, but not A's
-	  // parent, as control dependent on A
-	  depSet.insert(curNode->getBlock());
-
-	  // Update cur
-	  curNode = curNode->getIDom();
-	} // end while (cur != parentA)
-	// Because std::map::operator[] returns a reference to the set then I
-	// believe we do not need to do any insertions
-
-	//errs() << "[DEBUG] size of depSet: " << depSet.size() << '\n';
-	//errs() << "[DEBUG] size of map value: " << controlDeps_[A].size() << '\n';
-	assert(depSet.size() == controlDeps_[A].size() && "map size mis-match");
-      } // end for(vector<>)
-    }
-
-    void getControlDependencies(Function &F, PostDominatorTree &PDT) {
-      // All edges in the CFG (A->B) such that B does not post-dominate A
-      std::vector<std::vector<BasicBlock*> > S;
-
-      S = getNonPDomEdges(F, PDT);
-      //errs() << "[DEBUG] Size of set S: " << S.size() << '\n';
-      updateControlDependencies(S, PDT);
+      for (unsigned i = 0; i != numBlocks; ++i) {
+	if (inACN.test(i))
+	  ACN.insert(blocks[i]);
+	if (inAWN.test(i))
+	  AWN.insert(blocks[i]);
+      }
     }
 
+    // ================ Whole module diff =================================
+    // Diffs every function of M against its old version in DiffModule.
+    // Functions are paired by name, and renamed ones by shape when that is
+    // unambiguous.  The pairs only read the IR while their blocks are matched
+    // and compared, so that can be done in parallel if the tool runs
+    // multithreaded; the dependence analyses then run on each changed
+    // function in turn.  The diff file lists the ACN
+    // blocks as "function block" lines.
+    bool diffModules(Module &M) {
+      SMDiagnostic Err;
+      OwningPtr<Module> Old(ParseIRFile(DiffModule, Err, M.getContext()));
+      if (!Old) {
+	Err.Print("diffFinder", errs());
+	return false;
+      }
 
+      DenseMap<Function*, Function*> old_of;
+      SmallPtrSet<Function*, 32> paired_old;
+      std::vector<Function*> unpaired_new;
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+	if (F->isDeclaration())
+	  continue;
+	Function *OF = Old->getFunction(F->getName());
+	if (OF && !OF->isDeclaration()) {
+	  old_of[F] = OF;
+	  paired_old.insert(OF);
+	} else {
+	  unpaired_new.push_back(F);
+	}
+      }
 
-    bool Ispotentiallyreachable(const BasicBlock *A, const BasicBlock *B , const DominatorTree *DT) {
-      assert(A->getParent() == B->getParent() &&
-	     "This analysis is function-local!");
+      std::map<unsigned, std::pair<Function*, unsigned> > old_shapes;
+      std::map<unsigned, std::pair<Function*, unsigned> > new_shapes;
+      for (Module::iterator F = Old->begin(), E = Old->end(); F != E; ++F)
+	if (!F->isDeclaration() && !paired_old.count(F)) {
+	  std::pair<Function*, unsigned> &entry = old_shapes[hashFunction(*F)];
+	  entry.first = F;
+	  ++entry.second;
+	}
+      for (unsigned i = 0, e = unpaired_new.size(); i != e; ++i) {
+	std::pair<Function*, unsigned> &entry =
+	  new_shapes[hashFunction(*unpaired_new[i])];
+	entry.first = unpaired_new[i];
+	++entry.second;
+      }
+      for (std::map<unsigned, std::pair<Function*, unsigned> >::iterator
+	     iter = new_shapes.begin(), iter_end = new_shapes.end();
+	   iter != iter_end; ++iter) {
+	std::pair<Function*, unsigned> &old_entry = old_shapes[iter->first];
+	if (iter->second.second == 1 && old_entry.second == 1)
+	  old_of[iter->second.first] = old_entry.first;
+      }
 
-      SmallVector<BasicBlock*, 32> Worklist;
-      Worklist.push_back(const_cast<BasicBlock*>(A));
+      std::vector<FunctionDiff> diffs;
+      for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+	if (!F->isDeclaration())
+	  diffs.push_back(FunctionDiff(old_of.lookup(F), F));
+      errs() << "Diffing " << diffs.size() << " functions against "
+	     << DiffModule << "\n";
+
+      // The pool runs the jobs on this thread unless the tool has put LLVM
+      // into multithreaded mode.
+      unsigned threads = num_threads ? num_threads
+				     : ThreadPool::getHardwareConcurrency();
+      threads = std::max(1U, std::min<unsigned>(threads, diffs.size()));
+      if (!llvm_is_multithreaded())
+	threads = 1;
+      std::vector<DiffJob> jobs(diffs.size());
+      {
+	ThreadPool Pool(threads);
+	for (unsigned i = 0, e = diffs.size(); i != e; ++i) {
+	  jobs[i].Pass = this;
+	  jobs[i].Diff = &diffs[i];
+	  Pool.async(runDiffJob, &jobs[i]);
+	}
+	Pool.wait();
+      }
 
-      return isPotentiallyReachableFromMany(Worklist, const_cast<BasicBlock *>(B),
-					    DT);
+      std:: ofstream diff_file("/tmp/diff_file.txt");
+      diff_bbs_vec->clear();
+      unsigned num_changed = 0;
+      for (unsigned i = 0, e = diffs.size(); i != e; ++i) {
+	if (!diffs[i].isChanged())
+	  continue;
+	++num_changed;
+	Function *F = diffs[i].New;
+	analyzeChanges(diffs[i]);
+	// Listed in block order, as in runOnModule.
+	for (Function::iterator bb = F->begin(), e = F->end(); bb != e; ++bb) {
+	  if (!ACN.count(bb))
+	    continue;
+	  diff_bbs_vec->push_back(bb);
+	  errs() << "ACN = " << F->getName() << " " << bb->getName() << '\n';
+	  diff_file << F->getName().str() << " " << bb->getName().str() << "\n";
+	}
+	for (Function::iterator bb = F->begin(), e = F->end(); bb != e; ++bb)
+	  if (AWN.count(bb))
+	    errs() << "AWN = " << F->getName() << " " << bb->getName() << '\n';
+      }
+      errs() << num_changed << " of " << diffs.size()
+	     << " functions changed\n";
+      return false;
     }
 
-    bool isPotentiallyReachableFromMany( SmallVectorImpl<BasicBlock *> &Worklist, BasicBlock *StopBB,
-					 const DominatorTree *DT ) {
+    // Pairs the blocks of the two versions and finds which pairs differ.
+    // This only reads the IR, and may run on any thread.
+    void matchBlocks(FunctionDiff &FD) {
+      if (!FD.Old) {
+	for (Function::iterator bb = FD.New->begin(), e = FD.New->end();
+	     bb != e; ++bb)
+	  FD.Added.push_back(bb);
+	return;
+      }
 
-      // Limit the number of blocks we visit. The goal is to avoid run-away compile
-      // times on large CFGs without hampering sensible code. Arbitrarily chosen.
-      unsigned Limit = 32;
-      std::set<BasicBlock*> Visited;
-      do {
-	BasicBlock *BB = Worklist.pop_back_val();
-	if (!Visited.insert(BB).second)
+      BlockMatcher matcher;
+      matcher.run(*FD.Old, *FD.New);
+      for (Function::iterator bb = FD.New->begin(), e = FD.New->end();
+	   bb != e; ++bb) {
+	BasicBlock *old_bb = matcher.getOld(bb);
+	if (!old_bb) {
+	  FD.Added.push_back(bb);
 	  continue;
-	if (BB == StopBB)
-	  return true;
-	if (DT && DT->dominates(BB, StopBB))
-	  return true;
-	if (!--Limit) {
-	  // We haven't been able to prove it one way or the other. Conservatively
-	  // answer true -- that there is potentially a path.
-	  return true;
 	}
-	  Worklist.append(succ_begin(BB), succ_end(BB));
-      } while (!Worklist.empty());
+	FunctionDiff::BlockDiff BD;
+	BD.Old = old_bb;
+	BD.New = bb;
+	BD.Changed = findDifference(old_bb, bb, BD.FirstDiff);
+	// Instructions compare branch targets as equal; a target that is not
+	// the counterpart of the old one is a difference too.
+	TerminatorInst *OT = old_bb->getTerminator();
+	TerminatorInst *NT = bb->getTerminator();
+	if (!BD.Changed && OT->getNumSuccessors() == NT->getNumSuccessors())
+	  for (unsigned i = 0, e = OT->getNumSuccessors(); i != e; ++i)
+	    if (matcher.getNew(OT->getSuccessor(i)) != NT->getSuccessor(i)) {
+	      BD.Changed = true;
+	      BD.FirstDiff = NT;
+	      break;
+	    }
+	FD.Matched.push_back(BD);
+      }
+    }
 
-      // We have exhausted all possible paths and are certain that 'To' can not be
-      // reached from 'From'.
-      return false;
+    static void runDiffJob(void *Arg) {
+      DiffJob *Job = static_cast<DiffJob*>(Arg);
+      Job->Pass->matchBlocks(*Job->Diff);
+    }
+
+    // Recomputes ACN and AWN for the new version of a changed function.
+    void analyzeChanges(FunctionDiff &FD) {
+      Function &F = *FD.New;
+      ACN.clear();
+      AWN.clear();
+      write_vec.clear();
+      cond_vec.clear();
+
+      reach = &getAnalysis<ReachabilityIndex>(F);
+      cdg = &getAnalysis<ControlDependenceGraph>(F);
+      MemoryDependenceAnalysis &MDA = getAnalysis<MemoryDependenceAnalysis>(F);
+
+      for (unsigned i = 0, e = FD.Matched.size(); i != e; ++i)
+	recordDifference(FD.Matched[i].New, FD.Matched[i].Changed,
+			 FD.Matched[i].FirstDiff);
+      for (unsigned i = 0, e = FD.Added.size(); i != e; ++i)
+	recordAddition(FD.Added[i]);
+      propagateAffectedSets(F, MDA);
     }
-  
- 
+
     // Other passes I need =======================================================
   virtual void getAnalysisUsage(AnalysisUsage &AU) const {
     AU.addRequired<MemoryDependenceAnalysis>();
     AU.setPreservesAll();
-    AU.addRequired<DominatorTree>();
-    AU.addRequired<PostDominatorTree>();
+    AU.addRequired<ReachabilityIndex>();
+    AU.addRequired<ControlDependenceGraph>();
   }
 }; // class
-  // External Interface of this pass for KLEE
-  ModulePass *createDiffBlocksPass(std::vector<BasicBlock*> *diff_bb_vec)
+  // External Interface of this pass for KLEE.  The whole module diff uses
+  // up to threads threads, if KLEE has started LLVM multithreaded.
+  ModulePass *createDiffBlocksPass(std::vector<BasicBlock*> *diff_bb_vec,
+				   unsigned threads = 1)
   {    
     Hello *cg = new Hello();
     errs() <<  " IN the create Diff Blocks Pass" << '\n';
     cg->called_from_klee = true;
     cg->diff_bbs_vec = diff_bb_vec;
+    cg->num_threads = threads;
     return cg;
   }
 
@@ -521,99 +1013,451 @@ static RegisterPass<Hello> X("diffFinder", "Identify differences between two ver
 
 
 namespace {
-  // Hello2 - The second implementation with getAnalysisUsage implemented.
+  // Hello2 - Answers reachability queries from start blocks towards named
+  // target blocks of "func_2".  All the queries of one run share the
+  // function's ReachabilityIndex, so KLEE can ask about every (state, target)
+  // pair at once instead of running the pass once per pair.
   class Hello2 : public ModulePass {
   public:
     static char ID; // Pass identification, replacement for typeid
-    BasicBlock* targetBB;
+    std::vector<BasicBlock*> start_bbs;
+    std::vector<std::string> target_bb_names;
+    // Where the answers go: one per query, or a single one.
+    std::vector<int> *results;
     int * reachable;
-    BasicBlock* startBB;
-    std::vector<BasicBlock*> bb_vec;
-    DominatorTree* domTree;
-    std::string target_bb_name;
-    Hello2() : ModulePass(ID) {}
+    Hello2() : ModulePass(ID), results(0), reachable(0) {}
 
     virtual bool runOnModule(Module &M) {
-      //errs() << "Function: I Am here wajih YYAYAYAY " << "\n";
       Function *F2 = M.getFunction("func_2");
-      domTree = &getAnalysis<DominatorTree>(*F2);
-      for (Function::iterator bb = F2->begin() , e = F2->end(); bb !=e ;++bb ){
-	bb_vec.push_back(bb);
-	std::string temp_str = bb->getName();
-	if(target_bb_name.compare(temp_str) == 0){
-	  //errs() << target_bb_name.c_str() << " YAYA Match found " << temp_str.c_str()  <<'\n' ;
-	  targetBB = bb;
-	}
-      }
-      //errs().write_escaped(F2->getName()) << '\n';
-      //errs() << targetBB->getName()  <<  " checking reachability from  " <<  startBB->getName() << "\n" ;
-      if(Ispotentiallyreachable(startBB,targetBB,domTree)){
-	//errs() << targetBB->getName()  <<  " is reachable from  " <<  startBB->getName() << "\n" ;
-	  *(this->reachable) = 1;
-      }else{
-	//errs() << targetBB->getName()  <<  " is not reachable from  " <<  startBB->getName() << "\n" ;
-	*(this->reachable) = 0;
+      StringMap<BasicBlock*> bbs_by_name;
+      for (Function::iterator bb = F2->begin() , e = F2->end(); bb !=e ;++bb )
+	bbs_by_name[bb->getName()] = bb;
+
+      ReachabilityIndex &RI = getAnalysis<ReachabilityIndex>(*F2);
+      std::vector<int> answers;
+      for (unsigned i = 0, e = start_bbs.size(); i != e; ++i) {
+	// An unknown target is never reachable.
+	BasicBlock *targetBB = bbs_by_name.lookup(target_bb_names[i]);
+	answers.push_back(targetBB && RI.isReachable(start_bbs[i], targetBB));
       }
+
+      if (results)
+	results->swap(answers);
+      else if (reachable && !answers.empty())
+	*reachable = answers[0];
       return false;
     }
 
     // We don't modify the program, so we preserve all analyses
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
-      AU.addRequired<DominatorTree>();
+      AU.addRequired<ReachabilityIndex>();
+      AU.setPreservesAll();
     }
+  };
+  ModulePass *createReachabilityPass(std::string  t_bb, BasicBlock* s_bb, int* in)
+  {    
+    Hello2 *cg2 = new Hello2();
+    cg2->target_bb_names.push_back(t_bb);
+    cg2->start_bbs.push_back(s_bb);
+    cg2->reachable = in;
+    return cg2;
+  }
 
-    bool Ispotentiallyreachable(const BasicBlock *A, const BasicBlock *B , const DominatorTree *DT) {
-      errs() << A->getParent()->getName() <<  " can reach to  " <<  B->getParent()->getName() << "\n" ;
-      assert(A->getParent() == B->getParent() &&
-	     "This analysis is function-local!");
+  // Batched interface: out[i] is set to 1 if t_bbs[i] is reachable from
+  // s_bbs[i], and to 0 otherwise.
+  ModulePass *createReachabilityPass(const std::vector<std::string> &t_bbs,
+				     const std::vector<BasicBlock*> &s_bbs,
+				     std::vector<int> *out)
+  {
+    assert(t_bbs.size() == s_bbs.size() && "Mismatched query lists!");
+    Hello2 *cg2 = new Hello2();
+    cg2->target_bb_names = t_bbs;
+    cg2->start_bbs = s_bbs;
+    cg2->results = out;
+    return cg2;
+  }
 
-      SmallVector<BasicBlock*, 32> Worklist;
-      Worklist.push_back(const_cast<BasicBlock*>(A));
+}
 
-      return isPotentiallyReachableFromMany(Worklist, const_cast<BasicBlock *>(B),
-					    DT);
-    }
+namespace {
+  /// TargetDistance - Computes how far every basic block of the module is from
+  /// the nearest of a set of target blocks, counting the edges of the shortest
+  /// path to it.  Paths follow the CFG, calls from the block of a call site to
+  /// the entry block of the callee, and returns from the blocks of the callee
+  /// that end in a return back to the block of a call site, using the call
+  /// sites the CallGraph knows about.  Indirect calls and calls to
+  /// declarations are not followed.
+  ///
+  /// Only paths that return to the call site they came from are counted.  The
+  /// caller of the function a path starts in is not known, so until the path
+  /// makes a call it may return to any call site of its function.  Once it
+  /// has made a call, it can only continue in the callee and the functions
+  /// that calls, as returning to the call site would only lead back to where
+  /// the call was made.  So the distance of a call site is the smaller of its
+  /// distance within its function and one more than the distance of the entry
+  /// block of the callee, and the distance of a block that can return is at
+  /// most one more than that of the call sites of its function.  Each block
+  /// has a node for paths that may still return and one for paths below a
+  /// call, and return edges only join the former.
+  ///
+  /// Blocks are numbered densely in module order and the distances are kept
+  /// in one table indexed by block number, so a search heuristic can look
+  /// them up in constant time.  When the targets change, only the distances
+  /// the change affects are recomputed.
+  class TargetDistance : public ModulePass {
+    std::vector<BasicBlock*> Blocks;
+    DenseMap<const BasicBlock*, unsigned> BlockNumbers;
+
+    /// Succs, SuccBegin - The nodes a path can go to from node N next are
+    /// Succs[SuccBegin[N]] up to Succs[SuccBegin[N + 1]].  Node N is block N
+    /// on a path that may still return, and node N + Blocks.size() is block N
+    /// below a call.
+    std::vector<unsigned> Succs, SuccBegin;
+
+    /// Preds, PredBegin - Likewise, for the nodes a path can come from.
+    std::vector<unsigned> Preds, PredBegin;
+
+    BitVector IsTarget;
+
+    /// Distances - The distance of every node.  The first Blocks.size()
+    /// entries are the distances of the blocks.
+    std::vector<unsigned> Distances;
 
-    bool isPotentiallyReachableFromMany( SmallVectorImpl<BasicBlock *> &Worklist, BasicBlock *StopBB,
-					 const DominatorTree *DT ) {
+  public:
+    static char ID;
 
-      // Limit the number of blocks we visit. The goal is to avoid run-away compile
-      // times on large CFGs without hampering sensible code. Arbitrarily chosen.
-      unsigned Limit = 32;
-      std::set<BasicBlock*> Visited;
-      do {
-	BasicBlock *BB = Worklist.pop_back_val();
-	if (!Visited.insert(BB).second)
-	  continue;
-	if (BB == StopBB)
-	  return true;
-	if (DT && DT->dominates(BB, StopBB))
-	  return true;
-	if (!--Limit) {
-	  // We haven't been able to prove it one way or the other. Conservatively
-	  // answer true -- that there is potentially a path.
-	  return true;
-	}
-	  Worklist.append(succ_begin(BB), succ_end(BB));
-      } while (!Worklist.empty());
+    /// Unreachable - The distance of blocks no path leads to a target from.
+    static const unsigned Unreachable = ~0U;
+
+    /// InitialTargets - The targets to start with.  If empty, they are read
+    /// from the file given by -distance-targets, if any.
+    std::vector<BasicBlock*> InitialTargets;
+
+    TargetDistance() : ModulePass(ID) {}
 
-      // We have exhausted all possible paths and are certain that 'To' can not be
-      // reached from 'From'.
+    virtual bool runOnModule(Module &M) {
+      releaseMemory();
+      buildGraph(M);
+      Distances.assign(2 * Blocks.size(), Unreachable);
+      IsTarget.resize(Blocks.size());
+      if (InitialTargets.empty() && !DistanceTargets.empty())
+        readTargets(M, DistanceTargets, InitialTargets);
+      setTargets(InitialTargets);
+      if (!DistanceRetarget.empty()) {
+        std::vector<BasicBlock*> Targets;
+        readTargets(M, DistanceRetarget, Targets);
+        setTargets(Targets);
+      }
       return false;
     }
 
+    /// setTargets - Make Targets the target blocks, updating the distances of
+    /// the blocks the change affects only.
+    void setTargets(const std::vector<BasicBlock*> &Targets) {
+      BitVector NewTargets(Blocks.size());
+      for (unsigned i = 0, e = Targets.size(); i != e; ++i)
+        NewTargets.set(getBlockNumber(Targets[i]));
+
+      // Both nodes of a block change.
+      unsigned NumBlocks = Blocks.size();
+      std::vector<unsigned> Removed, Added;
+      for (unsigned N = 0; N != NumBlocks; ++N)
+        if (IsTarget[N] != NewTargets[N]) {
+          IsTarget[N] = NewTargets[N];
+          std::vector<unsigned> &Changed = IsTarget[N] ? Added : Removed;
+          Changed.push_back(N);
+          Changed.push_back(N + NumBlocks);
+        }
+
+      // Removing targets can only make blocks further away and adding them
+      // can only bring blocks closer, so do one and then the other.
+      if (!Removed.empty())
+        raiseDistances(Removed);
+      if (!Added.empty())
+        lowerDistances(Added);
+    }
+
+    /// getBlockNumber - Return the number of BB, which is its index in the
+    /// distance table.
+    unsigned getBlockNumber(const BasicBlock *BB) const {
+      DenseMap<const BasicBlock*, unsigned>::const_iterator I =
+        BlockNumbers.find(BB);
+      assert(I != BlockNumbers.end() && "Block not in this module!");
+      return I->second;
+    }
+
+    /// getBlock - Return the block with number N.
+    BasicBlock *getBlock(unsigned N) const { return Blocks[N]; }
+
+    /// getDistance - Return the distance of block N from the nearest target,
+    /// or Unreachable.
+    unsigned getDistance(unsigned N) const {
+      assert(N < Blocks.size() && "Not a block number!");
+      return Distances[N];
+    }
+
+    /// getDistance - Likewise, for BB.  Blocks of functions that were only
+    /// declared when the pass ran are unreachable.
+    unsigned getDistance(const BasicBlock *BB) const {
+      DenseMap<const BasicBlock*, unsigned>::const_iterator I =
+        BlockNumbers.find(BB);
+      return I == BlockNumbers.end() ? Unreachable : Distances[I->second];
+    }
+
+    /// getDistanceTable - Return the distance of every block, indexed by block
+    /// number.
+    ArrayRef<unsigned> getDistanceTable() const {
+      return ArrayRef<unsigned>(Distances.empty() ? 0 : &Distances[0],
+                                Blocks.size());
+    }
+
+    virtual void releaseMemory() {
+      Blocks.clear();
+      BlockNumbers.clear();
+      Succs.clear();
+      SuccBegin.clear();
+      Preds.clear();
+      PredBegin.clear();
+      IsTarget.clear();
+      Distances.clear();
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<CallGraph>();
+      AU.setPreservesAll();
+    }
+
+    virtual void print(raw_ostream &OS, const Module *) const {
+      OS << "Distances to " << IsTarget.count() << " target blocks:\n";
+      for (unsigned N = 0, e = Blocks.size(); N != e; ++N) {
+        OS << "  " << Blocks[N]->getParent()->getName() << ' ';
+        WriteAsOperand(OS, Blocks[N], false);
+        if (Distances[N] == Unreachable)
+          OS << ": unreachable\n";
+        else
+          OS << ": " << Distances[N] << '\n';
+      }
+    }
+
+  private:
+    /// buildAdjacency - Lay out Edges, sorted by their first member, as the
+    /// adjacency arrays List and Begin.
+    void buildAdjacency(std::vector<std::pair<unsigned, unsigned> > &Edges,
+                        std::vector<unsigned> &List,
+                        std::vector<unsigned> &Begin) {
+      std::sort(Edges.begin(), Edges.end());
+      Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+      unsigned NumNodes = 2 * Blocks.size();
+      List.reserve(Edges.size());
+      Begin.reserve(NumNodes + 1);
+      for (unsigned i = 0, e = Edges.size(); i != e; ++i) {
+        while (Begin.size() <= Edges[i].first)
+          Begin.push_back(List.size());
+        List.push_back(Edges[i].second);
+      }
+      while (Begin.size() <= NumNodes)
+        Begin.push_back(List.size());
+    }
+
+    /// buildGraph - Number the blocks of M and collect the edges paths can
+    /// take between their nodes.
+    void buildGraph(Module &M) {
+      for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F)
+        for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+          BlockNumbers[BB] = Blocks.size();
+          Blocks.push_back(BB);
+        }
+
+      unsigned NumBlocks = Blocks.size();
+      std::vector<std::pair<unsigned, unsigned> > Edges;
+      for (unsigned N = 0; N != NumBlocks; ++N)
+        for (succ_iterator SI = succ_begin(Blocks[N]),
+             SE = succ_end(Blocks[N]); SI != SE; ++SI) {
+          unsigned S = BlockNumbers[*SI];
+          Edges.push_back(std::make_pair(N, S));
+          Edges.push_back(std::make_pair(N + NumBlocks, S + NumBlocks));
+        }
+
+      CallGraph &CG = getAnalysis<CallGraph>();
+      DenseMap<const Function*, SmallVector<unsigned, 2> > ReturnBlocks;
+      for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+        if (F->isDeclaration())
+          continue;
+        CallGraphNode *Node = CG[F];
+        for (CallGraphNode::iterator I = Node->begin(), E = Node->end();
+             I != E; ++I) {
+          Function *Callee = I->second->getFunction();
+          Instruction *Call = dyn_cast_or_null<Instruction>(&*I->first);
+          if (!Callee || Callee->isDeclaration() || !Call)
+            continue;
+
+          DenseMap<const Function*, SmallVector<unsigned, 2> >::iterator
+            RI = ReturnBlocks.find(Callee);
+          if (RI == ReturnBlocks.end()) {
+            RI = ReturnBlocks.insert(std::make_pair(Callee,
+                                     SmallVector<unsigned, 2>())).first;
+            for (Function::iterator BB = Callee->begin(), E = Callee->end();
+                 BB != E; ++BB)
+              if (isa<ReturnInst>(BB->getTerminator()))
+                RI->second.push_back(BlockNumbers[BB]);
+          }
+
+          // A call always leads below the call, and only paths that have not
+          // made one may return.
+          unsigned Site = BlockNumbers[Call->getParent()];
+          unsigned Entry = BlockNumbers[&Callee->front()] + NumBlocks;
+          Edges.push_back(std::make_pair(Site, Entry));
+          Edges.push_back(std::make_pair(Site + NumBlocks, Entry));
+          for (unsigned i = 0, e = RI->second.size(); i != e; ++i)
+            Edges.push_back(std::make_pair(RI->second[i], Site));
+        }
+      }
+
+      buildAdjacency(Edges, Succs, SuccBegin);
+      for (unsigned i = 0, e = Edges.size(); i != e; ++i)
+        std::swap(Edges[i].first, Edges[i].second);
+      buildAdjacency(Edges, Preds, PredBegin);
+    }
+
+    /// readTargets - Add the blocks named in Filename to Targets.  Each line
+    /// names a function and one of its blocks; a line with a block name only
+    /// refers to "func_2", as diffFinder writes when it diffs one function.
+    void readTargets(Module &M, const std::string &Filename,
+                     std::vector<BasicBlock*> &Targets) {
+      std::ifstream In(Filename.c_str());
+      if (!In)
+        report_fatal_error("cannot open distance targets file '" + Filename +
+                           "'");
+      std::string Line;
+      while (std::getline(In, Line)) {
+        std::pair<StringRef, StringRef> Names = StringRef(Line).split(' ');
+        if (Names.first.empty())
+          continue;
+        if (Names.second.empty())
+          Names = std::make_pair(StringRef("func_2"), Names.first);
+        Function *F = M.getFunction(Names.first);
+        BasicBlock *Target = 0;
+        if (F)
+          for (Function::iterator BB = F->begin(), E = F->end(); BB != E;
+               ++BB)
+            if (BB->getName() == Names.second) {
+              Target = BB;
+              break;
+            }
+        if (!Target)
+          errs() << "[Warning] No target block " << Names.second << " in "
+                 << Names.first << "\n";
+        else
+          Targets.push_back(Target);
+      }
+    }
+
+    /// lowerDistances - Bring the nodes that can reach the new targets in
+    /// Sources closer, with a breadth first search backwards from them that
+    /// stops at nodes that are no closer than they were.
+    void lowerDistances(const std::vector<unsigned> &Sources) {
+      std::vector<unsigned> Queue;
+      for (unsigned i = 0, e = Sources.size(); i != e; ++i) {
+        Distances[Sources[i]] = 0;
+        Queue.push_back(Sources[i]);
+      }
+      for (unsigned Head = 0; Head != Queue.size(); ++Head) {
+        unsigned N = Queue[Head];
+        unsigned D = Distances[N] + 1;
+        for (unsigned i = PredBegin[N], e = PredBegin[N + 1]; i != e; ++i)
+          if (D < Distances[Preds[i]]) {
+            Distances[Preds[i]] = D;
+            Queue.push_back(Preds[i]);
+          }
+      }
+    }
+
+    /// raiseDistances - Recompute the distances that relied on the targets in
+    /// Removed, which are no longer targets.
+    void raiseDistances(const std::vector<unsigned> &Removed) {
+      // First find the nodes whose every shortest path went through one of
+      // the removed targets.  They are visited in order of their old
+      // distance, so the nodes one step closer have all been classified by
+      // the time a node is looked at.
+      BitVector Affected(Distances.size());
+      std::vector<unsigned> Queue(Removed);
+      for (unsigned i = 0, e = Removed.size(); i != e; ++i)
+        Affected.set(Removed[i]);
+      for (unsigned Head = 0; Head != Queue.size(); ++Head) {
+        unsigned N = Queue[Head];
+        unsigned D = Distances[N] + 1;
+        for (unsigned i = PredBegin[N], e = PredBegin[N + 1]; i != e; ++i) {
+          unsigned P = Preds[i];
+          if (Affected[P] || Distances[P] != D)
+            continue;
+          bool StillShortest = false;
+          for (unsigned j = SuccBegin[P], je = SuccBegin[P + 1]; j != je; ++j)
+            if (!Affected[Succs[j]] && Distances[Succs[j]] + 1 == D) {
+              StillShortest = true;
+              break;
+            }
+          if (!StillShortest) {
+            Affected.set(P);
+            Queue.push_back(P);
+          }
+        }
+      }
+
+      // Then start each of them from its best unaffected successor, and
+      // settle them in order of distance.
+      typedef std::pair<unsigned, unsigned> DistanceAndBlock;
+      std::priority_queue<DistanceAndBlock, std::vector<DistanceAndBlock>,
+                          std::greater<DistanceAndBlock> > Heap;
+      for (unsigned i = 0, e = Queue.size(); i != e; ++i) {
+        unsigned N = Queue[i];
+        unsigned Best = Unreachable;
+        for (unsigned j = SuccBegin[N], je = SuccBegin[N + 1]; j != je; ++j) {
+          unsigned S = Succs[j];
+          if (!Affected[S] && Distances[S] != Unreachable)
+            Best = std::min(Best, Distances[S] + 1);
+        }
+        Distances[N] = Best;
+        if (Best != Unreachable)
+          Heap.push(std::make_pair(Best, N));
+      }
+      while (!Heap.empty()) {
+        DistanceAndBlock Top = Heap.top();
+        Heap.pop();
+        if (Top.first != Distances[Top.second])
+          continue;
+        unsigned D = Top.first + 1;
+        for (unsigned i = PredBegin[Top.second], e = PredBegin[Top.second + 1];
+             i != e; ++i) {
+          unsigned P = Preds[i];
+          if (Affected[P] && D < Distances[P]) {
+            Distances[P] = D;
+            Heap.push(std::make_pair(D, P));
+          }
+        }
+      }
+    }
   };
-  ModulePass *createReachabilityPass(std::string  t_bb, BasicBlock* s_bb, int* in)
-  {    
-    Hello2 *cg2 = new Hello2();
-    cg2->target_bb_name = t_bb;
-    cg2->reachable = in;
-    cg2->startBB = s_bb;
-    return cg2;
-  }
 
+  // External interface for KLEE: the returned pass computes the distances to
+  // targets when it runs, and can be given new targets with setTargets()
+  // afterwards.
+  TargetDistance *createTargetDistancePass(
+      const std::vector<BasicBlock*> &targets) {
+    TargetDistance *TD = new TargetDistance();
+    TD->InitialTargets = targets;
+    return TD;
+  }
 }
 
 char Hello2::ID = 0;
 static RegisterPass<Hello2>
 Y("ReachabilityFinder", "Finds reachability from the source basicblock towards target basicblock");
+
+char ReachabilityIndex::ID = 0;
+static RegisterPass<ReachabilityIndex>
+Z("block-reachability", "Index block to block reachability", true, true);
+
+char TargetDistance::ID = 0;
+const unsigned TargetDistance::Unreachable;
+static RegisterPass<TargetDistance>
+W("target-distance", "Compute distances to target blocks", false, true);
@@ -776,7 +776,7 @@ Instruction *InstCombiner::visitCallSite(CallSite CS) {
         // Only do this for calls to a function with a body.  A prototype may
         // not actually end up matching the implementation's calling conv for a
         // variety of reasons (e.g. it may be written in assembly).
-        !CalleeF->isDeclaration()) {
+        (!CalleeF->isDeclaration() || CalleeF->isMaterializable())) {
       Instruction *OldCall = CS.getInstruction();
       new StoreInst(ConstantInt::getTrue(Callee->getContext()),
                 UndefValue::get(Type::getInt1PtrTy(Callee->getContext())), 
@@ -881,7 +881,7 @@ bool InstCombiner::transformConstExprCastCall(CallSite CS) {
 
   // Check to see if we are changing the return type...
   if (OldRetTy != NewRetTy) {
-    if (Callee->isDeclaration() &&
+    if (Callee->isDeclaration() && !Callee->isMaterializable() &&
         // Conversion is ok if changing from one pointer type to another or from
         // a pointer to an integer of the same size.
         !((OldRetTy->isPointerTy() || !TD ||
@@ -950,10 +950,12 @@ bool InstCombiner::transformConstExprCastCall(CallSite CS) {
       ParamTy == TD->getIntPtrType(Caller->getContext())) &&
               (ActTy->isPointerTy() ||
               ActTy == TD->getIntPtrType(Caller->getContext()))));
-    if (Callee->isDeclaration() && !isConvertible) return false;
+    if (Callee->isDeclaration() && !Callee->isMaterializable() &&
+        !isConvertible)
+      return false;
   }
 
-  if (Callee->isDeclaration()) {
+  if (Callee->isDeclaration() && !Callee->isMaterializable()) {
     // Do not delete arguments unless we have a function body.
     if (FT->getNumParams() < NumActualArgs && !FT->isVarArg())
       return false;
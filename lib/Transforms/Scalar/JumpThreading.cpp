@@ -16,6 +16,7 @@
 #include "llvm/IntrinsicInst.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Pass.h"
+#include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/Loads.h"
@@ -75,6 +76,7 @@ namespace {
   class JumpThreading : public FunctionPass {
     TargetData *TD;
     LazyValueInfo *LVI;
+    DominatorTree *DT;
 #ifdef NDEBUG
     SmallPtrSet<BasicBlock*, 16> LoopHeaders;
 #else
@@ -106,6 +108,7 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<LazyValueInfo>();
       AU.addPreserved<LazyValueInfo>();
+      AU.addPreserved<DominatorTree>();
     }
 
     void FindLoopHeaders(Function &F);
@@ -144,6 +147,7 @@ bool JumpThreading::runOnFunction(Function &F) {
   DEBUG(dbgs() << "Jump threading on function '" << F.getName() << "'\n");
   TD = getAnalysisIfAvailable<TargetData>();
   LVI = &getAnalysis<LazyValueInfo>();
+  DT = getAnalysisIfAvailable<DominatorTree>();
 
   FindLoopHeaders(F);
 
@@ -191,7 +195,7 @@ bool JumpThreading::runOnFunction(Function &F) {
         // awesome, but it allows us to use AssertingVH to prevent nasty
         // dangling pointer issues within LazyValueInfo.
         LVI->eraseBlock(BB);
-        if (TryToSimplifyUncondBranchFromEmptyBlock(BB)) {
+        if (TryToSimplifyUncondBranchFromEmptyBlock(BB, this)) {
           Changed = true;
           // If we deleted BB and BB was the header of a loop, then the
           // successor is now the header of the loop.
@@ -636,14 +640,8 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
       if (LoopHeaders.erase(SinglePred))
         LoopHeaders.insert(BB);
 
-      // Remember if SinglePred was the entry block of the function.  If so, we
-      // will need to move BB back to the entry position.
-      bool isEntry = SinglePred == &SinglePred->getParent()->getEntryBlock();
       LVI->eraseBlock(SinglePred);
-      MergeBasicBlockIntoOnlyPred(BB);
-
-      if (isEntry && BB != &BB->getParent()->getEntryBlock())
-        BB->moveBefore(&BB->getParent()->getEntryBlock());
+      MergeBasicBlockIntoOnlyPred(BB, this);
       return true;
     }
   }
@@ -675,15 +673,20 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
 
     // Fold the branch/switch.
     TerminatorInst *BBTerm = BB->getTerminator();
+    SmallVector<DominatorTree::UpdateType, 8> Updates;
     for (unsigned i = 0, e = BBTerm->getNumSuccessors(); i != e; ++i) {
       if (i == BestSucc) continue;
       BBTerm->getSuccessor(i)->removePredecessor(BB, true);
+      Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete, BB,
+                                                  BBTerm->getSuccessor(i)));
     }
 
     DEBUG(dbgs() << "  In block '" << BB->getName()
           << "' folding undef terminator: " << *BBTerm << '\n');
     BranchInst::Create(BBTerm->getSuccessor(BestSucc), BBTerm);
     BBTerm->eraseFromParent();
+    if (DT)
+      DT->applyUpdates(Updates);
     return true;
   }
 
@@ -694,7 +697,7 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
     DEBUG(dbgs() << "  In block '" << BB->getName()
           << "' folding terminator: " << *BB->getTerminator() << '\n');
     ++NumFolds;
-    ConstantFoldTerminator(BB);
+    ConstantFoldTerminator(BB, this);
     return true;
   }
 
@@ -739,9 +742,12 @@ bool JumpThreading::ProcessBlock(BasicBlock *BB) {
         if (PI == PE) {
           unsigned ToRemove = Baseline == LazyValueInfo::True ? 1 : 0;
           unsigned ToKeep = Baseline == LazyValueInfo::True ? 0 : 1;
-          CondBr->getSuccessor(ToRemove)->removePredecessor(BB, true);
+          BasicBlock *RemovedSucc = CondBr->getSuccessor(ToRemove);
+          RemovedSucc->removePredecessor(BB, true);
           BranchInst::Create(CondBr->getSuccessor(ToKeep), CondBr);
           CondBr->eraseFromParent();
+          if (DT)
+            DT->deleteEdge(BB, RemovedSucc);
           return true;
         }
       }
@@ -1418,6 +1424,15 @@ bool JumpThreading::ThreadEdge(BasicBlock *BB,
       PredTerm->setSuccessor(i, NewBB);
     }
 
+  if (DT) {
+    DominatorTree::UpdateType Updates[] = {
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, NewBB, SuccBB),
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, PredBB, NewBB),
+      DominatorTree::UpdateType(DomTreeUpdate::Delete, PredBB, BB)
+    };
+    DT->applyUpdates(Updates);
+  }
+
   // At this point, the IR is fully up to date and consistent.  Do a quick scan
   // over the new instructions and zap any that are constants or dead.  This
   // frequently happens because of phi translation.
@@ -1569,6 +1584,17 @@ bool JumpThreading::DuplicateCondBranchOnPHIIntoPred(BasicBlock *BB,
   // Remove the unconditional branch at the end of the PredBB block.
   OldPredBranch->eraseFromParent();
 
+  if (DT) {
+    DominatorTree::UpdateType Updates[] = {
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, PredBB,
+                                BBBranch->getSuccessor(0)),
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, PredBB,
+                                BBBranch->getSuccessor(1)),
+      DominatorTree::UpdateType(DomTreeUpdate::Delete, PredBB, BB)
+    };
+    DT->applyUpdates(Updates);
+  }
+
   ++NumDupes;
   return true;
 }
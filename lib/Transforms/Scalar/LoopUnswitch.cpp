@@ -149,7 +149,7 @@ namespace {
     void EmitPreheaderBranchOnCondition(Value *LIC, Constant *Val,
                                         BasicBlock *TrueDest, 
                                         BasicBlock *FalseDest,
-                                        Instruction *InsertPt);
+                                        BranchInst *OldBranch);
 
     void SimplifyCode(std::vector<Instruction*> &Worklist, Loop *L);
     void RemoveBlockIfDead(BasicBlock *BB,
@@ -210,7 +210,6 @@ bool LoopUnswitch::runOnLoop(Loop *L, LPPassManager &LPM_Ref) {
   LPM = &LPM_Ref;
   DT = getAnalysisIfAvailable<DominatorTree>();
   currentLoop = L;
-  Function *F = currentLoop->getHeader()->getParent();
   bool Changed = false;
   do {
     assert(currentLoop->isLCSSAForm(*DT));
@@ -218,11 +217,6 @@ bool LoopUnswitch::runOnLoop(Loop *L, LPPassManager &LPM_Ref) {
     Changed |= processCurrentLoop();
   } while(redoLoop);
 
-  if (Changed) {
-    // FIXME: Reconstruct dom info, because it is not preserved properly.
-    if (DT)
-      DT->runOnFunction(*F);
-  }
   return Changed;
 }
 
@@ -480,12 +474,14 @@ static Loop *CloneLoop(Loop *L, Loop *PL, ValueToValueMapTy &VM,
 }
 
 /// EmitPreheaderBranchOnCondition - Emit a conditional branch on two values
-/// if LIC == Val, branch to TrueDst, otherwise branch to FalseDest.  Insert the
-/// code immediately before InsertPt.
+/// if LIC == Val, branch to TrueDst, otherwise branch to FalseDest.  The new
+/// branch replaces OldBranch, an unconditional branch, which is deleted.
 void LoopUnswitch::EmitPreheaderBranchOnCondition(Value *LIC, Constant *Val,
                                                   BasicBlock *TrueDest,
                                                   BasicBlock *FalseDest,
-                                                  Instruction *InsertPt) {
+                                                  BranchInst *OldBranch) {
+  assert(OldBranch->isUnconditional() && "Preheader is not split correctly");
+  Instruction *InsertPt = OldBranch;
   // Insert a conditional branch on LIC to the two preheaders.  The original
   // code is the true version and the new code is the false version.
   Value *BranchVal = LIC;
@@ -498,6 +494,20 @@ void LoopUnswitch::EmitPreheaderBranchOnCondition(Value *LIC, Constant *Val,
 
   // Insert the new branch.
   BranchInst *BI = BranchInst::Create(TrueDest, FalseDest, BranchVal, InsertPt);
+  BasicBlock *OldDest = OldBranch->getSuccessor(0);
+  OldBranch->eraseFromParent();
+
+  // The new edges bring in the cloned loop, if there is one, and the blocks
+  // they reach become dominated by the preheader.
+  if (DT) {
+    BasicBlock *BB = BI->getParent();
+    DominatorTree::UpdateType Updates[] = {
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, BB, TrueDest),
+      DominatorTree::UpdateType(DomTreeUpdate::Insert, BB, FalseDest),
+      DominatorTree::UpdateType(DomTreeUpdate::Delete, BB, OldDest)
+    };
+    DT->applyUpdates(Updates);
+  }
 
   // If either edge is critical, split it. This helps preserve LoopSimplify
   // form for enclosing loops.
@@ -536,10 +546,9 @@ void LoopUnswitch::UnswitchTrivialCondition(Loop *L, Value *Cond,
     
   // Okay, now we have a position to branch from and a position to branch to, 
   // insert the new conditional branch.
-  EmitPreheaderBranchOnCondition(Cond, Val, NewExit, NewPH, 
-                                 loopPreheader->getTerminator());
-  LPM->deleteSimpleAnalysisValue(loopPreheader->getTerminator(), L);
-  loopPreheader->getTerminator()->eraseFromParent();
+  BranchInst *OldBR = cast<BranchInst>(loopPreheader->getTerminator());
+  LPM->deleteSimpleAnalysisValue(OldBR, L);
+  EmitPreheaderBranchOnCondition(Cond, Val, NewExit, NewPH, OldBR);
 
   // We need to reprocess this loop, it could be unswitched again.
   redoLoop = true;
@@ -664,9 +673,8 @@ void LoopUnswitch::UnswitchNontrivialCondition(Value *LIC, Constant *Val,
          "Preheader splitting did not work correctly!");
 
   // Emit the new branch that selects between the two versions of this loop.
-  EmitPreheaderBranchOnCondition(LIC, Val, NewBlocks[0], LoopBlocks[0], OldBR);
   LPM->deleteSimpleAnalysisValue(OldBR, L);
-  OldBR->eraseFromParent();
+  EmitPreheaderBranchOnCondition(LIC, Val, NewBlocks[0], LoopBlocks[0], OldBR);
 
   LoopProcessWorklist.push_back(NewLoop);
   redoLoop = true;
@@ -936,10 +944,8 @@ void LoopUnswitch::RewriteLoopBodyWithConditionConstant(Loop *L, Value *LIC,
          PHINode *PN = dyn_cast<PHINode>(II); ++II)
       PN->setIncomingValue(PN->getBasicBlockIndex(Switch),
                            UndefValue::get(PN->getType()));
-    // Tell the domtree about the new block. We don't fully update the
-    // domtree here -- instead we force it to do a full recomputation
-    // after the pass is complete -- but we do need to inform it of
-    // new blocks.
+    // Tell the domtree about the new block.  The edges of NewSISucc are the
+    // same as before, so it is the only change.
     if (DT)
       DT->addNewBlock(Abort, NewSISucc);
   }
@@ -1013,6 +1019,16 @@ void LoopUnswitch::SimplifyCode(std::vector<Instruction*> &Worklist, Loop *L) {
         // If Succ has any successors with PHI nodes, update them to have
         // entries coming from Pred instead of Succ.
         Succ->replaceAllUsesWith(Pred);
+
+        // Pred takes over the blocks Succ dominated.
+        if (DT)
+          if (DomTreeNode *SuccNode = DT->getNode(Succ)) {
+            DomTreeNode *PredNode = DT->getNode(Pred);
+            while (!SuccNode->getChildren().empty())
+              DT->changeImmediateDominator(SuccNode->getChildren().back(),
+                                           PredNode);
+            DT->eraseNode(Succ);
+          }
         
         // Remove Succ from the loop tree.
         LI->removeBlock(Succ);
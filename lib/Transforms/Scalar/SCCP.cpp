@@ -1260,8 +1260,8 @@ CallOverdefined:
     
     // Otherwise, if we have a single return value case, and if the function is
     // a declaration, maybe we can constant fold it.
-    if (F && F->isDeclaration() && !I->getType()->isStructTy() &&
-        canConstantFoldCallTo(F)) {
+    if (F && F->isDeclaration() && !F->isMaterializable() &&
+        !I->getType()->isStructTy() && canConstantFoldCallTo(F)) {
       
       SmallVector<Constant*, 8> Operands;
       for (CallSite::arg_iterator AI = CS.arg_begin(), E = CS.arg_end();
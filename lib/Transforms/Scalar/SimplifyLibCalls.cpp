@@ -1603,9 +1603,11 @@ bool SimplifyLibCalls::runOnFunction(Function &F) {
       CallInst *CI = dyn_cast<CallInst>(I++);
       if (!CI) continue;
 
-      // Ignore indirect calls and calls to non-external functions.
+      // Ignore indirect calls and calls to non-external functions.  A body
+      // that has not been read in yet still counts as a definition.
       Function *Callee = CI->getCalledFunction();
       if (Callee == 0 || !Callee->isDeclaration() ||
+          Callee->isMaterializable() ||
           !(Callee->hasExternalLinkage() || Callee->hasDLLImportLinkage()))
         continue;
 
@@ -2326,7 +2328,7 @@ bool SimplifyLibCalls::doInitialization(Module &M) {
   Modified = false;
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
     Function &F = *I;
-    if (F.isDeclaration() && F.hasName())
+    if (F.isDeclaration() && !F.isMaterializable() && F.hasName())
       inferPrototypeAttributes(F);
   }
   return Modified;
@@ -40,11 +40,10 @@ using namespace llvm;
 //  Local constant propagation.
 //
 
-// ConstantFoldTerminator - If a terminator instruction is predicated on a
-// constant value, convert it into an unconditional branch to the constant
-// destination.
+// FoldTerminator - If a terminator instruction is predicated on a constant
+// value, convert it into an unconditional branch to the constant destination.
 //
-bool llvm::ConstantFoldTerminator(BasicBlock *BB) {
+static bool FoldTerminator(BasicBlock *BB) {
   TerminatorInst *T = BB->getTerminator();
 
   // Branch - See if we are conditional jumping on constant
@@ -198,6 +197,28 @@ bool llvm::ConstantFoldTerminator(BasicBlock *BB) {
   return false;
 }
 
+// ConstantFoldTerminator - Fold the terminator of BB and tell the dominator
+// tree which successors BB no longer branches to.
+//
+bool llvm::ConstantFoldTerminator(BasicBlock *BB, Pass *P) {
+  DominatorTree *DT = P ? P->getAnalysisIfAvailable<DominatorTree>() : 0;
+  if (!DT)
+    return FoldTerminator(BB);
+
+  SmallVector<BasicBlock*, 8> OldSuccs(succ_begin(BB), succ_end(BB));
+  if (!FoldTerminator(BB))
+    return false;
+
+  SmallVector<DominatorTree::UpdateType, 8> Updates;
+  SmallPtrSet<BasicBlock*, 8> Seen(succ_begin(BB), succ_end(BB));
+  for (unsigned i = 0, e = OldSuccs.size(); i != e; ++i)
+    if (Seen.insert(OldSuccs[i]))
+      Updates.push_back(DominatorTree::UpdateType(DomTreeUpdate::Delete, BB,
+                                                  OldSuccs[i]));
+  DT->applyUpdates(Updates);
+  return true;
+}
+
 
 //===----------------------------------------------------------------------===//
 //  Local dead code elimination.
@@ -392,6 +413,7 @@ void llvm::MergeBasicBlockIntoOnlyPred(BasicBlock *DestBB, Pass *P) {
   
   BasicBlock *PredBB = DestBB->getSinglePredecessor();
   assert(PredBB && "Block doesn't have a single predecessor!");
+  bool ReplaceEntryBB = PredBB == &DestBB->getParent()->getEntryBlock();
   
   // Splice all the instructions from PredBB to DestBB.
   PredBB->getTerminator()->eraseFromParent();
@@ -411,13 +433,14 @@ void llvm::MergeBasicBlockIntoOnlyPred(BasicBlock *DestBB, Pass *P) {
   // Anything that branched to PredBB now branches to DestBB.
   PredBB->replaceAllUsesWith(DestBB);
   
+  DominatorTree *DT = 0;
   if (P) {
-    DominatorTree *DT = P->getAnalysisIfAvailable<DominatorTree>();
-    if (DT) {
-      BasicBlock *PredBBIDom = DT->getNode(PredBB)->getIDom()->getBlock();
-      DT->changeImmediateDominator(DestBB, PredBBIDom);
-      DT->eraseNode(PredBB);
-    }
+    DT = P->getAnalysisIfAvailable<DominatorTree>();
+    if (DT && !ReplaceEntryBB)
+      if (DomTreeNode *PredNode = DT->getNode(PredBB)) {
+        DT->changeImmediateDominator(DestBB, PredNode->getIDom()->getBlock());
+        DT->eraseNode(PredBB);
+      }
     ProfileInfo *PI = P->getAnalysisIfAvailable<ProfileInfo>();
     if (PI) {
       PI->replaceAllUses(PredBB, DestBB);
@@ -426,6 +449,16 @@ void llvm::MergeBasicBlockIntoOnlyPred(BasicBlock *DestBB, Pass *P) {
   }
   // Nuke BB.
   PredBB->eraseFromParent();
+
+  // DestBB takes over as the entry block, and as the root of the dominator
+  // tree.
+  if (ReplaceEntryBB) {
+    Function *F = DestBB->getParent();
+    if (DestBB != &F->getEntryBlock())
+      DestBB->moveBefore(&F->getEntryBlock());
+    if (DT)
+      DT->runOnFunction(*F);
+  }
 }
 
 /// CanPropagatePredecessorsForPHIs - Return true if we can fold BB, an
@@ -505,7 +538,7 @@ static bool CanPropagatePredecessorsForPHIs(BasicBlock *BB, BasicBlock *Succ) {
 /// potential debug intrinsics and the branch.  If possible, eliminate BB by
 /// rewriting all the predecessors to branch to the successor block and return
 /// true.  If we can't transform, return false.
-bool llvm::TryToSimplifyUncondBranchFromEmptyBlock(BasicBlock *BB) {
+bool llvm::TryToSimplifyUncondBranchFromEmptyBlock(BasicBlock *BB, Pass *P) {
   assert(BB != &BB->getParent()->getEntryBlock() &&
          "TryToSimplifyUncondBranchFromEmptyBlock called on entry block!");
 
@@ -592,6 +625,15 @@ bool llvm::TryToSimplifyUncondBranchFromEmptyBlock(BasicBlock *BB) {
     }
   }
     
+  // If BB dominated Succ, BB's immediate dominator takes its place.  Succ is
+  // the only block BB can have dominated, since it is its only successor.
+  if (DominatorTree *DT = P ? P->getAnalysisIfAvailable<DominatorTree>() : 0)
+    if (DomTreeNode *BBNode = DT->getNode(BB)) {
+      if (DT->getNode(Succ)->getIDom() == BBNode)
+        DT->changeImmediateDominator(Succ, BBNode->getIDom()->getBlock());
+      DT->eraseNode(BB);
+    }
+
   // Everything that jumped to BB now goes to Succ.
   BB->replaceAllUsesWith(Succ);
   if (!Succ->hasName()) Succ->takeName(BB);
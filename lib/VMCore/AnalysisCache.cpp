@@ -0,0 +1,268 @@
+//===- AnalysisCache.cpp - Function analyses kept across runs -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the AnalysisCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "analysis-cache"
+#include "llvm/AnalysisCache.h"
+#include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/PassManagers.h"
+#include "llvm/Support/ValueHandle.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumReused,   "Number of analysis results reused");
+STATISTIC(NumComputed, "Number of analysis results computed");
+
+/// AnalysisInfo - What the cache knows about one of its analyses.
+struct AnalysisCache::AnalysisInfo {
+  /// Inspected - True once the fields below are filled in.
+  bool Inspected;
+
+  /// IsFunctionAnalysis - True if the analysis is a function pass that can
+  /// be created from its PassInfo.
+  bool IsFunctionAnalysis;
+
+  /// Usage - The analysis usage of the pass.
+  AnalysisUsage Usage;
+
+  AnalysisInfo() : Inspected(false), IsFunctionAnalysis(false) {}
+};
+
+/// FunctionResults - The analysis instances kept for one function.  They are
+/// deleted along with the function.
+class AnalysisCache::FunctionResults : public CallbackVH {
+  AnalysisCache *Cache;
+
+public:
+  struct Result {
+    AnalysisID ID;
+    FunctionPass *P;
+    bool Valid;
+  };
+  SmallVector<Result, 4> Entries;
+
+  FunctionResults(Function *F, AnalysisCache *C) : CallbackVH(F), Cache(C) {}
+
+  virtual ~FunctionResults() {
+    invalidate(0);
+    for (unsigned i = 0, e = Entries.size(); i != e; ++i)
+      delete Entries[i].P;
+  }
+
+  /// lookup - Return the entry for ID, adding an empty one if needed.
+  Result &lookup(AnalysisID ID) {
+    for (unsigned i = 0, e = Entries.size(); i != e; ++i)
+      if (Entries[i].ID == ID)
+        return Entries[i];
+    Result R = { ID, 0, false };
+    Entries.push_back(R);
+    return Entries.back();
+  }
+
+  /// invalidate - Release the results not in Preserved, or all of them if
+  /// Preserved is null.
+  void invalidate(const AnalysisUsage::VectorType *Preserved) {
+    for (unsigned i = 0, e = Entries.size(); i != e; ++i) {
+      Result &R = Entries[i];
+      if (!R.Valid)
+        continue;
+      if (Preserved &&
+          std::find(Preserved->begin(), Preserved->end(), R.ID) !=
+            Preserved->end())
+        continue;
+      R.P->releaseMemory();
+      R.Valid = false;
+    }
+  }
+
+  virtual void deleted() {
+    // This deletes the handle.
+    Cache->forget(cast<Function>(getValPtr()));
+  }
+};
+
+namespace {
+  /// CacheManager - The pass manager of the analysis instances kept in an
+  /// AnalysisCache.  It has no passes of its own: the instances find whatever
+  /// else they ask for through the top level manager that asked for them.
+  class CacheManager : public PMDataManager {
+  public:
+    CacheManager() : PMDataManager(0) {}
+    virtual Pass *getAsPass() { return 0; }
+  };
+}
+
+AnalysisCache::AnalysisCache()
+  : CurrentFunction(0), Manager(new CacheManager()), NumHits(0), NumMisses(0) {
+}
+
+AnalysisCache::~AnalysisCache() {
+  clear();
+  DeleteContainerSeconds(Infos);
+  delete Manager;
+}
+
+void AnalysisCache::addAnalysis(AnalysisID ID) {
+  AnalysisInfo *&Info = Infos[ID];
+  if (!Info)
+    Info = new AnalysisInfo();
+}
+
+void AnalysisCache::invalidate(Function &F) {
+  DenseMap<const Function*, FunctionResults*>::iterator I = Results.find(&F);
+  if (I != Results.end())
+    I->second->invalidate(0);
+}
+
+void AnalysisCache::invalidate(Function &F, const AnalysisUsage &AU) {
+  if (AU.getPreservesAll())
+    return;
+  DenseMap<const Function*, FunctionResults*>::iterator I = Results.find(&F);
+  if (I != Results.end())
+    I->second->invalidate(&AU.getPreservedSet());
+}
+
+void AnalysisCache::invalidate(const AnalysisUsage &AU) {
+  if (AU.getPreservesAll())
+    return;
+  for (DenseMap<const Function*, FunctionResults*>::iterator
+       I = Results.begin(), E = Results.end(); I != E; ++I)
+    I->second->invalidate(&AU.getPreservedSet());
+}
+
+void AnalysisCache::clear() {
+  DeleteContainerSeconds(Results);
+}
+
+/// forget - Delete the results for F, which is going away.
+void AnalysisCache::forget(const Function *F) {
+  DenseMap<const Function*, FunctionResults*>::iterator I = Results.find(F);
+  assert(I != Results.end() && "Function has no results!");
+  FunctionResults *FR = I->second;
+  Results.erase(I);
+  delete FR;
+}
+
+/// getInfo - Return what is known about the analysis with the given ID, or
+/// null if it is not one of the analyses to keep.
+AnalysisCache::AnalysisInfo *AnalysisCache::getInfo(AnalysisID ID) {
+  DenseMap<AnalysisID, AnalysisInfo*>::iterator I = Infos.find(ID);
+  if (I == Infos.end())
+    return 0;
+
+  AnalysisInfo *Info = I->second;
+  if (!Info->Inspected) {
+    Info->Inspected = true;
+    const PassInfo *PI = PassRegistry::getPassRegistry()->getPassInfo(ID);
+    if (PI && PI->isAnalysis() && !PI->isAnalysisGroup() &&
+        PI->getNormalCtor()) {
+      Pass *P = PI->createPass();
+      if (P->getPassKind() == PT_Function) {
+        Info->IsFunctionAnalysis = true;
+        P->getAnalysisUsage(Info->Usage);
+      }
+      delete P;
+    }
+  }
+  return Info;
+}
+
+/// isCached - Return true if the analysis with the given ID is kept.  The
+/// analyses it requires are looked up in PM, and must be immutable passes or
+/// be kept as well.
+bool AnalysisCache::isCached(AnalysisID ID, PMDataManager &PM) {
+  AnalysisInfo *Info = getInfo(ID);
+  if (!Info || !Info->IsFunctionAnalysis)
+    return false;
+
+  const AnalysisUsage::VectorType &Required = Info->Usage.getRequiredSet();
+  for (AnalysisUsage::VectorType::const_iterator I = Required.begin(),
+       E = Required.end(); I != E; ++I) {
+    Pass *Impl = PM.findAnalysisPass(*I, true);
+    if (Impl && Impl->getAsImmutablePass())
+      continue;
+    if (!isCached(Impl ? Impl->getPassID() : *I, PM))
+      return false;
+  }
+  return true;
+}
+
+/// getResult - Return the instance of the analysis with the given ID for F,
+/// computing its results if they are out of date.
+Pass *AnalysisCache::getResult(AnalysisID ID, Function &F, PMDataManager &PM) {
+  FunctionResults *FR = Results[&F];
+  if (!FR)
+    FR = Results[&F] = new FunctionResults(&F, this);
+
+  // Whatever the instance asks for later is found through the manager that
+  // asked for it last.
+  Manager->setTopLevelManager(PM.getTopLevelManager());
+
+  if (FR->lookup(ID).Valid)
+    return FR->lookup(ID).P;
+
+  // Bring the analyses it requires up to date first.
+  SmallVector<std::pair<AnalysisID, Pass*>, 4> Impls;
+  const AnalysisUsage::VectorType &Required =
+    getInfo(ID)->Usage.getRequiredSet();
+  for (AnalysisUsage::VectorType::const_iterator I = Required.begin(),
+       E = Required.end(); I != E; ++I) {
+    Pass *Impl = PM.findAnalysisPass(*I, true);
+    if (!Impl || !Impl->getAsImmutablePass())
+      Impl = getResult(Impl ? Impl->getPassID() : *I, F, PM);
+    Impls.push_back(std::make_pair(*I, Impl));
+  }
+
+  // The recursive calls may have grown the entries, so look this one up
+  // again.
+  FunctionResults::Result &R = FR->lookup(ID);
+  if (!R.P) {
+    const PassInfo *PI = PassRegistry::getPassRegistry()->getPassInfo(ID);
+    R.P = static_cast<FunctionPass*>(PI->createPass());
+    R.P->setResolver(new AnalysisResolver(*Manager));
+    R.P->doInitialization(*F.getParent());
+  }
+
+  AnalysisResolver *AR = R.P->getResolver();
+  AR->clearAnalysisImpls();
+  for (unsigned i = 0, e = Impls.size(); i != e; ++i)
+    AR->addAnalysisImplsPair(Impls[i].first, Impls[i].second);
+
+  {
+    PassManagerPrettyStackEntry X(R.P, F);
+    R.P->runOnFunction(F);
+  }
+  R.Valid = true;
+  ++NumMisses;
+  ++NumComputed;
+  return R.P;
+}
+
+Pass *AnalysisCache::getCachedPass(Pass *P, Function &F, PMDataManager &PM) {
+  if (F.isDeclaration() || !isCached(P, PM))
+    return P;
+  return getResult(P->getPassID(), F, PM);
+}
+
+void AnalysisCache::runCachedPass(Pass *P, Function &F, PMDataManager &PM) {
+  DenseMap<const Function*, FunctionResults*>::iterator I = Results.find(&F);
+  if (I != Results.end() && I->second->lookup(P->getPassID()).Valid) {
+    ++NumHits;
+    ++NumReused;
+    return;
+  }
+  getResult(P->getPassID(), F, PM);
+}
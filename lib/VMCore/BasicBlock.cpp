@@ -89,6 +89,13 @@ void BasicBlock::setParent(Function *parent) {
   // Set Parent=parent, updating instruction symtab entries as appropriate.
   InstList.setSymTabObject(&Parent, parent);
 
+#ifndef NDEBUG
+  if (parent)
+    for (iterator I = begin(), E = end(); I != E; ++I)
+      assert((!I->isArenaAllocated() || parent->isInArena(I)) &&
+             "Arena allocated instruction moved into another function!");
+#endif
+
   if (getParent())
     LeakDetector::removeGarbageObject(this);
 }
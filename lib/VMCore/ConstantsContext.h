@@ -18,10 +18,12 @@
 #include "llvm/InlineAsm.h"
 #include "llvm/Instructions.h"
 #include "llvm/Operator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
-#include <map>
+#include <algorithm>
 
 namespace llvm {
 template<class ValType>
@@ -336,6 +338,15 @@ struct ExprMapKeyType {
   bool operator!=(const ExprMapKeyType& that) const {
     return !(*this == that);
   }
+  unsigned getHashValue() const {
+    unsigned Hash = (unsigned(opcode) << 24) ^
+                    (unsigned(subclassoptionaldata) << 16) ^ subclassdata;
+    for (unsigned i = 0, e = operands.size(); i != e; ++i)
+      Hash = Hash * 37 + DenseMapInfo<Constant*>::getHashValue(operands[i]);
+    for (unsigned i = 0, e = indices.size(); i != e; ++i)
+      Hash = Hash * 37 + indices[i];
+    return Hash;
+  }
 };
 
 struct InlineAsmKeyType {
@@ -369,8 +380,44 @@ struct InlineAsmKeyType {
   bool operator!=(const InlineAsmKeyType& that) const {
     return !(*this == that);
   }
+  unsigned getHashValue() const {
+    return HashString(constraints, HashString(asm_string)) * 37 +
+           has_side_effects * 2 + is_align_stack;
+  }
 };
 
+// getConstantKeyHash - Hash the value that, with a type, is the key of a
+// constant in a ConstantUniqueMap.
+static inline unsigned getConstantKeyHash(char) {
+  return 0;
+}
+
+static inline unsigned getConstantKeyHash(const std::vector<Constant*> &V) {
+  unsigned Hash = V.size();
+  for (unsigned i = 0, e = V.size(); i != e; ++i)
+    Hash = Hash * 37 + DenseMapInfo<Constant*>::getHashValue(V[i]);
+  return Hash;
+}
+
+static inline unsigned getConstantKeyHash(const ExprMapKeyType &V) {
+  return V.getHashValue();
+}
+
+static inline unsigned getConstantKeyHash(const InlineAsmKeyType &V) {
+  return V.getHashValue();
+}
+
+// operandsMatch - Return true if the operands of U are V.
+static inline bool operandsMatch(const User *U,
+                                 const std::vector<Constant*> &V) {
+  if (U->getNumOperands() != V.size())
+    return false;
+  for (unsigned i = 0, e = V.size(); i != e; ++i)
+    if (U->getOperand(i) != V[i])
+      return false;
+  return true;
+}
+
 // The number of operands for each ConstantCreator::create method is
 // determined by the ConstantTraits template.
 // ConstantCreator - A class that is used to create constants by
@@ -399,6 +446,9 @@ struct ConstantCreator {
   }
 };
 
+// ConstantKeyData - getValType returns the value that, with its type, is the
+// key of a constant.  matches returns true if the key of a constant has the
+// value V, without building it.
 template<class ConstantClass>
 struct ConstantKeyData {
   typedef void ValType;
@@ -467,6 +517,15 @@ struct ConstantKeyData<ConstantExpr> {
         CE->hasIndices() ?
           CE->getIndices() : SmallVector<unsigned, 4>());
   }
+  static bool matches(ConstantExpr *CE, const ValType &V) {
+    if (CE->getOpcode() != V.opcode ||
+        CE->getRawSubclassOptionalData() != V.subclassoptionaldata ||
+        (CE->isCompare() ? CE->getPredicate() : 0) != V.subclassdata ||
+        !operandsMatch(CE, V.operands))
+      return false;
+    return CE->hasIndices() ? CE->getIndices() == V.indices
+                            : V.indices.empty();
+  }
 };
 
 // ConstantAggregateZero does not take extra "value" argument...
@@ -487,6 +546,9 @@ struct ConstantKeyData<ConstantVector> {
       Elements.push_back(CP->getOperand(i));
     return Elements;
   }
+  static bool matches(ConstantVector *CP, const ValType &V) {
+    return operandsMatch(CP, V);
+  }
 };
 
 template<>
@@ -495,6 +557,9 @@ struct ConstantKeyData<ConstantAggregateZero> {
   static ValType getValType(ConstantAggregateZero *C) {
     return 0;
   }
+  static bool matches(ConstantAggregateZero *C, ValType V) {
+    return true;
+  }
 };
 
 template<>
@@ -507,6 +572,9 @@ struct ConstantKeyData<ConstantArray> {
       Elements.push_back(cast<Constant>(CA->getOperand(i)));
     return Elements;
   }
+  static bool matches(ConstantArray *CA, const ValType &V) {
+    return operandsMatch(CA, V);
+  }
 };
 
 template<>
@@ -519,6 +587,9 @@ struct ConstantKeyData<ConstantStruct> {
       Elements.push_back(cast<Constant>(CS->getOperand(i)));
     return Elements;
   }
+  static bool matches(ConstantStruct *CS, const ValType &V) {
+    return operandsMatch(CS, V);
+  }
 };
 
 // ConstantPointerNull does not take extra "value" argument...
@@ -535,6 +606,9 @@ struct ConstantKeyData<ConstantPointerNull> {
   static ValType getValType(ConstantPointerNull *C) {
     return 0;
   }
+  static bool matches(ConstantPointerNull *C, ValType V) {
+    return true;
+  }
 };
 
 // UndefValue does not take extra "value" argument...
@@ -551,6 +625,9 @@ struct ConstantKeyData<UndefValue> {
   static ValType getValType(UndefValue *C) {
     return 0;
   }
+  static bool matches(UndefValue *C, ValType V) {
+    return true;
+  }
 };
 
 template<>
@@ -568,221 +645,257 @@ struct ConstantKeyData<InlineAsm> {
     return InlineAsmKeyType(Asm->getAsmString(), Asm->getConstraintString(),
                             Asm->hasSideEffects(), Asm->isAlignStack());
   }
+  static bool matches(InlineAsm *Asm, const ValType &V) {
+    return Asm->getAsmString() == V.asm_string &&
+           Asm->getConstraintString() == V.constraints &&
+           Asm->hasSideEffects() == V.has_side_effects &&
+           Asm->isAlignStack() == V.is_align_stack;
+  }
 };
 
-template<class ValType, class TypeClass, class ConstantClass,
-         bool HasLargeKey = false /*true for arrays and structs*/ >
+/// ConstantUniqueMap - The uniquing table of one kind of constant.  It is an
+/// open addressed hash table of the constants themselves, with their hashes:
+/// a constant is its own key, so looking one up neither allocates nor stores
+/// a copy of the key, and the constants it finds are compared to the key in
+/// place.
+template<class ValType, class TypeClass, class ConstantClass>
 class ConstantUniqueMap : public AbstractTypeUser {
-public:
-  typedef std::pair<const TypeClass*, ValType> MapKey;
-  typedef std::map<MapKey, ConstantClass *> MapTy;
-  typedef std::map<ConstantClass *, typename MapTy::iterator> InverseMapTy;
-  typedef std::map<const DerivedType*, typename MapTy::iterator>
-    AbstractTypeMapTy;
-private:
-  /// Map - This is the main map from the element descriptor to the Constants.
-  /// This is the primary way we avoid creating two of the same shape
-  /// constant.
-  MapTy Map;
-    
-  /// InverseMap - If "HasLargeKey" is true, this contains an inverse mapping
-  /// from the constants to their element in Map.  This is important for
-  /// removal of constants from the array, which would otherwise have to scan
-  /// through the map with very large keys.
-  InverseMapTy InverseMap;
-
-  /// AbstractTypeMap - Map for abstract type constants.
+  struct Bucket {
+    unsigned Hash;
+    ConstantClass *C;   // Null if the bucket is empty.
+  };
+
+  /// Buckets - The table.  Its size is zero or a power of two.
+  std::vector<Bucket> Buckets;
+  unsigned NumEntries, NumTombstones;
+
+  /// AbstractTypeMap - The constants of each abstract type.
   ///
+  typedef DenseMap<const DerivedType*, std::vector<ConstantClass*> >
+    AbstractTypeMapTy;
   AbstractTypeMapTy AbstractTypeMap;
-    
+
+  static ConstantClass *getTombstone() {
+    return DenseMapInfo<ConstantClass*>::getTombstoneKey();
+  }
+
+  static bool isLive(const Bucket &B) {
+    return B.C != 0 && B.C != getTombstone();
+  }
+
+  static unsigned getHash(const TypeClass *Ty, const ValType &V) {
+    unsigned Hash = DenseMapInfo<const TypeClass*>::getHashValue(Ty) * 37 +
+                    getConstantKeyHash(V);
+    // Mix the high bits into the ones that pick the bucket.
+    Hash ^= Hash >> 16;
+    Hash *= 0x85ebca6bU;
+    return Hash ^ (Hash >> 13);
+  }
+
+  static unsigned getHash(ConstantClass *C) {
+    return getHash(static_cast<const TypeClass*>(C->getRawType()),
+                   ConstantKeyData<ConstantClass>::getValType(C));
+  }
+
 public:
-  typename MapTy::iterator map_begin() { return Map.begin(); }
-  typename MapTy::iterator map_end() { return Map.end(); }
+  ConstantUniqueMap() : NumEntries(0), NumTombstones(0) {}
 
   void freeConstants() {
-    for (typename MapTy::iterator I=Map.begin(), E=Map.end();
-         I != E; ++I) {
-      // Asserts that use_empty().
-      delete I->second;
-    }
+    for (unsigned i = 0, e = Buckets.size(); i != e; ++i)
+      if (isLive(Buckets[i]))
+        delete Buckets[i].C;  // Asserts that use_empty().
+  }
+
+  /// dropAllReferences - Drop the operands of all the constants, so that they
+  /// can be freed in any order.
+  void dropAllReferences() {
+    for (unsigned i = 0, e = Buckets.size(); i != e; ++i)
+      if (isLive(Buckets[i]))
+        Buckets[i].C->dropAllReferences();
   }
-    
-  /// InsertOrGetItem - Return an iterator for the specified element.
-  /// If the element exists in the map, the returned iterator points to the
-  /// entry and Exists=true.  If not, the iterator points to the newly
-  /// inserted entry and returns Exists=false.  Newly inserted entries have
-  /// I->second == 0, and should be filled in.
-  typename MapTy::iterator InsertOrGetItem(std::pair<MapKey, ConstantClass *>
-                                 &InsertVal,
-                                 bool &Exists) {
-    std::pair<typename MapTy::iterator, bool> IP = Map.insert(InsertVal);
-    Exists = !IP.second;
-    return IP.first;
-  }
-    
+
 private:
-  typename MapTy::iterator FindExistingElement(ConstantClass *CP) {
-    if (HasLargeKey) {
-      typename InverseMapTy::iterator IMI = InverseMap.find(CP);
-      assert(IMI != InverseMap.end() && IMI->second != Map.end() &&
-             IMI->second->second == CP &&
-             "InverseMap corrupt!");
-      return IMI->second;
+  /// LookupBucketFor - Return true and set BucketNo to the bucket of the
+  /// constant for the key (Ty, V) if there is one.  Otherwise return false and
+  /// set BucketNo to the bucket to insert it in.
+  bool LookupBucketFor(const TypeClass *Ty, const ValType &V, unsigned Hash,
+                       unsigned &BucketNo) const {
+    if (Buckets.empty()) {
+      BucketNo = ~0U;
+      return false;
+    }
+    unsigned Mask = Buckets.size() - 1;
+    unsigned FoundTombstone = ~0U;
+    BucketNo = Hash & Mask;
+    for (unsigned ProbeAmt = 1; ; ++ProbeAmt) {
+      const Bucket &B = Buckets[BucketNo];
+      if (B.C == 0) {
+        if (FoundTombstone != ~0U)
+          BucketNo = FoundTombstone;
+        return false;
+      }
+      if (B.C == getTombstone()) {
+        if (FoundTombstone == ~0U)
+          FoundTombstone = BucketNo;
+      } else if (B.Hash == Hash && B.C->getRawType() == Ty &&
+                 ConstantKeyData<ConstantClass>::matches(B.C, V)) {
+        return true;
+      }
+      BucketNo = (BucketNo + ProbeAmt) & Mask;
     }
-      
-    typename MapTy::iterator I =
-      Map.find(MapKey(static_cast<const TypeClass*>(CP->getRawType()),
-                      ConstantKeyData<ConstantClass>::getValType(CP)));
-    if (I == Map.end() || I->second != CP) {
-      // FIXME: This should not use a linear scan.  If this gets to be a
-      // performance problem, someone should look at this.
-      for (I = Map.begin(); I != Map.end() && I->second != CP; ++I)
-        /* empty */;
+  }
+
+  /// FindExistingElement - Return the bucket of CP.
+  unsigned FindExistingElement(ConstantClass *CP) const {
+    unsigned Mask = Buckets.size() - 1;
+    unsigned BucketNo = getHash(CP) & Mask;
+    for (unsigned ProbeAmt = 1; Buckets[BucketNo].C != 0; ++ProbeAmt) {
+      if (Buckets[BucketNo].C == CP)
+        return BucketNo;
+      BucketNo = (BucketNo + ProbeAmt) & Mask;
+    }
+
+    // The key of CP changed since it was inserted.  FIXME: This should not use
+    // a linear scan.  If this gets to be a performance problem, someone should
+    // look at this.
+    for (BucketNo = 0; Buckets[BucketNo].C != CP; ++BucketNo)
+      assert(BucketNo + 1 != Buckets.size() &&
+             "Constant not found in constant table!");
+    return BucketNo;
+  }
+
+  /// grow - Make room for one more constant, rehashing into a larger table
+  /// when it is three quarters full.
+  void grow() {
+    unsigned NumBuckets = Buckets.size();
+    if ((NumEntries + NumTombstones + 1) * 4 < NumBuckets * 3)
+      return;
+    if ((NumEntries + 1) * 4 >= NumBuckets * 2)
+      NumBuckets = std::max(NumBuckets * 2, 64U);
+
+    std::vector<Bucket> OldBuckets(NumBuckets);
+    OldBuckets.swap(Buckets);
+    NumTombstones = 0;
+    unsigned Mask = NumBuckets - 1;
+    for (unsigned i = 0, e = OldBuckets.size(); i != e; ++i) {
+      if (!isLive(OldBuckets[i]))
+        continue;
+      unsigned BucketNo = OldBuckets[i].Hash & Mask;
+      for (unsigned ProbeAmt = 1; Buckets[BucketNo].C != 0; ++ProbeAmt)
+        BucketNo = (BucketNo + ProbeAmt) & Mask;
+      Buckets[BucketNo] = OldBuckets[i];
     }
-    return I;
   }
-    
-  void AddAbstractTypeUser(const Type *Ty, typename MapTy::iterator I) {
+
+  /// Insert - Add C, whose key is (Ty, V), which is not in the table.
+  void Insert(ConstantClass *C, const TypeClass *Ty, const ValType &V,
+              unsigned Hash) {
+    grow();
+    unsigned BucketNo;
+    bool Found = LookupBucketFor(Ty, V, Hash, BucketNo);
+    assert(!Found && "Constant is already in the table!"); (void)Found;
+    Bucket &B = Buckets[BucketNo];
+    if (B.C == getTombstone())
+      --NumTombstones;
+    B.Hash = Hash;
+    B.C = C;
+    ++NumEntries;
+  }
+
+  /// Erase - Remove the constant in bucket BucketNo.
+  void Erase(unsigned BucketNo) {
+    Buckets[BucketNo].C = getTombstone();
+    --NumEntries;
+    ++NumTombstones;
+  }
+
+  void AddAbstractTypeUser(const Type *Ty, ConstantClass *C) {
     // If the type of the constant is abstract, make sure that an entry
     // exists for it in the AbstractTypeMap.
     if (Ty->isAbstract()) {
       const DerivedType *DTy = static_cast<const DerivedType *>(Ty);
-      typename AbstractTypeMapTy::iterator TI = AbstractTypeMap.find(DTy);
-
-      if (TI == AbstractTypeMap.end()) {
-        // Add ourselves to the ATU list of the type.
+      std::vector<ConstantClass*> &Constants = AbstractTypeMap[DTy];
+      // Add ourselves to the ATU list of the type.
+      if (Constants.empty())
         cast<DerivedType>(DTy)->addAbstractTypeUser(this);
+      Constants.push_back(C);
+    }
+  }
 
-        AbstractTypeMap.insert(TI, std::make_pair(DTy, I));
-      }
+  void RemoveAbstractTypeUser(const Type *Ty, ConstantClass *C) {
+    if (!Ty->isAbstract())
+      return;
+    const DerivedType *DTy = static_cast<const DerivedType *>(Ty);
+    typename AbstractTypeMapTy::iterator I = AbstractTypeMap.find(DTy);
+    assert(I != AbstractTypeMap.end() &&
+           "Abstract type not in AbstractTypeMap?");
+    std::vector<ConstantClass*> &Constants = I->second;
+    typename std::vector<ConstantClass*>::iterator CI =
+      std::find(Constants.begin(), Constants.end(), C);
+    assert(CI != Constants.end() && "Constant not in AbstractTypeMap?");
+    *CI = Constants.back();
+    Constants.pop_back();
+
+    // If we are removing the last constant of this type, remove the type
+    // from the ATM, and ourselves from its user list.
+    if (Constants.empty()) {
+      AbstractTypeMap.erase(I);
+      cast<DerivedType>(Ty)->removeAbstractTypeUser(this);
     }
   }
 
   ConstantClass* Create(const TypeClass *Ty, const ValType &V,
-                        typename MapTy::iterator I) {
+                        unsigned Hash) {
     ConstantClass* Result =
       ConstantCreator<ConstantClass,TypeClass,ValType>::create(Ty, V);
 
     assert(Result->getType() == Ty && "Type specified is not correct!");
-    I = Map.insert(I, std::make_pair(MapKey(Ty, V), Result));
-
-    if (HasLargeKey)  // Remember the reverse mapping if needed.
-      InverseMap.insert(std::make_pair(Result, I));
-
-    AddAbstractTypeUser(Ty, I);
-      
+    Insert(Result, Ty, V, Hash);
+    AddAbstractTypeUser(Ty, Result);
     return Result;
   }
 public:
-    
+
   /// getOrCreate - Return the specified constant from the map, creating it if
   /// necessary.
   ConstantClass *getOrCreate(const TypeClass *Ty, const ValType &V) {
-    MapKey Lookup(Ty, V);
-    ConstantClass* Result = 0;
-    
-    typename MapTy::iterator I = Map.find(Lookup);
-    // Is it in the map?  
-    if (I != Map.end())
-      Result = I->second;
-        
-    if (!Result) {
-      // If no preexisting value, create one now...
-      Result = Create(Ty, V, I);
-    }
-        
-    return Result;
-  }
+    unsigned Hash = getHash(Ty, V);
+    unsigned BucketNo;
+    if (LookupBucketFor(Ty, V, Hash, BucketNo))
+      return Buckets[BucketNo].C;
 
-  void UpdateAbstractTypeMap(const DerivedType *Ty,
-                             typename MapTy::iterator I) {
-    assert(AbstractTypeMap.count(Ty) &&
-           "Abstract type not in AbstractTypeMap?");
-    typename MapTy::iterator &ATMEntryIt = AbstractTypeMap[Ty];
-    if (ATMEntryIt == I) {
-      // Yes, we are removing the representative entry for this type.
-      // See if there are any other entries of the same type.
-      typename MapTy::iterator TmpIt = ATMEntryIt;
-
-      // First check the entry before this one...
-      if (TmpIt != Map.begin()) {
-        --TmpIt;
-        if (TmpIt->first.first != Ty) // Not the same type, move back...
-          ++TmpIt;
-      }
-
-      // If we didn't find the same type, try to move forward...
-      if (TmpIt == ATMEntryIt) {
-        ++TmpIt;
-        if (TmpIt == Map.end() || TmpIt->first.first != Ty)
-          --TmpIt;   // No entry afterwards with the same type
-      }
+    // If no preexisting value, create one now...
+    return Create(Ty, V, Hash);
+  }
 
-      // If there is another entry in the map of the same abstract type,
-      // update the AbstractTypeMap entry now.
-      if (TmpIt != ATMEntryIt) {
-        ATMEntryIt = TmpIt;
-      } else {
-        // Otherwise, we are removing the last instance of this type
-        // from the table.  Remove from the ATM, and from user list.
-        cast<DerivedType>(Ty)->removeAbstractTypeUser(this);
-        AbstractTypeMap.erase(Ty);
-      }
-    }
+  /// getExisting - Return the constant for the key (Ty, V), or null if there
+  /// is none.
+  ConstantClass *getExisting(const TypeClass *Ty, const ValType &V) const {
+    unsigned BucketNo;
+    if (LookupBucketFor(Ty, V, getHash(Ty, V), BucketNo))
+      return Buckets[BucketNo].C;
+    return 0;
   }
 
   void remove(ConstantClass *CP) {
-    typename MapTy::iterator I = FindExistingElement(CP);
-    assert(I != Map.end() && "Constant not found in constant table!");
-    assert(I->second == CP && "Didn't find correct element?");
-
-    if (HasLargeKey)  // Remember the reverse mapping if needed.
-      InverseMap.erase(CP);
-      
-    // Now that we found the entry, make sure this isn't the entry that
-    // the AbstractTypeMap points to.
-    const TypeClass *Ty = I->first.first;
-    if (Ty->isAbstract())
-      UpdateAbstractTypeMap(static_cast<const DerivedType *>(Ty), I);
-
-    Map.erase(I);
-  }
-
-  /// MoveConstantToNewSlot - If we are about to change C to be the element
-  /// specified by I, update our internal data structures to reflect this
-  /// fact.
-  void MoveConstantToNewSlot(ConstantClass *C, typename MapTy::iterator I) {
-    // First, remove the old location of the specified constant in the map.
-    typename MapTy::iterator OldI = FindExistingElement(C);
-    assert(OldI != Map.end() && "Constant not found in constant table!");
-    assert(OldI->second == C && "Didn't find correct element?");
-      
-    // If this constant is the representative element for its abstract type,
-    // update the AbstractTypeMap so that the representative element is I.
-    //
+    Erase(FindExistingElement(CP));
+    RemoveAbstractTypeUser(CP->getRawType(), CP);
+  }
+
+  /// MoveConstantToNewSlot - We are about to change the operands of C so that
+  /// its key becomes V, which no other constant has.  Update our internal data
+  /// structures to reflect this fact.
+  void MoveConstantToNewSlot(ConstantClass *C, const ValType &V) {
+    assert(!getExisting(static_cast<const TypeClass*>(C->getRawType()), V) &&
+           "Moving a constant to the key of another one!");
     // This must use getRawType() because if the type is under refinement, we
     // will get the refineAbstractType callback below, and we don't want to
     // kick union find in on the constant.
-    if (C->getRawType()->isAbstract()) {
-      typename AbstractTypeMapTy::iterator ATI =
-          AbstractTypeMap.find(cast<DerivedType>(C->getRawType()));
-      assert(ATI != AbstractTypeMap.end() &&
-             "Abstract type not in AbstractTypeMap?");
-      if (ATI->second == OldI)
-        ATI->second = I;
-    }
-      
-    // Remove the old entry from the map.
-    Map.erase(OldI);
-    
-    // Update the inverse map so that we know that this constant is now
-    // located at descriptor I.
-    if (HasLargeKey) {
-      assert(I->second == C && "Bad inversemap entry!");
-      InverseMap[C] = I;
-    }
+    const TypeClass *Ty = static_cast<const TypeClass*>(C->getRawType());
+    Erase(FindExistingElement(C));
+    Insert(C, Ty, V, getHash(Ty, V));
   }
-    
+
   void refineAbstractType(const DerivedType *OldTy, const Type *NewTy) {
     typename AbstractTypeMapTy::iterator I = AbstractTypeMap.find(OldTy);
 
@@ -793,37 +906,23 @@ public:
     // leaving will remove() itself, causing the AbstractTypeMapEntry to be
     // eliminated eventually.
     do {
-      ConstantClass *C = I->second->second;
-      MapKey Key(cast<TypeClass>(NewTy),
-                 ConstantKeyData<ConstantClass>::getValType(C));
-
-      std::pair<typename MapTy::iterator, bool> IP =
-        Map.insert(std::make_pair(Key, C));
-      if (IP.second) {
-        // The map didn't previously have an appropriate constant in the
-        // new type.
-        
-        // Remove the old entry.
-        typename MapTy::iterator OldI =
-          Map.find(MapKey(cast<TypeClass>(OldTy), IP.first->first.second));
-        assert(OldI != Map.end() && "Constant not in map!");
-        UpdateAbstractTypeMap(OldTy, OldI);
-        Map.erase(OldI);
-
-        // Set the constant's type. This is done in place!
-        setType(C, NewTy);
+      ConstantClass *C = I->second.back();
+      const TypeClass *Ty = cast<TypeClass>(NewTy);
+      ValType V = ConstantKeyData<ConstantClass>::getValType(C);
 
-        // Update the inverse map so that we know that this constant is now
-        // located at descriptor I.
-        if (HasLargeKey)
-          InverseMap[C] = IP.first;
-
-        AddAbstractTypeUser(NewTy, IP.first);
-      } else {
+      if (ConstantClass *Existing = getExisting(Ty, V)) {
         // The map already had an appropriate constant in the new type, so
         // there's no longer a need for the old constant.
-        C->uncheckedReplaceAllUsesWith(IP.first->second);
+        C->uncheckedReplaceAllUsesWith(Existing);
         C->destroyConstant();    // This constant is now dead, destroy it.
+      } else {
+        // The map didn't previously have an appropriate constant in the
+        // new type.  Remove the old entry, and set the constant's type.  This
+        // is done in place!
+        remove(C);
+        setType(C, NewTy);
+        Insert(C, Ty, V, getHash(Ty, V));
+        AddAbstractTypeUser(NewTy, C);
       }
       I = AbstractTypeMap.find(OldTy);
     } while (I != AbstractTypeMap.end());
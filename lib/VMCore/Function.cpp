@@ -16,11 +16,14 @@
 #include "llvm/IntrinsicInst.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/CodeGen/ValueTypes.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/LeakDetector.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/StringPool.h"
 #include "llvm/Support/RWMutex.h"
+#include "llvm/Support/ThreadLocal.h"
 #include "llvm/Support/Threading.h"
 #include "SymbolTableListTraitsImpl.h"
 #include "llvm/ADT/DenseMap.h"
@@ -158,6 +161,7 @@ Function::Function(const FunctionType *Ty, LinkageTypes Linkage,
   assert(FunctionType::isValidReturnType(getReturnType()) &&
          !getReturnType()->isOpaqueTy() && "invalid return type");
   SymTab = new ValueSymbolTable();
+  Arena = 0;
 
   // If the function has arguments, mark them as lazily built.
   if (Ty->getNumParams())
@@ -181,6 +185,7 @@ Function::~Function() {
   // Delete all of the method arguments and unlink from symbol table...
   ArgumentList.clear();
   delete SymTab;
+  delete Arena;
 
   // Remove the function from the on-the-side GC table.
   clearGC();
@@ -231,6 +236,11 @@ void Function::dropAllReferences() {
   // blockaddresses, but BasicBlock's destructor takes care of those.
   while (!BasicBlocks.empty())
     BasicBlocks.begin()->eraseFromParent();
+
+  // Every instruction allocated from the arena has been destroyed with its
+  // block, so its memory can go all at once.
+  if (Arena)
+    Arena->Reset();
 }
 
 void Function::addAttribute(unsigned i, Attributes attr) {
@@ -392,6 +402,40 @@ Function *Intrinsic::getDeclaration(Module *M, ID id, const Type **Tys,
 #include "llvm/Intrinsics.gen"
 #undef GET_LLVM_INTRINSIC_FOR_GCC_BUILTIN
 
+//===----------------------------------------------------------------------===//
+// IRArenaScope Implementation
+//===----------------------------------------------------------------------===//
+
+// The innermost scope of each thread.  NumActiveScopes lets the threads that
+// never use an arena skip the thread local lookup on every new instruction.
+static ManagedStatic<sys::ThreadLocal<const IRArenaScope> > CurrentScope;
+static volatile sys::cas_flag NumActiveScopes = 0;
+
+IRArenaScope::IRArenaScope(Function &F) : Prev(CurrentScope->get()) {
+  if (!F.Arena)
+    F.Arena = new BumpPtrAllocator();
+  Arena = F.Arena;
+  CurrentScope->set(this);
+  sys::AtomicIncrement(&NumActiveScopes);
+}
+
+IRArenaScope::~IRArenaScope() {
+  assert(CurrentScope->get() == this && "Arena scopes must nest!");
+  CurrentScope->set(Prev);
+  sys::AtomicDecrement(&NumActiveScopes);
+}
+
+bool Function::isInArena(const Instruction *I) const {
+  return Arena && Arena->Owns(I);
+}
+
+BumpPtrAllocator *IRArenaScope::getCurrentArena() {
+  if (!NumActiveScopes)
+    return 0;
+  const IRArenaScope *S = CurrentScope->get();
+  return S ? S->Arena : 0;
+}
+
 /// hasAddressTaken - returns true if there are any uses of this function
 /// other than direct calls or invokes to it.
 bool Function::hasAddressTaken(const User* *PutOffender) const {
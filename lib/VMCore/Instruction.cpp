@@ -15,7 +15,9 @@
 #include "llvm/Type.h"
 #include "llvm/Instructions.h"
 #include "llvm/Constants.h"
+#include "llvm/Function.h"
 #include "llvm/Module.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/LeakDetector.h"
 using namespace llvm;
@@ -26,6 +28,9 @@ Instruction::Instruction(const Type *ty, unsigned it, Use *Ops, unsigned NumOps,
   // Make sure that we get added to a basicblock
   LeakDetector::addGarbageObject(this);
 
+  // operator new took the memory from the arena of the current scope, if any.
+  ArenaAllocated = IRArenaScope::getCurrentArena() != 0;
+
   // If requested, insert this instruction into a basic block...
   if (InsertBefore) {
     assert(InsertBefore->getParent() &&
@@ -40,21 +45,37 @@ Instruction::Instruction(const Type *ty, unsigned it, Use *Ops, unsigned NumOps,
   // Make sure that we get added to a basicblock
   LeakDetector::addGarbageObject(this);
 
+  // operator new took the memory from the arena of the current scope, if any.
+  ArenaAllocated = IRArenaScope::getCurrentArena() != 0;
+
   // append this instruction into the basic block
   assert(InsertAtEnd && "Basic block to append to may not be NULL!");
   InsertAtEnd->getInstList().push_back(this);
 }
 
+void *Instruction::operator new(size_t s, unsigned Us) {
+  if (BumpPtrAllocator *Arena = IRArenaScope::getCurrentArena())
+    return User::operator new(s, Us, *Arena);
+  return User::operator new(s, Us);
+}
 
 // Out of line virtual method, so the vtable, etc has a home.
 Instruction::~Instruction() {
   assert(Parent == 0 && "Instruction still linked in the program!");
   if (hasMetadataHashEntry())
     clearMetadataHashEntries();
+#ifdef LLVM_COMPACT_IR
+  if (HasDebugLocEntry)
+    setDebugLoc(DebugLoc());
+#endif
 }
 
 
 void Instruction::setParent(BasicBlock *P) {
+  assert((!P || !isArenaAllocated() || !P->getParent() ||
+          P->getParent()->isInArena(this)) &&
+         "Arena allocated instruction moved into another function!");
+
   if (getParent()) {
     if (!P) LeakDetector::addGarbageObject(this);
   } else {
@@ -41,17 +41,6 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
   OpaqueTypes.insert(AlwaysOpaqueTy);
 }
 
-namespace {
-struct DropReferences {
-  // Takes the value_type of a ConstantUniqueMap's internal map, whose 'second'
-  // is a Constant*.
-  template<typename PairT>
-  void operator()(const PairT &P) {
-    P.second->dropAllReferences();
-  }
-};
-}
-
 LLVMContextImpl::~LLVMContextImpl() {
   // NOTE: We need to delete the contents of OwnedModules, but we have to
   // duplicate it into a temporary vector, because the destructor of Module
@@ -62,14 +51,10 @@ LLVMContextImpl::~LLVMContextImpl() {
        I != E; ++I)
     delete *I;
   
-  std::for_each(ExprConstants.map_begin(), ExprConstants.map_end(),
-                DropReferences());
-  std::for_each(ArrayConstants.map_begin(), ArrayConstants.map_end(),
-                DropReferences());
-  std::for_each(StructConstants.map_begin(), StructConstants.map_end(),
-                DropReferences());
-  std::for_each(VectorConstants.map_begin(), VectorConstants.map_end(),
-                DropReferences());
+  ExprConstants.dropAllReferences();
+  ArrayConstants.dropAllReferences();
+  StructConstants.dropAllReferences();
+  VectorConstants.dropAllReferences();
   ExprConstants.freeConstants();
   ArrayConstants.freeConstants();
   StructConstants.freeConstants();
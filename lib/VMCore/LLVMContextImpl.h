@@ -142,11 +142,11 @@ public:
   ConstantUniqueMap<char, Type, ConstantAggregateZero> AggZeroConstants;
 
   typedef ConstantUniqueMap<std::vector<Constant*>, ArrayType,
-    ConstantArray, true /*largekey*/> ArrayConstantsTy;
+                            ConstantArray> ArrayConstantsTy;
   ArrayConstantsTy ArrayConstants;
   
   typedef ConstantUniqueMap<std::vector<Constant*>, StructType,
-    ConstantStruct, true /*largekey*/> StructConstantsTy;
+                            ConstantStruct> StructConstantsTy;
   StructConstantsTy StructConstants;
   
   typedef ConstantUniqueMap<std::vector<Constant*>, VectorType,
@@ -219,6 +219,16 @@ public:
   /// MetadataStore - Collection of per-instruction metadata used in this
   /// context.
   DenseMap<const Instruction *, MDMapTy> MetadataStore;
+
+#ifdef LLVM_COMPACT_IR
+  /// ValueNames - The names of the values of this context, which the compact
+  /// IR layout keeps out of Value.
+  DenseMap<const Value*, ValueName*> ValueNames;
+
+  /// InstructionDebugLocs - The known debug locations of the instructions of
+  /// this context, which the compact IR layout keeps out of Instruction.
+  DenseMap<const Instruction*, DebugLoc> InstructionDebugLocs;
+#endif
   
   /// ScopeRecordIdx - This is the index in ScopeRecords for an MDNode scope
   /// entry with no "inlined at" element.
@@ -445,7 +445,7 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
 
   // Handle 'dbg' as a special case since it is not stored in the hash table.
   if (KindID == LLVMContext::MD_dbg) {
-    DbgLoc = DebugLoc::getFromDILocation(Node);
+    setDebugLoc(DebugLoc::getFromDILocation(Node));
     return;
   }
   
@@ -497,7 +497,7 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
 MDNode *Instruction::getMetadataImpl(unsigned KindID) const {
   // Handle 'dbg' as a special case since it is not stored in the hash table.
   if (KindID == LLVMContext::MD_dbg)
-    return DbgLoc.getAsMDNode(getContext());
+    return getDebugLoc().getAsMDNode(getContext());
   
   if (!hasMetadataHashEntry()) return 0;
   
@@ -516,9 +516,10 @@ void Instruction::getAllMetadataImpl(SmallVectorImpl<std::pair<unsigned,
   Result.clear();
   
   // Handle 'dbg' as a special case since it is not stored in the hash table.
-  if (!DbgLoc.isUnknown()) {
+  DebugLoc Loc = getDebugLoc();
+  if (!Loc.isUnknown()) {
     Result.push_back(std::make_pair((unsigned)LLVMContext::MD_dbg,
-                                    DbgLoc.getAsMDNode(getContext())));
+                                    Loc.getAsMDNode(getContext())));
     if (!hasMetadataHashEntry()) return;
   }
   
@@ -563,3 +564,23 @@ void Instruction::clearMetadataHashEntries() {
   setHasMetadataHashEntry(false);
 }
 
+#ifdef LLVM_COMPACT_IR
+void Instruction::setDebugLoc(const DebugLoc &Loc) {
+  DenseMap<const Instruction*, DebugLoc> &Locs =
+    getContext().pImpl->InstructionDebugLocs;
+  if (!Loc.isUnknown()) {
+    Locs[this] = Loc;
+    HasDebugLocEntry = true;
+  } else if (HasDebugLocEntry) {
+    Locs.erase(this);
+    HasDebugLocEntry = false;
+  }
+}
+
+DebugLoc Instruction::getDebugLoc() const {
+  if (!HasDebugLocEntry)
+    return DebugLoc();
+  return getContext().pImpl->InstructionDebugLocs.lookup(this);
+}
+#endif
+
@@ -14,6 +14,7 @@
 
 #include "llvm/PassManagers.h"
 #include "llvm/PassManager.h"
+#include "llvm/AnalysisCache.h"
 #include "llvm/Assembly/PrintModulePass.h"
 #include "llvm/Assembly/Writer.h"
 #include "llvm/Support/CommandLine.h"
@@ -370,6 +371,11 @@ public:
   /// Collection of on the fly FPPassManagers. These managers manage
   /// function passes that are required by module passes.
   std::map<Pass *, FunctionPassManagerImpl *> OnTheFlyManagers;
+
+  /// OnTheFlyFunctions - The functions the running module pass has asked for
+  /// analyses of.  The pass may have changed them since, so their cached
+  /// results are not used for it again.
+  SmallPtrSet<Function *, 16> OnTheFlyFunctions;
 };
 
 char MPPassManager::ID = 0;
@@ -490,7 +496,7 @@ static TimingInfo *TheTimeInfo;
 // PMTopLevelManager implementation
 
 /// Initialize top level manager. Create first pass manager.
-PMTopLevelManager::PMTopLevelManager(PMDataManager *PMDM) {
+PMTopLevelManager::PMTopLevelManager(PMDataManager *PMDM) : Cache(0) {
   PMDM->setTopLevelManager(this);
   addPassManager(PMDM);
   activeStack.push(PMDM);
@@ -813,6 +819,8 @@ void PMDataManager::verifyPreservedAnalysis(Pass *P) {
          E = PreservedSet.end(); I != E; ++I) {
     AnalysisID AID = *I;
     if (Pass *AP = findAnalysisPass(AID, true)) {
+      if (AnalysisCache *Cache = TPM->getAnalysisCache())
+        AP = Cache->getCachedPass(AP, *this);
       TimeRegion PassTimer(getPassTimer(AP));
       AP->verifyAnalysis();
     }
@@ -868,6 +876,19 @@ void PMDataManager::removeNotPreservedAnalysis(Pass *P) {
   }
 }
 
+/// Tell the analysis cache that P changed F, or any function if F is null.
+void PMDataManager::invalidateCachedAnalysis(Pass *P, Function *F) {
+  AnalysisCache *Cache = TPM->getAnalysisCache();
+  if (!Cache)
+    return;
+
+  AnalysisUsage *AnUsage = TPM->findAnalysisUsage(P);
+  if (F)
+    Cache->invalidate(*F, *AnUsage);
+  else
+    Cache->invalidate(*AnUsage);
+}
+
 /// Remove analysis passes that are not used any longer
 void PMDataManager::removeDeadPasses(Pass *P, StringRef Msg,
                                      enum PassDebuggingString DBG_STR) {
@@ -895,7 +916,10 @@ void PMDataManager::freePass(Pass *P, StringRef Msg,
                              enum PassDebuggingString DBG_STR) {
   dumpPassInfo(P, FREEING_MSG, DBG_STR, Msg);
 
-  {
+  // The results of a cached analysis are held and released by the cache; P
+  // itself never ran.
+  AnalysisCache *Cache = TPM->getAnalysisCache();
+  if (!Cache || !Cache->isCached(P, *this)) {
     // If the pass crashes releasing memory, remember this.
     PassManagerPrettyStackEntry X(P);
     TimeRegion PassTimer(getPassTimer(P));
@@ -1032,6 +1056,7 @@ void PMDataManager::collectRequiredAnalysis(SmallVectorImpl<Pass *> &RP,
 //
 void PMDataManager::initializeAnalysisImpl(Pass *P) {
   AnalysisUsage *AnUsage = TPM->findAnalysisUsage(P);
+  AnalysisCache *Cache = TPM->getAnalysisCache();
 
   for (AnalysisUsage::VectorType::const_iterator
          I = AnUsage->getRequiredSet().begin(),
@@ -1041,6 +1066,9 @@ void PMDataManager::initializeAnalysisImpl(Pass *P) {
       // This may be analysis pass that is initialized on the fly.
       // If that is not the case then it will raise an assert when it is used.
       continue;
+    // Hand out the results kept for the current function, if any.
+    if (Cache)
+      Impl = Cache->getCachedPass(Impl, *this);
     AnalysisResolver *AR = P->getResolver();
     assert(AR && "Analysis Resolver is not set");
     AR->addAnalysisImplsPair(*I, Impl);
@@ -1212,7 +1240,11 @@ PMDataManager::~PMDataManager() {
 // NOTE: Is this the right place to define this method ?
 // getAnalysisIfAvailable - Return analysis result or null if it doesn't exist.
 Pass *AnalysisResolver::getAnalysisIfAvailable(AnalysisID ID, bool dir) const {
-  return PM.findAnalysisPass(ID, dir);
+  Pass *P = PM.findAnalysisPass(ID, dir);
+  if (P)
+    if (AnalysisCache *Cache = PM.getTopLevelManager()->getAnalysisCache())
+      P = Cache->getCachedPass(P, PM);
+  return P;
 }
 
 Pass *AnalysisResolver::findImplPass(Pass *P, AnalysisID AnalysisPI,
@@ -1251,9 +1283,11 @@ bool BBPassManager::runOnFunction(Function &F) {
       }
 
       Changed |= LocalChanged;
-      if (LocalChanged)
+      if (LocalChanged) {
         dumpPassInfo(BP, MODIFICATION_MSG, ON_BASICBLOCK_MSG,
                      I->getName());
+        invalidateCachedAnalysis(BP, &F);
+      }
       dumpPreservedSet(BP);
 
       verifyPreservedAnalysis(BP);
@@ -1365,6 +1399,12 @@ bool FunctionPassManager::run(Function &F) {
 }
 
 
+/// setAnalysisCache - Keep the function analyses that Cache is told about in
+/// Cache.
+void FunctionPassManager::setAnalysisCache(AnalysisCache *Cache) {
+  FPM->setAnalysisCache(Cache);
+}
+
 /// doInitialization - Run all of the initializers for the function passes.
 ///
 bool FunctionPassManager::doInitialization() {
@@ -1467,6 +1507,9 @@ bool FPPassManager::runOnFunction(Function &F) {
   // Collect inherited analysis from Module level pass manager.
   populateInheritedAnalysis(TPM->activeStack);
 
+  AnalysisCache *Cache = TPM->getAnalysisCache();
+  Function *PrevF = Cache ? Cache->setCurrentFunction(&F) : 0;
+
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
     FunctionPass *FP = getContainedPass(Index);
     bool LocalChanged = false;
@@ -1474,18 +1517,27 @@ bool FPPassManager::runOnFunction(Function &F) {
     dumpPassInfo(FP, EXECUTION_MSG, ON_FUNCTION_MSG, F.getName());
     dumpRequiredSet(FP);
 
-    initializeAnalysisImpl(FP);
+    // The results of a cached analysis are computed by the cache, and only if
+    // those it has for F are out of date.
+    bool IsCached = Cache && Cache->isCached(FP, *this);
+    if (!IsCached)
+      initializeAnalysisImpl(FP);
 
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
 
-      LocalChanged |= FP->runOnFunction(F);
+      if (IsCached)
+        Cache->runCachedPass(FP, F, *this);
+      else
+        LocalChanged |= FP->runOnFunction(F);
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
       dumpPassInfo(FP, MODIFICATION_MSG, ON_FUNCTION_MSG, F.getName());
+      invalidateCachedAnalysis(FP, &F);
+    }
     dumpPreservedSet(FP);
 
     verifyPreservedAnalysis(FP);
@@ -1493,6 +1545,9 @@ bool FPPassManager::runOnFunction(Function &F) {
     recordAvailableAnalysis(FP);
     removeDeadPasses(FP, F.getName(), ON_FUNCTION_MSG);
   }
+
+  if (Cache)
+    Cache->setCurrentFunction(PrevF);
   return Changed;
 }
 
@@ -1550,6 +1605,7 @@ MPPassManager::runOnModule(Module &M) {
 
     initializeAnalysisImpl(MP);
 
+    OnTheFlyFunctions.clear();
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
@@ -1558,9 +1614,11 @@ MPPassManager::runOnModule(Module &M) {
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
       dumpPassInfo(MP, MODIFICATION_MSG, ON_MODULE_MSG,
                    M.getModuleIdentifier());
+      invalidateCachedAnalysis(MP, 0);
+    }
     dumpPreservedSet(MP);
 
     verifyPreservedAnalysis(MP);
@@ -1615,9 +1673,21 @@ Pass* MPPassManager::getOnTheFlyPass(Pass *MP, AnalysisID PI, Function &F){
   FunctionPassManagerImpl *FPP = OnTheFlyManagers[MP];
   assert(FPP && "Unable to find on the fly pass");
 
+  // With an analysis cache, the results for F are computed at most once
+  // until a pass changes F.  The module pass asking for them may itself have
+  // changed F since its last request, and only reports that once it is done,
+  // so it is only handed the cached results the first time.
+  AnalysisCache *Cache = TPM->getAnalysisCache();
+  FPP->setAnalysisCache(Cache);
+  if (Cache && !OnTheFlyFunctions.insert(&F))
+    Cache->invalidate(F);
+
   FPP->releaseMemoryOnTheFly();
   FPP->run(F);
-  return ((PMTopLevelManager*)FPP)->findAnalysisPass(PI);
+  Pass *P = ((PMTopLevelManager*)FPP)->findAnalysisPass(PI);
+  if (Cache && P)
+    P = Cache->getCachedPass(P, F, *FPP);
+  return P;
 }
 
 
@@ -1676,6 +1746,12 @@ void PassManager::add(Pass *P) {
                                  + P->getPassName() + " ***"));
 }
 
+/// setAnalysisCache - Keep the function analyses that Cache is told about in
+/// Cache.
+void PassManager::setAnalysisCache(AnalysisCache *Cache) {
+  PM->setAnalysisCache(Cache);
+}
+
 /// run - Execute all of the passes scheduled for execution.  Keep track of
 /// whether any of the passes modifies the module, and if so, return true.
 bool PassManager::run(Module &M) {
@@ -10,6 +10,7 @@
 #include "llvm/Constant.h"
 #include "llvm/GlobalValue.h"
 #include "llvm/User.h"
+#include "llvm/Support/Allocator.h"
 
 namespace llvm {
 
@@ -66,12 +67,27 @@ void *User::operator new(size_t s, unsigned Us) {
   return Obj;
 }
 
+void *User::operator new(size_t s, unsigned Us, BumpPtrAllocator &Arena) {
+  // No User subclass needs more than 8 byte alignment.
+  void *Storage = Arena.Allocate(s + sizeof(Use) * Us, 8);
+  Use *Start = static_cast<Use*>(Storage);
+  Use *End = Start + Us;
+  User *Obj = reinterpret_cast<User*>(End);
+  Obj->OperandList = Start;
+  Obj->NumOperands = Us;
+  Use::initTags(Start, End);
+  return Obj;
+}
+
 //===----------------------------------------------------------------------===//
 //                         User operator delete Implementation
 //===----------------------------------------------------------------------===//
 
 void User::operator delete(void *Usr) {
   User *Start = static_cast<User*>(Usr);
+  // Arena allocated Users are released in bulk along with their arena.
+  if (Start->ArenaAllocated)
+    return;
   Use *Storage = static_cast<Use*>(Usr) - Start->NumOperands;
   // If there were hung-off uses, they will have been freed already and
   // NumOperands reset to 0, so here we just free the User itself.
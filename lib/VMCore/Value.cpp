@@ -42,8 +42,14 @@ static inline const Type *checkType(const Type *Ty) {
 
 Value::Value(const Type *ty, unsigned scid)
   : SubclassID(scid), HasValueHandle(0),
-    SubclassOptionalData(0), SubclassData(0), VTy(checkType(ty)),
-    UseList(0), Name(0) {
+    SubclassOptionalData(0), SubclassData(0),
+#ifdef LLVM_COMPACT_IR
+    HasName(0), ArenaAllocated(0), HasDebugLocEntry(0), NumOperands(0),
+#endif
+    VTy(checkType(ty)), UseList(0) {
+#ifndef LLVM_COMPACT_IR
+  Name = 0;
+#endif
   if (isa<CallInst>(this) || isa<InvokeInst>(this))
     assert((VTy->isFirstClassType() || VTy->isVoidTy() ||
             ty->isOpaqueTy() || VTy->isStructTy()) &&
@@ -77,8 +83,10 @@ Value::~Value() {
 
   // If this value is named, destroy the name.  This should not be in a symtab
   // at this point.
-  if (Name)
-    Name->Destroy();
+  if (hasName()) {
+    getValueName()->Destroy();
+    setValueName(0);
+  }
 
   // There should be no uses of this object anymore, remove it.
   LeakDetector::removeGarbageObject(this);
@@ -153,10 +161,29 @@ StringRef Value::getName() const {
   // Make sure the empty string is still a C string. For historical reasons,
   // some clients want to call .data() on the result and expect it to be null
   // terminated.
-  if (!Name) return StringRef("", 0);
-  return Name->getKey();
+  if (!hasName()) return StringRef("", 0);
+  return getValueName()->getKey();
 }
 
+#ifdef LLVM_COMPACT_IR
+ValueName *Value::getValueName() const {
+  if (!HasName)
+    return 0;
+  return getContext().pImpl->ValueNames.lookup(this);
+}
+
+void Value::setValueName(ValueName *VN) {
+  DenseMap<const Value*, ValueName*> &Names = getContext().pImpl->ValueNames;
+  if (VN) {
+    Names[this] = VN;
+    HasName = true;
+  } else if (HasName) {
+    Names.erase(this);
+    HasName = false;
+  }
+}
+#endif
+
 std::string Value::getNameStr() const {
   return getName().str();
 }
@@ -183,20 +210,21 @@ void Value::setName(const Twine &NewName) {
   if (!ST) { // No symbol table to update?  Just do the change.
     if (NameRef.empty()) {
       // Free the name for this value.
-      Name->Destroy();
-      Name = 0;
+      getValueName()->Destroy();
+      setValueName(0);
       return;
     }
 
-    if (Name)
-      Name->Destroy();
+    if (hasName())
+      getValueName()->Destroy();
 
     // NOTE: Could optimize for the case the name is shrinking to not deallocate
     // then reallocated.
 
     // Create the new name.
-    Name = ValueName::Create(NameRef.begin(), NameRef.end());
+    ValueName *Name = ValueName::Create(NameRef.begin(), NameRef.end());
     Name->setValue(this);
+    setValueName(Name);
     return;
   }
 
@@ -204,16 +232,17 @@ void Value::setName(const Twine &NewName) {
   // then reallocated.
   if (hasName()) {
     // Remove old name.
+    ValueName *Name = getValueName();
     ST->removeValueName(Name);
     Name->Destroy();
-    Name = 0;
+    setValueName(0);
 
     if (NameRef.empty())
       return;
   }
 
   // Name is changing to something new.
-  Name = ST->createValueName(NameRef, this);
+  setValueName(ST->createValueName(NameRef, this));
 }
 
 
@@ -232,10 +261,11 @@ void Value::takeName(Value *V) {
     }
 
     // Remove old name.
+    ValueName *Name = getValueName();
     if (ST)
       ST->removeValueName(Name);
     Name->Destroy();
-    Name = 0;
+    setValueName(0);
   }
 
   // Now we know that this has no name.
@@ -261,8 +291,9 @@ void Value::takeName(Value *V) {
   // This works even if both values have no symtab yet.
   if (ST == VST) {
     // Take the name!
-    Name = V->Name;
-    V->Name = 0;
+    ValueName *Name = V->getValueName();
+    V->setValueName(0);
+    setValueName(Name);
     Name->setValue(this);
     return;
   }
@@ -270,10 +301,11 @@ void Value::takeName(Value *V) {
   // Otherwise, things are slightly more complex.  Remove V's name from VST and
   // then reinsert it into ST.
 
+  ValueName *Name = V->getValueName();
   if (VST)
-    VST->removeValueName(V->Name);
-  Name = V->Name;
-  V->Name = 0;
+    VST->removeValueName(Name);
+  V->setValueName(0);
+  setValueName(Name);
   Name->setValue(this);
 
   if (ST)
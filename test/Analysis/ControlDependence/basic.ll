@@ -0,0 +1,62 @@
+; RUN: opt < %s -cdg -analyze | FileCheck %s
+
+; An if-then-else inside a loop.  The loop body and the latch run again only
+; if the latch branches back, so they depend on the latch too.
+define void @loop(i1 %c, i1 %d) {
+; CHECK: Printing analysis 'Control Dependence Graph Construction' for function 'loop':
+; CHECK-NEXT: Control dependent on %body: %then %else
+; CHECK-NEXT: Control dependent on %latch: %body %latch
+; CHECK-NOT: Control dependent
+entry:
+  br label %body
+
+body:
+  br i1 %c, label %then, label %else
+
+then:
+  br label %latch
+
+else:
+  br label %latch
+
+latch:
+  br i1 %d, label %body, label %exit
+
+exit:
+  ret void
+}
+
+; With several exits, the branches that choose between them still control
+; the blocks that lead to each exit.
+define i32 @exits(i1 %c, i1 %d) {
+; CHECK: for function 'exits':
+; CHECK-NEXT: Control dependent on %entry: %a %b
+; CHECK-NEXT: Control dependent on %a: %b %x
+; CHECK-NOT: Control dependent
+entry:
+  br i1 %c, label %a, label %b
+
+a:
+  br i1 %d, label %x, label %b
+
+b:
+  ret i32 0
+
+x:
+  ret i32 1
+}
+
+; Blocks that cannot reach an exit have no control dependences, and do not
+; get in the way of the others.
+define void @infinite(i1 %c) {
+; CHECK: for function 'infinite':
+; CHECK-NOT: Control dependent
+entry:
+  br i1 %c, label %spin, label %exit
+
+spin:
+  br label %spin
+
+exit:
+  ret void
+}
@@ -0,0 +1,29 @@
+; RUN: opt < %s -analyze -ir-memory > %t
+; RUN: grep {^ *2 .*  BinaryOperator\$} %t
+; RUN: grep {^ *2 .*  BranchInst\$} %t
+; RUN: grep {^ *1 .*  PHINode\$} %t
+; RUN: grep {^ *3 .*  BasicBlock\$} %t
+; RUN: grep {^ *2 .*  Argument\$} %t
+; RUN: grep {^ *3 .*  ConstantInt\$} %t
+; RUN: grep {^ *1 .*  GlobalVariable\$} %t
+; RUN: grep {^ *1 .*  (metadata attachments)\$} %t
+; RUN: grep {^ *12 .*  (value names)\$} %t
+; RUN: grep {bytes per instruction} %t
+
+@g = global i32 7
+
+define i32 @f(i32 %x, i32 %y) nounwind {
+entry:
+  %a = add i32 %x, %y
+  %b = mul i32 %a, 3
+  %c = icmp eq i32 %b, 0
+  br i1 %c, label %zero, label %done
+zero:
+  %v = load i32* @g, !range !0
+  br label %done
+done:
+  %r = phi i32 [ %b, %entry ], [ %v, %zero ]
+  ret i32 %r
+}
+
+!0 = metadata !{i32 0, i32 8}
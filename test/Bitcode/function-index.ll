@@ -0,0 +1,55 @@
+; RUN: llvm-as -bitcode-function-index < %s > %t.bc
+; RUN: llvm-bcanalyzer -dump %t.bc |& FileCheck --check-prefix=DUMP %s
+; RUN: llvm-extract -func g -S %t.bc | FileCheck %s
+; RUN: llvm-dis < %t.bc | FileCheck --check-prefix=ALL %s
+; RUN: llvm-as < %s > %t.noindex.bc
+; RUN: llvm-bcanalyzer -dump %t.noindex.bc |& \
+; RUN:   FileCheck --check-prefix=NOINDEX %s
+; RUN: llvm-extract -func g -S %t.noindex.bc | FileCheck %s
+; RUN: llvm-dis < %t.noindex.bc | FileCheck --check-prefix=ALL %s
+
+; With -bitcode-function-index, the function blocks sit between two function
+; index blocks: the first points at the second, which lists the blocks with
+; the globals that they refer to.  Without it there is no index, and the
+; reader walks over the function blocks instead.
+
+; DUMP: <FUNCTION_INDEX_BLOCK
+; DUMP-NEXT: <OFFSET abbrevid=4
+; DUMP: <FUNCTION_BLOCK
+; DUMP: <FUNCTION_BLOCK
+; DUMP: <FUNCTION_BLOCK
+; DUMP: <FUNCTION_INDEX_BLOCK
+; DUMP-NEXT: <ENTRY op0=1 op1=0 op2={{[0-9]+}}/>
+; DUMP-NEXT: <ENTRY op0=2 op1=0 op2={{[0-9]+}} op3=0 op4=1/>
+; DUMP-NEXT: <ENTRY op0=4 op1=0 op2={{[0-9]+}} op3=2/>
+
+; NOINDEX-NOT: FUNCTION_INDEX_BLOCK
+; NOINDEX: <FUNCTION_BLOCK
+; NOINDEX-NOT: FUNCTION_INDEX_BLOCK
+
+; CHECK: define i32 @g()
+; CHECK: call i32 @f(i32* @x)
+; CHECK-NOT: define
+
+; ALL: define i32 @f(i32* %p)
+; ALL: define i32 @g()
+; ALL: define i32 @h()
+
+@x = global i32 1
+
+define i32 @f(i32* %p) {
+  %v = load i32* %p
+  ret i32 %v
+}
+
+define i32 @g() {
+  %r = call i32 @f(i32* @x)
+  ret i32 %r
+}
+
+declare void @d()
+
+define i32 @h() {
+  %r = call i32 @g()
+  ret i32 %r
+}
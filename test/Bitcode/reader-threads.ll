@@ -0,0 +1,37 @@
+; RUN: llvm-as < %s > %t.bc
+; RUN: opt -S %t.bc > %t.1.ll
+; RUN: opt -S -reader-threads=2 %t.bc > %t.2.ll
+; RUN: diff %t.1.ll %t.2.ll
+; RUN: FileCheck %s < %t.2.ll
+
+@g = global i32 7
+
+define i32 @f(i32 %x) nounwind {
+entry:
+  %y = add i32 %x, 3, !dbg !0
+  %c = icmp eq i32 %y, 0
+  br i1 %c, label %zero, label %done
+zero:
+  %v = load i32* @g
+  br label %done
+done:
+  %r = phi i32 [ %y, %entry ], [ %v, %zero ]
+  ret i32 %r
+}
+; CHECK: define i32 @f
+; CHECK: %y = add i32 %x, 3, !dbg !0
+; CHECK: %r = phi i32 [ %y, %entry ], [ %v, %zero ]
+
+define double @h(double %d) nounwind {
+  %m = fmul double %d, 2.500000e-01
+  %s = call i32 @f(i32 1)
+  ret double %m
+}
+; CHECK: define double @h
+; CHECK: fmul double %d, 2.500000e-01
+; CHECK: call i32 @f(i32 1)
+
+declare void @decl()
+
+!0 = metadata !{i32 4, i32 2, metadata !1, null}
+!1 = metadata !{i32 524299, null, metadata !"t.c", null}
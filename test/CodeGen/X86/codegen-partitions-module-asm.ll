@@ -0,0 +1,31 @@
+; RUN: llc -mtriple=x86_64-linux-gnu -codegen-partitions=2 \
+; RUN:   -codegen-split-output %s -o %t
+; RUN: FileCheck %s -check-prefix=P0 < %t
+; RUN: FileCheck %s -check-prefix=P1 < %t.1
+
+; Module level inline asm is emitted by partition 0 only, or the symbols it
+; defines would be defined once per partition.
+
+module asm "\09.globl asm_sym"
+module asm "asm_sym:"
+module asm "\09.long 1"
+
+define i32 @big(i32 %x) nounwind {
+entry:
+  %a = add i32 %x, 1
+  %b = mul i32 %a, %x
+  %c = sub i32 %b, 7
+  ret i32 %c
+}
+
+define i32 @small(i32 %x) nounwind {
+entry:
+  ret i32 %x
+}
+
+; P0: asm_sym:
+; P0: big:
+
+; P1-NOT: asm_sym
+; P1: small:
+; P1-NOT: asm_sym
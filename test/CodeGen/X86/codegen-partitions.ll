@@ -0,0 +1,41 @@
+; RUN: llc -mtriple=x86_64-linux-gnu -codegen-partitions=2 -codegen-threads=2 \
+; RUN:   -codegen-split-output %s -o %t
+; RUN: FileCheck %s -check-prefix=P0 < %t
+; RUN: FileCheck %s -check-prefix=P1 < %t.1
+; RUN: not llc -mtriple=x86_64-linux-gnu -codegen-partitions=2 %s -o %t \
+; RUN:   |& FileCheck %s -check-prefix=NOSPLIT
+
+; NOSPLIT: requires -codegen-split-output
+
+; The larger function goes into partition 0 together with all global
+; variables.  The internal helper lands in partition 1 and, since it is
+; called from partition 0, is renamed and given hidden visibility.
+
+@g = global i32 42
+
+define i32 @big(i32 %x) nounwind {
+entry:
+  %a = add i32 %x, 1
+  %b = mul i32 %a, %x
+  %c = sub i32 %b, 7
+  %d = call i32 @helper(i32 %c)
+  ret i32 %d
+}
+
+define internal i32 @helper(i32 %x) nounwind {
+entry:
+  %v = load i32* @g
+  %r = add i32 %v, %x
+  ret i32 %r
+}
+
+; P0: big:
+; P0: call{{q?}} helper.llvm.part.{{[0-9A-F]+}}
+; P0: g:
+; P0-NOT: helper.llvm.part.{{[0-9A-F]+}}:
+
+; P1-NOT: big:
+; P1: .hidden helper.llvm.part.{{[0-9A-F]+}}
+; P1: helper.llvm.part.{{[0-9A-F]+}}:
+; P1: g
+; P1-NOT: {{^}}g:
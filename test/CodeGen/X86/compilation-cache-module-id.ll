@@ -0,0 +1,19 @@
+; RUN: rm -rf %t.cache %t.a.ll %t.b.ll
+; RUN: cp %s %t.a.ll
+; RUN: cp %s %t.b.ll
+; RUN: llc -mtriple=x86_64-linux-gnu -cache-dir=%t.cache %t.a.ll -o %t.a.s
+; RUN: llc -mtriple=x86_64-linux-gnu -cache-dir=%t.cache %t.b.ll -o %t.b.s
+; RUN: FileCheck %s -check-prefix=A < %t.a.s
+; RUN: FileCheck %s -check-prefix=B < %t.b.s
+
+; The same module read from two files must not share a cache entry, since the
+; file name is written into the output.
+
+; A: .file "{{.*}}.a.ll"
+; B: .file "{{.*}}.b.ll"
+
+define i32 @f(i32 %x) nounwind {
+entry:
+  %r = add i32 %x, 1
+  ret i32 %r
+}
@@ -0,0 +1,56 @@
+; RUN: lli -force-interpreter %s > /dev/null
+
+; Intrinsics are lowered while other frames of their function are running,
+; PHI nodes swap their values, and invokes return and unwind.
+
+declare i32 @llvm.ctpop.i32(i32)
+declare i32 @llvm.bswap.i32(i32)
+
+define i32 @rec(i32 %n) {
+entry:
+  %z = icmp eq i32 %n, 0
+  br i1 %z, label %base, label %more
+base:
+  ret i32 0
+more:
+  %m = sub i32 %n, 1
+  %r = call i32 @rec(i32 %m)
+  %p = call i32 @llvm.ctpop.i32(i32 %n)
+  %s = add i32 %r, %p
+  ret i32 %s
+}
+
+define i32 @thrower(i32 %x) {
+  %c = icmp eq i32 %x, 7
+  br i1 %c, label %u, label %ok
+u:
+  unwind
+ok:
+  ret i32 %x
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %j, %loop ]
+  %a = phi i32 [ 1, %entry ], [ %b, %loop ]
+  %b = phi i32 [ 2, %entry ], [ %a, %loop ]
+  %j = add i32 %i, 1
+  %d = icmp slt i32 %j, 5
+  br i1 %d, label %loop, label %exit
+exit:
+  %r = call i32 @rec(i32 10)
+  %v = invoke i32 @thrower(i32 7) to label %norm unwind label %exc
+norm:
+  ret i32 100
+exc:
+  %w = invoke i32 @thrower(i32 3) to label %n2 unwind label %exc
+n2:
+  %t = add i32 %r, %w
+  %t2 = add i32 %t, %a
+  %bs = call i32 @llvm.bswap.i32(i32 16777216)
+  %t3 = add i32 %t2, %bs
+  %t4 = sub i32 %t3, 22
+  ret i32 %t4
+}
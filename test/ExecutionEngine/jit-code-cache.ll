@@ -0,0 +1,24 @@
+; RUN: rm -rf %t
+; RUN: lli -jit-cache-dir=%t %s > /dev/null
+; RUN: lli -jit-cache-dir=%t %s > /dev/null
+
+@N = global i32 2
+@Base = global i32 7
+
+define i32 @main() {
+Entry:
+	%N = load i32* @N
+	switch i32 %N, label %Fail [ i32 0, label %Fail
+	                             i32 1, label %Fail
+	                             i32 2, label %Check
+	                             i32 3, label %Fail ]
+Check:
+	%B = load i32* @Base
+	%F = sitofp i32 %B to double
+	%M = fmul double %F, 2.5
+	%R = fptosi double %M to i32
+	%Res = sub i32 %R, 17
+	ret i32 %Res
+Fail:
+	ret i32 1
+}
@@ -0,0 +1,35 @@
+; RUN: lli -jit-write-xor-execute -disable-lazy-compilation=false %s > /dev/null
+; RUN: lli -jit-size-class-memory %s > /dev/null
+
+; Functions are compiled lazily from code that is already executable, and
+; each call must find its callee through a patched stub.
+
+define i32 @square(i32 %X) nounwind {
+	%R = mul i32 %X, %X
+	ret i32 %R
+}
+
+define i32 @sum_squares(i32 %N) nounwind {
+Entry:
+	br label %Loop
+Loop:		; preds = %Loop, %Entry
+	%I = phi i32 [ 0, %Entry ], [ %I2, %Loop ]
+	%S = phi i32 [ 0, %Entry ], [ %S2, %Loop ]
+	%Q = call i32 @square(i32 %I)
+	%S2 = add i32 %S, %Q
+	%I2 = add i32 %I, 1
+	%C = icmp ult i32 %I2, %N
+	br i1 %C, label %Loop, label %Exit
+Exit:		; preds = %Loop
+	ret i32 %S2
+}
+
+define i32 @main() nounwind {
+	%S = call i32 @sum_squares(i32 10)
+	%C = icmp eq i32 %S, 285
+	br i1 %C, label %Pass, label %Fail
+Pass:
+	ret i32 0
+Fail:
+	ret i32 1
+}
@@ -0,0 +1,31 @@
+; RUN: lli -tier-up-threshold=5 %s > /dev/null
+
+define i32 @sum(i32 %N) {
+Entry:
+	br label %Loop
+Loop:		; preds = %Loop, %Entry
+	%I = phi i32 [ 0, %Entry ], [ %I2, %Loop ]
+	%S = phi i32 [ 0, %Entry ], [ %S2, %Loop ]
+	%S2 = add i32 %S, %I
+	%I2 = add i32 %I, 1
+	%C = icmp eq i32 %I2, %N
+	br i1 %C, label %Out, label %Loop
+Out:		; preds = %Loop
+	ret i32 %S2
+}
+
+define i32 @main() {
+Entry:
+	br label %Loop
+Loop:		; preds = %Loop, %Entry
+	%I = phi i32 [ 0, %Entry ], [ %I2, %Loop ]
+	%T = phi i32 [ 0, %Entry ], [ %T2, %Loop ]
+	%S = call i32 @sum(i32 10)
+	%T2 = add i32 %T, %S
+	%I2 = add i32 %I, 1
+	%C = icmp eq i32 %I2, 20
+	br i1 %C, label %Out, label %Loop
+Out:		; preds = %Loop
+	%R = sub i32 %T2, 900
+	ret i32 %R
+}
@@ -0,0 +1,33 @@
+; Test that llvm-ld resolves symbols through the hashed symbol table index
+; written by llvm-ar, and by scanning the members of an archive without one.
+; RUN: rm -f %t.a %t.plain.a
+; RUN: llvm-as %s -o %t.main.bc
+; RUN: echo {define i32 @foo() \{ %r = call i32 @bar() ret i32 %r \} \
+; RUN:   declare i32 @bar() } | llvm-as -o %t.foo.bc
+; RUN: echo {define i32 @bar() \{ ret i32 7 \} } | llvm-as -o %t.bar.bc
+; RUN: echo {define i32 @baz() \{ ret i32 1 \} } | llvm-as -o %t.baz.bc
+; RUN: llvm-ar rcs %t.a %t.foo.bc %t.bar.bc %t.baz.bc
+; RUN: llvm-ar t %t.a | FileCheck -check-prefix=TOC %s
+; RUN: llvm-ld -disable-opt -link-as-library %t.main.bc %t.a -o %t.bc
+; RUN: llvm-dis < %t.bc | FileCheck %s
+; RUN: llvm-ar rc %t.plain.a %t.foo.bc %t.bar.bc %t.baz.bc
+; RUN: llvm-ld -disable-opt -link-as-library -parallel-archive-scan \
+; RUN:   %t.main.bc %t.plain.a -o %t.plain.bc
+; RUN: llvm-dis < %t.plain.bc | FileCheck %s
+
+; TOC-NOT: SYM_IDX
+; TOC: tmp.bar.bc
+; TOC: tmp.baz.bc
+; TOC: tmp.foo.bc
+
+; CHECK: define i32 @main()
+; CHECK: define i32 @foo()
+; CHECK: define i32 @bar()
+; CHECK-NOT: @baz
+
+declare i32 @foo()
+
+define i32 @main() {
+  %r = call i32 @foo()
+  ret i32 %r
+}
@@ -0,0 +1,29 @@
+; RUN: echo {define i32 @foo() \{ %r = call i32 @bar() ret i32 %r \} \
+; RUN:       define internal i32 @bar() \{ ret i32 1 \} \
+; RUN:       define internal i32 @dead() \{ ret i32 2 \} \
+; RUN:       define i32 @unused() \{ ret i32 3 \} } | llvm-as -o %t.2.bc
+; RUN: llvm-as %s -o %t.1.bc
+; RUN: llvm-link -only-needed %t.1.bc %t.2.bc -S | FileCheck %s
+; RUN: llvm-link %t.1.bc %t.2.bc -S | FileCheck %s -check-prefix=ALL
+
+; With -only-needed, only @foo, which the first module declares, and what it
+; calls are linked in.  Without it, everything is.
+
+; CHECK: define i32 @main()
+; CHECK: define i32 @foo()
+; CHECK: define internal i32 @bar()
+; CHECK-NOT: @dead
+; CHECK-NOT: @unused
+
+; ALL: define i32 @main()
+; ALL: define i32 @foo()
+; ALL: define internal i32 @bar()
+; ALL: define internal i32 @dead()
+; ALL: define i32 @unused()
+
+declare i32 @foo()
+
+define i32 @main() {
+  %r = call i32 @foo()
+  ret i32 %r
+}
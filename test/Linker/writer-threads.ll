@@ -0,0 +1,43 @@
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-link %t.bc -o %t.1.bc
+; RUN: llvm-link -writer-threads=4 %t.bc -o %t.4.bc
+; RUN: cmp %t.1.bc %t.4.bc
+; RUN: llvm-link -writer-threads=4 %t.bc -o - | llvm-dis | FileCheck %s
+
+; Function bodies encoded on several threads are written in order, with the
+; same encoding as on one thread.
+
+@g = global [2 x i32] [i32 1, i32 2]
+
+define i32 @first(i32 %x) {
+  %p = getelementptr [2 x i32]* @g, i32 0, i32 1
+  %v = load i32* %p, !tag !0
+  %r = add i32 %x, %v
+  ret i32 %r
+}
+
+define i32 @second(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 7
+  br i1 %c, label %t, label %f
+t:
+  %a = call i32 @first(i32 %x)
+  ret i32 %a
+f:
+  %b = select i1 %c, i8* blockaddress(@second, %t), i8* null
+  ret i32 3
+}
+
+define double @third(double %d) {
+  %r = fmul double %d, 2.500000e+00
+  ret double %r
+}
+
+!0 = metadata !{i32 42}
+
+; CHECK: define i32 @first
+; CHECK: add i32 %x, %v
+; CHECK: define i32 @second
+; CHECK: blockaddress(@second, %t)
+; CHECK: define double @third
+; CHECK: fmul double %d, 2.500000e+00
@@ -0,0 +1,31 @@
+; RUN: opt < %s -analysis-cache -domtree -tailcallelim -simplifycfg -domtree \
+; RUN:   -verify-dom-info -stats -disable-output |& FileCheck %s
+
+; With the analysis cache, the dominator tree of @f is built once because no
+; pass changes @f, while @g gets a new one after -simplifycfg folds its branch.
+; CHECK: 3 analysis-cache - Number of analysis results computed
+; CHECK: 1 analysis-cache - Number of analysis results reused
+
+define i32 @f(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %a, label %b
+
+a:
+  ret i32 1
+
+b:
+  %y = add i32 %x, 1
+  ret i32 %y
+}
+
+define i32 @g(i32 %x) {
+entry:
+  br i1 true, label %a, label %b
+
+a:
+  ret i32 1
+
+b:
+  ret i32 %x
+}
@@ -0,0 +1,56 @@
+; RUN: llvm-as < %s > %t.bc
+; RUN: opt < %t.bc -instcombine -simplify-libcalls -S > %t.eager
+; RUN: opt < %t.bc -lazy-function-bodies -instcombine -simplify-libcalls -S \
+; RUN:   > %t.lazy
+; RUN: diff %t.eager %t.lazy
+; RUN: FileCheck %s < %t.lazy
+
+; A body that has not been read in yet must not be mistaken for a declaration
+; of the C library routine of the same name.  The callers come first so that
+; @malloc and @strlen are still unmaterialized when they are optimized.
+
+@str = internal constant [4 x i8] c"abc\00"
+
+; CHECK: define i64 @len()
+; CHECK: call i64 @strlen
+define i64 @len() {
+entry:
+  %p = getelementptr [4 x i8]* @str, i32 0, i32 0
+  %n = call i64 @strlen(i8* %p)
+  ret i64 %n
+}
+
+; CHECK: define void @alloc()
+; CHECK: call i8* @malloc
+; CHECK: call void @free
+define void @alloc() {
+entry:
+  %p = call i8* @malloc(i64 4)
+  call void @free(i8* %p)
+  ret void
+}
+
+@pool = global [16 x i8] zeroinitializer
+@count = global i32 0
+
+; CHECK: define i8* @malloc(i64 %n)
+define i8* @malloc(i64 %n) {
+entry:
+  %c = load i32* @count
+  %c1 = add i32 %c, 1
+  store i32 %c1, i32* @count
+  ret i8* getelementptr ([16 x i8]* @pool, i32 0, i32 0)
+}
+
+define void @free(i8* %p) {
+entry:
+  %c = load i32* @count
+  %c1 = sub i32 %c, 1
+  store i32 %c1, i32* @count
+  ret void
+}
+
+define i64 @strlen(i8* %s) {
+entry:
+  ret i64 42
+}
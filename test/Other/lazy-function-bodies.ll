@@ -0,0 +1,37 @@
+; RUN: llvm-as < %s | opt -lazy-function-bodies -instcombine -S | FileCheck %s
+; RUN: llvm-as < %s | opt -lazy-function-bodies -analyze -domtree | FileCheck %s -check-prefix=DOM
+
+; Function passes given first run while the bodies are read on demand.  Check
+; that every body is still optimized and written out, and that analyses are
+; printed for each function when the bodies are released after use.
+
+@g = internal constant i32 7
+
+; CHECK: define i32 @a(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %r = add i32 %x, 7
+define i32 @a(i32 %x) {
+entry:
+  %v = load i32* @g
+  %r = add i32 %x, %v
+  ret i32 %r
+}
+
+; CHECK: define internal i32 @b(i32 %x)
+; CHECK: call i32 @a(i32 %x)
+define internal i32 @b(i32 %x) {
+entry:
+  %y = add i32 %x, 0
+  %r = call i32 @a(i32 %y)
+  ret i32 %r
+}
+
+define i32 @c() {
+entry:
+  %r = call i32 @b(i32 1)
+  ret i32 %r
+}
+
+; DOM: Printing analysis 'Dominator Tree Construction' for function 'a':
+; DOM: Printing analysis 'Dominator Tree Construction' for function 'b':
+; DOM: Printing analysis 'Dominator Tree Construction' for function 'c':
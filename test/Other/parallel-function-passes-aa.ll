@@ -0,0 +1,28 @@
+; RUN: opt < %s -basicaa -gvn -S > %t.serial
+; RUN: opt < %s -function-pass-threads=2 -basicaa -gvn -S > %t.parallel
+; RUN: diff %t.serial %t.parallel
+; RUN: FileCheck %s < %t.parallel
+
+; The worker threads must see the alias analysis given on the command line,
+; or GVN cannot forward the first store past the store through the other
+; noalias pointer.
+
+; CHECK: define i32 @f
+; CHECK: ret i32 1
+define i32 @f(i32* noalias %p, i32* noalias %q) {
+entry:
+  store i32 1, i32* %p
+  store i32 2, i32* %q
+  %v = load i32* %p
+  ret i32 %v
+}
+
+; CHECK: define i32 @g
+; CHECK: ret i32 3
+define i32 @g(i32* noalias %p, i32* noalias %q) {
+entry:
+  store i32 3, i32* %p
+  store i32 4, i32* %q
+  %v = load i32* %p
+  ret i32 %v
+}
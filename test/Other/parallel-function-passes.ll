@@ -0,0 +1,52 @@
+; RUN: opt < %s -function-pass-threads=3 -instcombine -simplify-libcalls -S | FileCheck %s
+
+; Function passes run on partitions of the module in separate contexts and
+; the results are merged back.  Check that the merged module still refers to
+; the original globals and picks up declarations added by the passes.
+
+%opaque = type opaque
+
+@g = internal constant i32 7
+@str = internal constant [7 x i8] c"hello\0A\00"
+@p = global %opaque* null
+
+declare i32 @printf(i8*, ...)
+
+; CHECK: define i32 @a(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %r = add i32 %x, 7
+define i32 @a(i32 %x) {
+entry:
+  %v = load i32* @g
+  %r = add i32 %x, %v
+  ret i32 %r
+}
+
+; CHECK: define internal i32 @b(i32 %x)
+; CHECK: call i32 @a(i32 %x)
+define internal i32 @b(i32 %x) {
+entry:
+  %y = add i32 %x, 0
+  %r = call i32 @a(i32 %y)
+  ret i32 %r
+}
+
+; CHECK: define %opaque* @c()
+; CHECK: call i32 @puts
+define %opaque* @c() {
+entry:
+  %f = getelementptr [7 x i8]* @str, i32 0, i32 0
+  call i32 (i8*, ...)* @printf(i8* %f)
+  %q = load %opaque** @p
+  ret %opaque* %q
+}
+
+; CHECK: define i32 @d()
+; CHECK: call i32 @b(i32 1)
+define i32 @d() {
+entry:
+  %r = call i32 @b(i32 1)
+  ret i32 %r
+}
+
+; CHECK: declare i32 @puts(i8*
@@ -0,0 +1,91 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMDirectedPass%shlibext \
+; RUN:   -diffFinder -disable-output |& FileCheck %s
+; REQUIRES: loadable_module
+
+; diffFinder compares @func_2 with its old version @func.  Only the value
+; stored in %update changed, so %update starts out in AWN.  The affected sets
+; then grow to their fixed point, which the worklist must reach whatever
+; order it visits the blocks in:
+;  - the store writes %q, which the loop condition in %header reads, so
+;    %header joins ACN;
+;  - %header controls %body, whose condition joins ACN, and %body controls
+;    %update again, closing the cycle through the loop;
+;  - %header also controls the chain of conditions in %check1 and %check2,
+;    and %check2 controls the store in %write, which joins AWN.
+; The store in %entry is controlled by nothing.
+
+; CHECK: Size of ACN and AWN vectors(updated) 4 --- 2
+; CHECK-NEXT: ACN = header
+; CHECK-NEXT: ACN = body
+; CHECK-NEXT: ACN = check1
+; CHECK-NEXT: ACN = check2
+; CHECK-NEXT: AWN = update
+; CHECK-NEXT: AWN = write
+
+define void @func(i32 %x, i32* %q, i32* %p) {
+entry:
+  store i32 0, i32* %q
+  br label %header
+
+header:
+  %v = load i32* %q
+  %c = icmp slt i32 %v, 10
+  br i1 %c, label %body, label %check1
+
+body:
+  %b = icmp eq i32 %x, 3
+  br i1 %b, label %update, label %exit
+
+update:
+  store i32 1, i32* %q
+  br label %header
+
+check1:
+  %c1 = icmp eq i32 %v, 11
+  br i1 %c1, label %check2, label %exit
+
+check2:
+  %c2 = icmp eq i32 %x, 12
+  br i1 %c2, label %write, label %exit
+
+write:
+  store i32 1, i32* %p
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @func_2(i32 %x, i32* %q, i32* %p) {
+entry:
+  store i32 0, i32* %q
+  br label %header
+
+header:
+  %v = load i32* %q
+  %c = icmp slt i32 %v, 10
+  br i1 %c, label %body, label %check1
+
+body:
+  %b = icmp eq i32 %x, 3
+  br i1 %b, label %update, label %exit
+
+update:
+  store i32 2, i32* %q
+  br label %header
+
+check1:
+  %c1 = icmp eq i32 %v, 11
+  br i1 %c1, label %check2, label %exit
+
+check2:
+  %c2 = icmp eq i32 %x, 12
+  br i1 %c2, label %write, label %exit
+
+write:
+  store i32 1, i32* %p
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,88 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMDirectedPass%shlibext \
+; RUN:   -block-reachability -verify-block-reachability -analyze | FileCheck %s
+; REQUIRES: loadable_module
+
+; -verify-block-reachability checks every answer of the index against a
+; depth first search; the CHECK lines spell out what that search finds.
+
+; The blocks of the nested loops form one component.  Blocks before it are not
+; reached from inside it, and the block no path from the entry reaches only
+; reaches what follows it.
+; CHECK: Reachability index for 'loops': 4 strongly connected components
+; CHECK-NEXT: %entry reaches %entry %outer %inner %latch %exit
+; CHECK-NEXT: %outer reaches %outer %inner %latch %exit
+; CHECK-NEXT: %inner reaches %outer %inner %latch %exit
+; CHECK-NEXT: %latch reaches %outer %inner %latch %exit
+; CHECK-NEXT: %exit reaches %exit
+; CHECK-NEXT: %dead reaches %exit %dead
+define void @loops(i32 %n) {
+entry:
+  br label %outer
+
+outer:
+  %c1 = icmp eq i32 %n, 0
+  br i1 %c1, label %exit, label %inner
+
+inner:
+  %c2 = icmp eq i32 %n, 1
+  br i1 %c2, label %inner, label %latch
+
+latch:
+  %c3 = icmp eq i32 %n, 2
+  br i1 %c3, label %outer, label %inner
+
+exit:
+  ret void
+
+dead:
+  br label %exit
+}
+
+; Unreachable blocks can form a cycle of their own.
+; CHECK: Reachability index for 'dead_cycle': 3 strongly connected components
+; CHECK-NEXT: %entry reaches %entry
+; CHECK-NEXT: %a reaches %a %b %c
+; CHECK-NEXT: %b reaches %a %b %c
+; CHECK-NEXT: %c reaches %c
+define void @dead_cycle() {
+entry:
+  ret void
+
+a:
+  br label %b
+
+b:
+  br i1 true, label %a, label %c
+
+c:
+  unreachable
+}
+
+; A recursive call is not an edge of the CFG: the return block does not reach
+; the entry block again.
+; CHECK: Reachability index for 'recursive': 3 strongly connected components
+; CHECK-NEXT: %entry reaches %entry %recurse %done
+; CHECK-NEXT: %recurse reaches %recurse %done
+; CHECK-NEXT: %done reaches %done
+define i32 @recursive(i32 %n) {
+entry:
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %done, label %recurse
+
+recurse:
+  %m = sub i32 %n, 1
+  %r = call i32 @recursive(i32 %m)
+  br label %done
+
+done:
+  %v = phi i32 [ 0, %entry ], [ %r, %recurse ]
+  ret i32 %v
+}
+
+; A function that is never called is indexed like any other.
+; CHECK: Reachability index for 'uncalled': 1 strongly connected components
+; CHECK-NEXT: %entry reaches %entry
+define internal void @uncalled() {
+entry:
+  ret void
+}
@@ -0,0 +1,50 @@
+; This file is the old version of the module in diff-module.ll, so it doesn't
+; actually do anything itself
+; RUN: true
+
+@g = global i32 0
+
+define i32 @unchanged(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %zero, label %done
+
+zero:
+  store i32 1, i32* @g
+  br label %done
+
+done:
+  ret i32 %x
+}
+
+define i32 @old_name(i32 %x, i32 %y) {
+entry:
+  %s = add i32 %x, %y
+  %c = icmp ult i32 %s, 10
+  br i1 %c, label %small, label %large
+
+small:
+  ret i32 %s
+
+large:
+  ret i32 10
+}
+
+define void @changed(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 5
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 %x, i32* @g
+  %v = load i32* @g
+  %c2 = icmp eq i32 %v, 3
+  br i1 %c2, label %inner, label %exit
+
+inner:
+  store i32 0, i32* @g
+  br label %exit
+
+exit:
+  ret void
+}
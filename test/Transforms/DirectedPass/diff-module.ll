@@ -0,0 +1,64 @@
+; RUN: opt < %s -load=%llvmshlibdir/LLVMDirectedPass%shlibext \
+; RUN:   -diffFinder -diff-module=%p/diff-module-old.ll -disable-output \
+; RUN:   |& FileCheck %s
+; REQUIRES: loadable_module
+
+; diffFinder pairs @new_name with @old_name by its shape, finds no difference
+; in it or in @unchanged, and only reports the blocks of @changed that the
+; changed comparison affects.
+
+; CHECK: Diffing 3 functions against {{.*}}diff-module-old.ll
+; CHECK-NOT: unchanged
+; CHECK-NOT: new_name
+; CHECK: ACN = changed entry
+; CHECK-NEXT: ACN = changed then
+; CHECK-NEXT: AWN = changed then
+; CHECK-NEXT: AWN = changed inner
+; CHECK-NEXT: 1 of 3 functions changed
+
+@g = global i32 0
+
+define i32 @unchanged(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %zero, label %done
+
+zero:
+  store i32 1, i32* @g
+  br label %done
+
+done:
+  ret i32 %x
+}
+
+define i32 @new_name(i32 %x, i32 %y) {
+entry:
+  %s = add i32 %x, %y
+  %c = icmp ult i32 %s, 10
+  br i1 %c, label %small, label %large
+
+small:
+  ret i32 %s
+
+large:
+  ret i32 10
+}
+
+define void @changed(i32 %x) {
+entry:
+  %c = icmp sgt i32 %x, 5
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 %x, i32* @g
+  %v = load i32* @g
+  %c2 = icmp eq i32 %v, 3
+  br i1 %c2, label %inner, label %exit
+
+inner:
+  store i32 0, i32* @g
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,81 @@
+; RUN: echo other goal > %t.targets
+; RUN: echo deep hit >> %t.targets
+; RUN: echo main m2 > %t.retarget
+; RUN: opt < %s -load=%llvmshlibdir/LLVMDirectedPass%shlibext \
+; RUN:   -target-distance -distance-targets=%t.targets -analyze \
+; RUN:   | FileCheck %s
+; RUN: opt < %s -load=%llvmshlibdir/LLVMDirectedPass%shlibext \
+; RUN:   -target-distance -distance-targets=%t.targets \
+; RUN:   -distance-retarget=%t.retarget -analyze > %t.updated
+; RUN: FileCheck %s -check-prefix=RETARGET < %t.updated
+; RUN: opt < %s -load=%llvmshlibdir/LLVMDirectedPass%shlibext \
+; RUN:   -target-distance -distance-targets=%t.retarget -analyze > %t.scratch
+; RUN: diff %t.updated %t.scratch
+; REQUIRES: loadable_module
+
+; @helper is called from @main and from @other.  A path that starts in
+; @helper may return to either, but one that comes from @main must return
+; there, so @main cannot get to %goal in @other through @helper.
+
+; CHECK: Distances to 2 target blocks:
+; CHECK-NEXT: main %entry: 4
+; CHECK-NEXT: main %m1: 3
+; CHECK-NEXT: main %m2: unreachable
+; CHECK-NEXT: helper %entry: 2
+; CHECK-NEXT: other %entry: 1
+; CHECK-NEXT: other %goal: 0
+; CHECK-NEXT: deep %entry: 2
+; CHECK-NEXT: deep %d1: 1
+; CHECK-NEXT: deep %hit: 0
+
+; With %m2 in @main as the target instead, @helper and @deep can return to
+; @main to get there, but @other cannot get there through @helper.
+
+; RETARGET: Distances to 1 target blocks:
+; RETARGET-NEXT: main %entry: 2
+; RETARGET-NEXT: main %m1: 1
+; RETARGET-NEXT: main %m2: 0
+; RETARGET-NEXT: helper %entry: 3
+; RETARGET-NEXT: other %entry: unreachable
+; RETARGET-NEXT: other %goal: unreachable
+; RETARGET-NEXT: deep %entry: 4
+; RETARGET-NEXT: deep %d1: 3
+; RETARGET-NEXT: deep %hit: 2
+
+define void @main() {
+entry:
+  call void @helper()
+  br label %m1
+
+m1:
+  call void @deep()
+  br label %m2
+
+m2:
+  ret void
+}
+
+define void @helper() {
+entry:
+  ret void
+}
+
+define void @other() {
+entry:
+  call void @helper()
+  br label %goal
+
+goal:
+  ret void
+}
+
+define void @deep() {
+entry:
+  br label %d1
+
+d1:
+  br label %hit
+
+hit:
+  ret void
+}
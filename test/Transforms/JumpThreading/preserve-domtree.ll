@@ -0,0 +1,95 @@
+; RUN: opt < %s -domtree -jump-threading -verify-dom-info -S | FileCheck %s
+; RUN: opt < %s -domtree -jump-threading -domtree -debug-pass=Arguments \
+; RUN:   -disable-output 2>&1 | FileCheck --check-prefix=PASSES %s
+
+; Jump threading updates the dominator tree as it changes the CFG instead of
+; leaving it to be recomputed by the next pass that needs it.
+; PASSES: -domtree -lazy-value-info -jump-threading -preverify -verify
+; PASSES-NOT: domtree
+
+declare i32 @f1()
+declare i32 @f2()
+declare void @f3()
+
+; Threading both edges into %Merge leaves it unreachable.
+define i32 @thread(i1 %cond) {
+; CHECK: @thread
+; CHECK-NEXT: br i1 %cond, label %T2, label %F2
+; CHECK: T2:
+; CHECK-NEXT: %v1 = call i32 @f1()
+; CHECK-NEXT: call void @f3()
+; CHECK-NEXT: ret i32 %v1
+	br i1 %cond, label %T1, label %F1
+
+T1:
+	%v1 = call i32 @f1()
+	br label %Merge
+
+F1:
+	%v2 = call i32 @f2()
+	br label %Merge
+
+Merge:
+	%A = phi i1 [true, %T1], [false, %F1]
+	%B = phi i32 [%v1, %T1], [%v2, %F1]
+	br i1 %A, label %T2, label %F2
+
+T2:
+	call void @f3()
+	ret i32 %B
+
+F2:
+	ret i32 %B
+}
+
+; Only the edge from %T1 is threaded; %Merge keeps its other predecessors
+; and %T2 gets a second predecessor.
+define i32 @partial(i1 %cond, i1 %cond2, i1 %c) {
+; CHECK: @partial
+; CHECK: Merge.thread:
+; CHECK-NEXT: %v1 = call i32 @f1()
+; CHECK-NEXT: br label %T2
+	br i1 %cond, label %T1, label %F1
+
+T1:
+	%v1 = call i32 @f1()
+	br label %Merge
+
+F1:
+	%v2 = call i32 @f2()
+	br i1 %cond2, label %Merge, label %F2
+
+Merge:
+	%A = phi i1 [true, %T1], [%c, %F1]
+	br i1 %A, label %T2, label %F2
+
+T2:
+	call void @f3()
+	ret i32 1
+
+F2:
+	ret i32 2
+}
+
+; Branches on undef and on constants are folded, and the blocks they no
+; longer reach drop out of the tree.
+define i32 @fold(i1 %cond) {
+; CHECK: @fold
+; CHECK-NEXT: C:
+; CHECK-NEXT: ret i32 1
+entry:
+	br i1 undef, label %A, label %B
+
+A:
+	br i1 true, label %C, label %D
+
+B:
+	br label %C
+
+C:
+	%x = phi i32 [1, %A], [2, %B]
+	ret i32 %x
+
+D:
+	ret i32 3
+}
@@ -76,6 +76,10 @@ namespace options {
   static std::string extra_library_path;
   static std::string triple;
   static std::string mcpu;
+  static unsigned partitions = 1;
+  static unsigned codegen_threads = 0;
+  static std::string cache_dir;
+  static unsigned cache_max_size = 0;
   // Additional options to pass into the code generator.
   // Note: This array will contain all plugin options which are not claimed
   // as plugin exclusive to pass to the code generator.
@@ -97,6 +101,22 @@ namespace options {
       extra_library_path = opt.substr(strlen("extra_library_path="));
     } else if (opt.startswith("mtriple=")) {
       triple = opt.substr(strlen("mtriple="));
+    } else if (opt.startswith("partitions=")) {
+      if (opt.substr(strlen("partitions=")).getAsInteger(10, partitions) ||
+          partitions == 0) {
+        (*message)(LDPL_WARNING, "Ignoring invalid option %s", opt_);
+        partitions = 1;
+      }
+    } else if (opt.startswith("codegen-threads=")) {
+      if (opt.substr(strlen("codegen-threads=")).getAsInteger(10,
+                                                              codegen_threads))
+        (*message)(LDPL_WARNING, "Ignoring invalid option %s", opt_);
+    } else if (opt.startswith("cache-dir=")) {
+      cache_dir = opt.substr(strlen("cache-dir="));
+    } else if (opt.startswith("cache-max-size=")) {
+      if (opt.substr(strlen("cache-max-size=")).getAsInteger(10,
+                                                             cache_max_size))
+        (*message)(LDPL_WARNING, "Ignoring invalid option %s", opt_);
     } else if (opt.startswith("obj-path=")) {
       obj_path = opt.substr(strlen("obj-path="));
     } else if (opt == "emit-llvm") {
@@ -361,6 +381,27 @@ static ld_plugin_status claim_file_hook(const ld_plugin_input_file *file,
   return LDPS_OK;
 }
 
+/// writeObjectFile - Write the object file in [buffer, buffer+size) to path.
+static ld_plugin_status writeObjectFile(const char *path, const char *buffer,
+                                        size_t size) {
+  std::string ErrMsg;
+  tool_output_file objFile(path, ErrMsg, raw_fd_ostream::F_Binary);
+  if (!ErrMsg.empty()) {
+    (*message)(LDPL_ERROR, "%s", ErrMsg.c_str());
+    return LDPS_ERR;
+  }
+
+  objFile.os().write(buffer, size);
+  objFile.os().close();
+  if (objFile.os().has_error()) {
+    (*message)(LDPL_ERROR, "Error writing output file '%s'", path);
+    objFile.os().clear_error();
+    return LDPS_ERR;
+  }
+  objFile.keep();
+  return LDPS_OK;
+}
+
 /// all_symbols_read_hook - gold informs us that all symbols have been read.
 /// At this point, we use get_symbols to see if any of our definitions have
 /// been overridden by a native object file. Then, perform optimization and
@@ -407,6 +448,16 @@ static ld_plugin_status all_symbols_read_hook(void) {
   lto_codegen_set_debug_model(code_gen, LTO_DEBUG_MODEL_DWARF);
   if (!options::mcpu.empty())
     lto_codegen_set_cpu(code_gen, options::mcpu.c_str());
+  if (options::partitions != 1 &&
+      lto_codegen_set_partitions(code_gen, options::partitions,
+                                 options::codegen_threads)) {
+    (*message)(LDPL_ERROR, "%s", lto_get_error_message());
+    return LDPS_ERR;
+  }
+  if (!options::cache_dir.empty()) {
+    lto_codegen_set_cache_dir(code_gen, options::cache_dir.c_str());
+    lto_codegen_set_cache_max_size(code_gen, options::cache_max_size);
+  }
 
   // Pass through extra options to the code generator.
   if (!options::extra.empty()) {
@@ -433,9 +484,31 @@ static ld_plugin_status all_symbols_read_hook(void) {
   size_t bufsize = 0;
   const char *buffer = static_cast<const char *>(lto_codegen_compile(code_gen,
                                                                      &bufsize));
+  if (!buffer) {
+    (*message)(LDPL_ERROR, "%s", lto_get_error_message());
+    return LDPS_ERR;
+  }
 
   std::string ErrMsg;
 
+  // With several partitions, every object after the first one goes to a
+  // temporary file of its own.
+  std::vector<sys::Path> extraObjPaths;
+  for (unsigned i = 1, e = lto_codegen_get_num_objects(code_gen); i != e;
+       ++i) {
+    size_t size = 0;
+    const char *obj =
+      static_cast<const char *>(lto_codegen_get_object(code_gen, i, &size));
+    sys::Path path("/tmp/llvmgold.o");
+    if (path.createTemporaryFileOnDisk(true, &ErrMsg) ||
+        writeObjectFile(path.c_str(), obj, size) != LDPS_OK) {
+      if (!ErrMsg.empty())
+        (*message)(LDPL_ERROR, "%s", ErrMsg.c_str());
+      return LDPS_ERR;
+    }
+    extraObjPaths.push_back(path);
+  }
+
   const char *objPath;
   sys::Path uniqueObjPath("/tmp/llvmgold.o");
   if (!options::obj_path.empty()) {
@@ -447,22 +520,8 @@ static ld_plugin_status all_symbols_read_hook(void) {
     }
     objPath = uniqueObjPath.c_str();
   }
-  tool_output_file objFile(objPath, ErrMsg,
-                             raw_fd_ostream::F_Binary);
-    if (!ErrMsg.empty()) {
-      (*message)(LDPL_ERROR, "%s", ErrMsg.c_str());
-      return LDPS_ERR;
-    }
-
-  objFile.os().write(buffer, bufsize);
-  objFile.os().close();
-  if (objFile.os().has_error()) {
-    (*message)(LDPL_ERROR, "Error writing output file '%s'",
-               objPath);
-    objFile.os().clear_error();
+  if (writeObjectFile(objPath, buffer, bufsize) != LDPS_OK)
     return LDPS_ERR;
-  }
-  objFile.keep();
 
   lto_codegen_dispose(code_gen);
   for (std::list<claimed_file>::iterator I = Modules.begin(),
@@ -488,6 +547,14 @@ static ld_plugin_status all_symbols_read_hook(void) {
   if (options::obj_path.empty())
     Cleanup.push_back(sys::Path(objPath));
 
+  for (unsigned i = 0, e = extraObjPaths.size(); i != e; ++i) {
+    Cleanup.push_back(extraObjPaths[i]);
+    if ((*add_input_file)(extraObjPaths[i].c_str()) != LDPS_OK) {
+      (*message)(LDPL_ERROR, "Unable to add .o file to the link.");
+      return LDPS_ERR;
+    }
+  }
+
   return LDPS_OK;
 }
 
@@ -18,19 +18,25 @@
 #include "llvm/PassManager.h"
 #include "llvm/Pass.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/IRReader.h"
 #include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Config/config.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/CompilationCache.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Target/SubtargetFeature.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Target/TargetMachine.h"
@@ -109,6 +115,35 @@ NoImplicitFloats("no-implicit-float",
   cl::desc("Don't generate implicit floating point instructions (x86-only)"),
   cl::init(false));
 
+static cl::opt<unsigned>
+CodeGenPartitions("codegen-partitions",
+  cl::desc("Split the module into N partitions and generate code for them "
+           "in parallel (requires -codegen-split-output)"),
+  cl::value_desc("N"), cl::init(1));
+
+static cl::opt<bool>
+CodeGenSplitOutput("codegen-split-output",
+  cl::desc("Write partition i > 0 of -codegen-partitions into <output>.i, "
+           "sharing internal symbols through hidden globals"));
+
+static cl::opt<unsigned>
+CodeGenThreads("codegen-threads",
+  cl::desc("Number of threads used with -codegen-partitions "
+           "(default = number of processors)"),
+  cl::value_desc("N"), cl::init(0));
+
+static cl::opt<std::string>
+CacheDir("cache-dir",
+  cl::desc("Reuse the output of identical compilations kept in this "
+           "directory"),
+  cl::value_desc("directory"));
+
+static cl::opt<unsigned>
+CacheMaxSize("cache-max-size",
+  cl::desc("Evict the least recently used entries of -cache-dir beyond "
+           "this size (default = no limit)"),
+  cl::value_desc("megabytes"), cl::init(0));
+
 // GetFileNameRoot - Helper function to get the basename of a filename.
 static inline std::string
 GetFileNameRoot(const std::string &InputFilename) {
@@ -189,6 +224,151 @@ static tool_output_file *GetOutputStream(const char *TargetName,
   return FDOut;
 }
 
+// CopyTargetMachineFlags - Apply the MC flags chosen for the main target
+// machine to a target machine created for a partition.
+static void CopyTargetMachineFlags(TargetMachine &TM, void *Opaque) {
+  const TargetMachine &Main = *static_cast<const TargetMachine*>(Opaque);
+  TM.setMCUseLoc(Main.hasMCUseLoc());
+  TM.setMCRelaxAll(Main.hasMCRelaxAll());
+}
+
+// GeneratePartitions - Generate code for the module in CodeGenPartitions
+// pieces on CodeGenThreads threads, leaving partition i in Outputs[i].
+// Returns true on error.
+static bool GeneratePartitions(Module &mod, const Target *TheTarget,
+                               const std::string &TripleStr,
+                               const std::string &FeaturesStr,
+                               TargetMachine &Target, CodeGenOpt::Level OLvl,
+                               std::vector<std::string> &Outputs,
+                               const char *ProgName) {
+  std::vector<std::string> Parts;
+  SplitModuleForCodeGen(mod, CodeGenPartitions, Parts);
+
+  ParallelCodeGenOptions Options;
+  Options.TheTarget = TheTarget;
+  Options.TargetTriple = TripleStr;
+  Options.Features = FeaturesStr;
+  Options.FileType = FileType;
+  Options.OptLevel = OLvl;
+  Options.DisableVerify = NoVerify;
+  Options.NumThreads = CodeGenThreads;
+  Options.InitTargetMachine = CopyTargetMachineFlags;
+  Options.InitOpaque = &Target;
+
+  std::string ErrMsg;
+  if (CodeGenModulePartitions(Parts, Options, Outputs, ErrMsg)) {
+    errs() << ProgName << ": " << ErrMsg << '\n';
+    return true;
+  }
+  return false;
+}
+
+// WriteOutputs - Write Outputs[0] to Out and Outputs[i] to
+// "<OutputFilename>.i".  Returns the process exit code.
+static int WriteOutputs(const std::vector<StringRef> &Outputs,
+                        tool_output_file &Out) {
+  // Write the partitions out in order, so the result does not depend on
+  // which thread finished first.
+  std::vector<tool_output_file*> Extra;
+  bool Failed = false;
+  for (unsigned i = 1, e = Outputs.size(); i != e && !Failed; ++i) {
+    std::string error;
+    std::string Name = OutputFilename + "." + utostr(i);
+    tool_output_file *FDOut = new tool_output_file(Name.c_str(), error,
+                                                   raw_fd_ostream::F_Binary);
+    if (!error.empty()) {
+      errs() << error << '\n';
+      delete FDOut;
+      Failed = true;
+      break;
+    }
+    FDOut->os() << Outputs[i];
+    Extra.push_back(FDOut);
+  }
+  if (!Failed) {
+    Out.os() << Outputs[0];
+    Out.keep();
+    for (unsigned i = 0, e = Extra.size(); i != e; ++i)
+      Extra[i]->keep();
+  }
+  for (unsigned i = 0, e = Extra.size(); i != e; ++i)
+    delete Extra[i];
+  return Failed ? 1 : 0;
+}
+
+// IsIgnoredByCache - Return true if the command line option Name does not
+// affect the output, apart from its file name.
+static bool IsIgnoredByCache(StringRef Name) {
+  return Name == "o" || Name == "cache-dir" || Name == "cache-max-size" ||
+         Name == "codegen-threads";
+}
+
+// GetCacheKey - Hash everything that determines the output of this run: the
+// module and its identifier, the target, and the rest of the command line.
+static std::string GetCacheKey(const Module &mod, const std::string &TripleStr,
+                               const std::string &FeaturesStr,
+                               int argc, char **argv) {
+  std::string Bitcode;
+  raw_string_ostream OS(Bitcode);
+  WriteBitcodeToFile(&mod, OS);
+  OS.flush();
+
+  CompilationCache::KeyBuilder Key;
+  Key.add("llc").add(PACKAGE_VERSION).add(TripleStr).add(FeaturesStr);
+  for (int i = 1; i < argc; ++i) {
+    StringRef Arg(argv[i]);
+    if (Arg == InputFilename)
+      continue;
+    if (Arg.size() > 1 && Arg[0] == '-') {
+      std::pair<StringRef, StringRef> NameValue =
+        Arg.substr(Arg[1] == '-' ? 2 : 1).split('=');
+      if (IsIgnoredByCache(NameValue.first)) {
+        // Skip the value too if it is a separate argument.
+        if (Arg.find('=') == StringRef::npos)
+          ++i;
+        continue;
+      }
+    }
+    Key.add(Arg);
+  }
+  // The bitcode does not record the module identifier, which names the
+  // source file in the output and is hashed into the names of symbols shared
+  // between -codegen-partitions.
+  Key.add(mod.getModuleIdentifier());
+  Key.add(Bitcode);
+  return Key.getKey();
+}
+
+// GetCacheEntryKey - Return the key of output Part of the compilation whose
+// key is Key.
+static std::string GetCacheEntryKey(const std::string &Key, unsigned Part) {
+  return Part == 0 ? Key : Key + "." + utostr(Part);
+}
+
+// EmitFromCache - If the cache has every output of the compilation whose key
+// is Key, write them out and return true.
+static bool EmitFromCache(CompilationCache &Cache, const std::string &Key,
+                          tool_output_file &Out, int &ExitCode) {
+  std::vector<MemoryBuffer*> Buffers;
+  for (unsigned i = 0; i != CodeGenPartitions; ++i) {
+    OwningPtr<MemoryBuffer> Buffer;
+    if (!Cache.lookup(GetCacheEntryKey(Key, i), Buffer))
+      break;
+    Buffers.push_back(Buffer.take());
+  }
+
+  bool Hit = Buffers.size() == CodeGenPartitions;
+  if (Hit) {
+    std::vector<StringRef> Outputs;
+    for (unsigned i = 0, e = Buffers.size(); i != e; ++i)
+      Outputs.push_back(Buffers[i]->getBuffer());
+    ExitCode = WriteOutputs(Outputs, Out);
+  }
+  for (unsigned i = 0, e = Buffers.size(); i != e; ++i)
+    delete Buffers[i];
+  return Hit;
+}
+
 // main - Entry point for the llc compiler.
 //
 int main(int argc, char **argv) {
@@ -207,7 +387,27 @@ int main(int argc, char **argv) {
   InitializeAllAsmParsers();
 
   cl::ParseCommandLineOptions(argc, argv, "llvm system compiler\n");
-  
+
+  if (CodeGenPartitions == 0) {
+    errs() << argv[0] << ": -codegen-partitions must be at least 1.\n";
+    return 1;
+  }
+  if (CodeGenPartitions > 1) {
+    // The partitions cannot be put back together into one file, and the
+    // symbols they share are no longer local, so this has to be asked for.
+    if (!CodeGenSplitOutput) {
+      errs() << argv[0] << ": -codegen-partitions writes one output file per "
+             << "partition and requires -codegen-split-output.\n";
+      return 1;
+    }
+    if (OutputFilename == "-" ||
+        (OutputFilename.empty() && InputFilename == "-")) {
+      errs() << argv[0] << ": -codegen-partitions requires an output file.\n";
+      return 1;
+    }
+    llvm_start_multithreaded();
+  }
+
   // Load the module to be compiled...
   SMDiagnostic Err;
   std::auto_ptr<Module> M;
@@ -328,6 +528,55 @@ int main(int argc, char **argv) {
       Target.setMCRelaxAll(true);
   }
 
+  // With a cache, the output of an identical earlier run is reused as is.
+  OwningPtr<CompilationCache> Cache;
+  std::string CacheKey;
+  if (!CacheDir.empty() && FileType != TargetMachine::CGFT_Null) {
+    Cache.reset(new CompilationCache(CacheDir));
+    Cache->setMaxSize(uint64_t(CacheMaxSize) << 20);
+    CacheKey = GetCacheKey(mod, TheTriple.getTriple(), FeaturesStr,
+                           argc, argv);
+    int ExitCode;
+    if (EmitFromCache(*Cache, CacheKey, *Out, ExitCode))
+      return ExitCode;
+  }
+
+  if (CodeGenPartitions > 1 || Cache) {
+    std::vector<std::string> Outputs;
+    if (CodeGenPartitions > 1) {
+      if (GeneratePartitions(mod, TheTarget, TheTriple.getTriple(),
+                             FeaturesStr, Target, OLvl, Outputs, argv[0]))
+        return 1;
+    } else {
+      Outputs.resize(1);
+      raw_string_ostream OS(Outputs[0]);
+      {
+        formatted_raw_ostream FOS(OS);
+        if (Target.addPassesToEmitFile(PM, FOS, FileType, OLvl, NoVerify)) {
+          errs() << argv[0] << ": target does not support generation of this"
+                 << " file type!\n";
+          return 1;
+        }
+        PM.run(mod);
+      }
+      OS.flush();
+    }
+
+    // A cache that cannot be written only costs time on the next run.
+    if (Cache) {
+      for (unsigned i = 0, e = Outputs.size(); i != e; ++i) {
+        std::string ErrMsg;
+        if (Cache->store(GetCacheEntryKey(CacheKey, i), Outputs[i], ErrMsg)) {
+          errs() << argv[0] << ": warning: " << ErrMsg << '\n';
+          break;
+        }
+      }
+    }
+
+    std::vector<StringRef> Refs(Outputs.begin(), Outputs.end());
+    return WriteOutputs(Refs, *Out);
+  }
+
   {
     formatted_raw_ostream FOS(Out->os());
 
@@ -23,6 +23,7 @@
 #include "llvm/ExecutionEngine/Interpreter.h"
 #include "llvm/ExecutionEngine/JIT.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/JITMemoryManager.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/IRReader.h"
@@ -33,6 +34,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Target/TargetSelect.h"
 #include <cerrno>
 
@@ -108,6 +110,42 @@ namespace {
   NoLazyCompilation("disable-lazy-compilation",
                   cl::desc("Disable JIT lazy compilation"),
                   cl::init(false));
+
+  cl::opt<unsigned>
+  TierUpThreshold("tier-up-threshold",
+                  cl::desc("Interpret functions until their calls and loop "
+                           "iterations reach this count, then JIT them"),
+                  cl::value_desc("count"), cl::init(0));
+
+  cl::opt<bool>
+  BackgroundCompilation("jit-background-compile",
+                  cl::desc("Compile lazily JIT'd functions on a background "
+                           "thread"),
+                  cl::init(false));
+
+  cl::opt<bool>
+  SizeClassMemory("jit-size-class-memory",
+                  cl::desc("Allocate JIT'd code from per-thread arenas of "
+                           "slabs with size segregated free lists"),
+                  cl::init(false));
+
+  cl::opt<bool>
+  WriteXorExecute("jit-write-xor-execute",
+                  cl::desc("Never map JIT'd code writable and executable at "
+                           "once (implies -jit-size-class-memory)"),
+                  cl::init(false));
+
+  cl::opt<unsigned>
+  ReaderThreads("reader-threads",
+                cl::desc("Number of threads to decode function bodies on "
+                         "when reading bitcode (0 = one per processor)"),
+                cl::value_desc("N"), cl::init(1));
+
+  cl::opt<std::string>
+  JITCacheDir("jit-cache-dir",
+              cl::desc("Keep the code of JIT'd functions in this directory "
+                       "and reuse it in later runs"),
+              cl::value_desc("directory"));
 }
 
 static ExecutionEngine *EE = 0;
@@ -141,9 +179,17 @@ int main(int argc, char **argv, char * const *envp) {
   if (DisableCoreFiles)
     sys::Process::PreventCoreFiles();
   
-  // Load the bitcode...
+  // Load the bitcode...  When the JIT compiles lazily, the function bodies
+  // are read as they are compiled, too.
   SMDiagnostic Err;
-  Module *Mod = ParseIRFile(InputFile, Err, Context);
+  Module *Mod;
+  if (!NoLazyCompilation && !UseMCJIT && ReaderThreads == 1) {
+    Mod = getLazyIRFileModule(InputFile, Err, Context);
+  } else {
+    if (ReaderThreads != 1)
+      llvm_start_multithreaded();
+    Mod = ParseIRFile(InputFile, Err, Context, ReaderThreads);
+  }
   if (!Mod) {
     Err.Print(argv[0], errs());
     return 1;
@@ -167,6 +213,18 @@ int main(int argc, char **argv, char * const *envp) {
   builder.setEngineKind(ForceInterpreter
                         ? EngineKind::Interpreter
                         : EngineKind::JIT);
+  if (TierUpThreshold && !ForceInterpreter)
+    builder.setEngineKind(EngineKind::Either)
+           .setTierUpThreshold(TierUpThreshold);
+
+  if (WriteXorExecute && BackgroundCompilation) {
+    errs() << argv[0] << ": -jit-write-xor-execute cannot be used with "
+           << "-jit-background-compile.\n";
+    return 1;
+  }
+  if ((SizeClassMemory || WriteXorExecute) && !ForceInterpreter)
+    builder.setJITMemoryManager(
+      JITMemoryManager::CreateSizeClassMemManager(WriteXorExecute));
 
   // If we are supposed to override the target triple, do so now.
   if (!TargetTriple.empty())
@@ -201,6 +259,10 @@ int main(int argc, char **argv, char * const *envp) {
   EE->RegisterJITEventListener(createOProfileJITEventListener());
 
   EE->DisableLazyCompilation(NoLazyCompilation);
+  if (BackgroundCompilation && !NoLazyCompilation && llvm_start_multithreaded())
+    EE->EnableBackgroundCompilation();
+  if (!JITCacheDir.empty())
+    EE->setCodeCacheDirectory(JITCacheDir);
 
   // If the user specifically requested an argv[0] to pass into the program,
   // do it now.
@@ -37,6 +37,7 @@
 #include "llvm/Support/SystemUtils.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Config/config.h"
 #include <memory>
 #include <cstring>
@@ -85,6 +86,9 @@ static cl::opt<bool> LinkAsLibrary("link-as-library",
 static cl::alias Relink("r", cl::aliasopt(LinkAsLibrary),
   cl::desc("Alias for -link-as-library"));
 
+static cl::opt<bool> ParallelArchiveScan("parallel-archive-scan",
+  cl::desc("Read the members of archives without a symbol table in parallel"));
+
 static cl::opt<bool> Native("native",
   cl::desc("Generate a native binary instead of a shell script"));
 
@@ -531,6 +535,11 @@ int main(int argc, char **argv, char **envp) {
   // Parse the command line options
   cl::ParseCommandLineOptions(argc, argv, "llvm linker\n");
 
+  // The archive reader scans members on a thread pool, which only runs tasks
+  // concurrently once LLVM is multithreaded.
+  if (ParallelArchiveScan)
+    llvm_start_multithreaded();
+
 #if defined(_WIN32) || defined(__CYGWIN__)
   if (!LinkAsLibrary) {
     // Default to "a.exe" instead of "a.out".
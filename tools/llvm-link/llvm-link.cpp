@@ -19,6 +19,7 @@
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/SystemUtils.h"
@@ -49,12 +50,24 @@ Verbose("v", cl::desc("Print information about actions taken"));
 static cl::opt<bool>
 DumpAsm("d", cl::desc("Print assembly as linked"), cl::Hidden);
 
+static cl::opt<bool>
+OnlyNeeded("only-needed",
+           cl::desc("Only link in the functions that the first input file "
+                    "needs, reading function bodies on demand"));
+
+static cl::opt<unsigned>
+WriterThreads("writer-threads",
+              cl::desc("Number of threads to encode function bodies on when "
+                       "writing bitcode (0 = one per processor)"),
+              cl::init(1));
+
 // LoadFile - Read the specified bitcode file in and return it.  This routine
 // searches the link path for the specified file to try to find it...
 //
 static inline std::auto_ptr<Module> LoadFile(const char *argv0,
                                              const std::string &FN, 
-                                             LLVMContext& Context) {
+                                             LLVMContext& Context,
+                                             bool Lazy = false) {
   sys::Path Filename;
   if (!Filename.set(FN)) {
     errs() << "Invalid file name: '" << FN << "'\n";
@@ -66,7 +79,10 @@ static inline std::auto_ptr<Module> LoadFile(const char *argv0,
   Module* Result = 0;
   
   const std::string &FNStr = Filename.str();
-  Result = ParseIRFile(FNStr, Err, Context);
+  if (Lazy)
+    Result = getLazyIRFileModule(FNStr, Err, Context);
+  else
+    Result = ParseIRFile(FNStr, Err, Context);
   if (Result) return std::auto_ptr<Module>(Result);   // Load successful!
 
   Err.Print(argv0, errs());
@@ -95,7 +111,7 @@ int main(int argc, char **argv) {
 
   for (unsigned i = BaseArg+1; i < InputFilenames.size(); ++i) {
     std::auto_ptr<Module> M(LoadFile(argv[0],
-                                     InputFilenames[i], Context));
+                                     InputFilenames[i], Context, OnlyNeeded));
     if (M.get() == 0) {
       errs() << argv[0] << ": error loading file '" <<InputFilenames[i]<< "'\n";
       return 1;
@@ -103,7 +119,8 @@ int main(int argc, char **argv) {
 
     if (Verbose) errs() << "Linking in '" << InputFilenames[i] << "'\n";
 
-    if (Linker::LinkModules(Composite.get(), M.get(), &ErrorMessage)) {
+    unsigned Mode = OnlyNeeded ? Linker::LinkOnlyNeeded : Linker::LinkAll;
+    if (Linker::LinkModules(Composite.get(), M.get(), Mode, &ErrorMessage)) {
       errs() << argv[0] << ": link error in '" << InputFilenames[i]
              << "': " << ErrorMessage << "\n";
       return 1;
@@ -131,8 +148,11 @@ int main(int argc, char **argv) {
   if (Verbose) errs() << "Writing bitcode...\n";
   if (OutputAssembly) {
     Out.os() << *Composite;
-  } else if (Force || !CheckBitcodeOutputToConsole(Out.os(), true))
-    WriteBitcodeToFile(Composite.get(), Out.os());
+  } else if (Force || !CheckBitcodeOutputToConsole(Out.os(), true)) {
+    if (WriterThreads != 1)
+      llvm_start_multithreaded();
+    WriteBitcodeToFile(Composite.get(), Out.os(), WriterThreads);
+  }
 
   // Declare success.
   Out.keep();
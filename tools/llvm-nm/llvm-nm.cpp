@@ -291,7 +291,8 @@ static void DumpSymbolNamesFromFile(std::string &Filename) {
   // Note: Currently we do not support reading an archive from stdin.
   if (Filename == "-" || aPath.isBitcodeFile()) {
     OwningPtr<MemoryBuffer> Buffer;
-    if (error_code ec = MemoryBuffer::getFileOrSTDIN(Filename, Buffer))
+    if (error_code ec = MemoryBuffer::getFileOrSTDIN(Filename, Buffer, -1,
+                                                     false))
       ErrorMessage = ec.message();
     Module *Result = 0;
     if (Buffer.get())
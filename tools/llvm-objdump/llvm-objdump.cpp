@@ -144,7 +144,7 @@ static void DumpBytes(StringRef bytes) {
 static void DisassembleInput(const StringRef &Filename) {
   OwningPtr<MemoryBuffer> Buff;
 
-  if (error_code ec = MemoryBuffer::getFileOrSTDIN(Filename, Buff)) {
+  if (error_code ec = MemoryBuffer::getFileOrSTDIN(Filename, Buff, -1, false)) {
     errs() << ToolName << ": " << Filename << ": " << ec.message() << "\n";
     return;
   }
@@ -25,6 +25,7 @@
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/Target/Mangler.h"
@@ -35,6 +36,7 @@
 #include "llvm/Target/TargetRegistry.h"
 #include "llvm/Target/TargetSelect.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/CompilationCache.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/StandardPasses.h"
@@ -43,8 +45,10 @@
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/system_error.h"
 #include "llvm/Config/config.h"
+#include <algorithm>
 #include <cstdlib>
 #include <unistd.h>
 #include <fcntl.h>
@@ -71,7 +75,7 @@ LTOCodeGenerator::LTOCodeGenerator()
       _linker("LinkTimeOptimizer", "ld-temp.o", _context), _target(NULL),
       _emitDwarfDebugInfo(false), _scopeRestrictionsDone(false),
       _codeModel(LTO_CODEGEN_PIC_MODEL_DYNAMIC),
-      _nativeObjectFile(NULL)
+      _codegenPartitions(1), _codegenThreads(0), _cacheMaxSize(0)
 {
     InitializeAllTargets();
     InitializeAllAsmPrinters();
@@ -80,7 +84,14 @@ LTOCodeGenerator::LTOCodeGenerator()
 LTOCodeGenerator::~LTOCodeGenerator()
 {
     delete _target;
-    delete _nativeObjectFile;
+    clearNativeObjects();
+}
+
+void LTOCodeGenerator::clearNativeObjects()
+{
+    for (unsigned i = 0, e = _nativeObjectFiles.size(); i != e; ++i)
+        delete _nativeObjectFiles[i];
+    _nativeObjectFiles.clear();
 }
 
 
@@ -137,6 +148,42 @@ void LTOCodeGenerator::addMustPreserveSymbol(const char* sym)
     _mustPreserveSymbols[sym] = 1;
 }
 
+bool LTOCodeGenerator::setCodeGenPartitions(unsigned partitions,
+                                            unsigned threads,
+                                            std::string& errMsg)
+{
+    if (partitions == 0) {
+        errMsg = "the number of partitions must be at least 1";
+        return true;
+    }
+    _codegenPartitions = partitions;
+    _codegenThreads = threads;
+    return false;
+}
+
+void LTOCodeGenerator::setCacheDir(const char* path)
+{
+    _cacheDir = path ? path : "";
+}
+
+void LTOCodeGenerator::setCacheMaxSize(uint64_t bytes)
+{
+    _cacheMaxSize = bytes;
+}
+
+unsigned LTOCodeGenerator::getNumObjects() const
+{
+    return _nativeObjectFiles.size();
+}
+
+const void* LTOCodeGenerator::getObject(unsigned index, size_t* length) const
+{
+    if (index >= _nativeObjectFiles.size())
+        return NULL;
+    *length = _nativeObjectFiles[index]->getBufferSize();
+    return _nativeObjectFiles[index]->getBufferStart();
+}
+
 
 bool LTOCodeGenerator::writeMergedModules(const char *path,
                                           std::string &errMsg) {
@@ -174,6 +221,18 @@ bool LTOCodeGenerator::writeMergedModules(const char *path,
 
 const void* LTOCodeGenerator::compile(size_t* length, std::string& errMsg)
 {
+    // remove old buffers if compile() called twice
+    clearNativeObjects();
+
+    // Partitioned and cached builds keep the objects in memory.
+    if (_codegenPartitions > 1 || !_cacheDir.empty()) {
+        if (this->generatePartitionedObjects(errMsg)) {
+            clearNativeObjects();
+            return NULL;
+        }
+        return getObject(0, length);
+    }
+
     // make unique temp .o file to put generated object file
     sys::PathWithStatus uniqueObjPath("lto-llvm.o");
     if ( uniqueObjPath.createTemporaryFileOnDisk(false, &errMsg) ) {
@@ -200,23 +259,20 @@ const void* LTOCodeGenerator::compile(size_t* length, std::string& errMsg)
     }
 
     const std::string& uniqueObjStr = uniqueObjPath.str();
-    // remove old buffer if compile() called twice
-    delete _nativeObjectFile;
 
     // read .o file into memory buffer
     OwningPtr<MemoryBuffer> BuffPtr;
     if (error_code ec = MemoryBuffer::getFile(uniqueObjStr.c_str(),BuffPtr))
       errMsg = ec.message();
-    _nativeObjectFile = BuffPtr.take();
 
     // remove temp files
     uniqueObjPath.eraseFromDisk();
 
     // return buffer, unless error
-    if ( _nativeObjectFile == NULL )
+    if ( !BuffPtr )
         return NULL;
-    *length = _nativeObjectFile->getBufferSize();
-    return _nativeObjectFile->getBufferStart();
+    _nativeObjectFiles.push_back(BuffPtr.take());
+    return getObject(0, length);
 }
 
 bool LTOCodeGenerator::determineTarget(std::string& errMsg)
@@ -250,6 +306,8 @@ bool LTOCodeGenerator::determineTarget(std::string& errMsg)
         Features.getDefaultSubtargetFeatures(_mCpu, llvm::Triple(Triple));
         std::string FeatureStr = Features.getString();
         _target = march->createTargetMachine(Triple, FeatureStr);
+        _targetTriple = Triple;
+        _targetFeatures = FeatureStr;
     }
     return false;
 }
@@ -339,8 +397,7 @@ void LTOCodeGenerator::applyScopeRestrictions() {
 }
 
 /// Optimize merged modules using various IPO passes
-bool LTOCodeGenerator::generateObjectFile(raw_ostream& out,
-                                          std::string& errMsg)
+bool LTOCodeGenerator::optimize(std::string& errMsg)
 {
     if ( this->determineTarget(errMsg) ) 
         return true;
@@ -370,6 +427,20 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream& out,
     // Make sure everything is still good.
     passes.add(createVerifierPass());
 
+    // Run our queue of passes all at once now, efficiently.
+    passes.run(*mergedModule);
+    return false;
+}
+
+/// Generate code for the optimized merged modules
+bool LTOCodeGenerator::generateObjectFile(raw_ostream& out,
+                                          std::string& errMsg)
+{
+    if ( this->optimize(errMsg) )
+        return true;
+
+    Module* mergedModule = _linker.getModule();
+
     FunctionPassManager* codeGenPasses = new FunctionPassManager(mergedModule);
 
     codeGenPasses->add(new TargetData(*_target->getTargetData()));
@@ -380,12 +451,10 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream& out,
                                      TargetMachine::CGFT_ObjectFile,
                                      CodeGenOpt::Aggressive)) {
       errMsg = "target file type not supported";
+      delete codeGenPasses;
       return true;
     }
 
-    // Run our queue of passes all at once now, efficiently.
-    passes.run(*mergedModule);
-
     // Run the code generator, and write assembly file
     codeGenPasses->doInitialization();
 
@@ -400,6 +469,172 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream& out,
     return false; // success
 }
 
+/// Compute the cache key of a partition: its bitcode and everything else
+/// that affects the code generated for it.
+std::string LTOCodeGenerator::getPartitionKey(const std::string& bitcode)
+{
+    CompilationCache::KeyBuilder key;
+    key.add("partition");
+    key.add(getVersionString());
+    key.add(_targetTriple);
+    key.add(_targetFeatures);
+    key.add(uint64_t(_codeModel));
+    for (unsigned i = 0, e = _codegenOptions.size(); i != e; ++i)
+        key.add(_codegenOptions[i]);
+    key.add(bitcode);
+    return key.getKey();
+}
+
+/// Compute the cache key of the whole link: the merged modules before any
+/// optimization, the symbols that must be preserved and the settings.
+std::string LTOCodeGenerator::getLinkKey()
+{
+    std::string bitcode;
+    raw_string_ostream out(bitcode);
+    WriteBitcodeToFile(_linker.getModule(), out);
+    out.flush();
+
+    // The iteration order of a StringMap depends on its history.
+    std::vector<StringRef> symbols;
+    for (StringSet::iterator it = _mustPreserveSymbols.begin(),
+           e = _mustPreserveSymbols.end(); it != e; ++it)
+        symbols.push_back(it->getKey());
+    std::sort(symbols.begin(), symbols.end());
+
+    CompilationCache::KeyBuilder key;
+    key.add("link");
+    key.add(getVersionString());
+    key.add(_targetTriple);
+    key.add(_targetFeatures);
+    key.add(uint64_t(_codeModel));
+    key.add(uint64_t(_emitDwarfDebugInfo));
+    key.add(uint64_t(DisableInline));
+    key.add(uint64_t(_codegenPartitions));
+    for (unsigned i = 0, e = _codegenOptions.size(); i != e; ++i)
+        key.add(_codegenOptions[i]);
+    key.add(uint64_t(symbols.size()));
+    for (unsigned i = 0, e = symbols.size(); i != e; ++i)
+        key.add(symbols[i]);
+    key.add(bitcode);
+    return key.getKey();
+}
+
+/// The entry of a link lists the keys of its partitions, one per line.  Load
+/// the objects of all of them, or of none if any is missing.
+bool LTOCodeGenerator::loadCachedLink(CompilationCache& cache,
+                                      const std::string& linkKey)
+{
+    OwningPtr<MemoryBuffer> manifest;
+    if ( !cache.lookup(linkKey, manifest) )
+        return false;
+
+    SmallVector<StringRef, 8> keys;
+    manifest->getBuffer().split(keys, "\n", -1, false);
+    for (unsigned i = 0, e = keys.size(); i != e; ++i) {
+        OwningPtr<MemoryBuffer> object;
+        if ( !cache.lookup(keys[i], object) ) {
+            clearNativeObjects();
+            return false;
+        }
+        _nativeObjectFiles.push_back(object.take());
+    }
+    return !_nativeObjectFiles.empty();
+}
+
+/// Split the optimized merged modules by call graph affinity and generate
+/// code for the partitions in parallel, reusing the objects of partitions
+/// found in the cache.  With a cache, a link identical to an earlier one
+/// reuses its objects without running the optimizer at all.
+bool LTOCodeGenerator::generatePartitionedObjects(std::string& errMsg)
+{
+    OwningPtr<CompilationCache> cache;
+    std::string linkKey;
+    if ( !_cacheDir.empty() ) {
+        cache.reset(new CompilationCache(_cacheDir));
+        cache->setMaxSize(_cacheMaxSize);
+        if ( this->determineTarget(errMsg) )
+            return true;
+        linkKey = getLinkKey();
+        if ( loadCachedLink(*cache, linkKey) )
+            return false;
+    }
+
+    if ( this->optimize(errMsg) )
+        return true;
+
+    std::vector<std::string> parts;
+    SplitModuleForCodeGen(*_linker.getModule(), _codegenPartitions, parts,
+                          /*ByCallGraph=*/ true);
+
+    // Look up every partition, and collect the ones that must be compiled.
+    _nativeObjectFiles.resize(parts.size());
+    std::vector<std::string> keys(parts.size());
+    std::vector<std::string> missing;
+    std::vector<unsigned> missingIndex;
+    for (unsigned i = 0, e = parts.size(); i != e; ++i) {
+        OwningPtr<MemoryBuffer> cached;
+        if ( cache ) {
+            keys[i] = getPartitionKey(parts[i]);
+            if ( cache->lookup(keys[i], cached) ) {
+                _nativeObjectFiles[i] = cached.take();
+                continue;
+            }
+        }
+        missing.push_back(std::string());
+        missing.back().swap(parts[i]);
+        missingIndex.push_back(i);
+    }
+    if ( !missing.empty() &&
+         this->compileMissingPartitions(missing, missingIndex, keys,
+                                        cache.get(), errMsg) )
+        return true;
+
+    // A cache that cannot be written only costs time on the next link.
+    if ( cache ) {
+        std::string manifest, storeErr;
+        for (unsigned i = 0, e = keys.size(); i != e; ++i)
+            manifest += keys[i] + "\n";
+        cache->store(linkKey, manifest, storeErr);
+    }
+    return false;
+}
+
+/// Generate code for the partitions that were not found in the cache, and
+/// store their objects into it.
+bool LTOCodeGenerator::compileMissingPartitions(
+                                    std::vector<std::string>& missing,
+                                    const std::vector<unsigned>& missingIndex,
+                                    const std::vector<std::string>& keys,
+                                    CompilationCache* cache,
+                                    std::string& errMsg)
+{
+    ParallelCodeGenOptions options;
+    options.TheTarget = &_target->getTarget();
+    options.TargetTriple = _targetTriple;
+    options.Features = _targetFeatures;
+    options.FileType = TargetMachine::CGFT_ObjectFile;
+    options.OptLevel = CodeGenOpt::Aggressive;
+    options.NumThreads = _codegenThreads;
+
+    // The partitions are only compiled concurrently in multithreaded mode.
+    if ( missing.size() > 1 && _codegenThreads != 1 &&
+         !llvm_is_multithreaded() )
+        llvm_start_multithreaded();
+
+    std::vector<std::string> objects;
+    if ( CodeGenModulePartitions(missing, options, objects, errMsg) )
+        return true;
+
+    for (unsigned i = 0, e = objects.size(); i != e; ++i) {
+        unsigned index = missingIndex[i];
+        std::string storeErr;
+        if ( cache )
+            cache->store(keys[index], objects[i], storeErr);
+        _nativeObjectFiles[index] =
+            MemoryBuffer::getMemBufferCopy(objects[i], "lto-llvm.o");
+    }
+    return false;
+}
 
 /// Optimize merged modules using various IPO passes
 void LTOCodeGenerator::setCodeGenDebugOptions(const char* options)
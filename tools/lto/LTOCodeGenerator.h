@@ -22,7 +22,11 @@
 #include "llvm/ADT/SmallPtrSet.h"
 
 #include <string>
+#include <vector>
 
+namespace llvm {
+  class CompilationCache;
+}
 
 //
 // C++ class which implements the opaque lto_code_gen_t
@@ -42,10 +46,30 @@ struct LTOCodeGenerator {
     bool                writeMergedModules(const char* path, 
                                                            std::string& errMsg);
     const void*         compile(size_t* length, std::string& errMsg);
+    bool                setCodeGenPartitions(unsigned partitions,
+                                             unsigned threads,
+                                             std::string& errMsg);
+    void                setCacheDir(const char* path);
+    void                setCacheMaxSize(uint64_t bytes);
+    unsigned            getNumObjects() const;
+    const void*         getObject(unsigned index, size_t* length) const;
     void                setCodeGenDebugOptions(const char *opts); 
 private:
+    bool                optimize(std::string& errMsg);
     bool                generateObjectFile(llvm::raw_ostream& out, 
                                            std::string& errMsg);
+    bool                generatePartitionedObjects(std::string& errMsg);
+    std::string         getPartitionKey(const std::string& bitcode);
+    std::string         getLinkKey();
+    bool                loadCachedLink(llvm::CompilationCache& cache,
+                                       const std::string& linkKey);
+    bool                compileMissingPartitions(
+                                    std::vector<std::string>& missing,
+                                    const std::vector<unsigned>& missingIndex,
+                                    const std::vector<std::string>& keys,
+                                    llvm::CompilationCache* cache,
+                                    std::string& errMsg);
+    void                clearNativeObjects();
     void                applyScopeRestrictions();
     void                applyRestriction(llvm::GlobalValue &GV,
                                      std::vector<const char*> &mustPreserveList,
@@ -63,9 +87,15 @@ private:
     lto_codegen_model           _codeModel;
     StringSet                   _mustPreserveSymbols;
     StringSet                   _asmUndefinedRefs;
-    llvm::MemoryBuffer*         _nativeObjectFile;
+    std::vector<llvm::MemoryBuffer*> _nativeObjectFiles;
     std::vector<const char*>    _codegenOptions;
     std::string                 _mCpu;
+    std::string                 _targetTriple;
+    std::string                 _targetFeatures;
+    unsigned                    _codegenPartitions;
+    unsigned                    _codegenThreads;
+    std::string                 _cacheDir;
+    uint64_t                    _cacheMaxSize;
 };
 
 #endif // LTO_CODE_GENERATOR_H
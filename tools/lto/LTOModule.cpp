@@ -65,7 +65,7 @@ bool LTOModule::isBitcodeFileForTarget(const void *mem, size_t length,
 bool LTOModule::isBitcodeFileForTarget(const char *path,
                                        const char *triplePrefix) {
   OwningPtr<MemoryBuffer> buffer;
-  if (MemoryBuffer::getFile(path, buffer))
+  if (MemoryBuffer::getFile(path, buffer, -1, false))
     return false;
   return isTargetMatch(buffer.take(), triplePrefix);
 }
@@ -87,7 +87,7 @@ LTOModule::LTOModule(Module *m, TargetMachine *t)
 LTOModule *LTOModule::makeLTOModule(const char *path,
                                     std::string &errMsg) {
   OwningPtr<MemoryBuffer> buffer;
-  if (error_code ec = MemoryBuffer::getFile(path, buffer)) {
+  if (error_code ec = MemoryBuffer::getFile(path, buffer, -1, false)) {
     errMsg = ec.message();
     return NULL;
   }
@@ -98,25 +98,20 @@ LTOModule *LTOModule::makeLTOModule(int fd, const char *path,
                                     off_t size,
                                     std::string &errMsg) {
   OwningPtr<MemoryBuffer> buffer;
-  if (error_code ec = MemoryBuffer::getOpenFile(fd, path, buffer, size)) {
+  if (error_code ec = MemoryBuffer::getOpenFile(fd, path, buffer, size,
+                                                false)) {
     errMsg = ec.message();
     return NULL;
   }
   return makeLTOModule(buffer.get(), errMsg);
 }
 
-/// makeBuffer - Create a MemoryBuffer from a memory range.  MemoryBuffer
-/// requires the byte past end of the buffer to be a zero.  We might get lucky
-/// and already be that way, otherwise make a copy.  Also if next byte is on a
-/// different page, don't assume it is readable.
+/// makeBuffer - Create a MemoryBuffer from a memory range.  The bitcode reader
+/// never reads past the end of the buffer, so the memory is used in place
+/// without a null terminator.
 MemoryBuffer *LTOModule::makeBuffer(const void *mem, size_t length) {
   const char *startPtr = (char*)mem;
-  const char *endPtr = startPtr+length;
-  if (((uintptr_t)endPtr & (sys::Process::GetPageSize()-1)) == 0 ||
-      *endPtr != 0)
-    return MemoryBuffer::getMemBufferCopy(StringRef(startPtr, length));
-
-  return MemoryBuffer::getMemBuffer(StringRef(startPtr, length));
+  return MemoryBuffer::getMemBuffer(StringRef(startPtr, length), "", false);
 }
 
 
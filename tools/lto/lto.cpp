@@ -281,6 +281,58 @@ lto_codegen_compile(lto_code_gen_t cg, size_t* length)
 }
 
 
+//
+// sets the number of partitions and code generation threads
+// returns true on error (check lto_get_error_message() for details)
+//
+extern bool
+lto_codegen_set_partitions(lto_code_gen_t cg, unsigned partitions,
+                           unsigned threads)
+{
+  return cg->setCodeGenPartitions(partitions, threads, sLastErrorString);
+}
+
+
+//
+// sets the directory used to cache the objects of partitions
+//
+extern void
+lto_codegen_set_cache_dir(lto_code_gen_t cg, const char* path)
+{
+  cg->setCacheDir(path);
+}
+
+
+//
+// sets the size limit of the cache directory in megabytes
+//
+extern void
+lto_codegen_set_cache_max_size(lto_code_gen_t cg, unsigned megabytes)
+{
+  cg->setCacheMaxSize(uint64_t(megabytes) << 20);
+}
+
+
+//
+// returns the number of objects generated by lto_codegen_compile()
+//
+extern unsigned
+lto_codegen_get_num_objects(lto_code_gen_t cg)
+{
+  return cg->getNumObjects();
+}
+
+
+//
+// returns the object at index, or NULL if index is out of range
+//
+extern const void*
+lto_codegen_get_object(lto_code_gen_t cg, unsigned index, size_t* length)
+{
+  return cg->getObject(index, length);
+}
+
+
 //
 // Used to pass extra options to the code generator
 //
@@ -367,7 +367,8 @@ int main(int argc, char **argv) {
   // Load the input file.
   std::string ErrorStr;
   OwningPtr<MemoryBuffer> InputBuffer;
-  if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFile, InputBuffer))
+  if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFile, InputBuffer, -1,
+                                                   false))
     return Error("unable to read input: '" + ec.message() + "'");
 
   // Construct the Mach-O wrapper object.
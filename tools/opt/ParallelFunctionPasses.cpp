@@ -0,0 +1,369 @@
+//===- ParallelFunctionPasses.cpp - Run function passes on threads --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a module pass that runs a sequence of function level
+// passes over the functions of a module on several threads.
+//
+// The uniquing tables of an LLVMContext (types, constants, metadata) are not
+// safe for concurrent use, and every function pass creates constants.  Rather
+// than putting locks into those tables, the function definitions are divided
+// into partitions.  Each partition is written to bitcode with every other
+// body stubbed out, optimized in a private LLVMContext on a worker thread, and
+// then read back into the original context where the new bodies replace the
+// old ones.  Everything that touches the original module happens on the
+// calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ParallelFunctionPasses.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/PassManager.h"
+#include "llvm/TypeSymbolTable.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+namespace {
+  class ParallelFunctionPasses;
+
+  /// PartitionJob - A partition in flight.  Bitcode holds the partition
+  /// before optimization and is replaced by the optimized partition.
+  struct PartitionJob {
+    const ParallelFunctionPasses *Owner;
+    std::string Bitcode;
+    std::string Error;
+  };
+
+  class ParallelFunctionPasses : public ModulePass {
+    std::vector<const PassInfo*> Passes;
+    std::vector<const PassInfo*> Immutables;
+    unsigned NumThreads;
+    std::string DataLayout;
+    bool DisableSimplifyLibCalls;
+
+  public:
+    static char ID;
+    ParallelFunctionPasses(const std::vector<const PassInfo*> &passes,
+                           const std::vector<const PassInfo*> &immutables,
+                           unsigned numThreads, const std::string &dataLayout,
+                           bool disableSimplifyLibCalls)
+      : ModulePass(ID), Passes(passes), Immutables(immutables),
+        NumThreads(numThreads), DataLayout(dataLayout),
+        DisableSimplifyLibCalls(disableSimplifyLibCalls) {}
+
+    virtual bool runOnModule(Module &M);
+
+    virtual const char *getPassName() const {
+      return "Parallel Function Pass Manager";
+    }
+
+    /// runPasses - Run the function passes over all of M on this thread.
+    void runPasses(Module &M) const;
+
+  private:
+    void mergePartition(Module &M, Module &Part, unsigned P,
+                        const std::vector<int> &PartOf, unsigned NumGlobals,
+                        unsigned NumAliases);
+  };
+}
+
+char ParallelFunctionPasses::ID = 0;
+
+ModulePass *
+llvm::createParallelFunctionPassesPass(const std::vector<const PassInfo*> &P,
+                                       const std::vector<const PassInfo*> &I,
+                                       unsigned NumThreads,
+                                       const std::string &DataLayout,
+                                       bool DisableSimplifyLibCalls) {
+  return new ParallelFunctionPasses(P, I, NumThreads, DataLayout,
+                                    DisableSimplifyLibCalls);
+}
+
+void ParallelFunctionPasses::runPasses(Module &M) const {
+  PassManager PM;
+
+  TargetLibraryInfo *TLI = new TargetLibraryInfo(Triple(M.getTargetTriple()));
+  if (DisableSimplifyLibCalls)
+    TLI->disableAllFunctions();
+  PM.add(TLI);
+
+  if (!M.getDataLayout().empty())
+    PM.add(new TargetData(&M));
+  else if (!DataLayout.empty())
+    PM.add(new TargetData(DataLayout));
+
+  // Without these, alias analysis queries would fall back to no-aa and the
+  // passes would do less than they do on the calling thread.
+  for (unsigned i = 0, e = Immutables.size(); i != e; ++i)
+    PM.add(Immutables[i]->createPass());
+
+  for (unsigned i = 0, e = Passes.size(); i != e; ++i)
+    PM.add(Passes[i]->createPass());
+  PM.run(M);
+}
+
+static void OptimizePartition(void *Arg) {
+  PartitionJob &Job = *static_cast<PartitionJob*>(Arg);
+
+  LLVMContext Context;
+  OwningPtr<Module> M;
+  {
+    OwningPtr<MemoryBuffer> Buffer(MemoryBuffer::getMemBuffer(Job.Bitcode));
+    M.reset(ParseBitcodeFile(Buffer.get(), Context, &Job.Error));
+  }
+  if (!M)
+    return;
+
+  Job.Owner->runPasses(*M);
+
+  Job.Bitcode.clear();
+  raw_string_ostream OS(Job.Bitcode);
+  WriteBitcodeToFile(M.get(), OS);
+  OS.flush();
+}
+
+/// resolveOpaqueTypes - Reading a partition back into the original context
+/// creates new opaque types.  Refine those that are named in both modules to
+/// the original type, as the linker does.
+static void resolveOpaqueTypes(Module &M, Module &Part) {
+  TypeSymbolTable &DestST = M.getTypeSymbolTable();
+  TypeSymbolTable &SrcST = Part.getTypeSymbolTable();
+
+  std::vector<std::string> Names;
+  for (TypeSymbolTable::iterator I = SrcST.begin(), E = SrcST.end();
+       I != E; ++I)
+    Names.push_back(I->first);
+
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (unsigned i = 0, e = Names.size(); i != e; ++i) {
+      const Type *Src = SrcST.lookup(Names[i]);
+      const Type *Dest = DestST.lookup(Names[i]);
+      if (!Src || !Dest || Src == Dest)
+        continue;
+      if (const OpaqueType *OT = dyn_cast<OpaqueType>(Src)) {
+        const_cast<OpaqueType*>(OT)->refineAbstractTypeTo(Dest);
+        Changed = true;
+      }
+    }
+  }
+}
+
+/// typesMatch - Return true if the first N entries of the lists of Part have
+/// the same types as the entries of M, so one can replace the other.
+template<typename ListTy>
+static bool typesMatch(const ListTy &MList, const ListTy &PartList) {
+  if (PartList.size() < MList.size())
+    return false;
+  typename ListTy::const_iterator PI = PartList.begin();
+  for (typename ListTy::const_iterator I = MList.begin(), E = MList.end();
+       I != E; ++I, ++PI)
+    if (I->getType() != PI->getType())
+      return false;
+  return true;
+}
+
+/// mapNewGlobal - Map a global that a pass added to a partition, typically a
+/// library function declaration, to the original module.
+static void mapNewGlobal(Module &M, GlobalValue *GV) {
+  GlobalValue *Existing = 0;
+  if (GV->hasName() && !GV->hasLocalLinkage())
+    Existing = M.getNamedValue(GV->getName());
+  if (Existing && !Existing->hasLocalLinkage()) {
+    if (Existing->getType() == GV->getType())
+      GV->replaceAllUsesWith(Existing);
+    else
+      GV->replaceAllUsesWith(ConstantExpr::getBitCast(Existing,
+                                                      GV->getType()));
+    return;
+  }
+
+  // Move it over.  Conflicting local names are renamed by the symbol table.
+  GV->removeFromParent();
+  if (Function *F = dyn_cast<Function>(GV))
+    M.getFunctionList().push_back(F);
+  else if (GlobalVariable *V = dyn_cast<GlobalVariable>(GV))
+    M.getGlobalList().push_back(V);
+  else
+    M.getAliasList().push_back(cast<GlobalAlias>(GV));
+}
+
+/// mergePartition - Move the optimized bodies of the functions owned by
+/// partition P from Part into M and redirect everything else in Part to M.
+/// Only the first PartOf.size() functions, NumGlobals variables and
+/// NumAliases aliases of M existed when the partitions were made; anything
+/// after them was added by merging an earlier partition.
+void ParallelFunctionPasses::mergePartition(Module &M, Module &Part,
+                                            unsigned P,
+                                            const std::vector<int> &PartOf,
+                                            unsigned NumGlobals,
+                                            unsigned NumAliases) {
+  unsigned NumFunctions = PartOf.size();
+
+  // Install the new bodies of the functions this partition owns, and point
+  // every use of a partition function at the original one.
+  Module::iterator F = M.begin(), NF = Part.begin();
+  for (unsigned Idx = 0; Idx != NumFunctions; ++Idx, ++F, ++NF) {
+    if (PartOf[Idx] == int(P)) {
+      F->dropAllReferences();
+      F->getBasicBlockList().splice(F->end(), NF->getBasicBlockList());
+      for (Function::arg_iterator A = F->arg_begin(), NA = NF->arg_begin(),
+             AE = F->arg_end(); A != AE; ++A, ++NA)
+        NA->replaceAllUsesWith(A);
+      F->setAttributes(NF->getAttributes());
+    } else if (F->isDeclaration()) {
+      // Passes may infer attributes of library functions.
+      F->setAttributes(NF->getAttributes());
+    }
+    if (!NF->use_empty())
+      NF->replaceAllUsesWith(F);
+  }
+
+  // Whatever follows the copies was added by the passes.
+  std::vector<GlobalValue*> Added;
+  for (Module::iterator E = Part.end(); NF != E; ++NF)
+    Added.push_back(NF);
+
+  Module::global_iterator G = M.global_begin(), PG = Part.global_begin();
+  for (unsigned Idx = 0; Idx != NumGlobals; ++Idx, ++G, ++PG) {
+    // Passes such as instcombine may raise the alignment of a global.
+    if (PG->getAlignment() > G->getAlignment())
+      G->setAlignment(PG->getAlignment());
+    if (!PG->use_empty())
+      PG->replaceAllUsesWith(G);
+  }
+  for (Module::global_iterator E = Part.global_end(); PG != E; ++PG)
+    Added.push_back(PG);
+
+  Module::alias_iterator A = M.alias_begin(), PA = Part.alias_begin();
+  for (unsigned Idx = 0; Idx != NumAliases; ++Idx, ++A, ++PA)
+    if (!PA->use_empty())
+      PA->replaceAllUsesWith(A);
+  for (Module::alias_iterator E = Part.alias_end(); PA != E; ++PA)
+    Added.push_back(PA);
+
+  for (unsigned i = 0, e = Added.size(); i != e; ++i)
+    mapNewGlobal(M, Added[i]);
+}
+
+bool ParallelFunctionPasses::runOnModule(Module &M) {
+  // Assign each function definition to a partition, largest first, always
+  // picking the least loaded partition.
+  std::vector<int> PartOf;
+  std::vector<std::pair<unsigned, unsigned> > Sizes;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    PartOf.push_back(-1);
+    if (F->isDeclaration())
+      continue;
+    unsigned Size = 0;
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      Size += BB->size();
+    // Sort by decreasing size, then by position.
+    Sizes.push_back(std::make_pair(~Size, PartOf.size() - 1));
+  }
+  std::sort(Sizes.begin(), Sizes.end());
+
+  unsigned NumParts = std::min<unsigned>(NumThreads, Sizes.size());
+  if (NumParts < 2) {
+    runPasses(M);
+    return true;
+  }
+
+  std::vector<uint64_t> Load(NumParts);
+  for (unsigned i = 0, e = Sizes.size(); i != e; ++i) {
+    unsigned P = std::min_element(Load.begin(), Load.end()) - Load.begin();
+    Load[P] += ~Sizes[i].first + 1;
+    PartOf[Sizes[i].second] = P;
+  }
+
+  std::vector<PartitionJob> Jobs(NumParts);
+  for (unsigned P = 0; P != NumParts; ++P) {
+    ValueToValueMapTy VMap;
+    OwningPtr<Module> Clone(CloneModule(&M, VMap));
+    // Bodies owned by other partitions are replaced with a stub rather than
+    // deleted, so passes that check whether a callee is a declaration behave
+    // as they would on the whole module.
+    unsigned Idx = 0;
+    for (Module::iterator F = Clone->begin(), E = Clone->end(); F != E;
+         ++F, ++Idx) {
+      if (PartOf[Idx] == int(P) || F->isDeclaration())
+        continue;
+      F->dropAllReferences();
+      BasicBlock *Stub = BasicBlock::Create(M.getContext(), "", F);
+      new UnreachableInst(M.getContext(), Stub);
+    }
+
+    Jobs[P].Owner = this;
+    raw_string_ostream OS(Jobs[P].Bitcode);
+    WriteBitcodeToFile(Clone.get(), OS);
+  }
+
+  {
+    ThreadPool Pool(NumThreads);
+    for (unsigned P = 0; P != NumParts; ++P)
+      Pool.async(OptimizePartition, &Jobs[P]);
+    Pool.wait();
+  }
+
+  // Read every partition back and check that it lines up with M before
+  // touching M, so that any problem can still fall back to a serial run.
+  std::vector<Module*> Parts;
+  bool Failed = false;
+  for (unsigned P = 0; P != NumParts && !Failed; ++P) {
+    Module *Part = 0;
+    if (Jobs[P].Error.empty()) {
+      OwningPtr<MemoryBuffer> Buffer(
+        MemoryBuffer::getMemBuffer(Jobs[P].Bitcode));
+      Part = ParseBitcodeFile(Buffer.get(), M.getContext(), &Jobs[P].Error);
+    }
+    if (!Part) {
+      errs() << "warning: parallel function passes failed on partition "
+             << P << ": " << Jobs[P].Error << "; running serially\n";
+      Failed = true;
+      break;
+    }
+    Parts.push_back(Part);
+    resolveOpaqueTypes(M, *Part);
+    if (!typesMatch(M.getFunctionList(), Part->getFunctionList()) ||
+        !typesMatch(M.getGlobalList(), Part->getGlobalList()) ||
+        !typesMatch(M.getAliasList(), Part->getAliasList())) {
+      errs() << "warning: parallel function passes could not merge partition "
+             << P << "; running serially\n";
+      Failed = true;
+    }
+  }
+
+  if (!Failed) {
+    unsigned NumGlobals = M.getGlobalList().size();
+    unsigned NumAliases = M.getAliasList().size();
+    for (unsigned P = 0; P != NumParts; ++P)
+      mergePartition(M, *Parts[P], P, PartOf, NumGlobals, NumAliases);
+  }
+
+  for (unsigned P = 0, e = Parts.size(); P != e; ++P)
+    delete Parts[P];
+
+  if (Failed)
+    runPasses(M);
+  return true;
+}
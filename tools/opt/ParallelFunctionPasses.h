@@ -0,0 +1,45 @@
+//===- ParallelFunctionPasses.h - Run function passes on threads -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the factory for the module pass used by opt to run a
+// sequence of function level passes on several threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OPT_PARALLELFUNCTIONPASSES_H
+#define OPT_PARALLELFUNCTIONPASSES_H
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class ModulePass;
+class PassInfo;
+
+/// createParallelFunctionPassesPass - Return a module pass that runs the
+/// passes in \p Passes, all of which must operate on a single function at a
+/// time, over the functions of the module using \p NumThreads threads.  The
+/// module's functions are split into partitions that are each optimized in
+/// a private LLVMContext and then merged back.  Every worker also gets an
+/// instance of each of the \p Immutables, which should be the immutable
+/// passes, such as alias analyses, that were scheduled before \p Passes.
+/// \p DataLayout, if not empty, is used when the module has no data layout
+/// of its own.  If \p DisableSimplifyLibCalls is set, the TargetLibraryInfo
+/// given to the passes has all library functions disabled.
+ModulePass *
+createParallelFunctionPassesPass(const std::vector<const PassInfo*> &Passes,
+                                 const std::vector<const PassInfo*> &Immutables,
+                                 unsigned NumThreads,
+                                 const std::string &DataLayout,
+                                 bool DisableSimplifyLibCalls);
+
+} // End llvm namespace
+
+#endif
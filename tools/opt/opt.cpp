@@ -14,11 +14,16 @@
 
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
+#include "llvm/AnalysisCache.h"
 #include "llvm/PassManager.h"
 #include "llvm/CallGraphSCCPass.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Assembly/PrintModulePass.h"
 #include "llvm/Analysis/DebugInfo.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/RegionPass.h"
@@ -36,9 +41,11 @@
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/StandardPasses.h"
 #include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/LinkAllPasses.h"
 #include "llvm/LinkAllVMCore.h"
+#include "ParallelFunctionPasses.h"
 #include <memory>
 #include <algorithm>
 using namespace llvm;
@@ -140,6 +147,29 @@ DefaultDataLayout("default-data-layout",
           cl::desc("data layout string to use if not specified by module"),
           cl::value_desc("layout-string"), cl::init(""));
 
+static cl::opt<unsigned>
+FunctionPassThreads("function-pass-threads",
+  cl::desc("Run consecutive function passes given on the command line "
+           "on N threads (the passes of -O1/-O2/-O3, -std-compile-opts and "
+           "-std-link-opts always run on one thread)"),
+  cl::value_desc("N"), cl::init(1));
+
+static cl::opt<unsigned>
+ReaderThreads("reader-threads",
+  cl::desc("Number of threads to decode function bodies on when reading "
+           "bitcode (0 = one per processor)"),
+  cl::value_desc("N"), cl::init(1));
+
+static cl::opt<bool>
+UseAnalysisCache("analysis-cache",
+  cl::desc("Keep dominator trees, loop info, scalar evolution and memory "
+           "dependences of each function until a pass changes it"));
+
+static cl::opt<bool>
+LazyFunctionBodies("lazy-function-bodies",
+  cl::desc("Read function bodies on demand while running the leading "
+           "function passes, and release them if nothing needs them later"));
+
 // ---------- Define Printers for module and function passes ------------
 namespace {
 
@@ -382,6 +412,28 @@ inline void addPass(PassManagerBase &PM, Pass *P) {
   if (VerifyEach) PM.add(createVerifierPass());
 }
 
+/// isFunctionLevelPass - Return true if passes of this kind only ever look at
+/// one function at a time.
+static bool isFunctionLevelPass(PassKind Kind) {
+  return Kind == PT_Function || Kind == PT_Loop || Kind == PT_Region ||
+         Kind == PT_BasicBlock;
+}
+
+/// FlushFunctionPasses - Add the pending run of function level passes, if
+/// any, as a single parallel module pass.  Immutables holds the immutable
+/// passes given before them, which the workers need as well.
+static void
+FlushFunctionPasses(PassManagerBase &PM, std::vector<const PassInfo*> &Pending,
+                    const std::vector<const PassInfo*> &Immutables) {
+  if (Pending.empty())
+    return;
+  addPass(PM, createParallelFunctionPassesPass(Pending, Immutables,
+                                               FunctionPassThreads,
+                                               DefaultDataLayout,
+                                               DisableSimplifyLibCalls));
+  Pending.clear();
+}
+
 /// AddOptimizationPasses - This routine adds optimization passes
 /// based on selected optimization level, OptLevel. This routine
 /// duplicates llvm-gcc behaviour.
@@ -484,6 +536,23 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  // Function passes can only be batched up if nothing has to run in between
+  // them.
+  bool ParallelFunctionPasses = FunctionPassThreads > 1 && !AnalyzeOnly &&
+                                !PrintEachXForm && !VerifyEach;
+  if (ParallelFunctionPasses)
+    llvm_start_multithreaded();
+  std::vector<const PassInfo*> PendingFunctionPasses;
+  std::vector<const PassInfo*> ImmutablePasses;
+
+  // The function passes given before any other pass can run one function at
+  // a time while the function bodies are read in on demand.  The -O levels
+  // run their function passes ahead of everything else, so they rule this
+  // out.
+  bool LazyPrefix = LazyFunctionBodies && !ParallelFunctionPasses &&
+                    !PrintEachXForm && !PrintBreakpoints && !StripDebug &&
+                    !OptLevelO1 && !OptLevelO2 && !OptLevelO3;
+
   // Allocate a full target machine description only if necessary.
   // FIXME: The choice of target should be controllable on the command line.
   std::auto_ptr<TargetMachine> target;
@@ -492,7 +561,13 @@ int main(int argc, char **argv) {
 
   // Load the input module...
   std::auto_ptr<Module> M;
-  M.reset(ParseIRFile(InputFilename, Err, Context));
+  if (LazyPrefix) {
+    M.reset(getLazyIRFileModule(InputFilename, Err, Context));
+  } else {
+    if (ReaderThreads != 1)
+      llvm_start_multithreaded();
+    M.reset(ParseIRFile(InputFilename, Err, Context, ReaderThreads));
+  }
 
   if (M.get() == 0) {
     Err.Print(argv[0], errs());
@@ -531,6 +606,17 @@ int main(int argc, char **argv) {
   //
   PassManager Passes;
 
+  // The analysis cache is shared by all of the pass managers below.
+  AnalysisCache Cache;
+  if (UseAnalysisCache) {
+    Cache.addAnalysis(&DominatorTree::ID);
+    Cache.addAnalysis(&PostDominatorTree::ID);
+    Cache.addAnalysis(&LoopInfo::ID);
+    Cache.addAnalysis(&ScalarEvolution::ID);
+    Cache.addAnalysis(&MemoryDependenceAnalysis::ID);
+    Passes.setAnalysisCache(&Cache);
+  }
+
   // Add an appropriate TargetLibraryInfo pass for the module's triple.
   TargetLibraryInfo *TLI = new TargetLibraryInfo(Triple(M->getTargetTriple()));
   
@@ -550,11 +636,27 @@ int main(int argc, char **argv) {
   if (TD)
     Passes.add(TD);
 
+  OwningPtr<FunctionPassManager> LazyPasses;
+  if (LazyPrefix) {
+    LazyPasses.reset(new FunctionPassManager(M.get()));
+    TargetLibraryInfo *LazyTLI =
+      new TargetLibraryInfo(Triple(M->getTargetTriple()));
+    if (DisableSimplifyLibCalls)
+      LazyTLI->disableAllFunctions();
+    LazyPasses->add(LazyTLI);
+    if (TD)
+      LazyPasses->add(new TargetData(*TD));
+    if (UseAnalysisCache)
+      LazyPasses->setAnalysisCache(&Cache);
+  }
+
   OwningPtr<PassManager> FPasses;
   if (OptLevelO1 || OptLevelO2 || OptLevelO3) {
     FPasses.reset(new PassManager());
     if (TD)
       FPasses->add(new TargetData(*TD));
+    if (UseAnalysisCache)
+      FPasses->setAnalysisCache(&Cache);
   }
 
   if (PrintBreakpoints) {
@@ -586,27 +688,34 @@ int main(int argc, char **argv) {
     // so, handle it.
     if (StandardCompileOpts &&
         StandardCompileOpts.getPosition() < PassList.getPosition(i)) {
+      FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
       AddStandardCompilePasses(Passes);
       StandardCompileOpts = false;
+      LazyPrefix = false;
     }
 
     if (StandardLinkOpts &&
         StandardLinkOpts.getPosition() < PassList.getPosition(i)) {
+      FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
       AddStandardLinkPasses(Passes);
       StandardLinkOpts = false;
+      LazyPrefix = false;
     }
 
     if (OptLevelO1 && OptLevelO1.getPosition() < PassList.getPosition(i)) {
+      FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
       AddOptimizationPasses(Passes, *FPasses, 1);
       OptLevelO1 = false;
     }
 
     if (OptLevelO2 && OptLevelO2.getPosition() < PassList.getPosition(i)) {
+      FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
       AddOptimizationPasses(Passes, *FPasses, 2);
       OptLevelO2 = false;
     }
 
     if (OptLevelO3 && OptLevelO3.getPosition() < PassList.getPosition(i)) {
+      FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
       AddOptimizationPasses(Passes, *FPasses, 3);
       OptLevelO3 = false;
     }
@@ -618,29 +727,44 @@ int main(int argc, char **argv) {
     else
       errs() << argv[0] << ": cannot create pass: "
              << PassInf->getPassName() << "\n";
+    if (P && ParallelFunctionPasses && P->getAsImmutablePass())
+      ImmutablePasses.push_back(PassInf);
+    if (P && ParallelFunctionPasses && isFunctionLevelPass(P->getPassKind())) {
+      // Each worker thread creates its own instance.
+      PendingFunctionPasses.push_back(PassInf);
+      delete P;
+      P = 0;
+    }
     if (P) {
       PassKind Kind = P->getPassKind();
-      addPass(Passes, P);
+      if (!isFunctionLevelPass(Kind))
+        LazyPrefix = false;
+      PassManagerBase *PM = &Passes;
+      if (LazyPrefix)
+        PM = LazyPasses.get();
+
+      FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
+      addPass(*PM, P);
 
       if (AnalyzeOnly) {
         switch (Kind) {
         case PT_BasicBlock:
-          Passes.add(new BasicBlockPassPrinter(PassInf, Out->os()));
+          PM->add(new BasicBlockPassPrinter(PassInf, Out->os()));
           break;
         case PT_Region:
-          Passes.add(new RegionPassPrinter(PassInf, Out->os()));
+          PM->add(new RegionPassPrinter(PassInf, Out->os()));
           break;
         case PT_Loop:
-          Passes.add(new LoopPassPrinter(PassInf, Out->os()));
+          PM->add(new LoopPassPrinter(PassInf, Out->os()));
           break;
         case PT_Function:
-          Passes.add(new FunctionPassPrinter(PassInf, Out->os()));
+          PM->add(new FunctionPassPrinter(PassInf, Out->os()));
           break;
         case PT_CallGraphSCC:
-          Passes.add(new CallGraphSCCPassPrinter(PassInf, Out->os()));
+          PM->add(new CallGraphSCCPassPrinter(PassInf, Out->os()));
           break;
         default:
-          Passes.add(new ModulePassPrinter(PassInf, Out->os()));
+          PM->add(new ModulePassPrinter(PassInf, Out->os()));
           break;
         }
       }
@@ -650,6 +774,11 @@ int main(int argc, char **argv) {
       Passes.add(createPrintModulePass(&errs()));
   }
 
+  FlushFunctionPasses(Passes, PendingFunctionPasses, ImmutablePasses);
+
+  if (StandardCompileOpts || StandardLinkOpts)
+    LazyPrefix = false;
+
   // If -std-compile-opts was specified at the end of the pass list, add them.
   if (StandardCompileOpts) {
     AddStandardCompilePasses(Passes);
@@ -674,8 +803,32 @@ int main(int argc, char **argv) {
     FPasses->run(*M.get());
 
   // Check that the module is well formed on completion of optimization
-  if (!NoVerify && !VerifyEach)
-    Passes.add(createVerifierPass());
+  if (!NoVerify && !VerifyEach) {
+    if (LazyPrefix)
+      LazyPasses->add(createVerifierPass());
+    else
+      Passes.add(createVerifierPass());
+  }
+
+  // Run the leading function passes one function at a time, reading each body
+  // in as it is reached.  If every pass ran here and no output is written,
+  // nothing needs the bodies afterwards, so release each one right away.
+  if (LazyPasses) {
+    bool ReleaseBodies = LazyPrefix && (NoOutput || AnalyzeOnly);
+    LazyPasses->doInitialization();
+    for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F) {
+      LazyPasses->run(*F);
+      if (ReleaseBodies)
+        M->Dematerialize(F);
+    }
+    LazyPasses->doFinalization();
+
+    std::string ErrorInfo;
+    if (!ReleaseBodies && M->MaterializeAllPermanently(&ErrorInfo)) {
+      errs() << argv[0] << ": error reading input: " << ErrorInfo << "\n";
+      return 1;
+    }
+  }
 
   // Write bitcode or assembly to the output as the last step...
   if (!NoOutput && !AnalyzeOnly) {
@@ -0,0 +1,211 @@
+//===- DominatorTreeTest.cpp - Incremental dominator tree update tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace llvm {
+namespace {
+
+/// RandomCFG - A function whose CFG is edited at random.  Block 0 is the
+/// entry and never gets predecessors; every block ends in a switch on the
+/// argument, a branch or a return, depending on its number of successors.
+class RandomCFG {
+  LLVMContext &Context;
+  Function *F;
+  std::vector<BasicBlock*> Blocks;
+  std::vector<std::vector<unsigned> > Succs;
+  unsigned Seed;
+
+  void rebuildTerminator(unsigned B) {
+    BasicBlock *BB = Blocks[B];
+    if (TerminatorInst *TI = BB->getTerminator())
+      TI->eraseFromParent();
+    const std::vector<unsigned> &S = Succs[B];
+    if (S.empty()) {
+      ReturnInst::Create(Context, BB);
+    } else if (S.size() == 1) {
+      BranchInst::Create(Blocks[S[0]], BB);
+    } else {
+      SwitchInst *SI = SwitchInst::Create(F->arg_begin(), Blocks[S[0]],
+                                          S.size()-1, BB);
+      for (unsigned i = 1, e = S.size(); i != e; ++i)
+        SI->addCase(ConstantInt::get(Type::getInt32Ty(Context), i),
+                    Blocks[S[i]]);
+    }
+  }
+
+public:
+  RandomCFG(Module *M, unsigned NumBlocks, unsigned NumEdges)
+    : Context(M->getContext()), Succs(NumBlocks), Seed(NumBlocks) {
+    std::vector<const Type*> Params(1, Type::getInt32Ty(Context));
+    F = Function::Create(FunctionType::get(Type::getVoidTy(Context), Params,
+                                           false),
+                         GlobalValue::ExternalLinkage, "f", M);
+    for (unsigned i = 0; i != NumBlocks; ++i)
+      Blocks.push_back(BasicBlock::Create(Context, "", F));
+    for (unsigned i = 0; i != NumEdges; ++i)
+      Succs[random(NumBlocks)].push_back(1 + random(NumBlocks-1));
+    for (unsigned i = 0; i != NumBlocks; ++i)
+      rebuildTerminator(i);
+  }
+
+  Function &getFunction() { return *F; }
+
+  unsigned random(unsigned N) {
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 16) % N;
+  }
+
+  /// edit - Insert or delete a random edge and describe it in Update.
+  DominatorTreeBase<BasicBlock>::UpdateType edit() {
+    unsigned From = random(Blocks.size());
+    std::vector<unsigned> &S = Succs[From];
+    if (S.empty() || random(2)) {
+      unsigned To = 1 + random(Blocks.size()-1);
+      S.push_back(To);
+      rebuildTerminator(From);
+      return DominatorTreeBase<BasicBlock>::UpdateType(DomTreeUpdate::Insert,
+                                                       Blocks[From],
+                                                       Blocks[To]);
+    }
+    unsigned i = random(S.size());
+    unsigned To = S[i];
+    S.erase(S.begin() + i);
+    rebuildTerminator(From);
+    return DominatorTreeBase<BasicBlock>::UpdateType(DomTreeUpdate::Delete,
+                                                     Blocks[From], Blocks[To]);
+  }
+};
+
+/// isSameTree - Return true if the trees have the same nodes with the same
+/// immediate dominators and every node has the level implied by its place.
+static bool isSameTree(Function &F, DominatorTreeBase<BasicBlock> &DT,
+                       DominatorTreeBase<BasicBlock> &Expected) {
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    DomTreeNode *Node = DT.getNode(BB);
+    DomTreeNode *ExpectedNode = Expected.getNode(BB);
+    if (!Node || !ExpectedNode) {
+      if (Node != ExpectedNode)
+        return false;
+      continue;
+    }
+    DomTreeNode *IDom = Node->getIDom();
+    DomTreeNode *ExpectedIDom = ExpectedNode->getIDom();
+    if (!IDom || !ExpectedIDom) {
+      if (IDom || ExpectedIDom || Node->getLevel() != 0)
+        return false;
+      continue;
+    }
+    if (IDom->getBlock() != ExpectedIDom->getBlock() ||
+        Node->getLevel() != IDom->getLevel() + 1)
+      return false;
+  }
+  // A postdominator tree is empty if no block exits.
+  if (!DT.getRootNode() || !Expected.getRootNode())
+    return DT.getRootNode() == Expected.getRootNode();
+  return DT.getRootNode()->getBlock() == Expected.getRootNode()->getBlock();
+}
+
+static void runRandomEdits(bool PostDom, unsigned BatchSize) {
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("m", Context));
+  for (unsigned Size = 4; Size <= 24; Size += 4) {
+    RandomCFG CFG(M.get(), Size, Size + Size / 2);
+    Function &F = CFG.getFunction();
+    DominatorTreeBase<BasicBlock> DT(PostDom);
+    DT.recalculate(F);
+
+    for (unsigned Step = 0; Step != 200; ++Step) {
+      std::vector<DominatorTreeBase<BasicBlock>::UpdateType> Updates;
+      unsigned N = 1 + CFG.random(BatchSize);
+      for (unsigned i = 0; i != N; ++i)
+        Updates.push_back(CFG.edit());
+      if (N == 1 && Updates[0].Kind == DomTreeUpdate::Insert)
+        DT.insertEdge(Updates[0].From, Updates[0].To);
+      else if (N == 1)
+        DT.deleteEdge(Updates[0].From, Updates[0].To);
+      else
+        DT.applyUpdates(Updates);
+
+      DominatorTreeBase<BasicBlock> Expected(PostDom);
+      Expected.recalculate(F);
+      ASSERT_TRUE(isSameTree(F, DT, Expected))
+        << "size " << Size << ", step " << Step;
+    }
+    F.eraseFromParent();
+  }
+}
+
+TEST(DominatorTreeTest, InsertAndDeleteEdges) {
+  runRandomEdits(false, 1);
+}
+
+TEST(DominatorTreeTest, ApplyUpdates) {
+  runRandomEdits(false, 6);
+}
+
+TEST(DominatorTreeTest, PostDominatorInsertAndDeleteEdges) {
+  runRandomEdits(true, 1);
+}
+
+TEST(DominatorTreeTest, PostDominatorApplyUpdates) {
+  runRandomEdits(true, 6);
+}
+
+TEST(DominatorTreeTest, DeleteDuplicateEdge) {
+  // Deleting one of two edges between the same blocks changes nothing, and
+  // deleting the last one drops the blocks that are no longer reachable.
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("m", Context));
+  std::vector<const Type*> Params(1, Type::getInt32Ty(Context));
+  Function *F = Function::Create(FunctionType::get(Type::getVoidTy(Context),
+                                                   Params, false),
+                                 GlobalValue::ExternalLinkage, "f", M.get());
+  BasicBlock *Entry = BasicBlock::Create(Context, "entry", F);
+  BasicBlock *A = BasicBlock::Create(Context, "a", F);
+  BasicBlock *B = BasicBlock::Create(Context, "b", F);
+  SwitchInst *SI = SwitchInst::Create(F->arg_begin(), A, 1, Entry);
+  SI->addCase(ConstantInt::get(Type::getInt32Ty(Context), 1), A);
+  BranchInst::Create(B, A);
+  ReturnInst::Create(Context, B);
+
+  DominatorTreeBase<BasicBlock> DT(false);
+  DT.recalculate(*F);
+  EXPECT_EQ(2U, DT.getNode(B)->getLevel());
+
+  SI->removeCase(1);
+  DT.deleteEdge(Entry, A);
+  EXPECT_TRUE(DT.getNode(A) != 0);
+
+  SI->eraseFromParent();
+  ReturnInst::Create(Context, Entry);
+  DT.deleteEdge(Entry, A);
+  EXPECT_TRUE(DT.getNode(A) == 0);
+  EXPECT_TRUE(DT.getNode(B) == 0);
+
+  ReturnInst *Ret = cast<ReturnInst>(Entry->getTerminator());
+  Ret->eraseFromParent();
+  BranchInst::Create(B, Entry);
+  DT.insertEdge(Entry, B);
+  EXPECT_TRUE(DT.getNode(A) == 0);
+  EXPECT_EQ(Entry, DT.getNode(B)->getIDom()->getBlock());
+  EXPECT_EQ(1U, DT.getNode(B)->getLevel());
+}
+
+} // end anonymous namespace
+} // end namespace llvm
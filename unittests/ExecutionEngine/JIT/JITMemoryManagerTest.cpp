@@ -276,4 +276,122 @@ TEST(JITMemoryManagerTest, TestManyStubs) {
   EXPECT_EQ(3U, MemMgr->GetNumStubSlabs());
 }
 
+// Free functions and emit them again without knowing their size, as a JIT
+// that recompiles them would.  Each should reuse the memory of its old code.
+TEST(JITMemoryManagerTest, SizeClassReuse) {
+  OwningPtr<JITMemoryManager> MemMgr(
+      JITMemoryManager::CreateSizeClassMemManager(false));
+  std::string Error;
+
+  OwningPtr<Function> F1(makeFakeFunction());
+  OwningPtr<Function> F2(makeFakeFunction());
+  uintptr_t size = 0;
+  uint8_t *Body1 = MemMgr->startFunctionBody(F1.get(), size);
+  EXPECT_LE(3000U, size);
+  memset(Body1, 0xFF, 3000);
+  MemMgr->endFunctionBody(F1.get(), Body1, Body1 + 3000);
+  size = 0;
+  uint8_t *Body2 = MemMgr->startFunctionBody(F2.get(), size);
+  memset(Body2, 0xFF, 100);
+  MemMgr->endFunctionBody(F2.get(), Body2, Body2 + 100);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  EXPECT_EQ(0U, MemMgr->getFreeBytes());
+  size_t Allocated = MemMgr->getAllocatedBytes();
+  EXPECT_LE(3100U, Allocated);
+
+  MemMgr->deallocateFunctionBody(Body1);
+  MemMgr->deallocateFunctionBody(Body2);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  EXPECT_EQ(0U, MemMgr->getAllocatedBytes());
+  EXPECT_EQ(Allocated, MemMgr->getFreeBytes());
+
+  size = 0;
+  EXPECT_EQ(Body2, MemMgr->startFunctionBody(F2.get(), size));
+  MemMgr->endFunctionBody(F2.get(), Body2, Body2 + 100);
+  size = 0;
+  EXPECT_EQ(Body1, MemMgr->startFunctionBody(F1.get(), size));
+  MemMgr->endFunctionBody(F1.get(), Body1, Body1 + 3000);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  EXPECT_EQ(0U, MemMgr->getFreeBytes());
+  EXPECT_EQ(1U, MemMgr->GetNumCodeSlabs());
+}
+
+// Functions larger than the size classes get a slab of their own, which is
+// unmapped when they are freed.
+TEST(JITMemoryManagerTest, SizeClassLargeFunction) {
+  OwningPtr<JITMemoryManager> MemMgr(
+      JITMemoryManager::CreateSizeClassMemManager(false));
+  std::string Error;
+
+  OwningPtr<Function> F(makeFakeFunction());
+  uintptr_t size = 1024 * 1024;
+  uint8_t *Body = MemMgr->startFunctionBody(F.get(), size);
+  EXPECT_LE(1024U * 1024U, size);
+  memset(Body, 0xFF, 1024 * 1024);
+  MemMgr->endFunctionBody(F.get(), Body, Body + 1024 * 1024);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  EXPECT_EQ(1U, MemMgr->GetNumCodeSlabs());
+  EXPECT_LE(1024U * 1024U, MemMgr->getCommittedBytes());
+
+  MemMgr->deallocateFunctionBody(Body);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  EXPECT_EQ(0U, MemMgr->GetNumCodeSlabs());
+  EXPECT_EQ(0U, MemMgr->getCommittedBytes());
+}
+
+// Stubs, globals and exception tables do not share slabs with code.
+TEST(JITMemoryManagerTest, SizeClassSegregation) {
+  OwningPtr<JITMemoryManager> MemMgr(
+      JITMemoryManager::CreateSizeClassMemManager(false));
+  std::string Error;
+
+  OwningPtr<Function> F(makeFakeFunction());
+  uintptr_t size = 0;
+  uint8_t *Body = MemMgr->startFunctionBody(F.get(), size);
+  MemMgr->endFunctionBody(F.get(), Body, Body + 64);
+  uint8_t *Stub = MemMgr->allocateStub(F.get(), 16, 8);
+  uint8_t *Global = MemMgr->allocateGlobal(8, 8);
+  size = 0;
+  uint8_t *Table = MemMgr->startExceptionTable(F.get(), size);
+  MemMgr->endExceptionTable(F.get(), Table, Table + 32, 0);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  EXPECT_EQ(1U, MemMgr->GetNumCodeSlabs());
+  EXPECT_EQ(1U, MemMgr->GetNumStubSlabs());
+  EXPECT_EQ(2U, MemMgr->GetNumDataSlabs());
+  EXPECT_EQ(0U, (uintptr_t)Stub % 8);
+  EXPECT_EQ(0U, (uintptr_t)Global % 8);
+
+  MemMgr->deallocateExceptionTable(Table);
+  MemMgr->deallocateFunctionBody(Body);
+  EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+}
+
+// With W^X, code can be written between setMemoryWritable and
+// setMemoryExecutable, including into freed memory that is reused.
+TEST(JITMemoryManagerTest, SizeClassWriteXorExecute) {
+  OwningPtr<JITMemoryManager> MemMgr(
+      JITMemoryManager::CreateSizeClassMemManager(true));
+  std::string Error;
+
+  OwningPtr<Function> F(makeFakeFunction());
+  for (unsigned i = 0; i != 4; ++i) {
+    MemMgr->setMemoryWritable();
+    uintptr_t size = 0;
+    uint8_t *Body = MemMgr->startFunctionBody(F.get(), size);
+    memset(Body, 0xFF, 500);
+    MemMgr->endFunctionBody(F.get(), Body, Body + 500);
+    MemMgr->setMemoryExecutable();
+    EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+
+    MemMgr->setMemoryWritable();
+    MemMgr->setCodeWritable(Body, 16);
+    memset(Body, 0xCC, 16);
+    MemMgr->setMemoryExecutable();
+
+    MemMgr->deallocateFunctionBody(Body);
+    EXPECT_TRUE(MemMgr->CheckInvariants(Error)) << Error;
+  }
+  EXPECT_EQ(1U, MemMgr->GetNumCodeSlabs());
+}
+
 }
@@ -13,10 +13,13 @@
 #include "llvm/Assembly/Parser.h"
 #include "llvm/BasicBlock.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Config/config.h"
 #include "llvm/Constant.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/JIT.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/JITMemoryManager.h"
 #include "llvm/Function.h"
 #include "llvm/GlobalValue.h"
@@ -25,11 +28,16 @@
 #include "llvm/Module.h"
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/TypeBuilder.h"
 #include "llvm/Target/TargetSelect.h"
 #include "llvm/Type.h"
 
+#include <map>
 #include <vector>
 
 using namespace llvm;
@@ -651,6 +659,183 @@ TEST_F(JITTest, EscapedLazyStubStillCallable) {
   EXPECT_EQ(42, stubbed());
 }
 
+#if ENABLE_THREADS
+// Records the code of every function the JIT emits, and whether it was
+// emitted on the thread that created the listener.
+class EmittingThreadListener : public JITEventListener {
+  sys::ThreadLocal<const EmittingThreadListener> Creator;
+  sys::Mutex Lock;
+  struct Emission {
+    void *Code;
+    bool OnCreatorThread;
+  };
+  std::map<const Function*, Emission> Emitted;
+
+public:
+  EmittingThreadListener() { Creator.set(this); }
+
+  virtual void NotifyFunctionEmitted(const Function &F, void *Code, size_t,
+                                     const EmittedFunctionDetails &) {
+    MutexGuard Locked(Lock);
+    Emission &E = Emitted[&F];
+    E.Code = Code;
+    E.OnCreatorThread = Creator.get() == this;
+  }
+
+  /// getCode - Return the code F was emitted at, or null if it has not been
+  /// emitted yet.  OnCreatorThread is set to where it was emitted.
+  void *getCode(const Function *F, bool &OnCreatorThread) {
+    MutexGuard Locked(Lock);
+    std::map<const Function*, Emission>::iterator I = Emitted.find(F);
+    if (I == Emitted.end())
+      return 0;
+    OnCreatorThread = I->second.OnCreatorThread;
+    return I->second.Code;
+  }
+};
+
+// The background compiler compiles the functions behind lazy stubs on its own
+// thread and retargets the stubs, and calls through them keep working.
+TEST_F(JITTest, BackgroundCompiledFunctionsStillCallable) {
+  ASSERT_TRUE(llvm_start_multithreaded());
+  EmittingThreadListener Listener;
+  TheJIT->RegisterJITEventListener(&Listener);
+  TheJIT->DisableLazyCompilation(false);
+  TheJIT->EnableBackgroundCompilation();
+  LoadAssembly("define internal i32 @add1(i32 %x) { "
+               "  %r = add i32 %x, 1 "
+               "  ret i32 %r "
+               "} "
+               " "
+               "define i32 @add3(i32 %x) { "
+               "  %a = call i32 @add1(i32 %x) "
+               "  %b = call i32 @add1(i32 %a) "
+               "  %c = call i32 @add1(i32 %b) "
+               "  ret i32 %c "
+               "} ");
+  Function *Add1 = M->getFunction("add1");
+  int32_t (*add3)(int32_t) = reinterpret_cast<int32_t(*)(int32_t)>(
+    (intptr_t)TheJIT->getPointerToFunction(M->getFunction("add3")));
+
+  // Compiling add3 in the background hands out the stub of add1, which queues
+  // it for the background compiler as well.  Nothing is called until then, so
+  // nothing can be compiled on this thread.
+  bool OnThisThread = true;
+  void *Add1Code = 0;
+  for (unsigned Tries = 0; !Add1Code && Tries != 1U << 28; ++Tries)
+    Add1Code = Listener.getCode(Add1, OnThisThread);
+  ASSERT_TRUE(Add1Code != 0) << "add1 was not compiled in the background";
+  EXPECT_FALSE(OnThisThread);
+
+  // The background compiler holds the JIT lock until it has retargeted the
+  // stub, so once the lock is free add1 resolves to its code.
+  {
+    MutexGuard Locked(TheJIT->lock);
+    EXPECT_EQ(Add1Code, TheJIT->getPointerToGlobalIfAvailable(Add1));
+  }
+  for (int32_t i = 0; i != 100; ++i)
+    EXPECT_EQ(i + 3, add3(i));
+  TheJIT->UnregisterJITEventListener(&Listener);
+}
+#endif
+
+// runFunction calls functions with a signature it cannot call directly
+// through a stub that it builds and erases again.
+TEST_F(JITTest, RunFunctionThroughStub) {
+  LoadAssembly("define i64 @sub3(i64 %a, i64 %b, i64 %c) { "
+               "  %d = sub i64 %a, %b "
+               "  %e = sub i64 %d, %c "
+               "  ret i64 %e "
+               "} ");
+  Function *Sub3 = M->getFunction("sub3");
+  size_t NumFunctions = M->size();
+  std::vector<GenericValue> Args(3);
+  for (unsigned i = 0; i != 10; ++i) {
+    Args[0].IntVal = APInt(64, 100);
+    Args[1].IntVal = APInt(64, i);
+    Args[2].IntVal = APInt(64, 2 * i);
+    GenericValue Result = TheJIT->runFunction(Sub3, Args);
+    EXPECT_EQ(100 - 3 * i, Result.IntVal.getZExtValue());
+  }
+  EXPECT_EQ(NumFunctions, M->size());
+}
+
+// Counts the functions the JIT compiled and the ones it loaded from its code
+// cache, which come without a machine function.
+class CodeCacheListener : public JITEventListener {
+public:
+  unsigned Compiled, Loaded;
+  CodeCacheListener() : Compiled(0), Loaded(0) {}
+
+  virtual void NotifyFunctionEmitted(const Function &, void *, size_t,
+                                     const EmittedFunctionDetails &Details) {
+    if (Details.MF)
+      ++Compiled;
+    else
+      ++Loaded;
+  }
+};
+
+const char CodeCacheAssembly[] =
+  "@table = global [4 x i32] [i32 3, i32 5, i32 7, i32 11] "
+  " "
+  "define i32 @pick(i32 %x) { "
+  "entry: "
+  "  switch i32 %x, label %other [ i32 0, label %a "
+  "                                i32 1, label %b "
+  "                                i32 2, label %c "
+  "                                i32 3, label %d ] "
+  "a: "
+  "  %p = getelementptr [4 x i32]* @table, i32 0, i32 3 "
+  "  %v = load i32* %p "
+  "  ret i32 %v "
+  "b: "
+  "  ret i32 20 "
+  "c: "
+  "  %f = fmul double 2.5, 4.0 "
+  "  %i = fptosi double %f to i32 "
+  "  ret i32 %i "
+  "d: "
+  "  ret i32 40 "
+  "other: "
+  "  ret i32 -1 "
+  "} ";
+
+TEST(JIT, CodeCacheReusesCompiledFunctions) {
+  std::string ErrMsg;
+  sys::Path CacheDir = sys::Path::GetTemporaryDirectory(&ErrMsg);
+  ASSERT_FALSE(CacheDir.isEmpty()) << ErrMsg;
+
+  // The second JIT, over a module of its own, loads what the first stored.
+  for (unsigned Run = 0; Run != 2; ++Run) {
+    LLVMContext Context;
+    Module *M = new Module("<main>", Context);
+    ASSERT_TRUE(LoadAssemblyInto(M, CodeCacheAssembly));
+    OwningPtr<ExecutionEngine> JIT(EngineBuilder(M)
+                                   .setEngineKind(EngineKind::JIT)
+                                   .setErrorStr(&ErrMsg)
+                                   .setAllocateGVsWithCode(false)
+                                   .create());
+    ASSERT_TRUE(JIT.get() != NULL) << ErrMsg;
+    JIT->setCodeCacheDirectory(CacheDir.str());
+    CodeCacheListener Listener;
+    JIT->RegisterJITEventListener(&Listener);
+
+    int32_t (*Pick)(int32_t) = reinterpret_cast<int32_t(*)(int32_t)>(
+      (intptr_t)JIT->getPointerToFunction(M->getFunction("pick")));
+    EXPECT_EQ(11, Pick(0));
+    EXPECT_EQ(20, Pick(1));
+    EXPECT_EQ(10, Pick(2));
+    EXPECT_EQ(40, Pick(3));
+    EXPECT_EQ(-1, Pick(4));
+
+    EXPECT_EQ(Run == 0 ? 1U : 0U, Listener.Compiled);
+    EXPECT_EQ(Run == 0 ? 0U : 1U, Listener.Loaded);
+    JIT->UnregisterJITEventListener(&Listener);
+  }
+  CacheDir.eraseFromDisk(true);
+}
+
 // Converts the LLVM assembly to bitcode and returns it in a std::string.  An
 // empty string indicates an error.
 std::string AssembleToBitcode(LLVMContext &Context, const char *Assembly) {
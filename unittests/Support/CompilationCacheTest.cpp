@@ -0,0 +1,98 @@
+//===- llvm/unittest/Support/CompilationCacheTest.cpp - Cache tests -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CompilationCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class CompilationCacheTest : public testing::Test {
+protected:
+  sys::Path Dir;
+
+  virtual void SetUp() {
+    std::string ErrMsg;
+    Dir = sys::Path::GetTemporaryDirectory(&ErrMsg);
+    ASSERT_FALSE(Dir.isEmpty()) << ErrMsg;
+  }
+
+  virtual void TearDown() {
+    Dir.eraseFromDisk(true);
+  }
+
+  // Pretend that the entry for Key was last used at Seconds.
+  void setLastUse(StringRef Key, int64_t Seconds) {
+    sys::PathWithStatus Entry(Dir);
+    Entry.appendComponent(Key);
+    const sys::FileStatus *FS = Entry.getFileStatus(true);
+    ASSERT_TRUE(FS != 0);
+    sys::FileStatus Used = *FS;
+    Used.modTime = sys::TimeValue(Seconds, 0);
+    ASSERT_FALSE(Entry.setStatusInfoOnDisk(Used));
+  }
+};
+
+TEST_F(CompilationCacheTest, Keys) {
+  std::string AB_C = CompilationCache::KeyBuilder().add("ab").add("c").getKey();
+  std::string A_BC = CompilationCache::KeyBuilder().add("a").add("bc").getKey();
+  EXPECT_EQ(32U, AB_C.size());
+  EXPECT_NE(AB_C, A_BC);
+  EXPECT_EQ(AB_C, CompilationCache::KeyBuilder().add("ab").add("c").getKey());
+  EXPECT_NE(CompilationCache::KeyBuilder().add(uint64_t(1)).getKey(),
+            CompilationCache::KeyBuilder().add(uint64_t(2)).getKey());
+}
+
+TEST_F(CompilationCacheTest, StoreAndLookup) {
+  CompilationCache Cache(Dir.str());
+  OwningPtr<MemoryBuffer> Result;
+  EXPECT_FALSE(Cache.lookup("0123", Result));
+
+  std::string ErrMsg;
+  ASSERT_FALSE(Cache.store("0123", "object", ErrMsg)) << ErrMsg;
+  ASSERT_TRUE(Cache.lookup("0123", Result));
+  EXPECT_EQ("object", Result->getBuffer().str());
+
+  // Storing again replaces the entry.
+  ASSERT_FALSE(Cache.store("0123", "other", ErrMsg)) << ErrMsg;
+  ASSERT_TRUE(Cache.lookup("0123", Result));
+  EXPECT_EQ("other", Result->getBuffer().str());
+}
+
+TEST_F(CompilationCacheTest, EvictsLeastRecentlyUsed) {
+  CompilationCache Cache(Dir.str());
+  std::string ErrMsg;
+  ASSERT_FALSE(Cache.store("a", "0123456789", ErrMsg)) << ErrMsg;
+  ASSERT_FALSE(Cache.store("b", "0123456789", ErrMsg)) << ErrMsg;
+  ASSERT_FALSE(Cache.store("c", "0123456789", ErrMsg)) << ErrMsg;
+  setLastUse("a", 1000);
+  setLastUse("b", 3000);
+  setLastUse("c", 2000);
+
+  Cache.setMaxSize(25);
+  Cache.prune();
+
+  OwningPtr<MemoryBuffer> Result;
+  EXPECT_FALSE(Cache.lookup("a", Result));
+  EXPECT_TRUE(Cache.lookup("b", Result));
+  EXPECT_TRUE(Cache.lookup("c", Result));
+
+  // Storing a new entry evicts the least recently used one again.
+  setLastUse("b", 4000);
+  setLastUse("c", 2000);
+  ASSERT_FALSE(Cache.store("d", "0123456789", ErrMsg)) << ErrMsg;
+  EXPECT_TRUE(Cache.lookup("b", Result));
+  EXPECT_FALSE(Cache.lookup("c", Result));
+  EXPECT_TRUE(Cache.lookup("d", Result));
+}
+
+}
@@ -0,0 +1,57 @@
+//===- llvm/unittest/Support/MD5Test.cpp - MD5 tests ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/MD5.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace llvm;
+
+namespace {
+
+std::string hash(StringRef Input) {
+  MD5 Hash;
+  Hash.update(Input);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  return Str.str().str();
+}
+
+TEST(MD5Test, RFC1321) {
+  EXPECT_EQ("d41d8cd98f00b204e9800998ecf8427e", hash(""));
+  EXPECT_EQ("0cc175b9c0f1b6a831c399e269772661", hash("a"));
+  EXPECT_EQ("900150983cd24fb0d6963f7d28e17f72", hash("abc"));
+  EXPECT_EQ("f96b697d7cb7938d525a2f31aaf161d0", hash("message digest"));
+  EXPECT_EQ("c3fcd3d76192e4007dfb496cca67e13b",
+            hash("abcdefghijklmnopqrstuvwxyz"));
+  EXPECT_EQ("57edf4a22be3c955ac49da2e2107b67a",
+            hash("1234567890123456789012345678901234567890"
+                 "1234567890123456789012345678901234567890"));
+}
+
+TEST(MD5Test, IncrementalUpdate) {
+  // Feeding the input in pieces that straddle block boundaries must give
+  // the same digest as hashing it at once.
+  std::string Input;
+  for (unsigned i = 0; i != 300; ++i)
+    Input += char('a' + i % 26);
+
+  MD5 Hash;
+  for (unsigned i = 0, Step = 1; i < Input.size(); i += Step, Step += 7)
+    Hash.update(StringRef(Input).substr(i, Step));
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  EXPECT_EQ(hash(Input), Str.str().str());
+}
+
+}
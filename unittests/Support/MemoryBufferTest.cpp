@@ -0,0 +1,65 @@
+//===- llvm/unittest/Support/MemoryBufferTest.cpp - MemoryBuffer tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+TEST(MemoryBufferTest, NoNullTerminatorIsNotCopied) {
+  const char Data[] = "abcdef";
+  OwningPtr<MemoryBuffer> Buf(
+    MemoryBuffer::getMemBuffer(StringRef(Data, 3), "slice", false));
+  EXPECT_EQ(Data, Buf->getBufferStart());
+  EXPECT_EQ(3U, Buf->getBufferSize());
+  EXPECT_EQ("abc", Buf->getBuffer());
+  EXPECT_EQ(std::string("slice"), Buf->getBufferIdentifier());
+}
+
+TEST(MemoryBufferTest, PageSizedFile) {
+  // A file that is exactly a multiple of the page size can only be mapped if
+  // the client does not need a null terminator.  Both ways must see the same
+  // contents.
+  int FD;
+  SmallString<64> TempPath;
+  ASSERT_FALSE(sys::fs::unique_file("%%-%%-%%-%%.temp", FD, TempPath));
+
+  size_t Size = 4 * sys::Process::GetPageSize();
+  std::string Contents;
+  for (size_t i = 0; i != Size; ++i)
+    Contents += char('a' + i % 26);
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Contents;
+  }
+
+  OwningPtr<MemoryBuffer> Mapped;
+  ASSERT_FALSE(MemoryBuffer::getFile(TempPath.c_str(), Mapped, -1, false));
+  EXPECT_EQ(Size, Mapped->getBufferSize());
+  EXPECT_TRUE(Mapped->getBuffer() == Contents);
+
+  OwningPtr<MemoryBuffer> Read;
+  ASSERT_FALSE(MemoryBuffer::getFile(TempPath.c_str(), Read));
+  EXPECT_EQ(Size, Read->getBufferSize());
+  EXPECT_EQ(0, *Read->getBufferEnd());
+  EXPECT_TRUE(Read->getBuffer() == Contents);
+
+  bool Existed;
+  sys::fs::remove(TempPath.str(), Existed);
+}
+
+}
@@ -0,0 +1,69 @@
+//===- llvm/unittest/Support/ThreadPoolTest.cpp - ThreadPool tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/Threading.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+void Increment(void *Arg) {
+  sys::AtomicIncrement(static_cast<volatile sys::cas_flag*>(Arg));
+}
+
+TEST(ThreadPoolTest, SingleThreadRunsInline) {
+  volatile sys::cas_flag Count = 0;
+  ThreadPool Pool(1);
+  EXPECT_FALSE(Pool.isParallel());
+  EXPECT_EQ(1U, Pool.getNumThreads());
+  Pool.async(Increment, (void*)&Count);
+  // No wait() needed: the task ran on this thread.
+  EXPECT_EQ(1U, Count);
+}
+
+TEST(ThreadPoolTest, RunsEveryTask) {
+  if (!llvm_is_multithreaded())
+    llvm_start_multithreaded();
+
+  volatile sys::cas_flag Count = 0;
+  ThreadPool Pool(4);
+  for (unsigned i = 0; i != 1000; ++i)
+    Pool.async(Increment, (void*)&Count);
+  Pool.wait();
+  EXPECT_EQ(1000U, Count);
+
+  // The pool can be reused after wait().
+  for (unsigned i = 0; i != 10; ++i)
+    Pool.async(Increment, (void*)&Count);
+  Pool.wait();
+  EXPECT_EQ(1010U, Count);
+}
+
+TEST(ThreadPoolTest, DestructorDrainsQueue) {
+  if (!llvm_is_multithreaded())
+    llvm_start_multithreaded();
+
+  volatile sys::cas_flag Count = 0;
+  {
+    ThreadPool Pool(2);
+    for (unsigned i = 0; i != 100; ++i)
+      Pool.async(Increment, (void*)&Count);
+  }
+  EXPECT_EQ(100U, Count);
+}
+
+TEST(ThreadPoolTest, HardwareConcurrency) {
+  EXPECT_LE(1U, ThreadPool::getHardwareConcurrency());
+}
+
+}
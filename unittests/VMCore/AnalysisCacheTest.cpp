@@ -0,0 +1,214 @@
+//===- AnalysisCacheTest.cpp - Analysis results kept across runs ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/AnalysisCache.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "gtest/gtest.h"
+
+namespace llvm {
+  void initializeCountingAnalysisPass(PassRegistry&);
+
+namespace {
+
+/// CountingAnalysis - A function analysis that counts how often it runs.
+struct CountingAnalysis : public FunctionPass {
+  static char ID;
+  static unsigned Runs;
+  Function *Analyzed;
+  unsigned NumBlocks;
+  CountingAnalysis() : FunctionPass(ID), Analyzed(0), NumBlocks(0) {}
+  virtual bool runOnFunction(Function &F) {
+    ++Runs;
+    Analyzed = &F;
+    NumBlocks = F.size();
+    return false;
+  }
+  virtual void releaseMemory() { Analyzed = 0; NumBlocks = 0; }
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+  }
+};
+char CountingAnalysis::ID = 0;
+unsigned CountingAnalysis::Runs = 0;
+
+/// UserPass - Checks that it is handed results for the right function.
+struct UserPass : public FunctionPass {
+  static char ID;
+  UserPass() : FunctionPass(ID) {}
+  virtual bool runOnFunction(Function &F) {
+    EXPECT_EQ(&F, getAnalysis<CountingAnalysis>().Analyzed);
+    return false;
+  }
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<CountingAnalysis>();
+    AU.setPreservesAll();
+  }
+};
+char UserPass::ID = 0;
+
+/// ChangingPass - Claims to change every function, preserving the analysis
+/// or not.
+struct ChangingPass : public FunctionPass {
+  static char ID;
+  bool Preserve;
+  explicit ChangingPass(bool Preserve)
+    : FunctionPass(ID), Preserve(Preserve) {}
+  virtual bool runOnFunction(Function &F) { return true; }
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    if (Preserve)
+      AU.addPreserved<CountingAnalysis>();
+  }
+};
+char ChangingPass::ID = 0;
+
+/// ModuleUserPass - Asks for the analysis of every function on the fly.
+struct ModuleUserPass : public ModulePass {
+  static char ID;
+  ModuleUserPass() : ModulePass(ID) {}
+  virtual bool runOnModule(Module &M) {
+    for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if (!F->isDeclaration()) {
+        EXPECT_EQ(&*F, getAnalysis<CountingAnalysis>(*F).Analyzed);
+      }
+    return false;
+  }
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<CountingAnalysis>();
+    AU.setPreservesAll();
+  }
+};
+char ModuleUserPass::ID = 0;
+
+/// ModuleChangingPass - Adds a block to every function between two requests
+/// for its analysis.
+struct ModuleChangingPass : public ModulePass {
+  static char ID;
+  ModuleChangingPass() : ModulePass(ID) {}
+  virtual bool runOnModule(Module &M) {
+    for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+      if (F->isDeclaration())
+        continue;
+      unsigned NumBlocks = F->size();
+      EXPECT_EQ(NumBlocks, getAnalysis<CountingAnalysis>(*F).NumBlocks);
+      LLVMContext &Context = M.getContext();
+      ReturnInst::Create(Context, BasicBlock::Create(Context, "dead", F));
+      EXPECT_EQ(NumBlocks + 1, getAnalysis<CountingAnalysis>(*F).NumBlocks);
+    }
+    return true;
+  }
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<CountingAnalysis>();
+  }
+};
+char ModuleChangingPass::ID = 0;
+
+static Function *makeFunction(Module *M, const char *Name) {
+  LLVMContext &Context = M->getContext();
+  Function *F = Function::Create(FunctionType::get(Type::getVoidTy(Context),
+                                                   false),
+                                 GlobalValue::ExternalLinkage, Name, M);
+  ReturnInst::Create(Context, BasicBlock::Create(Context, "entry", F));
+  return F;
+}
+
+class AnalysisCacheTest : public testing::Test {
+protected:
+  LLVMContext Context;
+  OwningPtr<Module> M;
+  AnalysisCache Cache;
+
+  virtual void SetUp() {
+    initializeCountingAnalysisPass(*PassRegistry::getPassRegistry());
+    M.reset(new Module("m", Context));
+    makeFunction(M.get(), "f");
+    makeFunction(M.get(), "g");
+    Cache.addAnalysis(&CountingAnalysis::ID);
+    CountingAnalysis::Runs = 0;
+  }
+
+  void runFunctionPasses(Pass *P1, Pass *P2 = 0, Pass *P3 = 0) {
+    FunctionPassManager FPM(M.get());
+    FPM.setAnalysisCache(&Cache);
+    FPM.add(P1);
+    if (P2)
+      FPM.add(P2);
+    if (P3)
+      FPM.add(P3);
+    FPM.doInitialization();
+    for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F)
+      FPM.run(*F);
+    FPM.doFinalization();
+  }
+};
+
+TEST_F(AnalysisCacheTest, ReusedAcrossRuns) {
+  runFunctionPasses(new UserPass(), new UserPass());
+  EXPECT_EQ(2U, CountingAnalysis::Runs);
+  runFunctionPasses(new UserPass());
+  EXPECT_EQ(2U, CountingAnalysis::Runs);
+  EXPECT_EQ(2U, Cache.getNumMisses());
+  EXPECT_EQ(2U, Cache.getNumHits());
+}
+
+TEST_F(AnalysisCacheTest, InvalidatedByChanges) {
+  runFunctionPasses(new UserPass(), new ChangingPass(false), new UserPass());
+  EXPECT_EQ(4U, CountingAnalysis::Runs);
+  runFunctionPasses(new UserPass(), new ChangingPass(true), new UserPass());
+  EXPECT_EQ(4U, CountingAnalysis::Runs);
+
+  Cache.invalidate(*M->getFunction("f"));
+  runFunctionPasses(new UserPass());
+  EXPECT_EQ(5U, CountingAnalysis::Runs);
+}
+
+TEST_F(AnalysisCacheTest, SharedWithModulePasses) {
+  PassManager PM;
+  PM.setAnalysisCache(&Cache);
+  PM.add(new ModuleUserPass());
+  PM.add(new ModuleUserPass());
+  PM.run(*M);
+  EXPECT_EQ(2U, CountingAnalysis::Runs);
+
+  runFunctionPasses(new UserPass());
+  EXPECT_EQ(2U, CountingAnalysis::Runs);
+}
+
+TEST_F(AnalysisCacheTest, ChangedWithinModulePass) {
+  runFunctionPasses(new UserPass());
+  EXPECT_EQ(2U, CountingAnalysis::Runs);
+
+  PassManager PM;
+  PM.setAnalysisCache(&Cache);
+  PM.add(new ModuleChangingPass());
+  PM.run(*M);
+  EXPECT_EQ(4U, CountingAnalysis::Runs);
+}
+
+TEST_F(AnalysisCacheTest, FunctionDeleted) {
+  runFunctionPasses(new UserPass());
+  EXPECT_EQ(2U, CountingAnalysis::Runs);
+
+  M->getFunction("f")->eraseFromParent();
+  makeFunction(M.get(), "f");
+  runFunctionPasses(new UserPass());
+  EXPECT_EQ(3U, CountingAnalysis::Runs);
+}
+
+} // end anonymous namespace
+} // end namespace llvm
+
+using namespace llvm;
+INITIALIZE_PASS(CountingAnalysis, "counting-analysis", "Counting Analysis",
+                false, true)
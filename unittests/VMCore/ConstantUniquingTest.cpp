@@ -0,0 +1,168 @@
+//===- llvm/unittest/VMCore/ConstantUniquingTest.cpp - Uniquing tests -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/InstrTypes.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/TimeValue.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace llvm {
+namespace {
+
+TEST(ConstantUniquingTest, Exprs) {
+  LLVMContext Context;
+  const Type *Int32 = Type::getInt32Ty(Context);
+  OwningPtr<Module> M(new Module("m", Context));
+  Constant *G = new GlobalVariable(*M, Int32, false,
+                                   GlobalValue::ExternalLinkage, 0, "g");
+  Constant *One = ConstantInt::get(Int32, 1);
+
+  Constant *Add = ConstantExpr::getAdd(ConstantExpr::getPtrToInt(G, Int32),
+                                       One);
+  EXPECT_EQ(Add, ConstantExpr::getAdd(ConstantExpr::getPtrToInt(G, Int32),
+                                      One));
+  EXPECT_NE(Add, ConstantExpr::getNSWAdd(ConstantExpr::getPtrToInt(G, Int32),
+                                         One));
+  EXPECT_NE(Add, ConstantExpr::getSub(ConstantExpr::getPtrToInt(G, Int32),
+                                      One));
+
+  Constant *EQ = ConstantExpr::getICmp(CmpInst::ICMP_EQ, G, G);
+  EXPECT_EQ(EQ, ConstantExpr::getICmp(CmpInst::ICMP_EQ, G, G));
+  EXPECT_NE(EQ, ConstantExpr::getICmp(CmpInst::ICMP_NE, G, G));
+
+  const Type *Int64 = Type::getInt64Ty(Context);
+  EXPECT_NE(ConstantExpr::getPtrToInt(G, Int32),
+            ConstantExpr::getPtrToInt(G, Int64));
+}
+
+TEST(ConstantUniquingTest, Aggregates) {
+  LLVMContext Context;
+  const Type *Int32 = Type::getInt32Ty(Context);
+  std::vector<Constant*> Elts;
+  for (unsigned i = 0; i != 4; ++i)
+    Elts.push_back(ConstantInt::get(Int32, i + 1));
+
+  const ArrayType *ATy = ArrayType::get(Int32, 4);
+  Constant *A = ConstantArray::get(ATy, Elts);
+  EXPECT_EQ(A, ConstantArray::get(ATy, Elts));
+  EXPECT_EQ(A, ConstantArray::get(ATy, &Elts[0], Elts.size()));
+
+  Constant *S = ConstantStruct::get(Context, Elts, false);
+  EXPECT_EQ(S, ConstantStruct::get(Context, Elts, false));
+  EXPECT_NE(S, ConstantStruct::get(Context, Elts, true));
+
+  Constant *V = ConstantVector::get(Elts);
+  EXPECT_EQ(V, ConstantVector::get(Elts));
+
+  std::swap(Elts[0], Elts[1]);
+  EXPECT_NE(A, ConstantArray::get(ATy, Elts));
+  EXPECT_NE(S, ConstantStruct::get(Context, Elts, false));
+  EXPECT_NE(V, ConstantVector::get(Elts));
+}
+
+TEST(ConstantUniquingTest, Destroy) {
+  LLVMContext Context;
+  const Type *Int32 = Type::getInt32Ty(Context);
+  const ArrayType *ATy = ArrayType::get(Int32, 2);
+
+  // Create enough arrays to grow the table, destroy every other one, and
+  // check that the rest are still found and the others are recreated.
+  std::vector<Constant*> Arrays;
+  for (unsigned i = 0; i != 1000; ++i) {
+    Constant *Elts[] = { ConstantInt::get(Int32, i),
+                         ConstantInt::get(Int32, 7) };
+    Arrays.push_back(ConstantArray::get(ATy, Elts, 2));
+  }
+  for (unsigned i = 0; i < 1000; i += 2)
+    Arrays[i]->destroyConstant();
+  for (unsigned i = 0; i != 1000; ++i) {
+    Constant *Elts[] = { ConstantInt::get(Int32, i),
+                         ConstantInt::get(Int32, 7) };
+    Constant *A = ConstantArray::get(ATy, Elts, 2);
+    if (i % 2) {
+      EXPECT_EQ(Arrays[i], A);
+    }
+    EXPECT_EQ(A, ConstantArray::get(ATy, Elts, 2));
+  }
+}
+
+TEST(ConstantUniquingTest, ReplaceOperand) {
+  LLVMContext Context;
+  const Type *Int32 = Type::getInt32Ty(Context);
+  OwningPtr<Module> M(new Module("m", Context));
+  GlobalVariable *G1 = new GlobalVariable(*M, Int32, false,
+                                          GlobalValue::ExternalLinkage, 0,
+                                          "g1");
+  GlobalVariable *G2 = new GlobalVariable(*M, Int32, false,
+                                          GlobalValue::ExternalLinkage, 0,
+                                          "g2");
+  GlobalVariable *G3 = new GlobalVariable(*M, Int32, false,
+                                          GlobalValue::ExternalLinkage, 0,
+                                          "g3");
+  const ArrayType *ATy = ArrayType::get(G1->getType(), 2);
+
+  // Replacing G1 with G3 updates the array and the struct in place, so they
+  // must be found under their new operands.
+  Constant *Elts[] = { G1, G2 };
+  Constant *A = ConstantArray::get(ATy, Elts, 2);
+  Constant *S = ConstantStruct::get(Context, Elts, 2, false);
+  G1->replaceAllUsesWith(G3);
+  Elts[0] = G3;
+  EXPECT_EQ(A, ConstantArray::get(ATy, Elts, 2));
+  EXPECT_EQ(S, ConstantStruct::get(Context, Elts, 2, false));
+
+  // Replacing G3 with G2 makes the array the same as one that already
+  // exists, which takes its place.
+  Constant *Same[] = { G2, G2 };
+  Constant *A2 = ConstantArray::get(ATy, Same, 2);
+  Constant *S2 = ConstantStruct::get(Context, Same, 2, false);
+  GlobalVariable *User =
+    new GlobalVariable(*M, ATy, false, GlobalValue::ExternalLinkage, A, "u");
+  G3->replaceAllUsesWith(G2);
+  EXPECT_EQ(A2, User->getInitializer());
+  EXPECT_EQ(A2, ConstantArray::get(ATy, Same, 2));
+  EXPECT_EQ(S2, ConstantStruct::get(Context, Same, 2, false));
+}
+
+TEST(ConstantUniquingTest, CreationRate) {
+  // Measure how many constant expressions and aggregates the uniquing tables
+  // create and look up per second, as a benchmark of ConstantUniqueMap.
+  LLVMContext Context;
+  const Type *Int32 = Type::getInt32Ty(Context);
+  const ArrayType *ATy = ArrayType::get(Int32, 4);
+  const unsigned N = 50000;
+
+  sys::TimeValue Start = sys::TimeValue::now();
+  unsigned NumConstants = 0;
+  for (unsigned Round = 0; Round != 2; ++Round) {
+    for (unsigned i = 0; i != N; ++i) {
+      Constant *C = ConstantInt::get(Int32, i);
+      Constant *Elts[] = { C, C, ConstantInt::get(Int32, i + 1), C };
+      ConstantArray::get(ATy, Elts, 4);
+      ConstantStruct::get(Context, Elts, 4, false);
+      ConstantExpr::getGetElementPtr(
+        ConstantExpr::getIntToPtr(C, PointerType::getUnqual(ATy)), Elts, 2);
+      NumConstants += 4;
+    }
+  }
+  sys::TimeValue Elapsed = sys::TimeValue::now() - Start;
+
+  double Seconds = Elapsed.seconds() + Elapsed.nanoseconds() / 1e9;
+  if (Seconds > 0)
+    RecordProperty("ConstantsPerSecond", int(NumConstants / Seconds));
+}
+
+} // end anonymous namespace
+} // end namespace llvm
@@ -0,0 +1,205 @@
+//===- llvm/unittest/VMCore/IRArenaTest.cpp - Arena allocated IR tests ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/TimeValue.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace llvm {
+namespace {
+
+/// buildBody - Give F a loop that sums its argument NumAdds times, using
+/// binary operators, compares, a PHI, a call and branches.
+static void buildBody(Function *F, unsigned NumAdds) {
+  LLVMContext &Context = F->getContext();
+  BasicBlock *Entry = BasicBlock::Create(Context, "entry", F);
+  BasicBlock *Loop = BasicBlock::Create(Context, "loop", F);
+  BasicBlock *Exit = BasicBlock::Create(Context, "exit", F);
+  IRBuilder<> Builder(Entry);
+  Value *Arg = F->arg_begin();
+  Builder.CreateBr(Loop);
+
+  Builder.SetInsertPoint(Loop);
+  PHINode *Phi = Builder.CreatePHI(Arg->getType(), "i");
+  Phi->addIncoming(Arg, Entry);
+  Value *V = Phi;
+  for (unsigned i = 0; i != NumAdds; ++i)
+    V = Builder.CreateAdd(Builder.CreateMul(V, Arg), Builder.getInt32(i));
+  V = Builder.CreateCall(F, V);
+  Phi->addIncoming(V, Loop);
+  Builder.CreateCondBr(Builder.CreateICmpSLT(V, Arg), Loop, Exit);
+
+  Builder.SetInsertPoint(Exit);
+  Builder.CreateRet(V);
+}
+
+static Function *createFunction(Module *M) {
+  const Type *Int32 = Type::getInt32Ty(M->getContext());
+  std::vector<const Type*> Params(1, Int32);
+  return Function::Create(FunctionType::get(Int32, Params, false),
+                          GlobalValue::ExternalLinkage, "f", M);
+}
+
+TEST(IRArenaTest, Construction) {
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("m", Context));
+  Function *F = createFunction(M.get());
+  EXPECT_TRUE(F->getArena() == 0);
+  {
+    IRArenaScope Scope(*F);
+    buildBody(F, 4);
+  }
+  EXPECT_TRUE(F->getArena() != 0);
+  EXPECT_FALSE(verifyFunction(*F, ReturnStatusAction));
+
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      EXPECT_TRUE(I->isArenaAllocated());
+
+  // Instructions created after the scope is gone come from the heap, and
+  // both kinds can be erased from the same function.
+  BasicBlock &Exit = F->back();
+  Value *Arg = F->arg_begin();
+  Instruction *Sub = BinaryOperator::CreateSub(Arg, Arg, "", &Exit.back());
+  EXPECT_FALSE(Sub->isArenaAllocated());
+  Sub->eraseFromParent();
+  F->front().front().eraseFromParent();
+  new UnreachableInst(Context, &F->front());
+
+  // Clones made inside a scope come from the arena of that scope.
+  Instruction *Ret = &Exit.back();
+  {
+    IRArenaScope Scope(*F);
+    Instruction *Clone = Ret->clone();
+    EXPECT_TRUE(Clone->isArenaAllocated());
+    delete Clone;
+  }
+  Instruction *Clone = Ret->clone();
+  EXPECT_FALSE(Clone->isArenaAllocated());
+  delete Clone;
+
+  // Constants are shared by the whole context, so they never are.
+  {
+    IRArenaScope Scope(*F);
+    EXPECT_FALSE(cast<User>(ConstantExpr::getAdd(
+      ConstantExpr::getPtrToInt(F, Type::getInt32Ty(Context)),
+      ConstantInt::get(Type::getInt32Ty(Context), 1)))->isArenaAllocated());
+  }
+
+  // Deleting the body releases the arena and the function can be rebuilt.
+  F->deleteBody();
+  {
+    IRArenaScope Scope(*F);
+    buildBody(F, 4);
+  }
+  EXPECT_FALSE(verifyFunction(*F, ReturnStatusAction));
+  F->eraseFromParent();
+}
+
+TEST(IRArenaTest, Nesting) {
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("m", Context));
+  Function *F = createFunction(M.get());
+  Function *G = createFunction(M.get());
+  EXPECT_TRUE(IRArenaScope::getCurrentArena() == 0);
+  {
+    IRArenaScope FScope(*F);
+    EXPECT_EQ(F->getArena(), IRArenaScope::getCurrentArena());
+    {
+      IRArenaScope GScope(*G);
+      EXPECT_EQ(G->getArena(), IRArenaScope::getCurrentArena());
+      buildBody(G, 2);
+    }
+    EXPECT_EQ(F->getArena(), IRArenaScope::getCurrentArena());
+    buildBody(F, 2);
+  }
+  EXPECT_TRUE(IRArenaScope::getCurrentArena() == 0);
+  EXPECT_NE(F->getArena(), G->getArena());
+  EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+}
+
+#ifdef GTEST_HAS_DEATH_TEST
+#ifndef NDEBUG
+TEST(IRArenaTest, MoveToOtherFunction) {
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("m", Context));
+  Function *F = createFunction(M.get());
+  Function *G = createFunction(M.get());
+  {
+    IRArenaScope Scope(*F);
+    buildBody(F, 1);
+  }
+  buildBody(G, 1);
+
+  // Moving within the function is fine, moving into another one is not,
+  // whether the instruction or its whole block moves.
+  BasicBlock &Loop = *++F->begin();
+  BasicBlock &Exit = F->back();
+  Instruction *Br = Loop.getTerminator();
+  Br->moveBefore(&Exit.back());
+  Loop.getInstList().splice(Loop.end(), Exit.getInstList(), Br);
+  Instruction *Ret = &Exit.back();
+  EXPECT_DEATH(Ret->moveBefore(&G->back().back()),
+               "Arena allocated instruction moved into another function");
+  EXPECT_DEATH(Exit.moveAfter(&G->back()),
+               "Arena allocated instruction moved into another function");
+}
+#endif
+#endif
+
+/// buildAndErase - Build N functions and erase each one right away, as a front
+/// end that throws away short-lived functions does.  Returns the number of
+/// instructions that were created per second.
+static double buildAndErase(unsigned N, bool UseArena) {
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("m", Context));
+  const unsigned NumAdds = 64;
+
+  sys::TimeValue Start = sys::TimeValue::now();
+  for (unsigned i = 0; i != N; ++i) {
+    Function *F = createFunction(M.get());
+    if (UseArena) {
+      IRArenaScope Scope(*F);
+      buildBody(F, NumAdds);
+    } else {
+      buildBody(F, NumAdds);
+    }
+    F->eraseFromParent();
+  }
+  sys::TimeValue Elapsed = sys::TimeValue::now() - Start;
+
+  double Seconds = Elapsed.seconds() + Elapsed.nanoseconds() / 1e9;
+  // Each body has the branch, PHI, call, compare, conditional branch, return
+  // and two instructions per add.
+  return Seconds > 0 ? N * (6 + 2 * NumAdds) / Seconds : 0;
+}
+
+TEST(IRArenaTest, ConstructionRate) {
+  // Measure how fast IRBuilder builds and erases functions with and without
+  // an arena.
+  const unsigned N = 5000;
+  double HeapRate = buildAndErase(N, false);
+  double ArenaRate = buildAndErase(N, true);
+  if (HeapRate > 0 && ArenaRate > 0) {
+    RecordProperty("HeapInstructionsPerSecond", int(HeapRate));
+    RecordProperty("ArenaInstructionsPerSecond", int(ArenaRate));
+  }
+}
+
+} // end anonymous namespace
+} // end namespace llvm